@@ -0,0 +1,289 @@
+﻿/*!
+ *  @file       iocbench.cpp
+ *  @brief      Resolution benchmark of the IoC container.
+ *  @details    Measures resolves per second of Common::Ioc::IOC against
+ *              LEGACY_IOC, a copy of the container it replaced, which
+ *              looked factories up in an unordered_map keyed by
+ *              std::type_index and called them through std::any_cast'ed
+ *              std::function objects. Builds on Linux with the logbench
+ *              compatibility header, GCC 14 or later:
+ *
+ *                  g++ -std=c++23 -O2 -pthread -I../logbench/compat -include Windows.h \
+ *                      -I../../User/common -o iocbench iocbench.cpp \
+ *                      ../../User/common/{allocctr,arena,assert}.cpp \
+ *                      ../../User/common/{excption,ioc,iocscope,log,logchan,logfield,logmsg}.cpp \
+ *                      ../../User/common/{logprov,lograte,logsessn,logsite,strutil,tscclock}.cpp
+ *
+ *              Usage:
+ *
+ *                  iocbench [--resolves N] [--types N]
+ *
+ *              Both containers get the same factories for N distinct
+ *              types, 64 by default. Cached factories return a shared
+ *              instance and isolate the container overhead, created
+ *              factories call std::make_shared as production factories
+ *              do. Each case makes the given number of resolves, 10
+ *              million by default, cycling through the types. The scoped
+ *              case creates a SCOPE, resolves three scoped types from it
+ *              and destroys it, once per three resolves. Prints one JSON
+ *              object per case to stdout and a table to stderr.
+ */
+
+#include <any>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <typeindex>
+#include <unordered_map>
+#include <utility>
+
+#include "ioc.hpp"
+#include "iocscope.hpp"
+
+using namespace Common;
+
+namespace {
+
+/**
+ * @brief The IoC container as it was before type slots, reduced to the
+ * non-parameterized path.
+ */
+class LEGACY_IOC {
+public:
+    template<class T>
+    void
+    RegisterFactory(
+        Ioc::TYPE_FACTORY<T> InstanceFactory
+    )
+    {
+        IocContainerMap_[typeid(T)] = InstanceFactory;
+    }
+
+    template<class T>
+    std::shared_ptr<T>
+    Resolve()
+    {
+        const auto iterator = IocContainerMap_.find(typeid(T));
+        if (iterator == IocContainerMap_.end()) {
+            throw Ioc::FACTORY_NOT_FOUND_EXCEPTION{
+                std::format("Failed to find factory for \"{}\" in the factory map",
+                            typeid(T).name())
+            };
+        }
+
+        return std::any_cast<Ioc::TYPE_FACTORY<T>>(iterator->second)();
+    }
+
+private:
+    std::unordered_map<std::type_index, std::any> IocContainerMap_;
+};
+
+class SERVICE_BASE {
+public:
+    virtual ~SERVICE_BASE() = default;
+
+    virtual
+    int
+    GetId() const = 0;
+};
+
+template<int ID>
+class SERVICE : public SERVICE_BASE {
+public:
+    int
+    GetId() const override
+    {
+        return ID;
+    }
+};
+
+constexpr int MaxTypes = 128;
+
+/*!
+ * @brief Number of scoped types resolved per scope.
+ */
+constexpr int ScopedTypes = 3;
+
+enum class FACTORY_KIND {
+    Cached,
+    Created
+};
+
+template<class CONTAINER, int ID>
+void
+RegisterService(
+    CONTAINER &Container,
+    FACTORY_KIND Kind
+)
+{
+    if (Kind == FACTORY_KIND::Cached) {
+        auto instance = std::make_shared<SERVICE<ID>>();
+        Container.template RegisterFactory<SERVICE<ID>>([instance] {
+            return instance;
+        });
+    } else {
+        Container.template RegisterFactory<SERVICE<ID>>([] {
+            return std::make_shared<SERVICE<ID>>();
+        });
+    }
+}
+
+/*!
+ * @brief Resolves Resolves times, cycling through the first TypeCount types.
+ * @return The elapsed time and a checksum that keeps the calls alive.
+ */
+template<class CONTAINER, int... IDS>
+std::pair<std::chrono::nanoseconds, std::int64_t>
+ResolveLoop(
+    CONTAINER &Container,
+    std::uint64_t Resolves,
+    int TypeCount,
+    std::integer_sequence<int, IDS...>
+)
+{
+    using RESOLVER = int (*)(CONTAINER &);
+    static constexpr RESOLVER resolvers[] = {
+        [](CONTAINER &Container) {
+            return Container.template Resolve<SERVICE<IDS>>()->GetId();
+        }...
+    };
+
+    std::int64_t checksum = 0;
+    const auto begin = std::chrono::steady_clock::now();
+
+    for (std::uint64_t i = 0; i < Resolves;) {
+        for (int type = 0; type < TypeCount && i < Resolves; ++type, ++i) {
+            checksum += resolvers[type](Container);
+        }
+    }
+
+    return {std::chrono::steady_clock::now() - begin, checksum};
+}
+
+template<class CONTAINER>
+std::pair<std::chrono::nanoseconds, std::int64_t>
+RunCase(
+    FACTORY_KIND Kind,
+    std::uint64_t Resolves,
+    int TypeCount
+)
+{
+    CONTAINER container;
+
+    [&]<int... IDS>(std::integer_sequence<int, IDS...>) {
+        (RegisterService<CONTAINER, IDS>(container, Kind), ...);
+    }(std::make_integer_sequence<int, MaxTypes>{});
+
+    /* Warmup, also assigns the type slots outside the measurement. */
+    ResolveLoop(container, Resolves / 10, TypeCount, std::make_integer_sequence<int, MaxTypes>{});
+    return ResolveLoop(container, Resolves, TypeCount, std::make_integer_sequence<int, MaxTypes>{});
+}
+
+/*!
+ * @brief Creates a scope, resolves ScopedTypes scoped services and ends the
+ * scope, until Resolves resolves were made.
+ */
+template<int... IDS>
+std::pair<std::chrono::nanoseconds, std::int64_t>
+ScopeLoop(
+    Ioc::IOC &Container,
+    std::uint64_t Resolves,
+    std::integer_sequence<int, IDS...>
+)
+{
+    std::int64_t checksum = 0;
+    const auto begin = std::chrono::steady_clock::now();
+
+    for (std::uint64_t i = 0; i < Resolves; i += ScopedTypes) {
+        auto scope = Container.CreateScope();
+        checksum += (scope.template Resolve<SERVICE<IDS>>().GetId() + ...);
+    }
+
+    return {std::chrono::steady_clock::now() - begin, checksum};
+}
+
+std::pair<std::chrono::nanoseconds, std::int64_t>
+RunScopeCase(
+    std::uint64_t Resolves
+)
+{
+    Ioc::IOC container;
+
+    [&]<int... IDS>(std::integer_sequence<int, IDS...>) {
+        (container.RegisterScopedFactory<SERVICE<IDS>>([](Ioc::SCOPE &Scope) -> SERVICE<IDS> & {
+            return Scope.Make<SERVICE<IDS>>();
+        }), ...);
+    }(std::make_integer_sequence<int, ScopedTypes>{});
+
+    ScopeLoop(container, Resolves / 10, std::make_integer_sequence<int, ScopedTypes>{});
+    return ScopeLoop(container, Resolves, std::make_integer_sequence<int, ScopedTypes>{});
+}
+
+int
+Usage()
+{
+    std::fprintf(stderr, "Usage: iocbench [--resolves N] [--types N]  (1 <= types <= %d)\n", MaxTypes);
+    return 2;
+}
+
+}
+
+int
+main(
+    int Argc,
+    char **Argv
+)
+{
+    std::uint64_t resolves = 10'000'000;
+    int typeCount = 64;
+
+    for (int i = 1; i < Argc; ++i) {
+        const std::string_view option = Argv[i];
+        if (i + 1 >= Argc) {
+            return Usage();
+        }
+
+        if (option == "--resolves") {
+            resolves = std::stoull(Argv[++i]);
+        } else if (option == "--types") {
+            typeCount = std::stoi(Argv[++i]);
+        } else {
+            return Usage();
+        }
+    }
+
+    if (typeCount < 1 || typeCount > MaxTypes || resolves == 0) {
+        return Usage();
+    }
+
+    std::fprintf(stderr, "%-10s %-8s %14s %10s\n", "container", "factory", "resolves/s", "ns/resolve");
+
+    using RESULT = std::pair<std::chrono::nanoseconds, std::int64_t>;
+
+    const std::tuple<const char *, const char *, int, RESULT> results[] = {
+        {"legacy", "cached", typeCount, RunCase<LEGACY_IOC>(FACTORY_KIND::Cached, resolves, typeCount)},
+        {"slots", "cached", typeCount, RunCase<Ioc::IOC>(FACTORY_KIND::Cached, resolves, typeCount)},
+        {"legacy", "created", typeCount, RunCase<LEGACY_IOC>(FACTORY_KIND::Created, resolves, typeCount)},
+        {"slots", "created", typeCount, RunCase<Ioc::IOC>(FACTORY_KIND::Created, resolves, typeCount)},
+        {"scope", "scoped", ScopedTypes, RunScopeCase(resolves)}
+    };
+
+    for (const auto &[container, kindName, types, result] : results) {
+        const auto seconds = std::chrono::duration<double>(result.first).count();
+        const auto perSecond = static_cast<double>(resolves) / seconds;
+        const auto nanoseconds = static_cast<double>(result.first.count()) / static_cast<double>(resolves);
+
+        std::printf("{\"container\":\"%s\",\"factory\":\"%s\",\"types\":%d,\"resolves\":%llu,"
+                    "\"resolves_per_second\":%.0f,\"ns_per_resolve\":%.2f,\"checksum\":%lld}\n",
+                    container, kindName, types, static_cast<unsigned long long>(resolves),
+                    perSecond, nanoseconds, static_cast<long long>(result.second));
+        std::fprintf(stderr, "%-10s %-8s %14.0f %10.2f\n", container, kindName, perSecond, nanoseconds);
+    }
+
+    return 0;
+}
@@ -0,0 +1,279 @@
+/*!
+ *  @file       jobqbench.cpp
+ *  @brief      Multi-producer benchmark of the job queues.
+ *  @details    Measures jobs per second and global allocations per job of
+ *              Common::Util::JOB_QUEUE against MPSC_JOB_QUEUE, with 1..N
+ *              producer threads enqueuing into one queue and one consumer
+ *              thread draining it on every wakeup, like the UI thread does on
+ *              WM_JOB. compat/Windows.h of logbench stands in for the Win32
+ *              definitions the allocation counter and the string helpers
+ *              use. Builds on Linux with GCC 14 or later:
+ *
+ *                  g++ -std=c++23 -O2 -pthread -I../logbench/compat -include Windows.h \
+ *                      -I../../User/common -DNTECTIVE_ALLOCATION_COUNTER_ACTIVE=true \
+ *                      -o jobqbench jobqbench.cpp \
+ *                      ../../User/common/{allocctr,excption,jobqueue,mpscjobq,strutil}.cpp
+ *
+ *              Usage:
+ *
+ *                  jobqbench [--threads LIST] [--jobs N] [--capacity N]
+ *
+ *              Every producer count in LIST, 1,2,4,8 by default, runs three
+ *              cases of N jobs per producer, 1 million by default: legacy
+ *              (JOB_QUEUE::Enqueue), future (MPSC_JOB_QUEUE::Enqueue, which
+ *              still allocates the shared state of its std::future) and post
+ *              (MPSC_JOB_QUEUE::Post). The MPSC queues pool CAPACITY
+ *              nodes, 65536 by default. Producers that outrun the consumer
+ *              by more than that get heap-allocated nodes, which shows up
+ *              in the allocations per job. Prints one JSON object per case
+ *              to stdout and a table to stderr.
+ */
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <latch>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "allocctr.hpp"
+#include "jobqueue.hpp"
+#include "mpscjobq.hpp"
+
+using namespace Common;
+
+namespace {
+
+/*!
+ * @brief Wakeup of the consumer thread, counts pending wakeups like the
+ * message queue counts WM_JOB messages.
+ */
+class WAKEUP_SIGNAL {
+public:
+    void
+    Post()
+    {
+        Pending_.fetch_add(1, std::memory_order_release);
+        Pending_.notify_one();
+    }
+
+    /*!
+     * @brief Waits for a wakeup or for Stop.
+     * @return false if stopped.
+     */
+    bool
+    Wait()
+    {
+        for (;;) {
+            if (Stopping_.load(std::memory_order_acquire)) {
+                return false;
+            }
+
+            auto pending = Pending_.load(std::memory_order_acquire);
+            if (pending) {
+                Pending_.fetch_sub(1, std::memory_order_acq_rel);
+                return true;
+            }
+
+            Pending_.wait(0, std::memory_order_acquire);
+        }
+    }
+
+    void
+    Stop()
+    {
+        Stopping_.store(true, std::memory_order_release);
+        Pending_.fetch_add(1, std::memory_order_release);
+        Pending_.notify_one();
+    }
+
+private:
+    std::atomic<std::uint32_t> Pending_ = 0;
+    std::atomic<bool> Stopping_ = false;
+};
+
+class RESULT {
+public:
+    double JobsPerSecond = 0;
+    double AllocationsPerJob = 0;
+    std::uint64_t Wakeups = 0;
+};
+
+/*!
+ * @brief Runs Jobs jobs from each of Producers threads through a QUEUE.
+ * Enqueue is called with the queue and a job.
+ */
+template<class QUEUE, class ENQUEUE>
+RESULT
+Run(
+    std::size_t Producers,
+    std::uint64_t Jobs,
+    ENQUEUE Enqueue
+)
+{
+    WAKEUP_SIGNAL signal;
+    std::atomic<std::uint64_t> wakeups = 0;
+    QUEUE queue{[&] {
+        wakeups.fetch_add(1, std::memory_order_relaxed);
+        signal.Post();
+    }};
+
+    std::uint64_t executed = 0;
+    const auto total = Jobs * Producers;
+
+    /* The consumer drains before its first wait, as the queues expect. */
+    std::thread consumer{[&] {
+        queue.DrainAll();
+        while (signal.Wait()) {
+            queue.Drain(std::chrono::milliseconds{4});
+        }
+        queue.DrainAll();
+    }};
+
+    std::latch start{1};
+    std::vector<std::thread> producers;
+    std::atomic<std::uint64_t> done = 0;
+
+    for (std::size_t i = 0; i < Producers; ++i) {
+        producers.emplace_back([&] {
+            start.wait();
+            for (std::uint64_t job = 0; job < Jobs; ++job) {
+                Enqueue(queue, [&executed, &done, total] {
+                    /* Only the consumer runs jobs. */
+                    if (++executed == total) {
+                        done.store(1, std::memory_order_release);
+                        done.notify_one();
+                    }
+                });
+            }
+        });
+    }
+
+    const auto baseAllocations = Util::GetAllocationCount();
+    const auto begin = std::chrono::steady_clock::now();
+    start.count_down();
+
+    for (auto &producer : producers) {
+        producer.join();
+    }
+
+    done.wait(0, std::memory_order_acquire);
+    const auto end = std::chrono::steady_clock::now();
+    const auto allocations = Util::GetAllocationCount() - baseAllocations;
+
+    signal.Stop();
+    consumer.join();
+
+    return {
+        .JobsPerSecond = static_cast<double>(total) / std::chrono::duration<double>(end - begin).count(),
+        .AllocationsPerJob = static_cast<double>(allocations) / static_cast<double>(total),
+        .Wakeups = wakeups.load()
+    };
+}
+
+void
+Print(
+    const char *Case,
+    std::size_t Producers,
+    std::uint64_t Jobs,
+    const RESULT &Result
+)
+{
+    std::printf("{\"case\":\"%s\",\"producers\":%zu,\"jobs\":%llu,\"jobs_per_second\":%.0f,"
+                "\"allocations_per_job\":%.3f,\"wakeups\":%llu}\n",
+                Case, Producers, static_cast<unsigned long long>(Jobs * Producers), Result.JobsPerSecond,
+                Result.AllocationsPerJob, static_cast<unsigned long long>(Result.Wakeups));
+    std::fprintf(stderr, "%-8s %9zu %14.0f %9.3f %9llu\n",
+                 Case, Producers, Result.JobsPerSecond, Result.AllocationsPerJob,
+                 static_cast<unsigned long long>(Result.Wakeups));
+}
+
+std::size_t PoolCapacity = 64 * 1024;
+
+/*!
+ * @brief MPSC_JOB_QUEUE with PoolCapacity nodes and a wakeup, so Run can
+ * construct both queue types the same way.
+ */
+class POOLED_QUEUE : public Util::MPSC_JOB_QUEUE {
+public:
+    explicit
+    POOLED_QUEUE(
+        WAKEUP Wakeup
+    ) : MPSC_JOB_QUEUE(PoolCapacity, std::move(Wakeup))
+    {
+    }
+};
+
+std::vector<std::size_t>
+ParseList(
+    std::string_view List
+)
+{
+    std::vector<std::size_t> values;
+    while (!List.empty()) {
+        const auto comma = List.find(',');
+        values.push_back(std::stoull(std::string{List.substr(0, comma)}));
+        List = comma == std::string_view::npos ? std::string_view{} : List.substr(comma + 1);
+    }
+
+    return values;
+}
+
+int
+Usage()
+{
+    std::fprintf(stderr, "Usage: jobqbench [--threads LIST] [--jobs N] [--capacity N]\n");
+    return 2;
+}
+
+}
+
+int
+main(
+    int Argc,
+    char **Argv
+)
+{
+    std::vector<std::size_t> threads = {1, 2, 4, 8};
+    std::uint64_t jobs = 1'000'000;
+
+    for (int i = 1; i < Argc; ++i) {
+        const std::string_view option = Argv[i];
+        if (i + 1 >= Argc) {
+            return Usage();
+        }
+
+        if (option == "--threads") {
+            threads = ParseList(Argv[++i]);
+        } else if (option == "--jobs") {
+            jobs = std::stoull(Argv[++i]);
+        } else if (option == "--capacity") {
+            PoolCapacity = std::stoull(Argv[++i]);
+        } else {
+            return Usage();
+        }
+    }
+
+    if (threads.empty() || jobs == 0) {
+        return Usage();
+    }
+
+    std::fprintf(stderr, "%-8s %9s %14s %9s %9s\n", "case", "producers", "jobs/s", "alloc/job", "wakeups");
+
+    for (const auto producers : threads) {
+        Print("legacy", producers, jobs, Run<Util::JOB_QUEUE>(producers, jobs, [](auto &Queue, auto &&Job) {
+            Queue.Enqueue(std::move(Job));
+        }));
+        Print("future", producers, jobs, Run<POOLED_QUEUE>(producers, jobs, [](auto &Queue, auto &&Job) {
+            Queue.Enqueue(std::move(Job));
+        }));
+        Print("post", producers, jobs, Run<POOLED_QUEUE>(producers, jobs, [](auto &Queue, auto &&Job) {
+            Queue.Post(std::move(Job));
+        }));
+    }
+
+    return 0;
+}
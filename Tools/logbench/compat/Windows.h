@@ -0,0 +1,323 @@
+﻿/*!
+ *  @file       Windows.h
+ *  @brief      Linux stand-in for the Win32 API used by the logging sources.
+ *  @details    Only the Win32 and MSVC runtime calls made by the sources
+ *              logbench links are provided. Text conversions treat wchar_t as UTF-32 and
+ *              narrow text as UTF-8, system error descriptions are not
+ *              available, debugger output is discarded and file handles
+ *              are POSIX file descriptors. Force-included
+ *              in every translation unit so the MSVC source location
+ *              macros are defined as well.
+ */
+
+#pragma once
+
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cwchar>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifndef __FILEW__
+    #define __FILEW__ L"" __FILE__
+#endif
+
+#ifndef __FUNCTIONW__
+    /* __func__ is not a string literal, it cannot be widened by concatenation. */
+    #define __FUNCTIONW__ L""
+#endif
+
+using BOOL = int;
+using DWORD = unsigned long;
+using UINT = unsigned int;
+using WORD = unsigned short;
+using LPWSTR = wchar_t *;
+using HLOCAL = void *;
+using HANDLE = void *;
+using SIZE_T = std::size_t;
+
+union LARGE_INTEGER {
+    std::int64_t QuadPart;
+};
+
+#define CP_ACP 0
+#define CP_UTF8 65001
+
+#define FORMAT_MESSAGE_ALLOCATE_BUFFER 0x00000100
+#define FORMAT_MESSAGE_IGNORE_INSERTS 0x00000200
+#define FORMAT_MESSAGE_FROM_SYSTEM 0x00001000
+
+#define LANG_NEUTRAL 0x00
+#define SUBLANG_DEFAULT 0x01
+#define MAKELANGID(Primary, Sub) ((static_cast<WORD>(Sub) << 10) | static_cast<WORD>(Primary))
+
+#define _TRUNCATE (static_cast<std::size_t>(-1))
+
+#define TRUE 1
+#define FALSE 0
+
+#define INVALID_HANDLE_VALUE (reinterpret_cast<HANDLE>(static_cast<std::intptr_t>(-1)))
+#define FILE_APPEND_DATA 0x00000004
+#define FILE_SHARE_READ 0x00000001
+#define FILE_SHARE_WRITE 0x00000002
+#define FILE_SHARE_DELETE 0x00000004
+#define OPEN_ALWAYS 4
+#define FILE_ATTRIBUTE_NORMAL 0x00000080
+#define FILE_FLAG_SEQUENTIAL_SCAN 0x08000000
+
+inline
+DWORD
+GetLastError()
+{
+    return static_cast<DWORD>(errno);
+}
+
+inline
+void
+OutputDebugStringW(
+    const wchar_t *
+)
+{
+}
+
+inline
+DWORD
+FormatMessageW(
+    DWORD,
+    const void *,
+    DWORD,
+    DWORD,
+    LPWSTR,
+    DWORD,
+    void *
+)
+{
+    return 0;
+}
+
+inline
+HLOCAL
+LocalFree(
+    HLOCAL Memory
+)
+{
+    std::free(Memory);
+    return nullptr;
+}
+
+/*!
+ * @brief Encodes UTF-32 to UTF-8. Returns 0 if the output does not fit.
+ */
+inline
+int
+WideCharToMultiByte(
+    UINT,
+    DWORD,
+    const wchar_t *Wide,
+    int WideLength,
+    char *Narrow,
+    int NarrowLength,
+    const char *,
+    BOOL *
+)
+{
+    int length = 0;
+    char sequence[4];
+
+    for (int i = 0; i < WideLength; ++i) {
+        auto codePoint = static_cast<std::uint32_t>(Wide[i]);
+        if (codePoint > 0x10FFFF || (codePoint >= 0xD800 && codePoint <= 0xDFFF)) {
+            codePoint = 0xFFFD;
+        }
+
+        int size;
+        if (codePoint < 0x80) {
+            sequence[0] = static_cast<char>(codePoint);
+            size = 1;
+        } else if (codePoint < 0x800) {
+            sequence[0] = static_cast<char>(0xC0 | codePoint >> 6);
+            sequence[1] = static_cast<char>(0x80 | (codePoint & 0x3F));
+            size = 2;
+        } else if (codePoint < 0x10000) {
+            sequence[0] = static_cast<char>(0xE0 | codePoint >> 12);
+            sequence[1] = static_cast<char>(0x80 | (codePoint >> 6 & 0x3F));
+            sequence[2] = static_cast<char>(0x80 | (codePoint & 0x3F));
+            size = 3;
+        } else {
+            sequence[0] = static_cast<char>(0xF0 | codePoint >> 18);
+            sequence[1] = static_cast<char>(0x80 | (codePoint >> 12 & 0x3F));
+            sequence[2] = static_cast<char>(0x80 | (codePoint >> 6 & 0x3F));
+            sequence[3] = static_cast<char>(0x80 | (codePoint & 0x3F));
+            size = 4;
+        }
+
+        if (Narrow) {
+            if (length + size > NarrowLength) {
+                return 0;
+            }
+            for (int j = 0; j < size; ++j) {
+                Narrow[length + j] = sequence[j];
+            }
+        }
+        length += size;
+    }
+
+    return length;
+}
+
+/*!
+ * @brief Decodes UTF-8 to UTF-32. Returns 0 if the output does not fit.
+ */
+inline
+int
+MultiByteToWideChar(
+    UINT,
+    DWORD,
+    const char *Narrow,
+    int NarrowLength,
+    wchar_t *Wide,
+    int WideLength
+)
+{
+    int length = 0;
+
+    for (int i = 0; i < NarrowLength;) {
+        const auto lead = static_cast<unsigned char>(Narrow[i]);
+        const int size = lead < 0x80 ? 1 : lead < 0xE0 ? 2 : lead < 0xF0 ? 3 : 4;
+
+        std::uint32_t codePoint = size == 1 ? lead : lead & (0x3F >> (size - 1));
+        for (int j = 1; j < size && i + j < NarrowLength; ++j) {
+            codePoint = codePoint << 6 | (static_cast<unsigned char>(Narrow[i + j]) & 0x3F);
+        }
+        i += size;
+
+        if (Wide) {
+            if (length >= WideLength) {
+                return 0;
+            }
+            Wide[length] = static_cast<wchar_t>(codePoint);
+        }
+        ++length;
+    }
+
+    return length;
+}
+
+inline
+void *
+_aligned_malloc(
+    std::size_t Size,
+    std::size_t Alignment
+)
+{
+    void *memory = nullptr;
+    return posix_memalign(&memory, Alignment, Size) == 0 ? memory : nullptr;
+}
+
+inline
+void
+_aligned_free(
+    void *Memory
+)
+{
+    std::free(Memory);
+}
+
+inline
+int
+wcstombs_s(
+    std::size_t *Converted,
+    char *Narrow,
+    std::size_t NarrowSize,
+    const wchar_t *Wide,
+    std::size_t
+)
+{
+    const auto length = std::wcstombs(Narrow, Wide, NarrowSize - 1);
+    if (length == static_cast<std::size_t>(-1)) {
+        *Converted = 0;
+        return EILSEQ;
+    }
+
+    Narrow[length] = '\0';
+    *Converted = length + 1;
+    return 0;
+}
+
+/*!
+ * @brief Opens a file for appending, creating it if needed. Takes a narrow
+ * path, the value type of std::filesystem::path on Linux.
+ */
+inline
+HANDLE
+CreateFileW(
+    const char *FileName,
+    DWORD,
+    DWORD,
+    void *,
+    DWORD,
+    DWORD,
+    HANDLE
+)
+{
+    const auto descriptor = open(FileName, O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, 0644);
+    return descriptor < 0 ? INVALID_HANDLE_VALUE : reinterpret_cast<HANDLE>(static_cast<std::intptr_t>(descriptor));
+}
+
+inline
+BOOL
+WriteFile(
+    HANDLE File,
+    const void *Buffer,
+    DWORD Size,
+    DWORD *Written,
+    void *
+)
+{
+    const auto descriptor = static_cast<int>(reinterpret_cast<std::intptr_t>(File));
+    const auto *bytes = static_cast<const char *>(Buffer);
+    DWORD total = 0;
+
+    while (total < Size) {
+        const auto result = write(descriptor, bytes + total, Size - total);
+        if (result < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+        total += static_cast<DWORD>(result);
+    }
+
+    *Written = total;
+    return total == Size;
+}
+
+inline
+BOOL
+GetFileSizeEx(
+    HANDLE File,
+    LARGE_INTEGER *Size
+)
+{
+    struct stat status{};
+    if (fstat(static_cast<int>(reinterpret_cast<std::intptr_t>(File)), &status) != 0) {
+        return FALSE;
+    }
+
+    Size->QuadPart = status.st_size;
+    return TRUE;
+}
+
+inline
+BOOL
+CloseHandle(
+    HANDLE Object
+)
+{
+    return close(static_cast<int>(reinterpret_cast<std::intptr_t>(Object))) == 0;
+}
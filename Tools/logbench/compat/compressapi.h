@@ -0,0 +1,86 @@
+﻿/*!
+ *  @file       compressapi.h
+ *  @brief      Linux stand-in for the Windows compression API.
+ *  @details    No compressor is available: CreateCompressor fails, so
+ *              log segments store every block as is, and CreateDecompressor
+ *              fails, so segments cannot be read back.
+ */
+
+#pragma once
+
+#include "Windows.h"
+
+using COMPRESSOR_HANDLE = void *;
+using DECOMPRESSOR_HANDLE = void *;
+
+#define COMPRESS_ALGORITHM_XPRESS_HUFF 4
+
+inline
+BOOL
+CreateCompressor(
+    DWORD,
+    void *,
+    COMPRESSOR_HANDLE *Compressor
+)
+{
+    *Compressor = nullptr;
+    return FALSE;
+}
+
+inline
+BOOL
+Compress(
+    COMPRESSOR_HANDLE,
+    const void *,
+    SIZE_T,
+    void *,
+    SIZE_T,
+    SIZE_T *
+)
+{
+    return FALSE;
+}
+
+inline
+BOOL
+CloseCompressor(
+    COMPRESSOR_HANDLE
+)
+{
+    return TRUE;
+}
+
+inline
+BOOL
+CreateDecompressor(
+    DWORD,
+    void *,
+    DECOMPRESSOR_HANDLE *Decompressor
+)
+{
+    *Decompressor = nullptr;
+    return FALSE;
+}
+
+inline
+BOOL
+Decompress(
+    DECOMPRESSOR_HANDLE,
+    const void *,
+    SIZE_T,
+    void *,
+    SIZE_T,
+    SIZE_T *
+)
+{
+    return FALSE;
+}
+
+inline
+BOOL
+CloseDecompressor(
+    DECOMPRESSOR_HANDLE
+)
+{
+    return TRUE;
+}
@@ -0,0 +1,1020 @@
+﻿/*!
+ *  @file       logbench.cpp
+ *  @brief      Multi-producer benchmark of the logging system.
+ *  @details    Drives the LOG_<LEVEL> macros, LOG_SESSION_IMPL, LOG_FORMATTER,
+ *              FILE_LOG_PROVIDER_IMPL and BUFFERED_FILE_LOG_PROVIDER_IMPL
+ *              from 1..N producer threads on Linux. compat/Windows.h and
+ *              compat/compressapi.h stand in for the few Win32 calls the
+ *              logging sources make and a null provider, which formats
+ *              every entry like DEBUGGER_LOG_PROVIDER_IMPL and discards it,
+ *              stands in for the debugger. Build with GCC 14 or later (or
+ *              any compiler with <format> and the chrono time zone
+ *              database):
+ *
+ *                  g++ -std=c++23 -O2 -pthread -Icompat -include Windows.h \
+ *                      -I../../User/common -DNTECTIVE_ALLOCATION_COUNTER_ACTIVE=true \
+ *                      -o logbench logbench.cpp ../../User/common/{allocctr,arena,assert}.cpp \
+ *                      ../../User/common/{excption,ioc,log,logchan,logfield,logfile,logmsg}.cpp \
+ *                      ../../User/common/{logprov,lograte,logsegm,logsessn,logsite,strutil,tscclock}.cpp
+ *
+ *              Usage:
+ *
+ *                  logbench [run] [--threads LIST] [--calls N] [--sinks LIST]
+ *                           [--delivery LIST] [--formatters LIST] [--messages LIST]
+ *                           [--levels LIST] [--label TEXT] [--dir DIR]
+ *                  logbench compare BASE.jsonl NEW.jsonl
+ *
+ *              run measures every combination of the listed parameters:
+ *              threads, such as 1,2,4,8; sinks null, file (null plus
+ *              FILE_LOG_PROVIDER_IMPL writing to DIR) and buffered (null
+ *              plus BUFFERED_FILE_LOG_PROVIDER_IMPL, the provider the
+ *              application ships, writing to DIR without rotation);
+ *              delivery queued (default LOG_DELIVERY_POLICY) and sync
+ *              (Capacity 0); formatters standard and fast (the
+ *              LOG_FORMATTER_MODE all sinks format with); messages short,
+ *              long (spills into the message arena), deferred (format
+ *              arguments) and fields (typed fields); levels info and mixed
+ *              (per 20 calls 1 Error, 1 Warning, 6 Info and 12 Verbose,
+ *              which the session filters out).
+ *              Every producer makes N calls, 100000 by default, after a
+ *              warmup of N / 10.
+ *
+ *              Every scenario prints one JSON object per line to stdout:
+ *              throughput at the call site and end to end including the
+ *              final Flush, per-call latency percentiles and the log-linear
+ *              histogram they come from (128 sub-buckets per power of two,
+ *              under 1% relative error), allocations per entry and bytes
+ *              written (the file growth for the file sinks, the formatted
+ *              size for the null sink). A table goes to stderr. compare
+ *              matches the scenarios of two such files and prints the
+ *              throughput and p99 ratios.
+ *
+ *              Rate limits are lifted for the run, messages differ from
+ *              call to call so that no repeat is collapsed.
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <latch>
+#include <map>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "allocctr.hpp"
+#include "ioc.hpp"
+#include "log.hpp"
+#include "logfile.hpp"
+#include "logprov.hpp"
+#include "lograte.hpp"
+#include "logsessn.hpp"
+
+using namespace Common;
+using namespace Common::Log;
+
+namespace {
+
+using CLOCK = std::chrono::steady_clock;
+
+/**
+ * @brief Log-linear latency histogram in the style of HdrHistogram.
+ * @details Values below 256 ns are counted exactly, larger values in 128
+ * sub-buckets per power of two. The largest value is tracked exactly.
+ */
+class LATENCY_HISTOGRAM {
+public:
+    static constexpr int SubBucketBits = 7;
+    static constexpr std::uint64_t SubBucketCount = 1ull << SubBucketBits;
+    static constexpr std::size_t BucketCount = (64 - SubBucketBits + 1) * SubBucketCount;
+
+    LATENCY_HISTOGRAM() : Counts_(BucketCount)
+    {
+    }
+
+    void
+    Record(
+        std::uint64_t Value
+    )
+    {
+        ++Counts_[IndexOf(Value)];
+        ++Count_;
+        Sum_ += Value;
+        Max_ = std::max(Max_, Value);
+    }
+
+    void
+    Merge(
+        const LATENCY_HISTOGRAM &Other
+    )
+    {
+        for (std::size_t i = 0; i < BucketCount; ++i) {
+            Counts_[i] += Other.Counts_[i];
+        }
+        Count_ += Other.Count_;
+        Sum_ += Other.Sum_;
+        Max_ = std::max(Max_, Other.Max_);
+    }
+
+    std::uint64_t
+    GetCount() const
+    {
+        return Count_;
+    }
+
+    std::uint64_t
+    GetMax() const
+    {
+        return Max_;
+    }
+
+    double
+    GetMean() const
+    {
+        return Count_ ? static_cast<double>(Sum_) / static_cast<double>(Count_) : 0;
+    }
+
+    /**
+     * @brief Returns the upper bound of the bucket holding the given
+     * percentile, never more than the largest value.
+     */
+    std::uint64_t
+    GetPercentile(
+        double Percentile
+    ) const
+    {
+        if (Count_ == 0) {
+            return 0;
+        }
+
+        const auto rank = std::max<std::uint64_t>(
+            1, static_cast<std::uint64_t>(Percentile / 100 * static_cast<double>(Count_) + 0.5));
+
+        std::uint64_t seen = 0;
+        for (std::size_t i = 0; i < BucketCount; ++i) {
+            seen += Counts_[i];
+            if (seen >= rank) {
+                return std::min(UpperBoundOf(i), Max_);
+            }
+        }
+
+        return Max_;
+    }
+
+    /**
+     * @brief Calls Visitor(UpperBound, Count) for every non-empty bucket, in
+     * increasing order.
+     */
+    template<class F>
+    void
+    ForEachBucket(
+        F &&Visitor
+    ) const
+    {
+        for (std::size_t i = 0; i < BucketCount; ++i) {
+            if (Counts_[i]) {
+                Visitor(std::min(UpperBoundOf(i), Max_), Counts_[i]);
+            }
+        }
+    }
+
+private:
+    static
+    std::size_t
+    IndexOf(
+        std::uint64_t Value
+    )
+    {
+        const int shift = std::max(0, static_cast<int>(std::bit_width(Value)) - SubBucketBits - 1);
+        return static_cast<std::size_t>(shift) * SubBucketCount + (Value >> shift);
+    }
+
+    static
+    std::uint64_t
+    UpperBoundOf(
+        std::size_t Index
+    )
+    {
+        if (Index < 2 * SubBucketCount) {
+            return Index;
+        }
+
+        const auto shift = Index / SubBucketCount - 1;
+        const auto subBucket = Index % SubBucketCount + SubBucketCount;
+        return ((subBucket + 1) << shift) - 1;
+    }
+
+    std::vector<std::uint64_t> Counts_;
+    std::uint64_t Count_ = 0;
+    std::uint64_t Sum_ = 0;
+    std::uint64_t Max_ = 0;
+};
+
+/**
+ * @brief Counter that threads add to without sharing a cache line.
+ */
+class STRIPED_COUNTER {
+public:
+    void
+    Add(
+        std::uint64_t Value
+    )
+    {
+        static std::atomic<std::size_t> nextStripe = 0;
+        thread_local const std::size_t stripe = nextStripe.fetch_add(1, std::memory_order_relaxed) % StripeCount;
+
+        Stripes_[stripe].Value.fetch_add(Value, std::memory_order_relaxed);
+    }
+
+    std::uint64_t
+    Get() const
+    {
+        std::uint64_t total = 0;
+        for (const auto &stripe : Stripes_) {
+            total += stripe.Value.load(std::memory_order_relaxed);
+        }
+        return total;
+    }
+
+private:
+    static constexpr std::size_t StripeCount = 64;
+
+    class alignas(64) STRIPE {
+    public:
+        std::atomic<std::uint64_t> Value = 0;
+    };
+
+    STRIPE Stripes_[StripeCount];
+};
+
+/**
+ * @brief Log provider that formats entries like the debugger provider and
+ * discards them, counting the formatted characters.
+ */
+class NULL_LOG_PROVIDER_IMPL : public LOG_PROVIDER_BASE {
+public:
+    NULL_LOG_PROVIDER_IMPL(
+        std::shared_ptr<LOG_FORMATTER_BASE> LogFormatter
+    ) : LogFormatter_(std::move(LogFormatter))
+    {
+    }
+
+    void
+    Write(
+        const LOG_ENTRY &LogEntry
+    ) override
+    {
+        thread_local std::wstring buffer;
+        buffer.clear();
+        LogFormatter_->FormatLogEntryTo(LogEntry, buffer);
+
+        Entries_.Add(1);
+        Characters_.Add(buffer.size());
+    }
+
+    void
+    Flush() override
+    {
+    }
+
+    void
+    RegisterFormatter(
+        std::shared_ptr<LOG_FORMATTER_BASE> LogFormatter
+    ) override
+    {
+        LogFormatter_ = std::move(LogFormatter);
+    }
+
+    std::uint64_t
+    GetEntryCount() const
+    {
+        return Entries_.Get();
+    }
+
+    std::uint64_t
+    GetCharacterCount() const
+    {
+        return Characters_.Get();
+    }
+
+private:
+    std::shared_ptr<LOG_FORMATTER_BASE> LogFormatter_;
+    STRIPED_COUNTER Entries_;
+    STRIPED_COUNTER Characters_;
+};
+
+/**
+ * @brief Default session of the process, forwarding to the session of the
+ * running scenario so the LOG_<LEVEL> macros reach it.
+ */
+class BENCH_SESSION : public LOG_SESSION_BASE {
+public:
+    void
+    Write(
+        LOG_ENTRY &LogEntry
+    ) override
+    {
+        if (auto *target = Target_.load(std::memory_order_acquire)) {
+            target->Write(LogEntry);
+        }
+    }
+
+    void
+    Flush() override
+    {
+        if (auto *target = Target_.load(std::memory_order_acquire)) {
+            target->Flush();
+        }
+    }
+
+    void
+    RegisterProvider(
+        std::shared_ptr<LOG_PROVIDER_BASE> LogProvider
+    ) override
+    {
+        if (auto *target = Target_.load(std::memory_order_acquire)) {
+            target->RegisterProvider(std::move(LogProvider));
+        }
+    }
+
+    void
+    SetTarget(
+        LOG_SESSION_BASE *Target
+    )
+    {
+        Target_.store(Target, std::memory_order_release);
+    }
+
+private:
+    std::atomic<LOG_SESSION_BASE *> Target_ = nullptr;
+};
+
+enum class SINK {
+    Null,
+    File,
+    Buffered
+};
+
+enum class DELIVERY {
+    Queued,
+    Sync
+};
+
+enum class FORMATTER {
+    Standard,
+    Fast
+};
+
+enum class MESSAGE_KIND {
+    Short,
+    Long,
+    Deferred,
+    Fields
+};
+
+enum class LEVEL_MIX {
+    Info,
+    Mixed
+};
+
+constexpr std::string_view SinkNames[] = {"null", "file", "buffered"};
+constexpr std::string_view DeliveryNames[] = {"queued", "sync"};
+constexpr std::string_view FormatterNames[] = {"standard", "fast"};
+constexpr std::string_view MessageNames[] = {"short", "long", "deferred", "fields"};
+constexpr std::string_view LevelMixNames[] = {"info", "mixed"};
+
+class SCENARIO {
+public:
+    SINK Sink;
+    DELIVERY Delivery;
+    FORMATTER Formatter;
+    MESSAGE_KIND Message;
+    LEVEL_MIX Levels;
+    unsigned Threads;
+
+    std::string
+    GetName() const
+    {
+        return std::string{SinkNames[static_cast<int>(Sink)]} + '/' +
+               std::string{DeliveryNames[static_cast<int>(Delivery)]} + '/' +
+               std::string{FormatterNames[static_cast<int>(Formatter)]} + '/' +
+               std::string{MessageNames[static_cast<int>(Message)]} + '/' +
+               std::string{LevelMixNames[static_cast<int>(Levels)]} + "/t" +
+               std::to_string(Threads);
+    }
+};
+
+class OPTIONS {
+public:
+    std::vector<unsigned> Threads = {1, 2, 4, 8};
+    std::uint64_t Calls = 100'000;
+    std::vector<SINK> Sinks = {SINK::Null, SINK::File, SINK::Buffered};
+    std::vector<DELIVERY> Deliveries = {DELIVERY::Queued, DELIVERY::Sync};
+    std::vector<FORMATTER> Formatters = {FORMATTER::Standard, FORMATTER::Fast};
+    std::vector<MESSAGE_KIND> Messages = {MESSAGE_KIND::Short, MESSAGE_KIND::Long,
+                                          MESSAGE_KIND::Deferred, MESSAGE_KIND::Fields};
+    std::vector<LEVEL_MIX> Levels = {LEVEL_MIX::Info, LEVEL_MIX::Mixed};
+    std::string Label = "run";
+    std::filesystem::path Directory = std::filesystem::temp_directory_path() / "logbench";
+};
+
+class RESULT {
+public:
+    std::uint64_t Calls = 0;
+    std::uint64_t Entries = 0;
+    double ProducerSeconds = 0;
+    double EndToEndSeconds = 0;
+    LATENCY_HISTOGRAM Latency;
+    std::uint64_t Allocations = 0;
+    std::uint64_t BytesWritten = 0;
+};
+
+/**
+ * @brief Message text with a decimal sequence number patched in place, so
+ * every call logs a different message without formatting.
+ */
+class PATCHED_TEXT {
+public:
+    PATCHED_TEXT(
+        std::wstring_view Prefix,
+        std::wstring_view Suffix
+    )
+    {
+        Text_ = Prefix;
+        DigitsOffset_ = Text_.size();
+        Text_.append(DigitCount, L'0');
+        Text_ += Suffix;
+    }
+
+    std::wstring_view
+    View(
+        std::uint64_t Sequence
+    )
+    {
+        for (auto i = DigitCount; i > 0; --i) {
+            Text_[DigitsOffset_ + i - 1] = static_cast<wchar_t>(L'0' + Sequence % 10);
+            Sequence /= 10;
+        }
+        return Text_;
+    }
+
+private:
+    static constexpr std::size_t DigitCount = 10;
+
+    std::wstring Text_;
+    std::size_t DigitsOffset_;
+};
+
+LOG_LEVEL
+LevelOf(
+    LEVEL_MIX Levels,
+    std::uint64_t Call
+)
+{
+    if (Levels == LEVEL_MIX::Info) {
+        return LOG_LEVEL::Info;
+    }
+
+    const auto position = Call % 20;
+    if (position == 0) {
+        return LOG_LEVEL::Error;
+    }
+    if (position == 1) {
+        return LOG_LEVEL::Warning;
+    }
+    return position < 8 ? LOG_LEVEL::Info : LOG_LEVEL::Verbose;
+}
+
+/*!
+ * One call of the given LOG_<LEVEL> macro with the message of the
+ * scenario. Every expansion is a call site of its own.
+ */
+#define LOGBENCH_CALL_(Macro, Kind, Sequence, ShortText, LongText)                                  \
+    switch (Kind) {                                                                                 \
+    case MESSAGE_KIND::Short:                                                                       \
+        Macro(ShortText.View(Sequence));                                                            \
+        break;                                                                                      \
+    case MESSAGE_KIND::Long:                                                                        \
+        Macro(LongText.View(Sequence));                                                             \
+        break;                                                                                      \
+    case MESSAGE_KIND::Deferred:                                                                    \
+        Macro(L"Request {} for {} completed with status {:#x}", Sequence, L"C:\\Windows\\notepad.exe", \
+              static_cast<unsigned>(Sequence & 0xFF));                                              \
+        break;                                                                                      \
+    case MESSAGE_KIND::Fields:                                                                      \
+        Macro(L"Request completed")                                                                 \
+            .With("request", Sequence)                                                              \
+            .With("path", L"C:\\Windows\\notepad.exe")                                              \
+            .With("status", static_cast<unsigned>(Sequence & 0xFF))                                 \
+            .With("elapsed", std::chrono::microseconds{static_cast<std::int64_t>(Sequence & 0x3FF)});                          \
+        break;                                                                                      \
+    }
+
+class PRODUCER {
+public:
+    PRODUCER() :
+        ShortText_(L"Request ", L" done"),
+        LongText_(L"Request ",
+                  L" completed after the image section of C:\\Program Files\\Vendor\\Product\\bin\\"
+                  L"service-host.exe was mapped, its import table resolved against 42 modules and "
+                  L"the loader lock released; no relocation was needed")
+    {
+    }
+
+    void
+    Call(
+        MESSAGE_KIND Kind,
+        LOG_LEVEL Level,
+        std::uint64_t Sequence
+    )
+    {
+        switch (Level) {
+        case LOG_LEVEL::Error:
+            LOGBENCH_CALL_(LOG_ERROR, Kind, Sequence, ShortText_, LongText_)
+            break;
+        case LOG_LEVEL::Warning:
+            LOGBENCH_CALL_(LOG_WARNING, Kind, Sequence, ShortText_, LongText_)
+            break;
+        case LOG_LEVEL::Verbose:
+            LOGBENCH_CALL_(LOG_VERBOSE, Kind, Sequence, ShortText_, LongText_)
+            break;
+        default:
+            LOGBENCH_CALL_(LOG_INFO, Kind, Sequence, ShortText_, LongText_)
+            break;
+        }
+    }
+
+private:
+    PATCHED_TEXT ShortText_;
+    PATCHED_TEXT LongText_;
+};
+
+std::uint64_t
+FileSize(
+    const std::filesystem::path &Path
+)
+{
+    std::error_code error;
+    const auto size = std::filesystem::file_size(Path, error);
+    return error ? 0 : size;
+}
+
+/**
+ * @brief Returns the median cost of a CLOCK::now() pair, which is included
+ * in every latency sample.
+ */
+std::uint64_t
+CalibrateTimer()
+{
+    constexpr int samples = 100'001;
+
+    std::vector<std::uint64_t> costs(samples);
+    for (auto &cost : costs) {
+        const auto begin = CLOCK::now();
+        const auto end = CLOCK::now();
+        cost = static_cast<std::uint64_t>((end - begin).count());
+    }
+
+    std::nth_element(costs.begin(), costs.begin() + samples / 2, costs.end());
+    return costs[samples / 2];
+}
+
+RESULT
+RunScenario(
+    const SCENARIO &Scenario,
+    const OPTIONS &Options,
+    BENCH_SESSION &BenchSession
+)
+{
+    const auto formatter = std::make_shared<LOG_FORMATTER>(
+        Scenario.Formatter == FORMATTER::Fast ? LOG_FORMATTER_MODE::Fast : LOG_FORMATTER_MODE::Standard);
+    const auto nullProvider = std::make_shared<NULL_LOG_PROVIDER_IMPL>(formatter);
+    const auto filePath = Options.Directory / "logbench.log";
+
+    LOG_DELIVERY_POLICY policy;
+    if (Scenario.Delivery == DELIVERY::Sync) {
+        policy.Capacity = 0;
+    }
+
+    auto session = std::make_unique<LOG_SESSION_IMPL>();
+    session->SetMinimumLevel(LOG_LEVEL::Info);
+    session->RegisterProvider(nullProvider, policy);
+
+    if (Scenario.Sink == SINK::File) {
+        std::filesystem::remove(filePath);
+        session->RegisterProvider(std::make_shared<FILE_LOG_PROVIDER_IMPL>(filePath, formatter), policy);
+    } else if (Scenario.Sink == SINK::Buffered) {
+        /* Rotation would rename the file and skew BytesWritten. */
+        std::filesystem::remove(filePath);
+        session->RegisterProvider(
+            std::make_shared<BUFFERED_FILE_LOG_PROVIDER_IMPL>(
+                filePath, formatter, LOG_FILE_COMMIT_POLICY{},
+                LOG_FILE_ROTATION_POLICY{.MaxSegmentBytes = 0, .Interval = std::chrono::seconds{0}}),
+            policy);
+    }
+
+    BenchSession.SetTarget(session.get());
+
+    const auto warmupCalls = std::max<std::uint64_t>(Options.Calls / 10, 1'000);
+
+    std::vector<LATENCY_HISTOGRAM> histograms(Scenario.Threads);
+    std::latch warmedUp{Scenario.Threads};
+    std::latch start{1};
+    std::vector<std::thread> producers;
+
+    for (unsigned thread = 0; thread < Scenario.Threads; ++thread) {
+        producers.emplace_back([&, thread] {
+            PRODUCER producer;
+            auto &histogram = histograms[thread];
+            auto sequence = static_cast<std::uint64_t>(thread) << 40;
+
+            for (std::uint64_t call = 0; call < warmupCalls; ++call) {
+                producer.Call(Scenario.Message, LevelOf(Scenario.Levels, call), ++sequence);
+            }
+
+            warmedUp.count_down();
+            start.wait();
+
+            for (std::uint64_t call = 0; call < Options.Calls; ++call) {
+                const auto level = LevelOf(Scenario.Levels, call);
+                const auto begin = CLOCK::now();
+                producer.Call(Scenario.Message, level, ++sequence);
+                const auto end = CLOCK::now();
+                histogram.Record(static_cast<std::uint64_t>((end - begin).count()));
+            }
+        });
+    }
+
+    warmedUp.wait();
+    session->Flush();
+
+    const auto baseEntries = nullProvider->GetEntryCount();
+    const auto baseCharacters = nullProvider->GetCharacterCount();
+    const auto baseFileSize = FileSize(filePath);
+    const auto baseAllocations = Util::GetAllocationCount();
+
+    const auto begin = CLOCK::now();
+    start.count_down();
+
+    for (auto &producer : producers) {
+        producer.join();
+    }
+
+    const auto producersDone = CLOCK::now();
+    session->Flush();
+    const auto end = CLOCK::now();
+
+    RESULT result;
+    result.Allocations = Util::GetAllocationCount() - baseAllocations;
+    result.Calls = Options.Calls * Scenario.Threads;
+    result.Entries = nullProvider->GetEntryCount() - baseEntries;
+    result.ProducerSeconds = std::chrono::duration<double>(producersDone - begin).count();
+    result.EndToEndSeconds = std::chrono::duration<double>(end - begin).count();
+    result.BytesWritten = Scenario.Sink != SINK::Null
+                              ? FileSize(filePath) - baseFileSize
+                              : nullProvider->GetCharacterCount() - baseCharacters;
+
+    for (const auto &histogram : histograms) {
+        result.Latency.Merge(histogram);
+    }
+
+    BenchSession.SetTarget(nullptr);
+    session.reset();
+    std::filesystem::remove(filePath);
+
+    return result;
+}
+
+void
+PrintJson(
+    const SCENARIO &Scenario,
+    const OPTIONS &Options,
+    const RESULT &Result,
+    std::uint64_t TimerOverhead
+)
+{
+    const auto entries = static_cast<double>(std::max<std::uint64_t>(Result.Entries, 1));
+
+    std::string line;
+    line += "{\"label\":\"" + Options.Label + '"';
+    line += ",\"scenario\":\"" + Scenario.GetName() + '"';
+    line += ",\"sink\":\"" + std::string{SinkNames[static_cast<int>(Scenario.Sink)]} + '"';
+    line += ",\"delivery\":\"" + std::string{DeliveryNames[static_cast<int>(Scenario.Delivery)]} + '"';
+    line += ",\"formatter\":\"" + std::string{FormatterNames[static_cast<int>(Scenario.Formatter)]} + '"';
+    line += ",\"message\":\"" + std::string{MessageNames[static_cast<int>(Scenario.Message)]} + '"';
+    line += ",\"levels\":\"" + std::string{LevelMixNames[static_cast<int>(Scenario.Levels)]} + '"';
+    line += ",\"threads\":" + std::to_string(Scenario.Threads);
+    line += ",\"calls\":" + std::to_string(Result.Calls);
+    line += ",\"entries\":" + std::to_string(Result.Entries);
+    line += std::format(",\"seconds\":{:.6f}", Result.EndToEndSeconds);
+    line += std::format(",\"calls_per_second\":{:.0f}", static_cast<double>(Result.Calls) / Result.ProducerSeconds);
+    line += std::format(",\"entries_per_second_e2e\":{:.0f}", static_cast<double>(Result.Entries) / Result.EndToEndSeconds);
+    line += std::format(",\"latency_ns\":{{\"p50\":{},\"p99\":{},\"p999\":{},\"max\":{},\"mean\":{:.1f}}}",
+                        Result.Latency.GetPercentile(50),
+                        Result.Latency.GetPercentile(99),
+                        Result.Latency.GetPercentile(99.9),
+                        Result.Latency.GetMax(),
+                        Result.Latency.GetMean());
+
+    line += ",\"histogram\":[";
+    bool first = true;
+    Result.Latency.ForEachBucket([&](std::uint64_t UpperBound, std::uint64_t Count) {
+        line += std::format("{}[{},{}]", first ? "" : ",", UpperBound, Count);
+        first = false;
+    });
+    line += ']';
+
+    line += std::format(",\"allocations_per_entry\":{:.3f}", static_cast<double>(Result.Allocations) / entries);
+    line += ",\"bytes_written\":" + std::to_string(Result.BytesWritten);
+    line += std::format(",\"bytes_per_entry\":{:.1f}", static_cast<double>(Result.BytesWritten) / entries);
+    line += ",\"timer_overhead_ns\":" + std::to_string(TimerOverhead);
+    line += "}\n";
+
+    std::fputs(line.c_str(), stdout);
+    std::fflush(stdout);
+}
+
+void
+PrintTableHeader()
+{
+    std::fprintf(stderr, "%-42s %12s %12s %8s %8s %8s %10s %8s %8s\n",
+                 "scenario", "calls/s", "e2e/s", "p50", "p99", "p99.9", "max", "alloc/e", "B/e");
+}
+
+void
+PrintTableRow(
+    const SCENARIO &Scenario,
+    const RESULT &Result
+)
+{
+    const auto entries = static_cast<double>(std::max<std::uint64_t>(Result.Entries, 1));
+
+    std::fprintf(stderr, "%-42s %12.0f %12.0f %8llu %8llu %8llu %10llu %8.3f %8.1f\n",
+                 Scenario.GetName().c_str(),
+                 static_cast<double>(Result.Calls) / Result.ProducerSeconds,
+                 static_cast<double>(Result.Entries) / Result.EndToEndSeconds,
+                 static_cast<unsigned long long>(Result.Latency.GetPercentile(50)),
+                 static_cast<unsigned long long>(Result.Latency.GetPercentile(99)),
+                 static_cast<unsigned long long>(Result.Latency.GetPercentile(99.9)),
+                 static_cast<unsigned long long>(Result.Latency.GetMax()),
+                 static_cast<double>(Result.Allocations) / entries,
+                 static_cast<double>(Result.BytesWritten) / entries);
+}
+
+int
+Run(
+    const OPTIONS &Options
+)
+{
+    /* The benchmark measures the logging path, not the limits. */
+    for (auto level : {LOG_LEVEL::Critical, LOG_LEVEL::Error, LOG_LEVEL::Warning, LOG_LEVEL::Info, LOG_LEVEL::Verbose}) {
+        GetLogRateLimiter().SetLimit(level, {});
+    }
+
+    const auto benchSession = std::make_shared<BENCH_SESSION>();
+    benchSession->SetMinimumLevel(LOG_LEVEL::Info);
+    Ioc::GetIoc().RegisterFactory<LOG_SESSION_BASE>([benchSession] {
+        return benchSession;
+    });
+    Ioc::GetSingletons().RegisterDelegateFactory<LOG_SESSION_BASE>();
+
+    std::filesystem::create_directories(Options.Directory);
+
+    const auto timerOverhead = CalibrateTimer();
+    std::fprintf(stderr, "label %s, %llu calls per thread, timer overhead %llu ns\n",
+                 Options.Label.c_str(),
+                 static_cast<unsigned long long>(Options.Calls),
+                 static_cast<unsigned long long>(timerOverhead));
+    PrintTableHeader();
+
+    for (const auto sink : Options.Sinks) {
+        for (const auto delivery : Options.Deliveries) {
+            for (const auto formatter : Options.Formatters) {
+                for (const auto message : Options.Messages) {
+                    for (const auto levels : Options.Levels) {
+                        for (const auto threads : Options.Threads) {
+                            const SCENARIO scenario{sink, delivery, formatter, message, levels, threads};
+                            const auto result = RunScenario(scenario, Options, *benchSession);
+                            PrintJson(scenario, Options, result, timerOverhead);
+                            PrintTableRow(scenario, result);
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    return 0;
+}
+
+std::vector<std::string>
+SplitList(
+    std::string_view List
+)
+{
+    std::vector<std::string> items;
+
+    while (!List.empty()) {
+        const auto comma = List.find(',');
+        items.emplace_back(List.substr(0, comma));
+        List = comma == std::string_view::npos ? std::string_view{} : List.substr(comma + 1);
+    }
+
+    return items;
+}
+
+template<class T, std::size_t N>
+std::vector<T>
+ParseNames(
+    std::string_view List,
+    const std::string_view (&Names)[N]
+)
+{
+    std::vector<T> values;
+
+    for (const auto &item : SplitList(List)) {
+        const auto name = std::find(std::begin(Names), std::end(Names), item);
+        if (name == std::end(Names)) {
+            throw std::runtime_error{"Unknown value " + item};
+        }
+        values.push_back(static_cast<T>(name - std::begin(Names)));
+    }
+
+    return values;
+}
+
+/**
+ * @brief Returns the value of a key of a flat JSON object written by
+ * PrintJson, as text without quotes.
+ */
+std::string_view
+JsonValue(
+    std::string_view Line,
+    std::string_view Key
+)
+{
+    const auto quotedKey = '"' + std::string{Key} + "\":";
+    auto position = Line.find(quotedKey);
+    if (position == std::string_view::npos) {
+        return {};
+    }
+
+    position += quotedKey.size();
+    if (position < Line.size() && Line[position] == '"') {
+        const auto end = Line.find('"', position + 1);
+        return Line.substr(position + 1, end - position - 1);
+    }
+
+    const auto end = Line.find_first_of(",}", position);
+    return Line.substr(position, end - position);
+}
+
+class COMPARED {
+public:
+    double CallsPerSecond = 0;
+    double P99 = 0;
+};
+
+std::map<std::string, COMPARED>
+ReadResults(
+    const std::string &Path
+)
+{
+    std::ifstream file{Path};
+    if (!file) {
+        throw std::runtime_error{"Failed to open " + Path};
+    }
+
+    std::map<std::string, COMPARED> results;
+    std::string line;
+
+    while (std::getline(file, line)) {
+        const auto scenario = JsonValue(line, "scenario");
+        if (scenario.empty()) {
+            continue;
+        }
+
+        auto &result = results[std::string{scenario}];
+        result.CallsPerSecond = std::strtod(std::string{JsonValue(line, "calls_per_second")}.c_str(), nullptr);
+        result.P99 = std::strtod(std::string{JsonValue(line, "p99")}.c_str(), nullptr);
+    }
+
+    return results;
+}
+
+int
+Compare(
+    const std::string &BasePath,
+    const std::string &NewPath
+)
+{
+    const auto baseResults = ReadResults(BasePath);
+    const auto newResults = ReadResults(NewPath);
+
+    std::printf("%-42s %12s %12s %7s %8s %8s %7s\n",
+                "scenario", "base calls/s", "new calls/s", "ratio", "base p99", "new p99", "ratio");
+
+    for (const auto &[scenario, baseResult] : baseResults) {
+        const auto newResult = newResults.find(scenario);
+        if (newResult == newResults.end()) {
+            continue;
+        }
+
+        const auto &result = newResult->second;
+        std::printf("%-42s %12.0f %12.0f %7.2f %8.0f %8.0f %7.2f\n",
+                    scenario.c_str(),
+                    baseResult.CallsPerSecond,
+                    result.CallsPerSecond,
+                    baseResult.CallsPerSecond > 0 ? result.CallsPerSecond / baseResult.CallsPerSecond : 0,
+                    baseResult.P99,
+                    result.P99,
+                    baseResult.P99 > 0 ? result.P99 / baseResult.P99 : 0);
+    }
+
+    return 0;
+}
+
+int
+Usage()
+{
+    std::fprintf(stderr,
+                 "Usage:\n"
+                 "  logbench [run] [--threads LIST] [--calls N] [--sinks LIST] [--delivery LIST]\n"
+                 "           [--formatters LIST] [--messages LIST] [--levels LIST] [--label TEXT]\n"
+                 "           [--dir DIR]\n"
+                 "  logbench compare BASE.jsonl NEW.jsonl\n"
+                 "sinks: null,file,buffered  delivery: queued,sync  formatters: standard,fast\n"
+                 "messages: short,long,deferred,fields  levels: info,mixed\n");
+    return 2;
+}
+
+}
+
+int
+main(
+    int Argc,
+    char **Argv
+)
+{
+    try {
+        int first = 1;
+
+        if (Argc > 1 && std::string_view{Argv[1]} == "compare") {
+            return Argc == 4 ? Compare(Argv[2], Argv[3]) : Usage();
+        }
+
+        if (Argc > 1 && std::string_view{Argv[1]} == "run") {
+            first = 2;
+        }
+
+        OPTIONS options;
+
+        for (int i = first; i < Argc; ++i) {
+            const std::string_view option = Argv[i];
+            if (i + 1 >= Argc) {
+                return Usage();
+            }
+
+            const std::string_view value = Argv[++i];
+            if (option == "--threads") {
+                options.Threads.clear();
+                for (const auto &item : SplitList(value)) {
+                    options.Threads.push_back(static_cast<unsigned>(std::max(1ul, std::stoul(item))));
+                }
+            } else if (option == "--calls") {
+                options.Calls = std::max<std::uint64_t>(std::stoull(std::string{value}), 1);
+            } else if (option == "--sinks") {
+                options.Sinks = ParseNames<SINK>(value, SinkNames);
+            } else if (option == "--delivery") {
+                options.Deliveries = ParseNames<DELIVERY>(value, DeliveryNames);
+            } else if (option == "--formatters") {
+                options.Formatters = ParseNames<FORMATTER>(value, FormatterNames);
+            } else if (option == "--messages") {
+                options.Messages = ParseNames<MESSAGE_KIND>(value, MessageNames);
+            } else if (option == "--levels") {
+                options.Levels = ParseNames<LEVEL_MIX>(value, LevelMixNames);
+            } else if (option == "--label") {
+                options.Label = value;
+            } else if (option == "--dir") {
+                options.Directory = value;
+            } else {
+                return Usage();
+            }
+        }
+
+        return Run(options);
+
+    } catch (const std::exception &exception) {
+        std::fprintf(stderr, "logbench: %s\n", exception.what());
+        return 1;
+    }
+}
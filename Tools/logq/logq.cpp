@@ -0,0 +1,949 @@
+﻿/*!
+ *  @file       logq.cpp
+ *  @brief      Offline indexer and query tool for binary log files.
+ *  @details    Standalone POSIX tool for files written by
+ *              BINARY_LOG_PROVIDER_IMPL. Build with:
+ *
+ *                  g++ -std=c++20 -O2 -I../../User/common -o logq logq.cpp
+ *
+ *              Usage:
+ *
+ *                  logq index FILE
+ *                  logq query FILE [--level LEVEL] [--from TIME] [--to TIME] [--count]
+ *                  logq render FILE
+ *
+ *              index builds FILE.ntli, a level/time index of the log file.
+ *              query prints the entries of LEVEL or more severe (Verbose
+ *              by default) logged between the two times, inclusive, and
+ *              builds or refreshes the index first when it is missing or
+ *              older than the log file. render prints the whole file. Both
+ *              print entries in the LOG_FORMATTER text layout, typed fields
+ *              included. Times are UTC and have the form
+ *              YYYY-MM-DD[THH:MM[:SS[.fffffff]]].
+ *
+ *              The log file and the index are memory-mapped. A query binary
+ *              searches one sorted timestamp array per level and merges the
+ *              matches, so it only touches the records it prints.
+ */
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <cwctype>
+#include <memory>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "logbfmt.hpp"
+#include "logfield.hpp"
+
+using namespace Common::Log;
+
+namespace {
+
+constexpr std::size_t LevelCount = static_cast<std::size_t>(LOG_LEVEL::Verbose) + 1;
+
+constexpr char IndexMagic[4] = {'N', 'T', 'L', 'I'};
+constexpr std::uint32_t IndexVersion = 1;
+
+using BINARY_TICKS = std::chrono::duration<std::int64_t, std::ratio<1, LogBinaryTicksPerSecond>>;
+
+/**
+ * @brief Header of an index file. It is followed by the segment table, the
+ * definition offsets and one entry array per level.
+ */
+class INDEX_HEADER {
+public:
+    char Magic[4];
+    std::uint32_t Version;
+    std::uint64_t SourceSize;
+    std::uint64_t SegmentCount;
+    std::uint64_t DefinitionCount;
+    std::uint64_t EntryCount[LevelCount];
+};
+
+/**
+ * @brief Range of the definition offsets that belong to a segment, the
+ * records between two Begin records.
+ */
+class INDEX_SEGMENT {
+public:
+    std::uint64_t FirstDefinition;
+    std::uint64_t DefinitionCount;
+};
+
+class INDEX_ENTRY {
+public:
+    std::int64_t Timestamp;
+    std::uint64_t Offset;
+    std::uint32_t Segment;
+    std::uint32_t Reserved;
+};
+
+static_assert(sizeof(INDEX_HEADER) % 8 == 0);
+static_assert(sizeof(INDEX_ENTRY) == 24);
+
+/**
+ * @brief Read-only memory mapping of a whole file.
+ */
+class MAPPED_FILE {
+public:
+    explicit
+    MAPPED_FILE(
+        const std::string &Path
+    )
+    {
+        Descriptor_ = open(Path.c_str(), O_RDONLY);
+        if (Descriptor_ < 0) {
+            throw std::runtime_error{"Failed to open " + Path};
+        }
+
+        struct stat status{};
+        if (fstat(Descriptor_, &status) != 0) {
+            close(Descriptor_);
+            throw std::runtime_error{"Failed to query the size of " + Path};
+        }
+
+        Size_ = static_cast<std::size_t>(status.st_size);
+        if (Size_ == 0) {
+            return;
+        }
+
+        Data_ = mmap(nullptr, Size_, PROT_READ, MAP_PRIVATE, Descriptor_, 0);
+        if (Data_ == MAP_FAILED) {
+            close(Descriptor_);
+            throw std::runtime_error{"Failed to map " + Path};
+        }
+    }
+
+    ~MAPPED_FILE()
+    {
+        if (Data_ && Data_ != MAP_FAILED) {
+            munmap(Data_, Size_);
+        }
+        close(Descriptor_);
+    }
+
+    MAPPED_FILE(const MAPPED_FILE &) = delete;
+    MAPPED_FILE &operator=(const MAPPED_FILE &) = delete;
+
+    const std::byte *
+    GetData() const
+    {
+        return static_cast<const std::byte *>(Data_);
+    }
+
+    std::size_t
+    GetSize() const
+    {
+        return Size_;
+    }
+
+private:
+    int Descriptor_ = -1;
+    void *Data_ = nullptr;
+    std::size_t Size_ = 0;
+};
+
+/**
+ * @brief Returns the fixed part of a record, or nullptr if the record is too
+ * short for its kind.
+ */
+template<class RECORD>
+const RECORD *
+RecordAs(
+    const MAPPED_FILE &File,
+    std::uint64_t Offset
+)
+{
+    const auto *header = reinterpret_cast<const LOG_BINARY_RECORD_HEADER *>(File.GetData() + Offset);
+    if (header->Kind != RECORD::Kind || header->Size < sizeof(RECORD)) {
+        return nullptr;
+    }
+    return reinterpret_cast<const RECORD *>(header);
+}
+
+/**
+ * @brief Returns the payload of a record, or an empty view if it does not fit.
+ */
+template<class RECORD>
+std::string_view
+PayloadOf(
+    const RECORD &Record,
+    std::uint32_t Length
+)
+{
+    if (Length > Record.Header.Size - sizeof(RECORD)) {
+        return {};
+    }
+    return {reinterpret_cast<const char *>(&Record + 1), Length};
+}
+
+bool
+IsBeginRecord(
+    const MAPPED_FILE &File,
+    std::uint64_t Offset
+)
+{
+    if (Offset + sizeof(LOG_BINARY_BEGIN) > File.GetSize()) {
+        return false;
+    }
+    const auto *begin = RecordAs<LOG_BINARY_BEGIN>(File, Offset);
+    return begin &&
+           begin->Header.Size == sizeof(LOG_BINARY_BEGIN) &&
+           std::memcmp(begin->Magic, LogBinaryMagic, sizeof(LogBinaryMagic)) == 0;
+}
+
+/**
+ * @brief Calls Visitor(Offset, Header) for every record of a log file.
+ * @details A record cut short by a crashed writer is followed by the Begin
+ * record of the next run, which its declared size may cover. Records are
+ * therefore checked for an embedded Begin record, and parsing resumes at
+ * the next Begin record after any damaged record.
+ */
+template<class VISITOR>
+void
+ForEachRecord(
+    const MAPPED_FILE &File,
+    VISITOR &&Visitor
+)
+{
+    const auto size = File.GetSize();
+    std::uint64_t offset = 0;
+
+    while (offset + sizeof(LOG_BINARY_RECORD_HEADER) <= size) {
+        const auto *header = reinterpret_cast<const LOG_BINARY_RECORD_HEADER *>(File.GetData() + offset);
+
+        if (header->Size < sizeof(LOG_BINARY_RECORD_HEADER) ||
+            header->Size % LogBinaryAlignment != 0 ||
+            header->Size > size - offset) {
+            offset += LogBinaryAlignment;
+            while (offset + sizeof(LOG_BINARY_RECORD_HEADER) <= size && !IsBeginRecord(File, offset)) {
+                offset += LogBinaryAlignment;
+            }
+            continue;
+        }
+
+        auto embedded = offset + LogBinaryAlignment;
+        while (embedded < offset + header->Size && !IsBeginRecord(File, embedded)) {
+            embedded += LogBinaryAlignment;
+        }
+        if (embedded < offset + header->Size) {
+            offset = embedded;
+            continue;
+        }
+
+        Visitor(offset, *header);
+        offset += header->Size;
+    }
+}
+
+/**
+ * @brief Strings, sites, zones and HRESULT descriptions of one segment.
+ */
+class DEFINITIONS {
+public:
+    class SITE {
+    public:
+        std::uint32_t FileStringId;
+        std::uint32_t FunctionStringId;
+        std::int32_t Line;
+    };
+
+    class ZONE {
+    public:
+        std::int32_t OffsetSeconds;
+        std::uint32_t AbbreviationStringId;
+    };
+
+    void
+    Clear()
+    {
+        Strings_.clear();
+        Sites_.clear();
+        Zones_.clear();
+        Hresults_.clear();
+    }
+
+    /**
+     * @brief Records the definition at Offset, ignores other records.
+     */
+    void
+    Apply(
+        const MAPPED_FILE &File,
+        std::uint64_t Offset
+    )
+    {
+        if (const auto *string = RecordAs<LOG_BINARY_STRING>(File, Offset)) {
+            Store(Strings_, string->StringId, PayloadOf(*string, string->Length));
+        } else if (const auto *site = RecordAs<LOG_BINARY_SITE>(File, Offset)) {
+            Store(Sites_, site->SiteId, SITE{site->FileStringId, site->FunctionStringId, site->Line});
+        } else if (const auto *zone = RecordAs<LOG_BINARY_ZONE>(File, Offset)) {
+            Store(Zones_, zone->ZoneId, ZONE{zone->OffsetSeconds, zone->AbbreviationStringId});
+        } else if (const auto *hresult = RecordAs<LOG_BINARY_HRESULT>(File, Offset)) {
+            Hresults_[hresult->Hresult] = hresult->DescriptionStringId;
+        }
+    }
+
+    std::string_view
+    GetString(
+        std::uint32_t StringId
+    ) const
+    {
+        return StringId < Strings_.size() ? Strings_[StringId] : std::string_view{"?"};
+    }
+
+    SITE
+    GetSite(
+        std::uint32_t SiteId
+    ) const
+    {
+        return SiteId < Sites_.size() ? Sites_[SiteId] : SITE{UINT32_MAX, UINT32_MAX, 0};
+    }
+
+    ZONE
+    GetZone(
+        std::uint32_t ZoneId
+    ) const
+    {
+        return ZoneId < Zones_.size() ? Zones_[ZoneId] : ZONE{0, UINT32_MAX};
+    }
+
+    std::string_view
+    GetHresultDescription(
+        std::uint32_t Hresult
+    ) const
+    {
+        const auto iterator = Hresults_.find(Hresult);
+        return iterator != Hresults_.end() ? GetString(iterator->second) : std::string_view{};
+    }
+
+private:
+    template<class T>
+    static
+    void
+    Store(
+        std::vector<T> &Table,
+        std::uint32_t Id,
+        T Value
+    )
+    {
+        if (Id >= Table.size()) {
+            Table.resize(Id + 1);
+        }
+        Table[Id] = Value;
+    }
+
+    std::vector<std::string_view> Strings_;
+    std::vector<SITE> Sites_;
+    std::vector<ZONE> Zones_;
+    std::unordered_map<std::uint32_t, std::uint32_t> Hresults_;
+};
+
+bool
+IsDefinition(
+    LOG_BINARY_RECORD_KIND Kind
+)
+{
+    return Kind == LOG_BINARY_RECORD_KIND::String ||
+           Kind == LOG_BINARY_RECORD_KIND::Site ||
+           Kind == LOG_BINARY_RECORD_KIND::Zone ||
+           Kind == LOG_BINARY_RECORD_KIND::Hresult;
+}
+
+/**
+ * @brief Appends a duration with the unit LOG_FIELDS::RenderTo picks for it.
+ */
+void
+AppendDuration(
+    std::int64_t Nanoseconds,
+    std::string &Output
+)
+{
+    const auto magnitude = Nanoseconds < 0 ? -Nanoseconds : Nanoseconds;
+
+    char duration[48];
+    if (magnitude < 1'000) {
+        std::snprintf(duration, sizeof(duration), "%lldns", static_cast<long long>(Nanoseconds));
+    } else if (magnitude < 1'000'000) {
+        std::snprintf(duration, sizeof(duration), "%.3fus", static_cast<double>(Nanoseconds) / 1e3);
+    } else if (magnitude < 1'000'000'000) {
+        std::snprintf(duration, sizeof(duration), "%.3fms", static_cast<double>(Nanoseconds) / 1e6);
+    } else {
+        std::snprintf(duration, sizeof(duration), "%.3fs", static_cast<double>(Nanoseconds) / 1e9);
+    }
+    Output += duration;
+}
+
+/**
+ * @brief Appends the field block of an entry as " {key=value, ...}", like
+ * LOG_FIELDS::RenderTo. A field cut short ends the block.
+ */
+void
+RenderFields(
+    const LOG_BINARY_ENTRY &Entry,
+    const DEFINITIONS &Definitions,
+    std::string &Output
+)
+{
+    const auto truncated = (Entry.Flags & LogBinaryEntryFieldsTruncated) != 0;
+    if (Entry.FieldsLength == 0 && !truncated) {
+        return;
+    }
+
+    const auto payload = PayloadOf(Entry, Entry.MessageLength + Entry.FieldsLength);
+    const auto block = payload.empty() ? payload : payload.substr(Entry.MessageLength);
+
+    bool first = true;
+    Output += " {";
+
+    for (std::size_t offset = 0; offset + sizeof(LOG_BINARY_FIELD) <= block.size();) {
+        LOG_BINARY_FIELD field;
+        std::memcpy(&field, block.data() + offset, sizeof(field));
+        offset += sizeof(field);
+
+        if (field.Size > block.size() - offset) {
+            break;
+        }
+
+        const auto value = block.substr(offset, field.Size);
+        offset += field.Size;
+
+        if (!first) {
+            Output += ", ";
+        }
+        first = false;
+
+        Output += Definitions.GetString(field.KeyStringId);
+        Output += '=';
+
+        if (field.Type == static_cast<std::uint8_t>(LOG_FIELD_TYPE::WideString) ||
+            field.Type == static_cast<std::uint8_t>(LOG_FIELD_TYPE::NarrowString)) {
+            Output += '"';
+            Output += value;
+            Output += '"';
+            continue;
+        }
+
+        std::uint64_t integer = 0;
+        std::memcpy(&integer, value.data(), std::min(value.size(), sizeof(integer)));
+
+        char text[32];
+        switch (static_cast<LOG_FIELD_TYPE>(field.Type)) {
+        case LOG_FIELD_TYPE::Signed:
+            std::snprintf(text, sizeof(text), "%lld", static_cast<long long>(integer));
+            break;
+        case LOG_FIELD_TYPE::Bool:
+            std::snprintf(text, sizeof(text), "%s", integer ? "true" : "false");
+            break;
+        case LOG_FIELD_TYPE::Pointer:
+            std::snprintf(text, sizeof(text), "0x%llx", static_cast<unsigned long long>(integer));
+            break;
+        case LOG_FIELD_TYPE::Duration:
+            AppendDuration(static_cast<std::int64_t>(integer), Output);
+            continue;
+        default:
+            std::snprintf(text, sizeof(text), "%llu", static_cast<unsigned long long>(integer));
+            break;
+        }
+        Output += text;
+    }
+
+    if (truncated) {
+        Output += first ? "..." : ", ...";
+    }
+
+    Output += '}';
+}
+
+/**
+ * @brief Appends an entry in the LOG_FORMATTER text layout.
+ */
+void
+RenderEntry(
+    const LOG_BINARY_ENTRY &Entry,
+    const DEFINITIONS &Definitions,
+    std::string &Output
+)
+{
+    using namespace std::chrono;
+
+    const auto levelName = Entry.Level < LevelCount
+                               ? LogLevelName(static_cast<LOG_LEVEL>(Entry.Level))
+                               : std::wstring_view{L"?"};
+
+    Output += '[';
+    for (const auto character : levelName) {
+        Output += static_cast<char>(character);
+    }
+    Output += "] [";
+
+    const auto zone = Definitions.GetZone(Entry.ZoneId);
+    const sys_time<BINARY_TICKS> local{BINARY_TICKS{Entry.Timestamp} + seconds{zone.OffsetSeconds}};
+    const auto day = floor<days>(local);
+    const year_month_day date{day};
+    const hh_mm_ss time{local - day};
+
+    char timestamp[64];
+    std::snprintf(timestamp,
+                  sizeof(timestamp),
+                  "%04d-%02u-%02u %02d:%02d:%02d.%07lld ",
+                  static_cast<int>(date.year()),
+                  static_cast<unsigned>(date.month()),
+                  static_cast<unsigned>(date.day()),
+                  static_cast<int>(time.hours().count()),
+                  static_cast<int>(time.minutes().count()),
+                  static_cast<int>(time.seconds().count()),
+                  static_cast<long long>(time.subseconds().count()));
+    Output += timestamp;
+    Output += Definitions.GetString(zone.AbbreviationStringId);
+    Output += "] ";
+    Output += PayloadOf(Entry, Entry.MessageLength);
+    RenderFields(Entry, Definitions, Output);
+
+    if (Entry.Flags & LogBinaryEntryHasHresult) {
+        char hresult[32];
+        std::snprintf(hresult, sizeof(hresult), "\n  !HRESULT [0x%08x]: ", Entry.Hresult);
+        Output += hresult;
+        Output += Definitions.GetHresultDescription(Entry.Hresult);
+    }
+
+    const auto site = Definitions.GetSite(Entry.SiteId);
+    Output += "\n  >> at ";
+    Output += Definitions.GetString(site.FunctionStringId);
+    Output += " [";
+    Output += Definitions.GetString(site.FileStringId);
+    Output += " @ ";
+    Output += std::to_string(site.Line);
+    Output += "]\n\n";
+}
+
+/**
+ * @brief Writes buffered output to stdout once it grows large.
+ */
+void
+FlushOutput(
+    std::string &Output,
+    bool Force = false
+)
+{
+    if (Force || Output.size() >= 1024 * 1024) {
+        std::fwrite(Output.data(), 1, Output.size(), stdout);
+        Output.clear();
+    }
+}
+
+void
+BuildIndex(
+    const MAPPED_FILE &File,
+    const std::string &IndexPath
+)
+{
+    std::vector<INDEX_SEGMENT> segments{INDEX_SEGMENT{0, 0}};
+    std::vector<std::uint64_t> definitions;
+    std::array<std::vector<INDEX_ENTRY>, LevelCount> entries;
+
+    ForEachRecord(File, [&](std::uint64_t Offset, const LOG_BINARY_RECORD_HEADER &Header) {
+        if (Header.Kind == LOG_BINARY_RECORD_KIND::Begin) {
+            if (Offset != 0) {
+                segments.push_back(INDEX_SEGMENT{definitions.size(), 0});
+            }
+        } else if (IsDefinition(Header.Kind)) {
+            definitions.push_back(Offset);
+            ++segments.back().DefinitionCount;
+        } else if (const auto *entry = RecordAs<LOG_BINARY_ENTRY>(File, Offset)) {
+            if (entry->Level < LevelCount) {
+                entries[entry->Level].push_back(INDEX_ENTRY{
+                    entry->Timestamp,
+                    Offset,
+                    static_cast<std::uint32_t>(segments.size() - 1),
+                    0
+                });
+            }
+        }
+    });
+
+    INDEX_HEADER header{};
+    std::memcpy(header.Magic, IndexMagic, sizeof(IndexMagic));
+    header.Version = IndexVersion;
+    header.SourceSize = File.GetSize();
+    header.SegmentCount = segments.size();
+    header.DefinitionCount = definitions.size();
+
+    for (std::size_t level = 0; level < LevelCount; ++level) {
+        /* Entries are almost in time order already, the sort is cheap. */
+        std::ranges::stable_sort(entries[level], {}, &INDEX_ENTRY::Timestamp);
+        header.EntryCount[level] = entries[level].size();
+    }
+
+    const auto temporaryPath = IndexPath + ".tmp";
+    auto *output = std::fopen(temporaryPath.c_str(), "wb");
+    if (!output) {
+        throw std::runtime_error{"Failed to create " + temporaryPath};
+    }
+
+    std::fwrite(&header, sizeof(header), 1, output);
+    std::fwrite(segments.data(), sizeof(INDEX_SEGMENT), segments.size(), output);
+    std::fwrite(definitions.data(), sizeof(std::uint64_t), definitions.size(), output);
+    for (const auto &level : entries) {
+        std::fwrite(level.data(), sizeof(INDEX_ENTRY), level.size(), output);
+    }
+
+    const bool failed = std::ferror(output) != 0;
+    if (std::fclose(output) != 0 || failed || std::rename(temporaryPath.c_str(), IndexPath.c_str()) != 0) {
+        std::remove(temporaryPath.c_str());
+        throw std::runtime_error{"Failed to write " + IndexPath};
+    }
+}
+
+/**
+ * @brief Memory-mapped index of a log file.
+ */
+class INDEX {
+public:
+    /**
+     * @brief Maps the index of a log file, rebuilding it if it is missing or stale.
+     */
+    INDEX(
+        const MAPPED_FILE &File,
+        const std::string &IndexPath
+    )
+    {
+        if (!Map(File, IndexPath)) {
+            BuildIndex(File, IndexPath);
+            if (!Map(File, IndexPath)) {
+                throw std::runtime_error{"Invalid index " + IndexPath};
+            }
+        }
+    }
+
+    std::span<const INDEX_SEGMENT> Segments;
+    std::span<const std::uint64_t> Definitions;
+    std::array<std::span<const INDEX_ENTRY>, LevelCount> Entries;
+
+private:
+    bool
+    Map(
+        const MAPPED_FILE &File,
+        const std::string &IndexPath
+    )
+    {
+        try {
+            Index_ = std::make_unique<MAPPED_FILE>(IndexPath);
+        } catch (const std::runtime_error &) {
+            return false;
+        }
+
+        if (Index_->GetSize() < sizeof(INDEX_HEADER)) {
+            return false;
+        }
+
+        const auto *header = reinterpret_cast<const INDEX_HEADER *>(Index_->GetData());
+        if (std::memcmp(header->Magic, IndexMagic, sizeof(IndexMagic)) != 0 ||
+            header->Version != IndexVersion ||
+            header->SourceSize != File.GetSize()) {
+            return false;
+        }
+
+        std::uint64_t expectedSize = sizeof(INDEX_HEADER) +
+                                     header->SegmentCount * sizeof(INDEX_SEGMENT) +
+                                     header->DefinitionCount * sizeof(std::uint64_t);
+        for (const auto count : header->EntryCount) {
+            expectedSize += count * sizeof(INDEX_ENTRY);
+        }
+        if (expectedSize != Index_->GetSize()) {
+            return false;
+        }
+
+        const auto *data = Index_->GetData() + sizeof(INDEX_HEADER);
+        Segments = {reinterpret_cast<const INDEX_SEGMENT *>(data), header->SegmentCount};
+        data += header->SegmentCount * sizeof(INDEX_SEGMENT);
+        Definitions = {reinterpret_cast<const std::uint64_t *>(data), header->DefinitionCount};
+        data += header->DefinitionCount * sizeof(std::uint64_t);
+        for (std::size_t level = 0; level < LevelCount; ++level) {
+            Entries[level] = {reinterpret_cast<const INDEX_ENTRY *>(data), header->EntryCount[level]};
+            data += header->EntryCount[level] * sizeof(INDEX_ENTRY);
+        }
+
+        return true;
+    }
+
+    std::unique_ptr<MAPPED_FILE> Index_;
+};
+
+std::int64_t
+ParseTime(
+    const std::string &Text
+)
+{
+    using namespace std::chrono;
+
+    int year = 0;
+    unsigned month = 0;
+    unsigned day = 0;
+    int hour = 0;
+    int minute = 0;
+    int second = 0;
+    int consumed = 0;
+
+    const int fields = std::sscanf(Text.c_str(), "%d-%u-%u%n", &year, &month, &day, &consumed);
+    if (fields != 3) {
+        throw std::runtime_error{"Invalid time " + Text};
+    }
+
+    const char *rest = Text.c_str() + consumed;
+    std::int64_t fraction = 0;
+
+    if (*rest == 'T' || *rest == ' ') {
+        int timeConsumed = 0;
+        if (std::sscanf(rest + 1, "%d:%d%n", &hour, &minute, &timeConsumed) != 2) {
+            throw std::runtime_error{"Invalid time " + Text};
+        }
+        rest += 1 + timeConsumed;
+
+        if (*rest == ':') {
+            int secondConsumed = 0;
+            if (std::sscanf(rest + 1, "%d%n", &second, &secondConsumed) != 1) {
+                throw std::runtime_error{"Invalid time " + Text};
+            }
+            rest += 1 + secondConsumed;
+
+            if (*rest == '.') {
+                std::int64_t scale = LogBinaryTicksPerSecond;
+                for (++rest; *rest >= '0' && *rest <= '9'; ++rest) {
+                    scale /= 10;
+                    fraction += (*rest - '0') * scale;
+                }
+            }
+        }
+    }
+
+    if (*rest == 'Z') {
+        ++rest;
+    }
+
+    const year_month_day date{std::chrono::year{year}, std::chrono::month{month}, std::chrono::day{day}};
+    if (*rest != '\0' || !date.ok()) {
+        throw std::runtime_error{"Invalid time " + Text};
+    }
+
+    const auto time = sys_days{date} + hours{hour} + minutes{minute} + seconds{second};
+    return duration_cast<BINARY_TICKS>(time.time_since_epoch()).count() + fraction;
+}
+
+LOG_LEVEL
+ParseLevel(
+    const std::string &Text
+)
+{
+    for (std::size_t level = 0; level < LevelCount; ++level) {
+        const auto name = LogLevelName(static_cast<LOG_LEVEL>(level));
+        if (std::ranges::equal(name, Text, [](wchar_t Left, char Right) {
+            return std::towlower(Left) == std::towlower(static_cast<unsigned char>(Right));
+        })) {
+            return static_cast<LOG_LEVEL>(level);
+        }
+    }
+
+    throw std::runtime_error{"Invalid level " + Text};
+}
+
+int
+Index(
+    const std::string &Path
+)
+{
+    const MAPPED_FILE file{Path};
+
+    const auto start = std::chrono::steady_clock::now();
+    BuildIndex(file, Path + ".ntli");
+    const auto elapsed = std::chrono::steady_clock::now() - start;
+
+    std::fprintf(stderr,
+                 "Indexed %zu bytes in %lld ms\n",
+                 file.GetSize(),
+                 static_cast<long long>(std::chrono::duration_cast<std::chrono::milliseconds>(elapsed).count()));
+    return 0;
+}
+
+int
+Query(
+    const std::string &Path,
+    LOG_LEVEL Level,
+    std::int64_t From,
+    std::int64_t To,
+    bool CountOnly
+)
+{
+    const MAPPED_FILE file{Path};
+    const INDEX index{file, Path + ".ntli"};
+
+    const auto start = std::chrono::steady_clock::now();
+
+    /* One sorted run per level, merged by timestamp. */
+    std::vector<std::span<const INDEX_ENTRY>> runs;
+    for (std::size_t level = 0; level <= static_cast<std::size_t>(Level); ++level) {
+        const auto entries = index.Entries[level];
+        const auto first = std::ranges::lower_bound(entries, From, {}, &INDEX_ENTRY::Timestamp);
+        const auto last = std::ranges::upper_bound(entries, To, {}, &INDEX_ENTRY::Timestamp);
+        if (first < last) {
+            runs.emplace_back(first, last);
+        }
+    }
+
+    DEFINITIONS definitions;
+    auto loadedSegment = UINT32_MAX;
+    std::string output;
+    std::uint64_t count = 0;
+
+    for (;;) {
+        std::span<const INDEX_ENTRY> *next = nullptr;
+        for (auto &run : runs) {
+            if (!run.empty() &&
+                (!next ||
+                 run.front().Timestamp < next->front().Timestamp ||
+                 (run.front().Timestamp == next->front().Timestamp && run.front().Offset < next->front().Offset))) {
+                next = &run;
+            }
+        }
+        if (!next) {
+            break;
+        }
+
+        const auto entry = next->front();
+        *next = next->subspan(1);
+        ++count;
+
+        if (CountOnly) {
+            continue;
+        }
+
+        if (entry.Segment != loadedSegment && entry.Segment < index.Segments.size()) {
+            const auto &segment = index.Segments[entry.Segment];
+            definitions.Clear();
+            for (const auto offset : index.Definitions.subspan(segment.FirstDefinition, segment.DefinitionCount)) {
+                definitions.Apply(file, offset);
+            }
+            loadedSegment = entry.Segment;
+        }
+
+        RenderEntry(*RecordAs<LOG_BINARY_ENTRY>(file, entry.Offset), definitions, output);
+        FlushOutput(output);
+    }
+
+    FlushOutput(output, true);
+
+    const auto elapsed = std::chrono::steady_clock::now() - start;
+    if (CountOnly) {
+        std::printf("%llu\n", static_cast<unsigned long long>(count));
+    }
+    std::fprintf(stderr,
+                 "%llu entries in %.3f ms\n",
+                 static_cast<unsigned long long>(count),
+                 std::chrono::duration<double, std::milli>(elapsed).count());
+    return 0;
+}
+
+int
+Render(
+    const std::string &Path
+)
+{
+    const MAPPED_FILE file{Path};
+
+    DEFINITIONS definitions;
+    std::string output;
+
+    ForEachRecord(file, [&](std::uint64_t Offset, const LOG_BINARY_RECORD_HEADER &Header) {
+        if (Header.Kind == LOG_BINARY_RECORD_KIND::Begin) {
+            definitions.Clear();
+        } else if (IsDefinition(Header.Kind)) {
+            definitions.Apply(file, Offset);
+        } else if (const auto *entry = RecordAs<LOG_BINARY_ENTRY>(file, Offset)) {
+            RenderEntry(*entry, definitions, output);
+            FlushOutput(output);
+        }
+    });
+
+    FlushOutput(output, true);
+    return 0;
+}
+
+int
+Usage()
+{
+    std::fprintf(stderr,
+                 "Usage:\n"
+                 "  logq index FILE\n"
+                 "  logq query FILE [--level LEVEL] [--from TIME] [--to TIME] [--count]\n"
+                 "  logq render FILE\n"
+                 "TIME is UTC: YYYY-MM-DD[THH:MM[:SS[.fffffff]]]\n");
+    return 2;
+}
+
+}
+
+int
+main(
+    int Argc,
+    char **Argv
+)
+{
+    if (Argc < 3) {
+        return Usage();
+    }
+
+    const std::string command = Argv[1];
+    const std::string path = Argv[2];
+
+    try {
+        if (command == "index" && Argc == 3) {
+            return Index(path);
+        }
+
+        if (command == "render" && Argc == 3) {
+            return Render(path);
+        }
+
+        if (command == "query") {
+            auto level = LOG_LEVEL::Verbose;
+            auto from = INT64_MIN;
+            auto to = INT64_MAX;
+            bool countOnly = false;
+
+            for (int i = 3; i < Argc; ++i) {
+                const std::string option = Argv[i];
+                if (option == "--count") {
+                    countOnly = true;
+                } else if (i + 1 < Argc && option == "--level") {
+                    level = ParseLevel(Argv[++i]);
+                } else if (i + 1 < Argc && option == "--from") {
+                    from = ParseTime(Argv[++i]);
+                } else if (i + 1 < Argc && option == "--to") {
+                    to = ParseTime(Argv[++i]);
+                } else {
+                    return Usage();
+                }
+            }
+
+            return Query(path, level, from, to, countOnly);
+        }
+    } catch (const std::exception &exception) {
+        std::fprintf(stderr, "logq: %s\n", exception.what());
+        return 1;
+    }
+
+    return Usage();
+}
@@ -0,0 +1,354 @@
+﻿/*!
+ *  @file       poolbench.cpp
+ *  @brief      Scaling benchmark of the work-stealing thread pool.
+ *  @details    Measures jobs per second of Common::Util::THREAD_POOL against
+ *              LEGACY_POOL, the JOB_QUEUE design (one std::deque behind one
+ *              std::mutex) drained by the same number of threads, which
+ *              sleep on a condition variable. Builds on Linux with GCC 12 or
+ *              later:
+ *
+ *                  g++ -std=c++23 -O2 -pthread -I../../User/common -o poolbench \
+ *                      poolbench.cpp ../../User/common/thrdpool.cpp
+ *
+ *              Usage:
+ *
+ *                  poolbench [--threads LIST] [--jobs N] [--work N]
+ *
+ *              Every pool size in LIST, by default the powers of two up to
+ *              and including the number of cores, runs two workloads of N
+ *              jobs, 1 million by default, each hashing for about WORK
+ *              iterations, 200 by default. inject enqueues every job from
+ *              the main thread. spawn enqueues one root job that splits
+ *              into a binary tree of jobs, every job enqueued by a worker.
+ *              Prints one JSON object per case to stdout and a table to
+ *              stderr.
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "thrdpool.hpp"
+
+using namespace Common;
+
+namespace {
+
+/**
+ * @brief The JOB_QUEUE design with consumer threads: a deque behind a mutex.
+ */
+class LEGACY_POOL {
+public:
+    explicit
+    LEGACY_POOL(
+        std::size_t WorkerCount
+    )
+    {
+        for (std::size_t i = 0; i < WorkerCount; ++i) {
+            Workers_.emplace_back([this] {
+                WorkerLoop();
+            });
+        }
+    }
+
+    ~LEGACY_POOL()
+    {
+        {
+            std::lock_guard lock{Lock_};
+            Stopping_ = true;
+        }
+
+        JobsChanged_.notify_all();
+        for (auto &worker : Workers_) {
+            worker.join();
+        }
+    }
+
+    template<std::invocable FunctionType>
+    auto
+    Enqueue(FunctionType &&Function)
+    {
+        using PACKAGED_JOB = std::packaged_task<std::invoke_result_t<FunctionType>()>;
+
+        PACKAGED_JOB packagedJob{std::forward<FunctionType>(Function)};
+        auto future = packagedJob.get_future();
+
+        {
+            std::lock_guard lock{Lock_};
+            Jobs_.push_back([packagedJob_ = std::move(packagedJob)]() mutable {
+                packagedJob_();
+            });
+        }
+
+        JobsChanged_.notify_one();
+        return future;
+    }
+
+private:
+    void
+    WorkerLoop()
+    {
+        for (;;) {
+            std::move_only_function<void()> job;
+            {
+                std::unique_lock lock{Lock_};
+                JobsChanged_.wait(lock, [this] {
+                    return Stopping_ || !Jobs_.empty();
+                });
+
+                if (Jobs_.empty()) {
+                    return;
+                }
+
+                job = std::move(Jobs_.front());
+                Jobs_.pop_front();
+            }
+
+            job();
+        }
+    }
+
+    std::mutex Lock_;
+    std::condition_variable JobsChanged_;
+    std::deque<std::move_only_function<void()>> Jobs_;
+    bool Stopping_ = false;
+    std::vector<std::thread> Workers_;
+};
+
+std::atomic<std::uint64_t> Checksum = 0;
+
+/*!
+ * @brief The job body: a short FNV-1a loop.
+ */
+void
+Work(
+    std::uint64_t Seed,
+    std::uint32_t Iterations
+)
+{
+    std::uint64_t hash = 14695981039346656037ull ^ Seed;
+    for (std::uint32_t i = 0; i < Iterations; ++i) {
+        hash = (hash ^ i) * 1099511628211ull;
+    }
+
+    Checksum.fetch_add(hash & 1, std::memory_order_relaxed);
+}
+
+/*!
+ * @brief Counts finished jobs and wakes the main thread after the last one.
+ */
+class COMPLETION {
+public:
+    explicit
+    COMPLETION(
+        std::uint64_t Jobs
+    ) : Remaining_(Jobs)
+    {
+    }
+
+    void
+    Finish()
+    {
+        if (Remaining_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            Remaining_.notify_all();
+        }
+    }
+
+    void
+    Wait()
+    {
+        for (auto remaining = Remaining_.load(std::memory_order_acquire);
+             remaining;
+             remaining = Remaining_.load(std::memory_order_acquire)) {
+            Remaining_.wait(remaining, std::memory_order_acquire);
+        }
+    }
+
+private:
+    std::atomic<std::uint64_t> Remaining_;
+};
+
+template<class POOL>
+std::chrono::nanoseconds
+Inject(
+    POOL &Pool,
+    std::uint64_t Jobs,
+    std::uint32_t WorkIterations
+)
+{
+    COMPLETION completion{Jobs};
+    const auto begin = std::chrono::steady_clock::now();
+
+    for (std::uint64_t i = 0; i < Jobs; ++i) {
+        Pool.Enqueue([&completion, i, WorkIterations] {
+            Work(i, WorkIterations);
+            completion.Finish();
+        });
+    }
+
+    completion.Wait();
+    return std::chrono::steady_clock::now() - begin;
+}
+
+/*!
+ * @brief Runs the jobs [First, First + Count) by splitting the range in
+ * halves until one job remains.
+ */
+template<class POOL>
+void
+Split(
+    POOL &Pool,
+    COMPLETION &Completion,
+    std::uint64_t First,
+    std::uint64_t Count,
+    std::uint32_t WorkIterations
+)
+{
+    while (Count > 1) {
+        const auto half = Count / 2;
+        Pool.Enqueue([&Pool, &Completion, First, half, WorkIterations] {
+            Split(Pool, Completion, First, half, WorkIterations);
+        });
+
+        First += half;
+        Count -= half;
+    }
+
+    Work(First, WorkIterations);
+    Completion.Finish();
+}
+
+template<class POOL>
+std::chrono::nanoseconds
+Spawn(
+    POOL &Pool,
+    std::uint64_t Jobs,
+    std::uint32_t WorkIterations
+)
+{
+    COMPLETION completion{Jobs};
+    const auto begin = std::chrono::steady_clock::now();
+
+    Pool.Enqueue([&Pool, &completion, Jobs, WorkIterations] {
+        Split(Pool, completion, 0, Jobs, WorkIterations);
+    });
+
+    completion.Wait();
+    return std::chrono::steady_clock::now() - begin;
+}
+
+template<class POOL>
+void
+RunCases(
+    const char *PoolName,
+    std::size_t Threads,
+    std::uint64_t Jobs,
+    std::uint32_t WorkIterations
+)
+{
+    POOL pool{Threads};
+
+    /* Warmup, starts the threads and grows the deques. */
+    Inject(pool, Jobs / 10, WorkIterations);
+    Spawn(pool, Jobs / 10, WorkIterations);
+
+    const std::pair<const char *, std::chrono::nanoseconds> results[] = {
+        {"inject", Inject(pool, Jobs, WorkIterations)},
+        {"spawn", Spawn(pool, Jobs, WorkIterations)}
+    };
+
+    for (const auto &[workload, elapsed] : results) {
+        const auto seconds = std::chrono::duration<double>(elapsed).count();
+        const auto perSecond = static_cast<double>(Jobs) / seconds;
+
+        std::printf("{\"pool\":\"%s\",\"workload\":\"%s\",\"threads\":%zu,\"jobs\":%llu,\"work\":%u,"
+                    "\"jobs_per_second\":%.0f,\"ns_per_job\":%.2f}\n",
+                    PoolName, workload, Threads, static_cast<unsigned long long>(Jobs), WorkIterations,
+                    perSecond, seconds * 1e9 / static_cast<double>(Jobs));
+        std::fprintf(stderr, "%-8s %-8s %7zu %14.0f %10.2f\n",
+                     PoolName, workload, Threads, perSecond, seconds * 1e9 / static_cast<double>(Jobs));
+    }
+}
+
+std::vector<std::size_t>
+ParseList(
+    std::string_view List
+)
+{
+    std::vector<std::size_t> values;
+    while (!List.empty()) {
+        const auto comma = List.find(',');
+        values.push_back(std::stoull(std::string{List.substr(0, comma)}));
+        List = comma == std::string_view::npos ? std::string_view{} : List.substr(comma + 1);
+    }
+
+    return values;
+}
+
+int
+Usage()
+{
+    std::fprintf(stderr, "Usage: poolbench [--threads LIST] [--jobs N] [--work N]\n");
+    return 2;
+}
+
+}
+
+int
+main(
+    int Argc,
+    char **Argv
+)
+{
+    const auto cores = std::max<std::size_t>(std::thread::hardware_concurrency(), 1);
+
+    std::vector<std::size_t> threads;
+    for (std::size_t count = 1; count < cores; count *= 2) {
+        threads.push_back(count);
+    }
+    threads.push_back(cores);
+
+    std::uint64_t jobs = 1'000'000;
+    std::uint32_t workIterations = 200;
+
+    for (int i = 1; i < Argc; ++i) {
+        const std::string_view option = Argv[i];
+        if (i + 1 >= Argc) {
+            return Usage();
+        }
+
+        if (option == "--threads") {
+            threads = ParseList(Argv[++i]);
+        } else if (option == "--jobs") {
+            jobs = std::stoull(Argv[++i]);
+        } else if (option == "--work") {
+            workIterations = static_cast<std::uint32_t>(std::stoul(Argv[++i]));
+        } else {
+            return Usage();
+        }
+    }
+
+    if (threads.empty() || std::ranges::count(threads, 0) || jobs < 10) {
+        return Usage();
+    }
+
+    std::fprintf(stderr, "%-8s %-8s %7s %14s %10s\n", "pool", "workload", "threads", "jobs/s", "ns/job");
+
+    for (const auto count : threads) {
+        RunCases<LEGACY_POOL>("legacy", count, jobs, workIterations);
+        RunCases<Util::THREAD_POOL>("stealing", count, jobs, workIterations);
+    }
+
+    return Checksum.load() == 0xFFFF'FFFF'FFFF'FFFF ? 1 : 0;
+}
@@ -0,0 +1,369 @@
+﻿/*!
+ *  @file       taskbench.cpp
+ *  @brief      Frame allocation benchmark of the coroutine tasks.
+ *  @details    Measures nanoseconds and global allocations per task of
+ *              Common::Util::TASK, whose frames come from the recycling
+ *              COROUTINE_FRAME_POOL, against PLAIN_TASK, the same lazy task
+ *              with frames from the global operator new. compat/Windows.h
+ *              of logbench stands in for the Win32 definitions the
+ *              allocation counter and the exception headers use. Builds on
+ *              Linux with GCC 14 or later:
+ *
+ *                  g++ -std=c++23 -O2 -pthread -I../logbench/compat -include Windows.h \
+ *                      -I../../User/common -DNTECTIVE_ALLOCATION_COUNTER_ACTIVE=true \
+ *                      -o taskbench taskbench.cpp \
+ *                      ../../User/common/{allocctr,arena,excption,strutil,task,thrdpool}.cpp
+ *
+ *              Usage:
+ *
+ *                  taskbench [--tasks N] [--threads N]
+ *
+ *              Runs three cases of N tasks, 1 million by default. plain and
+ *              pooled await N child tasks of one level each, which create,
+ *              run and destroy a frame, from a single driver coroutine.
+ *              switch hops a coroutine to a THREAD_POOL of THREADS workers,
+ *              4 by default, and back to the main thread N times, which
+ *              also includes the cost of the jobs: the pool boxes every job
+ *              on the heap, which is the one allocation per task left in
+ *              this case. Prints one JSON object per case to stdout and a
+ *              table to stderr.
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <coroutine>
+#include <cstdint>
+#include <cstdio>
+#include <exception>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <utility>
+
+#include "allocctr.hpp"
+#include "task.hpp"
+#include "thrdpool.hpp"
+
+using namespace Common;
+
+namespace {
+
+/*!
+ * @brief Lazy task with a result of type int and frames from the global
+ * allocator, otherwise as TASK<int>.
+ */
+class PLAIN_TASK {
+public:
+    class promise_type {
+    public:
+        class FINAL_AWAITER {
+        public:
+            bool
+            await_ready() noexcept
+            {
+                return false;
+            }
+
+            std::coroutine_handle<>
+            await_suspend(
+                std::coroutine_handle<promise_type> Handle
+            ) noexcept
+            {
+                return Handle.promise().Continuation;
+            }
+
+            void
+            await_resume() noexcept
+            {
+            }
+        };
+
+        PLAIN_TASK
+        get_return_object() noexcept
+        {
+            return PLAIN_TASK{std::coroutine_handle<promise_type>::from_promise(*this)};
+        }
+
+        std::suspend_always
+        initial_suspend() noexcept
+        {
+            return {};
+        }
+
+        FINAL_AWAITER
+        final_suspend() noexcept
+        {
+            return {};
+        }
+
+        void
+        return_value(
+            int Result
+        )
+        {
+            Value = Result;
+        }
+
+        void
+        unhandled_exception()
+        {
+            std::terminate();
+        }
+
+        std::coroutine_handle<> Continuation;
+        int Value = 0;
+    };
+
+    class AWAITER {
+    public:
+        bool
+        await_ready() noexcept
+        {
+            return false;
+        }
+
+        std::coroutine_handle<>
+        await_suspend(
+            std::coroutine_handle<> Awaiting
+        ) noexcept
+        {
+            Handle.promise().Continuation = Awaiting;
+            return Handle;
+        }
+
+        int
+        await_resume() noexcept
+        {
+            return Handle.promise().Value;
+        }
+
+        std::coroutine_handle<promise_type> Handle;
+    };
+
+    explicit
+    PLAIN_TASK(
+        std::coroutine_handle<promise_type> Handle
+    ) : Handle_(Handle)
+    {
+    }
+
+    PLAIN_TASK(
+        PLAIN_TASK &&Other
+    ) noexcept : Handle_(std::exchange(Other.Handle_, nullptr))
+    {
+    }
+
+    ~PLAIN_TASK()
+    {
+        if (Handle_) {
+            Handle_.destroy();
+        }
+    }
+
+    AWAITER
+    operator co_await() noexcept
+    {
+        return {Handle_};
+    }
+
+private:
+    std::coroutine_handle<promise_type> Handle_;
+};
+
+PLAIN_TASK
+PlainChild(
+    int Value
+)
+{
+    co_return Value + 1;
+}
+
+Util::TASK<int>
+PooledChild(
+    int Value
+)
+{
+    co_return Value + 1;
+}
+
+Util::TASK<std::uint64_t>
+PlainDriver(
+    std::uint64_t Tasks
+)
+{
+    std::uint64_t sum = 0;
+    for (std::uint64_t i = 0; i < Tasks; ++i) {
+        sum += co_await PlainChild(static_cast<int>(i & 0xFF));
+    }
+
+    co_return sum;
+}
+
+Util::TASK<std::uint64_t>
+PooledDriver(
+    std::uint64_t Tasks
+)
+{
+    std::uint64_t sum = 0;
+    for (std::uint64_t i = 0; i < Tasks; ++i) {
+        sum += co_await PooledChild(static_cast<int>(i & 0xFF));
+    }
+
+    co_return sum;
+}
+
+/*!
+ * @brief Executor running posted jobs on the thread that calls Run.
+ */
+class INLINE_EXECUTOR {
+public:
+    void
+    Post(
+        std::move_only_function<void()> Job
+    )
+    {
+        Job_ = std::move(Job);
+        Posted_.store(true, std::memory_order_release);
+        Posted_.notify_one();
+    }
+
+    void
+    Run()
+    {
+        Posted_.wait(false, std::memory_order_acquire);
+        Posted_.store(false, std::memory_order_relaxed);
+        std::exchange(Job_, nullptr)();
+    }
+
+private:
+    std::move_only_function<void()> Job_;
+    std::atomic<bool> Posted_ = false;
+};
+
+Util::TASK<std::uint64_t>
+SwitchDriver(
+    Util::THREAD_POOL &Pool,
+    INLINE_EXECUTOR &Main,
+    std::uint64_t Tasks
+)
+{
+    std::uint64_t sum = 0;
+    for (std::uint64_t i = 0; i < Tasks; ++i) {
+        co_await Util::SwitchTo(Pool);
+        sum += co_await PooledChild(static_cast<int>(i & 0xFF));
+        co_await Util::SwitchTo(Main);
+    }
+
+    co_return sum;
+}
+
+class RESULT {
+public:
+    double NanosecondsPerTask = 0;
+    double AllocationsPerTask = 0;
+};
+
+template<class RUN>
+RESULT
+Measure(
+    std::uint64_t Tasks,
+    RUN Run
+)
+{
+    /* Warms up the frame pool and the arena of the future. */
+    Run(std::min<std::uint64_t>(Tasks, 1000));
+
+    const auto baseAllocations = Util::GetAllocationCount();
+    const auto begin = std::chrono::steady_clock::now();
+
+    const auto sum = Run(Tasks);
+
+    const auto end = std::chrono::steady_clock::now();
+    const auto allocations = Util::GetAllocationCount() - baseAllocations;
+
+    /* Keeps the work observable. */
+    if (sum == 0) {
+        std::fprintf(stderr, "unexpected sum\n");
+    }
+
+    return {
+        .NanosecondsPerTask = std::chrono::duration<double, std::nano>(end - begin).count() / static_cast<double>(Tasks),
+        .AllocationsPerTask = static_cast<double>(allocations) / static_cast<double>(Tasks)
+    };
+}
+
+void
+Print(
+    const char *Case,
+    std::uint64_t Tasks,
+    const RESULT &Result
+)
+{
+    std::printf("{\"case\":\"%s\",\"tasks\":%llu,\"ns_per_task\":%.1f,\"allocations_per_task\":%.3f}\n",
+                Case, static_cast<unsigned long long>(Tasks), Result.NanosecondsPerTask, Result.AllocationsPerTask);
+    std::fprintf(stderr, "%-8s %12llu %10.1f %10.3f\n",
+                 Case, static_cast<unsigned long long>(Tasks), Result.NanosecondsPerTask, Result.AllocationsPerTask);
+}
+
+int
+Usage()
+{
+    std::fprintf(stderr, "Usage: taskbench [--tasks N] [--threads N]\n");
+    return 2;
+}
+
+}
+
+int
+main(
+    int Argc,
+    char **Argv
+)
+{
+    std::uint64_t tasks = 1'000'000;
+    std::size_t threads = 4;
+
+    for (int i = 1; i < Argc; ++i) {
+        const std::string_view option = Argv[i];
+        if (i + 1 >= Argc) {
+            return Usage();
+        }
+
+        if (option == "--tasks") {
+            tasks = std::stoull(Argv[++i]);
+        } else if (option == "--threads") {
+            threads = std::stoull(Argv[++i]);
+        } else {
+            return Usage();
+        }
+    }
+
+    if (tasks == 0 || threads == 0) {
+        return Usage();
+    }
+
+    std::fprintf(stderr, "%-8s %12s %10s %10s\n", "case", "tasks", "ns/task", "alloc/task");
+
+    Print("plain", tasks, Measure(tasks, [](std::uint64_t Tasks) {
+        return PlainDriver(Tasks).Start().Get();
+    }));
+    Print("pooled", tasks, Measure(tasks, [](std::uint64_t Tasks) {
+        return PooledDriver(Tasks).Start().Get();
+    }));
+
+    Util::THREAD_POOL pool{threads};
+    Print("switch", tasks, Measure(tasks, [&pool](std::uint64_t Tasks) {
+        INLINE_EXECUTOR main;
+        auto future = SwitchDriver(pool, main, Tasks).Start();
+
+        /* The driver ends on the main thread, after its last switch. */
+        for (std::uint64_t i = 0; i < Tasks; ++i) {
+            main.Run();
+        }
+
+        return future.Get();
+    }));
+
+    return 0;
+}
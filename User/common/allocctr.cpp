@@ -0,0 +1,188 @@
+﻿/*!
+ *  @file       allocctr.cpp
+ *  @brief      Global allocation counter.
+ */
+
+#include "allocctr.hpp"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+namespace Common::Util {
+
+namespace {
+
+std::atomic<std::uint64_t> AllocationCount = 0;
+thread_local std::uint64_t ThreadAllocationCount = 0;
+
+}
+
+std::uint64_t
+GetAllocationCount()
+{
+    return AllocationCount.load(std::memory_order_relaxed);
+}
+
+std::uint64_t
+GetThreadAllocationCount()
+{
+    return ThreadAllocationCount;
+}
+
+}
+
+#if NTECTIVE_ALLOCATION_COUNTER_ACTIVE
+
+namespace {
+
+void *
+CountedAllocate(
+    std::size_t Size
+)
+{
+    Common::Util::AllocationCount.fetch_add(1, std::memory_order_relaxed);
+    ++Common::Util::ThreadAllocationCount;
+
+    for (;;) {
+        if (void *memory = std::malloc(Size ? Size : 1)) {
+            return memory;
+        }
+        if (auto handler = std::get_new_handler()) {
+            handler();
+        } else {
+            throw std::bad_alloc{};
+        }
+    }
+}
+
+void *
+CountedAllocateAligned(
+    std::size_t Size,
+    std::align_val_t Alignment
+)
+{
+    Common::Util::AllocationCount.fetch_add(1, std::memory_order_relaxed);
+    ++Common::Util::ThreadAllocationCount;
+
+    for (;;) {
+        if (void *memory = _aligned_malloc(Size ? Size : 1, static_cast<std::size_t>(Alignment))) {
+            return memory;
+        }
+        if (auto handler = std::get_new_handler()) {
+            handler();
+        } else {
+            throw std::bad_alloc{};
+        }
+    }
+}
+
+}
+
+void *
+operator new(
+    std::size_t Size
+)
+{
+    return CountedAllocate(Size);
+}
+
+void *
+operator new[](
+    std::size_t Size
+)
+{
+    return CountedAllocate(Size);
+}
+
+void *
+operator new(
+    std::size_t Size,
+    std::align_val_t Alignment
+)
+{
+    return CountedAllocateAligned(Size, Alignment);
+}
+
+void *
+operator new[](
+    std::size_t Size,
+    std::align_val_t Alignment
+)
+{
+    return CountedAllocateAligned(Size, Alignment);
+}
+
+void
+operator delete(
+    void *Memory
+) noexcept
+{
+    std::free(Memory);
+}
+
+void
+operator delete[](
+    void *Memory
+) noexcept
+{
+    std::free(Memory);
+}
+
+void
+operator delete(
+    void *Memory,
+    std::size_t
+) noexcept
+{
+    std::free(Memory);
+}
+
+void
+operator delete[](
+    void *Memory,
+    std::size_t
+) noexcept
+{
+    std::free(Memory);
+}
+
+void
+operator delete(
+    void *Memory,
+    std::align_val_t
+) noexcept
+{
+    _aligned_free(Memory);
+}
+
+void
+operator delete[](
+    void *Memory,
+    std::align_val_t
+) noexcept
+{
+    _aligned_free(Memory);
+}
+
+void
+operator delete(
+    void *Memory,
+    std::size_t,
+    std::align_val_t
+) noexcept
+{
+    _aligned_free(Memory);
+}
+
+void
+operator delete[](
+    void *Memory,
+    std::size_t,
+    std::align_val_t
+) noexcept
+{
+    _aligned_free(Memory);
+}
+
+#endif
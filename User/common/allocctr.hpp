@@ -0,0 +1,35 @@
+﻿/*!
+ *  @file       allocctr.hpp
+ *  @brief      Global allocation counter.
+ *  @details    When NTECTIVE_ALLOCATION_COUNTER_ACTIVE is true, the global
+ *              operator new and operator delete are replaced by versions that
+ *              count every allocation, process-wide and per thread. Used to
+ *              verify that hot paths, such as steady-state logging, do not
+ *              allocate.
+ */
+
+#pragma once
+
+#include <cstdint>
+
+#ifndef NTECTIVE_ALLOCATION_COUNTER_ACTIVE
+    #define NTECTIVE_ALLOCATION_COUNTER_ACTIVE false
+#endif
+
+namespace Common::Util {
+
+/*!
+ * @brief Returns the number of operator new calls made by the process.
+ * Always 0 if the allocation counter is not active.
+ */
+std::uint64_t
+GetAllocationCount();
+
+/*!
+ * @brief Returns the number of operator new calls made by the calling thread.
+ * Always 0 if the allocation counter is not active.
+ */
+std::uint64_t
+GetThreadAllocationCount();
+
+}
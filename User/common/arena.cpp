@@ -0,0 +1,155 @@
+﻿/*!
+ *  @file       arena.cpp
+ *  @brief      Per-thread bump arenas.
+ */
+
+#include "arena.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+
+namespace Common::Util {
+
+class ARENA_CHUNK {
+public:
+    /*!
+     * @brief Outstanding allocations, plus one while the chunk is the current
+     * chunk of its owning thread.
+     */
+    std::atomic<std::uint32_t> References = 0;
+    std::size_t Used = 0;
+    ARENA_CHUNK *NextFree = nullptr;
+    alignas(16) std::byte Data[THREAD_ARENA::ChunkSize];
+};
+
+namespace {
+
+constexpr std::size_t AllocationAlignment = 16;
+
+/*!
+ * @brief Pool of chunks that are no longer referenced.
+ */
+class CHUNK_POOL {
+public:
+    ARENA_CHUNK *
+    Acquire()
+    {
+        ARENA_CHUNK *chunk = nullptr;
+        {
+            std::lock_guard lock{Lock_};
+            if (Free_) {
+                chunk = Free_;
+                Free_ = chunk->NextFree;
+                --FreeCount_;
+            }
+        }
+
+        if (!chunk) {
+            chunk = new ARENA_CHUNK;
+        }
+
+        chunk->References.store(1, std::memory_order_relaxed);
+        chunk->Used = 0;
+        chunk->NextFree = nullptr;
+        return chunk;
+    }
+
+    void
+    Recycle(
+        ARENA_CHUNK *Chunk
+    )
+    {
+        {
+            std::lock_guard lock{Lock_};
+            if (FreeCount_ < MaxFreeChunks) {
+                Chunk->NextFree = Free_;
+                Free_ = Chunk;
+                ++FreeCount_;
+                return;
+            }
+        }
+
+        delete Chunk;
+    }
+
+private:
+    static constexpr std::size_t MaxFreeChunks = 64;
+
+    std::mutex Lock_;
+    ARENA_CHUNK *Free_ = nullptr;
+    std::size_t FreeCount_ = 0;
+};
+
+CHUNK_POOL &
+GetChunkPool()
+{
+    /* Never destroyed, allocations may be released during static destruction. */
+    static auto chunkPool = new CHUNK_POOL;
+    return *chunkPool;
+}
+
+/*!
+ * @brief Current chunk of a thread. Drops the thread's reference on thread exit.
+ */
+class THREAD_STATE {
+public:
+    ~THREAD_STATE()
+    {
+        if (Current) {
+            THREAD_ARENA::Release(Current);
+        }
+    }
+
+    ARENA_CHUNK *Current = nullptr;
+};
+
+thread_local THREAD_STATE ThreadState;
+
+}
+
+ARENA_ALLOCATION
+THREAD_ARENA::Allocate(
+    std::size_t Size
+)
+{
+    Size = (Size + AllocationAlignment - 1) & ~(AllocationAlignment - 1);
+    if (Size > MaxAllocationSize) {
+        return {};
+    }
+
+    auto &state = ThreadState;
+    auto chunk = state.Current;
+
+    if (chunk && chunk->Used + Size > ChunkSize) {
+        /* Everything allocated from the chunk has been released, start over. */
+        if (chunk->References.load(std::memory_order_acquire) == 1) {
+            chunk->Used = 0;
+        } else {
+            Release(chunk);
+            chunk = nullptr;
+        }
+    }
+
+    if (!chunk) {
+        chunk = state.Current = GetChunkPool().Acquire();
+    }
+
+    void *data = chunk->Data + chunk->Used;
+    chunk->Used += Size;
+    chunk->References.fetch_add(1, std::memory_order_relaxed);
+
+    return {data, chunk};
+}
+
+void
+THREAD_ARENA::Release(
+    ARENA_CHUNK *Chunk
+)
+{
+    if (Chunk->References.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        GetChunkPool().Recycle(Chunk);
+    }
+}
+
+}
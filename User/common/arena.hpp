@@ -0,0 +1,66 @@
+﻿/*!
+ *  @file       arena.hpp
+ *  @brief      Per-thread bump arenas.
+ *  @details    Each thread bump-allocates from its own chunk. Allocations may
+ *              be released from any thread; a chunk is recycled into a shared
+ *              pool once its owning thread has moved on and every allocation
+ *              made from it has been released. In steady state allocations are
+ *              served from recycled chunks and never reach the global allocator.
+ */
+
+#pragma once
+
+#include <cstddef>
+
+namespace Common::Util {
+
+class ARENA_CHUNK;
+
+/*!
+ * @brief A block of memory allocated from a thread arena.
+ */
+class ARENA_ALLOCATION {
+public:
+    void *Data = nullptr;
+    ARENA_CHUNK *Chunk = nullptr;
+};
+
+/*!
+ * @brief Bump allocator with a current chunk per thread.
+ */
+class THREAD_ARENA {
+public:
+    /*!
+     * @brief Size of the usable memory of a single chunk.
+     */
+    static constexpr std::size_t ChunkSize = 64 * 1024;
+
+    /*!
+     * @brief Largest allocation served by the arena. Larger requests fail
+     * so that a single allocation cannot pin a whole chunk.
+     */
+    static constexpr std::size_t MaxAllocationSize = ChunkSize / 8;
+
+    /*!
+     * @brief Allocates memory from the arena of the calling thread.
+     * @param Size The number of bytes to allocate.
+     * @return The allocation, or an empty allocation if Size exceeds MaxAllocationSize.
+     */
+    static
+    ARENA_ALLOCATION
+    Allocate(
+        std::size_t Size
+    );
+
+    /*!
+     * @brief Releases an allocation. May be called from any thread.
+     * @param Chunk The chunk the allocation was made from.
+     */
+    static
+    void
+    Release(
+        ARENA_CHUNK *Chunk
+    );
+};
+
+}
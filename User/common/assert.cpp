@@ -5,6 +5,7 @@
 
 #include "assert.hpp"
 #include "log.hpp"
+#include "lograte.hpp"
 #include "logsessn.hpp"
 
 using namespace Common::Log;
@@ -37,7 +38,13 @@ ASSERTION::~ASSERTION()
                : LOG_LEVEL::Error);
 
     if (AssertionEffect_ == ASSERTION_EFFECT::Termination) {
-        Log::GetDefaultSession()->Flush();
+        /*
+         * Writes the pending "repeated N times" summaries, then drains queued
+         * entries of asynchronous sessions on this thread.
+         */
+        const auto session = Log::GetDefaultSession();
+        GetLogRateLimiter().Sweep(*session);
+        session->Flush();
         std::terminate();
     }
 }
@@ -28,7 +28,7 @@ BUF_EXCEPTION::BUF_EXCEPTION(
 }
 
 const char *
-BUF_EXCEPTION::what() const
+BUF_EXCEPTION::what() const noexcept
 {
     using namespace std::string_literals;
 
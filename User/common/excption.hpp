@@ -29,7 +29,7 @@ public:
     );
 
     const char *
-    what() const override;
+    what() const noexcept override;
 
 private:
     std::string Message_;
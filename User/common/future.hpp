@@ -0,0 +1,903 @@
+﻿/*!
+ *  @file       future.hpp
+ *  @brief      Lightweight future and promise with continuations.
+ *  @details    A PROMISE and its FUTURE share one state holding the result
+ *              inline, a reference count and the continuation. The state is
+ *              bump-allocated from the thread arena and stores the
+ *              continuation inline, so the pair costs no global allocation
+ *              when the continuation fits.
+ *              Instead of blocking in Get, a continuation attached with Then
+ *              runs when the result arrives, on the completing thread or
+ *              posted to a job queue or thread pool, and returns the future
+ *              of its own result, which chains stages into a pipeline.
+ *              Exceptions are stored as std::exception_ptr and skip the
+ *              continuations taking a value, so a BUF_EXCEPTION thrown in any
+ *              stage reaches the end of the pipeline with its type.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <new>
+#include <optional>
+#include <stop_token>
+#include <type_traits>
+#include <utility>
+#include <variant>
+#include <vector>
+
+#include "arena.hpp"
+#include "excption.hpp"
+#include "jobqueue.hpp"
+
+namespace Common::Util {
+
+/*!
+ * @brief Thrown by the future of a promise destroyed without a result.
+ */
+class BROKEN_PROMISE_EXCEPTION : public BUF_EXCEPTION {
+public:
+    using BUF_EXCEPTION::BUF_EXCEPTION;
+};
+
+/*!
+ * @brief Thrown when a result is set for a promise that already has one.
+ */
+class PROMISE_ALREADY_SATISFIED_EXCEPTION : public BUF_EXCEPTION {
+public:
+    using BUF_EXCEPTION::BUF_EXCEPTION;
+};
+
+/*!
+ * @brief A queue or pool that runs posted jobs, such as JOB_QUEUE,
+ * MPSC_JOB_QUEUE and THREAD_POOL.
+ */
+template<class E>
+concept JOB_EXECUTOR = requires(E &Executor, std::move_only_function<void()> Job) {
+    Executor.Post(std::move(Job));
+};
+
+template<class T>
+class FUTURE;
+
+template<class T>
+class PROMISE;
+
+template<class T>
+class JOB_PROMISE;
+
+/*!
+ * @brief Returns the cancellation token of the JOB_OPTIONS among the
+ * arguments passed to Post, or an empty token if there are none.
+ */
+template<class... A>
+std::stop_token
+GetJobCancellation(
+    const A &...PostArguments
+)
+{
+    std::stop_token cancellation;
+    ([&] {
+        if constexpr (std::same_as<A, JOB_OPTIONS>) {
+            cancellation = PostArguments.Cancellation;
+        }
+    }(), ...);
+
+    return cancellation;
+}
+
+/*!
+ * @brief State shared by a PROMISE and its FUTURE.
+ */
+template<class T>
+class FUTURE_STATE {
+public:
+    using VALUE = std::conditional_t<std::is_void_v<T>, std::monostate, T>;
+
+    /*!
+     * @brief Size of the continuation storage. Larger continuations are
+     * boxed on the heap.
+     */
+    static constexpr std::size_t InlineContinuationSize = 12 * sizeof(void *);
+
+    /*!
+     * @brief Creates a state referenced once.
+     */
+    static
+    FUTURE_STATE *
+    Create()
+    {
+        if constexpr (sizeof(FUTURE_STATE) <= THREAD_ARENA::MaxAllocationSize &&
+                      alignof(FUTURE_STATE) <= alignof(std::max_align_t)) {
+            const auto allocation = THREAD_ARENA::Allocate(sizeof(FUTURE_STATE));
+            return new (allocation.Data) FUTURE_STATE{allocation.Chunk};
+        } else {
+            return new (::operator new(sizeof(FUTURE_STATE))) FUTURE_STATE{nullptr};
+        }
+    }
+
+    void
+    AddReference()
+    {
+        References_.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void
+    Release()
+    {
+        if (References_.fetch_sub(1, std::memory_order_acq_rel) != 1) {
+            return;
+        }
+
+        const auto chunk = Chunk_;
+        this->~FUTURE_STATE();
+
+        if (chunk) {
+            THREAD_ARENA::Release(chunk);
+        } else {
+            ::operator delete(this);
+        }
+    }
+
+    template<class... A>
+    void
+    SetValue(
+        A &&...Arguments
+    )
+    {
+        Value_.emplace(std::forward<A>(Arguments)...);
+        Complete();
+    }
+
+    void
+    SetException(
+        std::exception_ptr Exception
+    )
+    {
+        Exception_ = std::move(Exception);
+        Complete();
+    }
+
+    /*!
+     * @brief Sets the result of Function, or the exception it throws. The
+     * continuation runs outside the handler, so an exception it throws
+     * leaves the call instead of completing the state a second time.
+     */
+    template<std::invocable F>
+    void
+    SetResultOf(
+        F &&Function
+    )
+    {
+        try {
+            if constexpr (std::is_void_v<T>) {
+                std::invoke(std::forward<F>(Function));
+                Value_.emplace();
+            } else {
+                Value_.emplace(std::invoke(std::forward<F>(Function)));
+            }
+        } catch (...) {
+            Exception_ = std::current_exception();
+        }
+
+        Complete();
+    }
+
+    bool
+    IsReady() const
+    {
+        return Status_.load(std::memory_order_acquire) == Ready;
+    }
+
+    void
+    Wait() const
+    {
+        for (auto status = Status_.load(std::memory_order_acquire);
+             status != Ready;
+             status = Status_.load(std::memory_order_acquire)) {
+            Status_.wait(status, std::memory_order_acquire);
+        }
+    }
+
+    /*!
+     * @brief Moves the value out of a ready state or rethrows its exception.
+     */
+    VALUE
+    TakeValue()
+    {
+        if (Exception_) {
+            std::rethrow_exception(Exception_);
+        }
+
+        return std::move(*Value_);
+    }
+
+    /*!
+     * @brief Sets the function run once the state is ready, at most once.
+     * Runs it right away if the state already is.
+     */
+    template<std::invocable F>
+    void
+    SetContinuation(
+        F &&Continuation
+    )
+    {
+        using CONTINUATION = std::decay_t<F>;
+
+        if constexpr (sizeof(CONTINUATION) <= InlineContinuationSize &&
+                      alignof(CONTINUATION) <= alignof(std::max_align_t)) {
+            new (Continuation_) CONTINUATION(std::forward<F>(Continuation));
+            RunContinuation_ = &RunContinuation<CONTINUATION>;
+        } else {
+            using BOXED = std::unique_ptr<CONTINUATION>;
+            new (Continuation_) BOXED(std::make_unique<CONTINUATION>(std::forward<F>(Continuation)));
+            RunContinuation_ = [](void *Storage) {
+                auto continuation = std::move(*std::launder(static_cast<BOXED *>(Storage)));
+                std::launder(static_cast<BOXED *>(Storage))->~BOXED();
+                (*continuation)();
+            };
+        }
+
+        auto status = Pending;
+        if (Status_.compare_exchange_strong(status, Continued, std::memory_order_acq_rel)) {
+            return;
+        }
+
+        RunContinuation_(Continuation_);
+    }
+
+private:
+    static constexpr std::uint32_t Pending = 0;
+    static constexpr std::uint32_t Continued = 1;
+    static constexpr std::uint32_t Ready = 2;
+
+    explicit
+    FUTURE_STATE(
+        ARENA_CHUNK *Chunk
+    ) : Chunk_(Chunk)
+    {
+    }
+
+    void
+    Complete()
+    {
+        const auto status = Status_.exchange(Ready, std::memory_order_acq_rel);
+        if (status == Pending) {
+            Status_.notify_all();
+            return;
+        }
+
+        /* The continuation already ran and was destroyed. */
+        if (status == Ready) {
+            throw PROMISE_ALREADY_SATISFIED_EXCEPTION{"Future completed twice"};
+        }
+
+        RunContinuation_(Continuation_);
+    }
+
+    /*!
+     * @brief Moves the continuation out of the state before running it, the
+     * continuation may release the last reference to the state.
+     */
+    template<class CONTINUATION>
+    static
+    void
+    RunContinuation(
+        void *Storage
+    )
+    {
+        const auto stored = std::launder(static_cast<CONTINUATION *>(Storage));
+        auto continuation = std::move(*stored);
+        stored->~CONTINUATION();
+        continuation();
+    }
+
+    std::atomic<std::uint32_t> References_ = 1;
+    std::atomic<std::uint32_t> Status_ = Pending;
+
+    /*!
+     * @brief The thread arena chunk of the state, null if it came from the
+     * global allocator.
+     */
+    ARENA_CHUNK *const Chunk_;
+    void (*RunContinuation_)(void *Storage) = nullptr;
+    alignas(std::max_align_t) std::byte Continuation_[InlineContinuationSize];
+    std::optional<VALUE> Value_;
+    std::exception_ptr Exception_;
+};
+
+/*!
+ * @brief Receiving end of a result that is computed asynchronously.
+ * @tparam T Type of the result, may be void.
+ */
+template<class T>
+class FUTURE {
+public:
+    FUTURE() = default;
+
+    FUTURE(
+        FUTURE &&Other
+    ) noexcept : State_(std::exchange(Other.State_, nullptr))
+    {
+    }
+
+    FUTURE &
+    operator=(
+        FUTURE &&Other
+    ) noexcept
+    {
+        if (this != &Other) {
+            Reset();
+            State_ = std::exchange(Other.State_, nullptr);
+        }
+
+        return *this;
+    }
+
+    ~FUTURE()
+    {
+        Reset();
+    }
+
+    /*!
+     * @brief Whether the future refers to a result. Get, Then and Subscribe
+     * consume the future.
+     */
+    bool
+    IsValid() const
+    {
+        return State_ != nullptr;
+    }
+
+    bool
+    IsReady() const
+    {
+        return State_->IsReady();
+    }
+
+    /*!
+     * @brief Blocks until the result is available.
+     */
+    void
+    Wait() const
+    {
+        State_->Wait();
+    }
+
+    /*!
+     * @brief Blocks until the result is available and returns it.
+     * @return The result, or throws the exception the producer stored.
+     */
+    T
+    Get()
+    {
+        State_->Wait();
+        const auto state = std::exchange(State_, nullptr);
+
+        class RELEASE {
+        public:
+            ~RELEASE()
+            {
+                State->Release();
+            }
+
+            FUTURE_STATE<T> *State;
+        };
+
+        RELEASE release{state};
+        if constexpr (std::is_void_v<T>) {
+            state->TakeValue();
+        } else {
+            return state->TakeValue();
+        }
+    }
+
+    /*!
+     * @brief Calls Function with this future once it is ready, on the thread
+     * that completes it, or right away if it already is.
+     * @param Function Invocable with a ready FUTURE<T>.
+     */
+    template<std::invocable<FUTURE> F>
+    void
+    Subscribe(
+        F &&Function
+    )
+    {
+        const auto state = State_;
+        state->SetContinuation([ready = std::move(*this), function = std::forward<F>(Function)]() mutable {
+            std::invoke(function, std::move(ready));
+        });
+    }
+
+    /*!
+     * @brief Runs Function with the result once it is ready, on the thread
+     * that completes the future.
+     * @param Function Invocable with the value, with nothing for FUTURE<void>,
+     * or else with the ready FUTURE itself to see exceptions. Functions taking
+     * the value are skipped when the future holds an exception, which passes
+     * to the returned future.
+     * @return The future of the result of Function.
+     */
+    template<class F>
+    auto
+    Then(
+        F &&Function
+    )
+    {
+        return ThenInternal(std::forward<F>(Function), [](auto Job) {
+            Job();
+        }, {});
+    }
+
+    /*!
+     * @brief Runs Function with the result once it is ready, as a job posted
+     * to Executor.
+     * @param Executor Receives the job, must outlive the future.
+     * @param Function See the overload without an executor.
+     * @param PostArguments Passed to Post after the job, such as JOB_OPTIONS.
+     * If the job is cancelled through JOB_OPTIONS before it starts, the
+     * returned future throws JOB_CANCELLED_EXCEPTION.
+     * @return The future of the result of Function.
+     */
+    template<JOB_EXECUTOR E, class F, class... A>
+    auto
+    Then(
+        E &Executor,
+        F &&Function,
+        A... PostArguments
+    )
+    {
+        auto cancellation = GetJobCancellation(PostArguments...);
+        return ThenInternal(std::forward<F>(Function), [&Executor, ...postArguments = std::move(PostArguments)](auto Job) mutable {
+            Executor.Post(std::move(Job), std::move(postArguments)...);
+        }, std::move(cancellation));
+    }
+
+private:
+    friend PROMISE<T>;
+
+    explicit
+    FUTURE(
+        FUTURE_STATE<T> *State
+    ) : State_(State)
+    {
+    }
+
+    void
+    Reset()
+    {
+        if (State_) {
+            std::exchange(State_, nullptr)->Release();
+        }
+    }
+
+    template<class F, class SCHEDULE>
+    auto
+    ThenInternal(
+        F &&Function,
+        SCHEDULE Schedule,
+        std::stop_token Cancellation
+    )
+    {
+        using FUNCTION = std::decay_t<F>;
+
+        /* The value is preferred, a generic lambda receives the value. Checked
+           with if constexpr so a generic lambda is not instantiated with the
+           future, which would be a hard error in its body. */
+        static constexpr bool TakesValue = [] {
+            if constexpr (std::is_void_v<T>) {
+                return std::invocable<FUNCTION &>;
+            } else {
+                return std::invocable<FUNCTION &, T>;
+            }
+        }();
+        static constexpr bool TakesFuture = [] {
+            if constexpr (TakesValue) {
+                return false;
+            } else {
+                return std::invocable<FUNCTION &, FUTURE>;
+            }
+        }();
+        static_assert(TakesValue || TakesFuture, "The continuation must take the value or the future");
+
+        using RESULT = typename std::conditional_t<TakesFuture,
+                                                   std::invoke_result<FUNCTION &, FUTURE>,
+                                                   std::conditional_t<std::is_void_v<T>,
+                                                                      std::invoke_result<FUNCTION &>,
+                                                                      std::invoke_result<FUNCTION &, T>>>::type;
+
+        PROMISE<RESULT> promise;
+        auto future = promise.GetFuture();
+
+        Subscribe([promise = JOB_PROMISE<RESULT>{std::move(promise), std::move(Cancellation)},
+                   function = std::forward<F>(Function),
+                   schedule = std::move(Schedule)](FUTURE Ready) mutable {
+            schedule([promise = std::move(promise),
+                      function = std::move(function),
+                      ready = std::move(Ready)]() mutable {
+                if constexpr (TakesFuture) {
+                    promise.SetResultOf([&] {
+                        return std::invoke(function, std::move(ready));
+                    });
+                } else if constexpr (std::is_void_v<T>) {
+                    promise.SetResultOf([&] {
+                        ready.Get();
+                        return std::invoke(function);
+                    });
+                } else {
+                    promise.SetResultOf([&] {
+                        return std::invoke(function, ready.Get());
+                    });
+                }
+            });
+        });
+
+        return future;
+    }
+
+    FUTURE_STATE<T> *State_ = nullptr;
+};
+
+/*!
+ * @brief Producing end of a FUTURE.
+ * @tparam T Type of the result, may be void.
+ */
+template<class T>
+class PROMISE {
+public:
+    PROMISE() : State_(FUTURE_STATE<T>::Create())
+    {
+    }
+
+    PROMISE(
+        PROMISE &&Other
+    ) noexcept : State_(std::exchange(Other.State_, nullptr)),
+                 Satisfied_(Other.Satisfied_)
+    {
+    }
+
+    PROMISE &
+    operator=(
+        PROMISE &&Other
+    ) noexcept
+    {
+        if (this != &Other) {
+            Reset();
+            State_ = std::exchange(Other.State_, nullptr);
+            Satisfied_ = Other.Satisfied_;
+        }
+
+        return *this;
+    }
+
+    /*!
+     * @brief Breaks the promise if no result was set.
+     */
+    ~PROMISE()
+    {
+        Reset();
+    }
+
+    /*!
+     * @brief Returns the future of the promise. Call once.
+     */
+    FUTURE<T>
+    GetFuture()
+    {
+        State_->AddReference();
+        return FUTURE<T>{State_};
+    }
+
+    /*!
+     * @brief Whether the promise still owes its future a result.
+     */
+    bool
+    IsPending() const
+    {
+        return State_ && !Satisfied_;
+    }
+
+    template<class... A>
+    void
+    SetValue(
+        A &&...Arguments
+    )
+    {
+        Satisfy();
+        State_->SetValue(std::forward<A>(Arguments)...);
+    }
+
+    void
+    SetException(
+        std::exception_ptr Exception
+    )
+    {
+        Satisfy();
+        State_->SetException(std::move(Exception));
+    }
+
+    /*!
+     * @brief Sets the result of Function, or the exception it throws. An
+     * exception thrown by a continuation that runs inline propagates.
+     */
+    template<std::invocable F>
+    void
+    SetResultOf(
+        F &&Function
+    )
+    {
+        Satisfy();
+        State_->SetResultOf(std::forward<F>(Function));
+    }
+
+private:
+    /*!
+     * @brief Marks the promise satisfied, throws if it already was.
+     */
+    void
+    Satisfy()
+    {
+        if (Satisfied_) {
+            throw PROMISE_ALREADY_SATISFIED_EXCEPTION{"Promise already has a result"};
+        }
+
+        Satisfied_ = true;
+    }
+
+    void
+    Reset()
+    {
+        if (!State_) {
+            return;
+        }
+
+        if (!Satisfied_) {
+            State_->SetException(std::make_exception_ptr(BROKEN_PROMISE_EXCEPTION{"Promise destroyed without a result"}));
+        }
+
+        std::exchange(State_, nullptr)->Release();
+    }
+
+    FUTURE_STATE<T> *State_;
+    bool Satisfied_ = false;
+};
+
+/*!
+ * @brief Promise held by a posted job. An executor such as JOB_QUEUE
+ * destroys a job cancelled before it starts without running it, the
+ * promise then throws JOB_CANCELLED_EXCEPTION from its future instead of
+ * BROKEN_PROMISE_EXCEPTION.
+ */
+template<class T>
+class JOB_PROMISE {
+public:
+    /*!
+     * @param Cancellation The token of the job, empty if it cannot be cancelled.
+     */
+    JOB_PROMISE(
+        PROMISE<T> Promise,
+        std::stop_token Cancellation
+    ) : Promise_(std::move(Promise)),
+        Cancellation_(std::move(Cancellation))
+    {
+    }
+
+    JOB_PROMISE(JOB_PROMISE &&) noexcept = default;
+
+    ~JOB_PROMISE()
+    {
+        if (Promise_.IsPending() && Cancellation_.stop_requested()) {
+            Promise_.SetException(std::make_exception_ptr(JOB_CANCELLED_EXCEPTION{"Job cancelled before it started"}));
+        }
+    }
+
+    template<std::invocable F>
+    void
+    SetResultOf(
+        F &&Function
+    )
+    {
+        Promise_.SetResultOf(std::forward<F>(Function));
+    }
+
+private:
+    PROMISE<T> Promise_;
+    std::stop_token Cancellation_;
+};
+
+/*!
+ * @brief Runs Function as a job posted to Executor.
+ * @param PostArguments Passed to Post after the job, such as JOB_OPTIONS.
+ * If the job is cancelled through JOB_OPTIONS before it starts, the
+ * returned future throws JOB_CANCELLED_EXCEPTION.
+ * @return The future of the result of Function.
+ */
+template<JOB_EXECUTOR E, std::invocable F, class... A>
+auto
+Async(
+    E &Executor,
+    F &&Function,
+    A &&...PostArguments
+)
+{
+    using RESULT = std::invoke_result_t<std::decay_t<F> &>;
+
+    PROMISE<RESULT> promise;
+    auto future = promise.GetFuture();
+
+    /* Read before the arguments are forwarded, which may move from them. */
+    JOB_PROMISE<RESULT> jobPromise{std::move(promise), GetJobCancellation(PostArguments...)};
+
+    Executor.Post([promise = std::move(jobPromise), function = std::forward<F>(Function)]() mutable {
+        promise.SetResultOf(function);
+    }, std::forward<A>(PostArguments)...);
+
+    return future;
+}
+
+/*!
+ * @brief Returns a future that is ready with Value.
+ */
+template<class T>
+FUTURE<std::decay_t<T>>
+MakeReadyFuture(
+    T &&Value
+)
+{
+    PROMISE<std::decay_t<T>> promise;
+    auto future = promise.GetFuture();
+    promise.SetValue(std::forward<T>(Value));
+    return future;
+}
+
+inline
+FUTURE<void>
+MakeReadyFuture()
+{
+    PROMISE<void> promise;
+    auto future = promise.GetFuture();
+    promise.SetValue();
+    return future;
+}
+
+/*!
+ * @brief Result of WhenAll: the values in the order of the futures, nothing
+ * for futures of void.
+ */
+template<class T>
+using WHEN_ALL_RESULT = std::conditional_t<std::is_void_v<T>, void, std::vector<T>>;
+
+/*!
+ * @brief Result of WhenAny: the index of the first ready future and its
+ * value, only the index for futures of void.
+ */
+template<class T>
+using WHEN_ANY_RESULT = std::conditional_t<std::is_void_v<T>, std::size_t, std::pair<std::size_t, T>>;
+
+/*!
+ * @brief Waits for all futures without blocking.
+ * @return A future that is ready with every value once all futures are, or
+ * with the first exception as soon as one of them holds one.
+ */
+template<class T>
+FUTURE<WHEN_ALL_RESULT<T>>
+WhenAll(
+    std::vector<FUTURE<T>> Futures
+)
+{
+    using VALUE = typename FUTURE_STATE<T>::VALUE;
+
+    class GATHER {
+    public:
+        explicit
+        GATHER(
+            std::size_t Count
+        ) : Remaining(Count),
+            Values(Count)
+        {
+        }
+
+        std::atomic<std::size_t> Remaining;
+        std::atomic<bool> Settled = false;
+        std::vector<std::optional<VALUE>> Values;
+        PROMISE<WHEN_ALL_RESULT<T>> Promise;
+    };
+
+    const auto gather = std::make_shared<GATHER>(Futures.size());
+    auto future = gather->Promise.GetFuture();
+
+    if (Futures.empty()) {
+        gather->Promise.SetValue();
+        return future;
+    }
+
+    for (std::size_t i = 0; i < Futures.size(); ++i) {
+        Futures[i].Subscribe([gather, i](FUTURE<T> Ready) {
+            try {
+                if constexpr (std::is_void_v<T>) {
+                    Ready.Get();
+                } else {
+                    gather->Values[i].emplace(Ready.Get());
+                }
+            } catch (...) {
+                if (!gather->Settled.exchange(true, std::memory_order_acq_rel)) {
+                    gather->Promise.SetException(std::current_exception());
+                }
+                return;
+            }
+
+            if (gather->Remaining.fetch_sub(1, std::memory_order_acq_rel) != 1 ||
+                gather->Settled.exchange(true, std::memory_order_acq_rel)) {
+                return;
+            }
+
+            if constexpr (std::is_void_v<T>) {
+                gather->Promise.SetValue();
+            } else {
+                gather->Promise.SetResultOf([&] {
+                    std::vector<T> values;
+                    values.reserve(gather->Values.size());
+                    for (auto &value : gather->Values) {
+                        values.push_back(std::move(*value));
+                    }
+                    return values;
+                });
+            }
+        });
+    }
+
+    return future;
+}
+
+/*!
+ * @brief Waits for the first of the futures without blocking.
+ * @return A future that is ready with the index and the value, or the
+ * exception, of the first future that is ready.
+ */
+template<class T>
+FUTURE<WHEN_ANY_RESULT<T>>
+WhenAny(
+    std::vector<FUTURE<T>> Futures
+)
+{
+    class FIRST {
+    public:
+        std::atomic<bool> Settled = false;
+        PROMISE<WHEN_ANY_RESULT<T>> Promise;
+    };
+
+    const auto first = std::make_shared<FIRST>();
+    auto future = first->Promise.GetFuture();
+
+    if (Futures.empty()) {
+        first->Promise.SetException(std::make_exception_ptr(BUF_EXCEPTION{"WhenAny of no futures"}));
+        return future;
+    }
+
+    for (std::size_t i = 0; i < Futures.size(); ++i) {
+        Futures[i].Subscribe([first, i](FUTURE<T> Ready) {
+            if (first->Settled.exchange(true, std::memory_order_acq_rel)) {
+                return;
+            }
+
+            first->Promise.SetResultOf([&]() -> WHEN_ANY_RESULT<T> {
+                if constexpr (std::is_void_v<T>) {
+                    Ready.Get();
+                    return i;
+                } else {
+                    return {i, Ready.Get()};
+                }
+            });
+        });
+    }
+
+    return future;
+}
+
+}
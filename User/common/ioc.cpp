@@ -1,12 +1,279 @@
-/*!
+﻿/*!
  *  @file       ioc.cpp
  *  @brief      IoC container.
  */
 
 #include "ioc.hpp"
 
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <string>
+
 namespace Common::Ioc {
 
+namespace {
+
+/*!
+ * @brief Registration graph of both containers.
+ */
+class REGISTRATION_GRAPH {
+public:
+    REGISTRATION_GRAPH(
+        const std::vector<REGISTRATION> &IocRegistrations,
+        std::vector<const REGISTRATION *> SingletonRegistrations
+    ) : IocRegistrations_(IocRegistrations),
+        SingletonRegistrations_(std::move(SingletonRegistrations))
+    {
+    }
+
+    std::vector<std::string>
+    Validate()
+    {
+        for (const auto singleton : {false, true}) {
+            const auto count = singleton ? SingletonRegistrations_.size() : IocRegistrations_.size();
+            for (std::size_t slot = 0; slot < count; ++slot) {
+                const DEPENDENCY node = {.Singleton = singleton, .Slot = slot};
+                if (const auto registration = Find(node)) {
+                    CheckDependencies(node, *registration);
+                    Visit(node);
+                }
+            }
+        }
+
+        return std::move(Problems_);
+    }
+
+private:
+    enum class VISIT_STATE : std::uint8_t {
+        Unvisited,
+        InProgress,
+        Done
+    };
+
+    const REGISTRATION *
+    Find(
+        const DEPENDENCY &Node
+    ) const
+    {
+        if (Node.Singleton) {
+            return Node.Slot < SingletonRegistrations_.size() ? SingletonRegistrations_[Node.Slot] : nullptr;
+        }
+
+        return Node.Slot < IocRegistrations_.size() && IocRegistrations_[Node.Slot].TypeName
+                   ? &IocRegistrations_[Node.Slot]
+                   : nullptr;
+    }
+
+    static
+    std::string
+    Describe(
+        bool Singleton,
+        const char *TypeName
+    )
+    {
+        return std::format("{}\"{}\"", Singleton ? "singleton " : "", TypeName);
+    }
+
+    void
+    CheckDependencies(
+        const DEPENDENCY &Node,
+        const REGISTRATION &Registration
+    )
+    {
+        for (const auto &dependency : Registration.Dependencies) {
+            const auto target = Find(dependency);
+            if (!target) {
+                Problems_.push_back(std::format("{} depends on {}, which is not registered",
+                                                Describe(Node.Singleton, Registration.TypeName),
+                                                Describe(dependency.Singleton, dependency.TypeName)));
+            } else if (target->Scoped && !Registration.Scoped) {
+                Problems_.push_back(std::format("{} resolves scoped {} outside of a scope",
+                                                Describe(Node.Singleton, Registration.TypeName),
+                                                Describe(dependency.Singleton, dependency.TypeName)));
+            } else if (target->Parameterized && target->PayloadDefault != PAYLOAD_DEFAULT::Supported) {
+                Problems_.push_back(std::format("{} resolves parameterized {} with a default payload, "
+                                                "which its factory does not accept",
+                                                Describe(Node.Singleton, Registration.TypeName),
+                                                Describe(dependency.Singleton, dependency.TypeName)));
+            }
+        }
+    }
+
+    VISIT_STATE &
+    State(
+        const DEPENDENCY &Node
+    )
+    {
+        auto &states = Node.Singleton ? SingletonStates_ : IocStates_;
+        if (Node.Slot >= states.size()) {
+            states.resize(Node.Slot + 1, VISIT_STATE::Unvisited);
+        }
+
+        return states[Node.Slot];
+    }
+
+    /*!
+     * @brief Depth-first search reporting every back edge as a cycle.
+     */
+    void
+    Visit(
+        const DEPENDENCY &Node
+    )
+    {
+        const auto registration = Find(Node);
+        if (!registration || State(Node) != VISIT_STATE::Unvisited) {
+            return;
+        }
+
+        State(Node) = VISIT_STATE::InProgress;
+        Path_.push_back(Node);
+
+        for (const auto &dependency : registration->Dependencies) {
+            if (State(dependency) == VISIT_STATE::InProgress) {
+                ReportCycle(dependency);
+            } else {
+                Visit(dependency);
+            }
+        }
+
+        Path_.pop_back();
+        State(Node) = VISIT_STATE::Done;
+    }
+
+    void
+    ReportCycle(
+        const DEPENDENCY &Target
+    )
+    {
+        const auto begin = std::ranges::find_if(Path_, [&](const DEPENDENCY &Node) {
+            return Node.Singleton == Target.Singleton && Node.Slot == Target.Slot;
+        });
+
+        std::string cycle = "Dependency cycle: ";
+        for (auto iterator = begin; iterator != Path_.end(); ++iterator) {
+            cycle += Describe(iterator->Singleton, Find(*iterator)->TypeName) + " -> ";
+        }
+
+        Problems_.push_back(cycle + Describe(Target.Singleton, Find(Target)->TypeName));
+    }
+
+    const std::vector<REGISTRATION> &IocRegistrations_;
+    std::vector<const REGISTRATION *> SingletonRegistrations_;
+    std::vector<VISIT_STATE> IocStates_;
+    std::vector<VISIT_STATE> SingletonStates_;
+    std::vector<DEPENDENCY> Path_;
+    std::vector<std::string> Problems_;
+};
+
+/*!
+ * @brief Type names of the singletons the calling thread is constructing,
+ * outermost first.
+ */
+thread_local std::vector<const char *> ConstructionStack;
+
+/*!
+ * @brief Collects the singletons a registration depends on, directly or
+ * through factories of the IoC container.
+ */
+void
+CollectSingletonDependencies(
+    const IOC &Ioc,
+    const REGISTRATION &Registration,
+    std::vector<std::size_t> &SingletonSlots
+)
+{
+    std::vector<bool> visited;
+    std::vector<const REGISTRATION *> pending = {&Registration};
+
+    while (!pending.empty()) {
+        const auto registration = pending.back();
+        pending.pop_back();
+
+        for (const auto &dependency : registration->Dependencies) {
+            if (dependency.Singleton) {
+                if (std::ranges::find(SingletonSlots, dependency.Slot) == SingletonSlots.end()) {
+                    SingletonSlots.push_back(dependency.Slot);
+                }
+
+                continue;
+            }
+
+            if (dependency.Slot >= visited.size()) {
+                visited.resize(dependency.Slot + 1);
+            }
+
+            if (const auto next = Ioc.FindRegistration(dependency.Slot); next && !visited[dependency.Slot]) {
+                visited[dependency.Slot] = true;
+                pending.push_back(next);
+            }
+        }
+    }
+}
+
+}
+
+std::size_t
+AllocateTypeSlot()
+{
+    static std::atomic<std::size_t> nextSlot = 0;
+    return nextSlot.fetch_add(1, std::memory_order_relaxed);
+}
+
+void
+IOC::Freeze()
+{
+    ValidateRegistrations(*this, GetSingletons());
+
+    Frozen_ = true;
+    Factories_.shrink_to_fit();
+    ScopedFactories_.shrink_to_fit();
+}
+
+void
+IOC::CheckNotFrozen(
+    const char *TypeName
+) const
+{
+    if (Frozen_) {
+        NTECTIVE_CHECK_FAIL.Message(std::format(L"Factory for \"{}\" is registered after the IoC container was frozen",
+                                                Util::StringToWstring(TypeName)))
+                           .Throw();
+    }
+}
+
+void
+ValidateRegistrations(
+    const IOC &Ioc,
+    SINGLETONS &Singletons
+)
+{
+    std::lock_guard lock{Singletons.StateLock_};
+
+    std::vector<const REGISTRATION *> singletonRegistrations;
+    for (const auto slot : Singletons.RegisteredSlots_) {
+        if (slot >= singletonRegistrations.size()) {
+            singletonRegistrations.resize(slot + 1);
+        }
+
+        singletonRegistrations[slot] = &Singletons.FindEntry(slot)->Registration;
+    }
+
+    const auto problems = REGISTRATION_GRAPH{Ioc.Registrations_, std::move(singletonRegistrations)}.Validate();
+    if (problems.empty()) {
+        return;
+    }
+
+    std::string message = std::format("IoC validation found {} problem(s):", problems.size());
+    for (const auto &problem : problems) {
+        message += "\n  " + problem;
+    }
+
+    throw IOC_VALIDATION_EXCEPTION{std::move(message)};
+}
+
 IOC &
 GetIoc()
 {
@@ -14,6 +281,352 @@ GetIoc()
     return iocContainer;
 }
 
+SINGLETONS::~SINGLETONS()
+{
+    for (auto &chunk : Chunks_) {
+        delete chunk.load(std::memory_order_relaxed);
+    }
+}
+
+SINGLETONS::ENTRY *
+SINGLETONS::FindEntry(
+    std::size_t Slot
+) const
+{
+    if (Slot >= ChunkSize * MaxChunks) {
+        return nullptr;
+    }
+
+    const auto chunk = Chunks_[Slot / ChunkSize].load(std::memory_order_acquire);
+    return chunk ? &chunk->Entries[Slot % ChunkSize] : nullptr;
+}
+
+void
+SINGLETONS::StoreFactory(
+    std::size_t Slot,
+    std::shared_ptr<void> Factory,
+    THUNK Create,
+    REGISTRATION Registration,
+    SINGLETON_START Start
+)
+{
+    std::lock_guard lock{StateLock_};
+
+    const auto typeName = Registration.TypeName;
+    if (Frozen_) {
+        NTECTIVE_CHECK_FAIL.Message(std::format(L"Singleton \"{}\" is registered after the singletons were frozen",
+                                                Util::StringToWstring(typeName)))
+                           .Throw();
+    }
+
+    if (Slot >= ChunkSize * MaxChunks) {
+        NTECTIVE_CHECK_FAIL.Message(std::format(L"Type slot {} of singleton \"{}\" exceeds the singleton container",
+                                                Slot,
+                                                Util::StringToWstring(typeName)))
+                           .Throw();
+    }
+
+    auto &chunkPointer = Chunks_[Slot / ChunkSize];
+    auto chunk = chunkPointer.load(std::memory_order_relaxed);
+    if (!chunk) {
+        chunk = new CHUNK;
+        chunkPointer.store(chunk, std::memory_order_release);
+    }
+
+    /* Readers copy the published instance without a lock, it cannot be replaced. */
+    auto &entry = chunk->Entries[Slot % ChunkSize];
+    if (entry.Instance.load(std::memory_order_relaxed) || entry.Constructor != std::thread::id{}) {
+        NTECTIVE_CHECK_FAIL.Message(std::format(L"Singleton \"{}\" is already resolved and cannot be registered again",
+                                                Util::StringToWstring(typeName)))
+                           .Throw();
+    }
+
+    if (!entry.Create) {
+        RegisteredSlots_.push_back(Slot);
+    }
+
+    entry.Create = Create;
+    entry.Factory = std::move(Factory);
+    entry.Registration = std::move(Registration);
+    entry.Start = Start;
+}
+
+std::string
+SINGLETONS::DescribeWaitCycle(
+    const ENTRY &Entry
+) const
+{
+    const auto self = std::this_thread::get_id();
+
+    /* Follow the constructing thread of each entry to the entry it waits for. */
+    std::vector<const ENTRY *> chain = {&Entry};
+    while (chain.back()->Constructor != self) {
+        const auto waiting = Waiting_.find(chain.back()->Constructor);
+        if (waiting == Waiting_.end() || chain.size() > Waiting_.size()) {
+            return {};
+        }
+
+        chain.push_back(waiting->second);
+    }
+
+    std::string cycle = "Singleton resolution cycle: ";
+    for (auto iterator = std::ranges::find(ConstructionStack, chain.back()->Registration.TypeName);
+         iterator != ConstructionStack.end();
+         ++iterator) {
+        cycle += std::format("\"{}\" -> ", *iterator);
+    }
+
+    for (std::size_t i = 0; i < chain.size(); ++i) {
+        cycle += std::format("{}\"{}\"", i ? " -> " : "", chain[i]->Registration.TypeName);
+    }
+
+    return cycle;
+}
+
+const void *
+SINGLETONS::Initialize(
+    std::size_t Slot,
+    const char *TypeName,
+    bool *Constructed
+)
+{
+    if (Constructed) {
+        *Constructed = false;
+    }
+
+    std::unique_lock lock{StateLock_};
+
+    const auto entry = FindEntry(Slot);
+    if (!entry || !entry->Create) {
+        throw FACTORY_NOT_FOUND_EXCEPTION{
+            std::format("Could not find entry for type \"{}\" in singleton container",
+                        TypeName)
+        };
+    }
+
+    const auto self = std::this_thread::get_id();
+
+    /* Wait while another thread constructs it, unless that closes a cycle. */
+    for (;;) {
+        if (const auto instance = entry->Instance.load(std::memory_order_relaxed)) {
+            return instance;
+        }
+
+        if (entry->Constructor == std::thread::id{}) {
+            break;
+        }
+
+        if (auto cycle = DescribeWaitCycle(*entry); !cycle.empty()) {
+            throw SINGLETON_CYCLE_EXCEPTION{std::move(cycle)};
+        }
+
+        Waiting_[self] = entry;
+        StateChanged_.wait(lock);
+        Waiting_.erase(self);
+    }
+
+    entry->Constructor = self;
+    ConstructionStack.push_back(entry->Registration.TypeName);
+    lock.unlock();
+
+    std::shared_ptr<void> holder;
+    try {
+        holder = entry->Create(entry->Factory.get());
+    } catch (...) {
+        lock.lock();
+        ConstructionStack.pop_back();
+        entry->Constructor = {};
+        StateChanged_.notify_all();
+        throw;
+    }
+
+    lock.lock();
+    ConstructionStack.pop_back();
+    entry->Constructor = {};
+
+    entry->Holder = std::move(holder);
+    entry->Instance.store(entry->Holder.get(), std::memory_order_release);
+    StateChanged_.notify_all();
+
+    if (Constructed) {
+        *Constructed = true;
+    }
+
+    return entry->Holder.get();
+}
+
+void
+SINGLETONS::Freeze()
+{
+    ValidateRegistrations(GetIoc(), *this);
+
+    std::lock_guard lock{StateLock_};
+    Frozen_ = true;
+}
+
+std::vector<SINGLETON_TIMING>
+SINGLETONS::StartEager(
+    std::size_t WorkerCount
+)
+{
+    /* The eager singletons and every singleton they reach through the graph. */
+    std::vector<std::size_t> slots;
+    std::unordered_map<std::size_t, std::size_t> nodeOf;
+    std::vector<std::vector<std::size_t>> dependencies;
+    {
+        std::lock_guard lock{StateLock_};
+
+        for (const auto slot : RegisteredSlots_) {
+            if (FindEntry(slot)->Start == SINGLETON_START::Eager) {
+                nodeOf.emplace(slot, slots.size());
+                slots.push_back(slot);
+            }
+        }
+
+        for (std::size_t node = 0; node < slots.size(); ++node) {
+            std::vector<std::size_t> singletonSlots;
+            CollectSingletonDependencies(GetIoc(), FindEntry(slots[node])->Registration, singletonSlots);
+
+            dependencies.emplace_back();
+            for (const auto slot : singletonSlots) {
+                const auto entry = FindEntry(slot);
+                if (!entry || !entry->Create) {
+                    continue;
+                }
+
+                const auto [iterator, added] = nodeOf.emplace(slot, slots.size());
+                if (added) {
+                    slots.push_back(slot);
+                }
+
+                dependencies[node].push_back(iterator->second);
+            }
+        }
+    }
+
+    const auto nodeCount = slots.size();
+    std::vector<std::vector<std::size_t>> dependents(nodeCount);
+    std::vector<std::size_t> pending(nodeCount);
+    std::deque<std::size_t> ready;
+
+    for (std::size_t node = 0; node < nodeCount; ++node) {
+        pending[node] = dependencies[node].size();
+        for (const auto dependency : dependencies[node]) {
+            dependents[dependency].push_back(node);
+        }
+
+        if (!pending[node]) {
+            ready.push_back(node);
+        }
+    }
+
+    std::mutex scheduleLock;
+    std::condition_variable scheduleChanged;
+    std::vector<bool> done(nodeCount);
+    std::size_t running = 0;
+    std::exception_ptr failure;
+    std::vector<SINGLETON_TIMING> timings;
+
+    const auto skipDependents = [&](std::size_t Node) {
+        std::vector<std::size_t> skipped = {Node};
+        while (!skipped.empty()) {
+            const auto next = skipped.back();
+            skipped.pop_back();
+
+            for (const auto dependent : dependents[next]) {
+                if (!done[dependent]) {
+                    done[dependent] = true;
+                    skipped.push_back(dependent);
+                }
+            }
+        }
+    };
+
+    const auto work = [&] {
+        std::unique_lock lock{scheduleLock};
+
+        for (;;) {
+            scheduleChanged.wait(lock, [&] {
+                return !ready.empty() || !running;
+            });
+
+            if (ready.empty()) {
+                return;
+            }
+
+            const auto node = ready.front();
+            ready.pop_front();
+            ++running;
+            lock.unlock();
+
+            const auto entry = FindEntry(slots[node]);
+
+            /* A singleton resolved lazily by another thread meanwhile is not timed, the worker only waited for it. */
+            bool constructed = false;
+            std::exception_ptr error;
+            const auto begin = std::chrono::steady_clock::now();
+            try {
+                Initialize(slots[node], entry->Registration.TypeName, &constructed);
+            } catch (...) {
+                error = std::current_exception();
+            }
+
+            const auto duration = std::chrono::steady_clock::now() - begin;
+
+            lock.lock();
+            --running;
+            done[node] = true;
+
+            if (error) {
+                if (!failure) {
+                    failure = error;
+                }
+
+                skipDependents(node);
+            } else {
+                if (constructed) {
+                    timings.push_back({.TypeName = entry->Registration.TypeName, .Duration = duration});
+                }
+
+                for (const auto dependent : dependents[node]) {
+                    if (!--pending[dependent] && !done[dependent]) {
+                        ready.push_back(dependent);
+                    }
+                }
+            }
+
+            scheduleChanged.notify_all();
+        }
+    };
+
+    {
+        std::vector<std::jthread> workers;
+        for (std::size_t i = 1; i < std::min(std::max<std::size_t>(WorkerCount, 1), nodeCount); ++i) {
+            workers.emplace_back(work);
+        }
+
+        work();
+    }
+
+    if (failure) {
+        std::rethrow_exception(failure);
+    }
+
+    /* Nodes never ready depend on each other. */
+    std::string cycle;
+    for (std::size_t node = 0; node < nodeCount; ++node) {
+        if (!done[node]) {
+            cycle += std::format("{}\"{}\"", cycle.empty() ? "" : ", ", FindEntry(slots[node])->Registration.TypeName);
+        }
+    }
+
+    if (!cycle.empty()) {
+        throw SINGLETON_CYCLE_EXCEPTION{std::format("Eager singletons depend on each other: {}", cycle)};
+    }
+
+    return timings;
+}
+
 SINGLETONS &
 GetSingletons()
 {
@@ -1,4 +1,4 @@
-/*!
+﻿/*!
  *  @file       ioc.hpp
  *  @brief      IoC container.
  *  @details    The implementation of an IoC container that supports registration
@@ -9,11 +9,20 @@
 
 #pragma once
 
-#include <any>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
 #include <format>
 #include <functional>
 #include <memory>
-#include <typeindex>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
 
 #include "assert.hpp"
 #include "strutil.hpp"
@@ -25,6 +34,21 @@ public:
     using BUF_EXCEPTION::BUF_EXCEPTION;
 };
 
+class SINGLETON_CYCLE_EXCEPTION : public Util::BUF_EXCEPTION {
+public:
+    using BUF_EXCEPTION::BUF_EXCEPTION;
+};
+
+class SCOPE_CYCLE_EXCEPTION : public Util::BUF_EXCEPTION {
+public:
+    using BUF_EXCEPTION::BUF_EXCEPTION;
+};
+
+class IOC_VALIDATION_EXCEPTION : public Util::BUF_EXCEPTION {
+public:
+    using BUF_EXCEPTION::BUF_EXCEPTION;
+};
+
 /*!
  * @brief Concept to identify types with payload.
  */
@@ -47,37 +71,226 @@ using TYPE_FACTORY = std::function<std::shared_ptr<T>()>;
 template<class T>
 using TYPE_FACTORY_PARAMETERIZED = std::function<std::shared_ptr<T>(typename T::IOC_PAYLOAD IocParams)>;
 
+/*!
+ * @brief Allocates the next dense type slot. Use GetTypeSlot instead.
+ */
+std::size_t
+AllocateTypeSlot();
+
+/*!
+ * @brief Returns the dense slot of type T. Slots are process-wide, assigned
+ * on first use and index the factory tables of the containers.
+ */
+template<class T>
+std::size_t
+GetTypeSlot()
+{
+    static const std::size_t slot = AllocateTypeSlot();
+    return slot;
+}
+
+/*!
+ * @brief Marks a dependency on the singleton of type T in DEPENDENCIES.
+ */
+template<class T>
+class SINGLETON_OF {
+};
+
+/*!
+ * @brief Types a factory resolves, validated by Freeze. Plain types are
+ * resolved from the IoC container, SINGLETON_OF<T> from the singletons.
+ */
+template<class... T>
+class DEPENDENCIES {
+};
+
+/*!
+ * @brief Whether the factory of a parameterized type accepts the default
+ * constructed payload, which is what dependents and singleton delegates
+ * resolve it with.
+ */
+enum class PAYLOAD_DEFAULT {
+    Unsupported,
+    Supported
+};
+
+/*!
+ * @brief Dependency edge of the registration graph.
+ */
+class DEPENDENCY {
+public:
+    bool Singleton = false;
+    std::size_t Slot = 0;
+    const char *TypeName = nullptr;
+};
+
+/*!
+ * @brief What Freeze knows about a registered factory.
+ */
+class REGISTRATION {
+public:
+    const char *TypeName = nullptr;
+    bool Parameterized = false;
+    bool Scoped = false;
+    PAYLOAD_DEFAULT PayloadDefault = PAYLOAD_DEFAULT::Supported;
+    std::vector<DEPENDENCY> Dependencies;
+};
+
+template<class T>
+class DEPENDENCY_TRAITS {
+public:
+    using TYPE = T;
+    static constexpr bool Singleton = false;
+};
+
+template<class T>
+class DEPENDENCY_TRAITS<SINGLETON_OF<T>> {
+public:
+    using TYPE = T;
+    static constexpr bool Singleton = true;
+};
+
+template<class D>
+DEPENDENCY
+MakeDependency()
+{
+    using TYPE = typename DEPENDENCY_TRAITS<D>::TYPE;
+
+    return {
+        .Singleton = DEPENDENCY_TRAITS<D>::Singleton,
+        .Slot = GetTypeSlot<TYPE>(),
+        .TypeName = typeid(TYPE).name()
+    };
+}
+
+class IOC;
+class SINGLETONS;
+class SCOPE;
+
+/*!
+ * @brief Checks the registrations of both containers together: every
+ * declared dependency must be registered, parameterized dependencies must
+ * accept a default payload and the graph must be acyclic.
+ * @throw IOC_VALIDATION_EXCEPTION listing every problem found.
+ */
+void
+ValidateRegistrations(
+    const IOC &Ioc,
+    SINGLETONS &Singletons
+);
+
 /*!
  * @brief IoC container.
+ * @details Factories are stored in a flat table indexed by the type slot of
+ * the registered type. Each entry holds the factory callable and a thunk
+ * that knows its exact type, so a resolution is an index and a single
+ * indirect call. After Freeze the table is immutable and can be resolved
+ * from any thread without locks.
  */
 class IOC {
 public:
     /*!
      * @brief Registers a factory function for creating instances of non-parameterized type T.
-     * @param InstanceFactory The factory function for type T.
+     * @param InstanceFactory The factory function for type T, a callable
+     * returning a shared pointer convertible to std::shared_ptr<T>.
+     * @param Dependencies The types the factory resolves.
      */
-    template<NOT_PARAMETERIZED T>
+    template<NOT_PARAMETERIZED T, class F, class... D>
+        requires std::is_invocable_r_v<std::shared_ptr<T>, std::decay_t<F> &>
     void
     RegisterFactory(
-        TYPE_FACTORY<T> InstanceFactory
+        F &&InstanceFactory,
+        DEPENDENCIES<D...> Dependencies = {}
     )
     {
-        IocContainerMap_[typeid(T)] = InstanceFactory;
+        using FACTORY = std::decay_t<F>;
+
+        StoreFactory<T>(std::make_shared<FACTORY>(std::forward<F>(InstanceFactory)),
+                        [](void *Factory, void *, void *Instance) {
+                            *static_cast<std::shared_ptr<T> *>(Instance) = (*static_cast<FACTORY *>(Factory))();
+                        },
+                        {
+                            .TypeName = typeid(T).name(),
+                            .Dependencies = {MakeDependency<D>()...}
+                        });
     }
 
     /*!
      * @brief Registers a factory function for creating instances of parameterized type T.
-     * @param InstanceFactory The factory function for type T.
+     * @param InstanceFactory The factory function for type T, a callable
+     * taking T::IOC_PAYLOAD and returning a shared pointer convertible to
+     * std::shared_ptr<T>.
+     * @param Dependencies The types the factory resolves.
+     * @param PayloadDefault Whether the factory accepts a default payload.
      */
-    template<PARAMETERIZED T>
+    template<PARAMETERIZED T, class F, class... D>
+        requires std::is_invocable_r_v<std::shared_ptr<T>, std::decay_t<F> &, typename T::IOC_PAYLOAD>
     void
     RegisterFactory(
-        TYPE_FACTORY_PARAMETERIZED<T> InstanceFactory
+        F &&InstanceFactory,
+        DEPENDENCIES<D...> Dependencies = {},
+        PAYLOAD_DEFAULT PayloadDefault = PAYLOAD_DEFAULT::Unsupported
     )
     {
-        IocContainerMap_[typeid(T)] = InstanceFactory;
+        using FACTORY = std::decay_t<F>;
+
+        StoreFactory<T>(std::make_shared<FACTORY>(std::forward<F>(InstanceFactory)),
+                        [](void *Factory, void *Payload, void *Instance) {
+                            *static_cast<std::shared_ptr<T> *>(Instance) = (*static_cast<FACTORY *>(Factory))(
+                                std::move(*static_cast<typename T::IOC_PAYLOAD *>(Payload)));
+                        },
+                        {
+                            .TypeName = typeid(T).name(),
+                            .Parameterized = true,
+                            .PayloadDefault = PayloadDefault,
+                            .Dependencies = {MakeDependency<D>()...}
+                        });
     }
 
+    /*!
+     * @brief Registers a factory for instances of type T that live as long
+     * as the SCOPE they are resolved from. A type has either a scoped or a
+     * transient factory; registering one replaces the other.
+     * @param InstanceFactory The factory for type T, a callable taking the
+     * SCOPE and returning a T & created with SCOPE::Make.
+     * @param Dependencies The types the factory resolves.
+     */
+    template<NOT_PARAMETERIZED T, class F, class... D>
+        requires std::is_invocable_r_v<T &, std::decay_t<F> &, SCOPE &>
+    void
+    RegisterScopedFactory(
+        F &&InstanceFactory,
+        DEPENDENCIES<D...> Dependencies = {}
+    )
+    {
+        using FACTORY = std::decay_t<F>;
+
+        CheckNotFrozen(typeid(T).name());
+
+        const auto slot = GetTypeSlot<T>();
+        Reserve(slot);
+
+        Factories_[slot] = {};
+        ScopedFactories_[slot] = {
+            .Create = [](void *Factory, SCOPE &Scope) -> void * {
+                T &instance = (*static_cast<FACTORY *>(Factory))(Scope);
+                return &instance;
+            },
+            .Factory = std::make_shared<FACTORY>(std::forward<F>(InstanceFactory))
+        };
+        Registrations_[slot] = {
+            .TypeName = typeid(T).name(),
+            .Scoped = true,
+            .Dependencies = {MakeDependency<D>()...}
+        };
+    }
+
+    /*!
+     * @brief Creates a scope for resolving scoped instances, see iocscope.hpp.
+     */
+    SCOPE
+    CreateScope() const;
+
     /*!
      * @brief Resolves and returns an instance of non-parameterized type T.
      * @return A shared pointer to the resolved instance.
@@ -86,7 +299,11 @@ public:
     std::shared_ptr<T>
     Resolve()
     {
-        return ResolveInternal<T, TYPE_FACTORY<T>>();
+        const auto &factory = FindFactory<T>();
+
+        std::shared_ptr<T> instance;
+        factory.Invoke(factory.Factory.get(), nullptr, &instance);
+        return instance;
     }
 
     /*!
@@ -100,37 +317,135 @@ public:
         typename T::IOC_PAYLOAD &&IocParams = {}
     )
     {
-        return ResolveInternal<T, TYPE_FACTORY_PARAMETERIZED<T>>(std::forward<typename T::IOC_PAYLOAD>(IocParams));
+        const auto &factory = FindFactory<T>();
+
+        std::shared_ptr<T> instance;
+        factory.Invoke(factory.Factory.get(), &IocParams, &instance);
+        return instance;
+    }
+
+    /*!
+     * @brief Validates the registrations together with those of the
+     * singletons and rejects further registrations.
+     * @throw IOC_VALIDATION_EXCEPTION listing every problem found.
+     */
+    void
+    Freeze();
+
+    /*!
+     * @brief Returns what is known about the factory of a type slot.
+     * @return The registration, null if the slot has no factory.
+     */
+    const REGISTRATION *
+    FindRegistration(
+        std::size_t Slot
+    ) const
+    {
+        return Slot < Registrations_.size() && Registrations_[Slot].TypeName ? &Registrations_[Slot] : nullptr;
     }
 
 private:
-    template<class T, class G, class... P>
-    std::shared_ptr<T>
-    ResolveInternal(
-        P&&... Payload
+    friend void ValidateRegistrations(const IOC &, SINGLETONS &);
+    friend SCOPE;
+
+    /*!
+     * @brief Type-erased factory. Invoke casts Factory, Payload and Instance
+     * back to the exact types they were registered with.
+     */
+    class FACTORY_ENTRY {
+    public:
+        using THUNK = void (*)(void *Factory, void *Payload, void *Instance);
+
+        THUNK Invoke = nullptr;
+        std::shared_ptr<void> Factory;
+    };
+
+    /*!
+     * @brief Type-erased scoped factory. Create returns the T * of the
+     * instance it made in the scope.
+     */
+    class SCOPED_FACTORY_ENTRY {
+    public:
+        using THUNK = void *(*)(void *Factory, SCOPE &Scope);
+
+        THUNK Create = nullptr;
+        std::shared_ptr<void> Factory;
+    };
+
+    void
+    Reserve(
+        std::size_t Slot
+    )
+    {
+        if (Slot >= Factories_.size()) {
+            Factories_.resize(Slot + 1);
+            ScopedFactories_.resize(Slot + 1);
+            Registrations_.resize(Slot + 1);
+        }
+    }
+
+    template<class T>
+    void
+    StoreFactory(
+        std::shared_ptr<void> Factory,
+        FACTORY_ENTRY::THUNK Invoke,
+        REGISTRATION Registration
     )
     {
-        const auto iterator = IocContainerMap_.find(typeid(T));
-        if (iterator == IocContainerMap_.end()) {
+        CheckNotFrozen(typeid(T).name());
+
+        const auto slot = GetTypeSlot<T>();
+        Reserve(slot);
+
+        Factories_[slot] = {.Invoke = Invoke, .Factory = std::move(Factory)};
+        ScopedFactories_[slot] = {};
+        Registrations_[slot] = std::move(Registration);
+    }
+
+    void
+    CheckNotFrozen(
+        const char *TypeName
+    ) const;
+
+    template<class T>
+    const FACTORY_ENTRY &
+    FindFactory() const
+    {
+        const auto slot = GetTypeSlot<T>();
+        if (slot >= Factories_.size() || !Factories_[slot].Invoke) {
             throw FACTORY_NOT_FOUND_EXCEPTION{
                 std::format("Failed to find factory for \"{}\" in the factory map",
                             typeid(T).name())
             };
         }
 
-        const auto &entry = iterator->second;
+        return Factories_[slot];
+    }
 
-        try {
-            return std::any_cast<G>(entry)(std::forward<P>(Payload)...);
-        } catch (const std::bad_any_cast &) {
-            NTECTIVE_CHECK_FAIL.Message(std::format(L"Could not resolve factory for type \"{}\" mapped from \"{}\"",
-                                                    Util::StringToWstring(typeid(G).name()),
-                                                    Util::StringToWstring(entry.type().name())))
-                               .Throw();
+    template<class T>
+    const SCOPED_FACTORY_ENTRY &
+    FindScopedFactory() const
+    {
+        const auto slot = GetTypeSlot<T>();
+        if (slot >= ScopedFactories_.size() || !ScopedFactories_[slot].Create) {
+            throw FACTORY_NOT_FOUND_EXCEPTION{
+                std::format("Failed to find scoped factory for \"{}\" in the factory map",
+                            typeid(T).name())
+            };
         }
+
+        return ScopedFactories_[slot];
     }
 
-    std::unordered_map<std::type_index, std::any> IocContainerMap_;
+    std::vector<FACTORY_ENTRY> Factories_;
+    std::vector<SCOPED_FACTORY_ENTRY> ScopedFactories_;
+
+    /*!
+     * @brief Indexed like Factories_, kept apart so the resolution tables
+     * stay dense.
+     */
+    std::vector<REGISTRATION> Registrations_;
+    bool Frozen_ = false;
 };
 
 /*!
@@ -140,72 +455,248 @@ private:
 IOC &
 GetIoc();
 
+/*!
+ * @brief When a singleton is constructed.
+ */
+enum class SINGLETON_START {
+    /*!
+     * @brief On first resolution.
+     */
+    Lazy,
+
+    /*!
+     * @brief By SINGLETONS::StartEager, concurrently with the other eager
+     * singletons it does not depend on.
+     */
+    Eager
+};
+
+/*!
+ * @brief How long the factory of a singleton ran, reported by StartEager.
+ */
+class SINGLETON_TIMING {
+public:
+    const char *TypeName = nullptr;
+    std::chrono::nanoseconds Duration{};
+};
+
 /*!
  * @brief Singleton container.
+ * @details Entries live in fixed-size chunks indexed by the type slot of the
+ * singleton type. Chunks are published once and never move, so an
+ * initialized singleton is resolved with an acquire load of its chunk and of
+ * its cached instance, without a lock. The first resolution of a type runs
+ * its factory without holding any lock; every other thread resolving the
+ * type waits for it and gets the same instance, while singletons of other
+ * types are constructed in parallel. A thread that would wait, directly or
+ * through other constructing threads, for a singleton it is constructing
+ * itself gets SINGLETON_CYCLE_EXCEPTION naming the chain instead of
+ * deadlocking. Freeze validates the registrations and rejects new ones.
  */
 class SINGLETONS {
 public:
+    SINGLETONS() = default;
+
+    SINGLETONS(const SINGLETONS &) = delete;
+
+    SINGLETONS &
+    operator=(const SINGLETONS &) = delete;
+
+    ~SINGLETONS();
+
     /*!
      * @brief Registers a factory function for creating a singleton instance of type T.
+     * The singleton must not have been resolved yet.
      * @param SingletonFactory The factory function for type T.
+     * @param Dependencies The types the factory resolves.
+     * @param Start When the singleton is constructed.
      */
-    template<class T>
+    template<class T, class... D>
     void
     RegisterFactory(
-        TYPE_FACTORY<T> SingletonFactory
+        TYPE_FACTORY<T> SingletonFactory,
+        DEPENDENCIES<D...> Dependencies = {},
+        SINGLETON_START Start = SINGLETON_START::Lazy
     )
     {
-        SingletonContainerMap_[typeid(T)] = SingletonFactory;
+        StoreFactory(GetTypeSlot<T>(),
+                     std::make_shared<TYPE_FACTORY<T>>(std::move(SingletonFactory)),
+                     [](void *Factory) -> std::shared_ptr<void> {
+                         return std::make_shared<std::shared_ptr<T>>((*static_cast<TYPE_FACTORY<T> *>(Factory))());
+                     },
+                     {
+                         .TypeName = typeid(T).name(),
+                         .Dependencies = {MakeDependency<D>()...}
+                     },
+                     Start);
     }
 
     /*!
      * @brief Registers a factory function that essentially passes through the resolution
      * to the IoC container for the specified type T.
+     * @param Start When the singleton is constructed.
      */
     template<class T>
     void
-    RegisterDelegateFactory()
+    RegisterDelegateFactory(
+        SINGLETON_START Start = SINGLETON_START::Lazy
+    )
     {
         RegisterFactory<T>([] {
-            return GetIoc().Resolve<T>();
-        });
+                               return GetIoc().Resolve<T>();
+                           },
+                           DEPENDENCIES<T>{},
+                           Start);
     }
 
+    /*!
+     * @brief Resolves the singleton instance of type T, creating it on first use.
+     * @return A shared pointer to the singleton instance.
+     */
     template<class T>
     std::shared_ptr<T>
     Resolve()
     {
-        const auto iterator = SingletonContainerMap_.find(typeid(T));
+        const auto slot = GetTypeSlot<T>();
 
-        if (iterator == SingletonContainerMap_.end()) {
-            throw FACTORY_NOT_FOUND_EXCEPTION{
-                std::format("Could not find entry for type \"{}\" in singleton container",
-                            typeid(T).name())
-            };
+        const void *instance = FindInstance(slot);
+        if (!instance) {
+            instance = Initialize(slot, typeid(T).name());
         }
 
-        auto &entry = iterator->second;
+        return *static_cast<const std::shared_ptr<T> *>(instance);
+    }
+
+    /*!
+     * @brief Validates the registrations together with those of the IoC
+     * container and rejects further registrations.
+     * @throw IOC_VALIDATION_EXCEPTION listing every problem found.
+     */
+    void
+    Freeze();
+
+    /*!
+     * @brief Constructs the eager singletons and the singletons they depend
+     * on, following the declared dependencies through the IoC container.
+     * Singletons whose dependencies are constructed run concurrently on up
+     * to WorkerCount threads; the call returns when all of them finished.
+     * Dependents of a singleton whose factory threw are skipped.
+     * @param WorkerCount The maximum number of construction threads.
+     * @return The construction time of every singleton constructed, in
+     * completion order.
+     * @throw The first exception thrown by a factory.
+     */
+    std::vector<SINGLETON_TIMING>
+    StartEager(
+        std::size_t WorkerCount = std::thread::hardware_concurrency()
+    );
+
+private:
+    friend void ValidateRegistrations(const IOC &, SINGLETONS &);
+
+    /*!
+     * @brief Creates the instance with the factory it was registered with
+     * and returns it as a heap allocated std::shared_ptr<T>.
+     */
+    using THUNK = std::shared_ptr<void> (*)(void *Factory);
+
+    class ENTRY {
+    public:
+        /*!
+         * @brief Points to the std::shared_ptr<T> held by Holder once the
+         * singleton is initialized, null before.
+         */
+        std::atomic<const void *> Instance = nullptr;
 
-        try {
-            if (auto existingInstance = std::any_cast<std::shared_ptr<T>>(&entry)) {
-                return *existingInstance;
-            }
+        THUNK Create = nullptr;
+        std::shared_ptr<void> Factory;
+        std::shared_ptr<void> Holder;
+        REGISTRATION Registration;
+        SINGLETON_START Start = SINGLETON_START::Lazy;
 
-            auto instance = std::any_cast<TYPE_FACTORY<T>>(entry)();
-            entry = instance;
+        /*!
+         * @brief Thread running the factory, default while none does.
+         */
+        std::thread::id Constructor;
+    };
 
-            return instance;
+    static constexpr std::size_t ChunkSize = 64;
+    static constexpr std::size_t MaxChunks = 64;
 
-        } catch (const std::bad_any_cast &) {
-            NTECTIVE_CHECK_FAIL.Message(std::format(L"Could not resolve singleton for type \"{}\" mapped from \"{}\"",
-                                                    Util::StringToWstring(entry.type().name()),
-                                                    Util::StringToWstring(typeid(TYPE_FACTORY<T>).name())))
-                               .Throw();
+    class CHUNK {
+    public:
+        std::array<ENTRY, ChunkSize> Entries;
+    };
+
+    const void *
+    FindInstance(
+        std::size_t Slot
+    ) const
+    {
+        if (Slot >= ChunkSize * MaxChunks) {
+            return nullptr;
         }
+
+        const auto chunk = Chunks_[Slot / ChunkSize].load(std::memory_order_acquire);
+        return chunk ? chunk->Entries[Slot % ChunkSize].Instance.load(std::memory_order_acquire) : nullptr;
     }
 
-private:
-    std::unordered_map<std::type_index, std::any> SingletonContainerMap_;
+    ENTRY *
+    FindEntry(
+        std::size_t Slot
+    ) const;
+
+    void
+    StoreFactory(
+        std::size_t Slot,
+        std::shared_ptr<void> Factory,
+        THUNK Create,
+        REGISTRATION Registration,
+        SINGLETON_START Start
+    );
+
+    /*!
+     * @brief Slow path of Resolve: runs the factory of the slot once.
+     * @param Constructed If not null, set to whether this call ran the
+     * factory rather than finding or waiting for the instance.
+     * @return The instance, a pointer to a std::shared_ptr<T>.
+     */
+    const void *
+    Initialize(
+        std::size_t Slot,
+        const char *TypeName,
+        bool *Constructed = nullptr
+    );
+
+    /*!
+     * @brief Describes the cycle closed if the calling thread waited for
+     * Entry, an empty string if waiting cannot deadlock. Called with
+     * StateLock_ held.
+     */
+    std::string
+    DescribeWaitCycle(
+        const ENTRY &Entry
+    ) const;
+
+    std::array<std::atomic<CHUNK *>, MaxChunks> Chunks_{};
+
+    /*!
+     * @brief Guards registration and the construction state of the
+     * entries. Never held while a factory runs.
+     */
+    mutable std::mutex StateLock_;
+    std::condition_variable StateChanged_;
+
+    /*!
+     * @brief Entry each thread waits for while another thread constructs it.
+     */
+    std::unordered_map<std::thread::id, const ENTRY *> Waiting_;
+
+    /*!
+     * @brief Registered slots in registration order, for Freeze.
+     */
+    std::vector<std::size_t> RegisteredSlots_;
+    bool Frozen_ = false;
 };
 
 SINGLETONS &
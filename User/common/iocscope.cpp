@@ -0,0 +1,85 @@
+﻿/*!
+ *  @file       iocscope.cpp
+ *  @brief      Scoped IoC lifetimes.
+ */
+
+#include "iocscope.hpp"
+
+#include <algorithm>
+
+namespace Common::Ioc {
+
+SCOPE::SCOPE(
+    const IOC &Ioc
+) : Ioc_(Ioc),
+    Cursor_(Inline_),
+    End_(Inline_ + InlineSize)
+{
+}
+
+SCOPE::~SCOPE()
+{
+    for (auto record = LastRecord_; record; record = record->Previous) {
+        record->Destroy(record->Object);
+    }
+
+    for (auto block = LastBlock_; block;) {
+        const auto previous = block->Previous;
+        if (block->Chunk) {
+            Util::THREAD_ARENA::Release(block->Chunk);
+        } else {
+            ::operator delete(block);
+        }
+
+        block = previous;
+    }
+}
+
+void *
+SCOPE::AllocateBlock(
+    std::size_t Size,
+    std::size_t Alignment
+)
+{
+    /* The header keeps the data maximally aligned, larger alignments are padded. */
+    constexpr auto headerSize = (sizeof(BLOCK) + alignof(std::max_align_t) - 1) & ~(alignof(std::max_align_t) - 1);
+    const auto dataSize = std::max(BlockSize, Size + (Alignment > alignof(std::max_align_t) ? Alignment : 0));
+
+    void *memory;
+    Util::ARENA_CHUNK *chunk = nullptr;
+
+    if (headerSize + dataSize <= Util::THREAD_ARENA::MaxAllocationSize) {
+        const auto allocation = Util::THREAD_ARENA::Allocate(headerSize + dataSize);
+        memory = allocation.Data;
+        chunk = allocation.Chunk;
+    } else {
+        memory = ::operator new(headerSize + dataSize);
+    }
+
+    LastBlock_ = new (memory) BLOCK{.Previous = LastBlock_, .Chunk = chunk};
+    Cursor_ = static_cast<std::byte *>(memory) + headerSize;
+    End_ = Cursor_ + dataSize;
+
+    return Allocate(Size, Alignment);
+}
+
+void
+SCOPE::Unlist(
+    INSTANCE *Instance
+)
+{
+    for (auto link = &Instances_; *link; link = &(*link)->Next) {
+        if (*link == Instance) {
+            *link = Instance->Next;
+            return;
+        }
+    }
+}
+
+SCOPE
+IOC::CreateScope() const
+{
+    return SCOPE{*this};
+}
+
+}
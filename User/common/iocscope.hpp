@@ -0,0 +1,210 @@
+﻿/*!
+ *  @file       iocscope.hpp
+ *  @brief      Scoped IoC lifetimes.
+ *  @details    A SCOPE caches the instances resolved from it through the
+ *              scoped factories of the IoC container and destroys them in
+ *              reverse construction order when it ends. Instances and the
+ *              bookkeeping records are bump-allocated from a monotonic
+ *              arena that starts in a buffer inside the scope and grows in
+ *              blocks taken from the thread arena, so creating and tearing
+ *              down a scope with a few instances does not reach the global
+ *              allocator.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <format>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+#include "arena.hpp"
+#include "ioc.hpp"
+
+namespace Common::Ioc {
+
+/*!
+ * @brief Lifetime scope of instances resolved through scoped factories.
+ * A scope is used by one thread at a time.
+ */
+class SCOPE {
+public:
+    /*!
+     * @brief Size of the arena buffer inside the scope.
+     */
+    static constexpr std::size_t InlineSize = 512;
+
+    /*!
+     * @brief Usable size of an arena block taken from the thread arena.
+     */
+    static constexpr std::size_t BlockSize = 4 * 1024;
+
+    explicit
+    SCOPE(
+        const IOC &Ioc
+    );
+
+    SCOPE(const SCOPE &) = delete;
+
+    SCOPE &
+    operator=(const SCOPE &) = delete;
+
+    /*!
+     * @brief Destroys the instances in reverse construction order and
+     * releases the arena.
+     */
+    ~SCOPE();
+
+    /*!
+     * @brief Resolves the instance of type T in this scope, creating it with
+     * the scoped factory of T on first use.
+     * @return The instance, valid until the scope ends.
+     */
+    template<NOT_PARAMETERIZED T>
+    T &
+    Resolve()
+    {
+        const auto slot = GetTypeSlot<T>();
+
+        for (auto instance = Instances_; instance; instance = instance->Next) {
+            if (instance->Slot == slot) {
+                if (!instance->Object) {
+                    throw SCOPE_CYCLE_EXCEPTION{
+                        std::format("Scoped factory of \"{}\" resolves itself",
+                                    typeid(T).name())
+                    };
+                }
+
+                return *static_cast<T *>(instance->Object);
+            }
+        }
+
+        const auto &factory = Ioc_.FindScopedFactory<T>();
+
+        /* Listed before the factory runs, so a factory resolving its own type is caught. */
+        const auto instance = new (Allocate(sizeof(INSTANCE), alignof(INSTANCE))) INSTANCE{.Slot = slot, .Next = Instances_};
+        Instances_ = instance;
+
+        try {
+            instance->Object = factory.Create(factory.Factory.get(), *this);
+        } catch (...) {
+            Unlist(instance);
+            throw;
+        }
+
+        return *static_cast<T *>(instance->Object);
+    }
+
+    /*!
+     * @brief Constructs an object in the arena of the scope. It is destroyed
+     * when the scope ends, before every object made earlier.
+     * @param Arguments The constructor arguments.
+     * @return The object.
+     */
+    template<class T, class... A>
+    T &
+    Make(
+        A &&...Arguments
+    )
+    {
+        if constexpr (std::is_trivially_destructible_v<T>) {
+            return *new (Allocate(sizeof(T), alignof(T))) T(std::forward<A>(Arguments)...);
+        } else {
+            const auto record = new (Allocate(sizeof(RECORD), alignof(RECORD))) RECORD;
+            const auto object = new (Allocate(sizeof(T), alignof(T))) T(std::forward<A>(Arguments)...);
+
+            *record = {
+                .Previous = LastRecord_,
+                .Object = object,
+                .Destroy = [](void *Object) {
+                    static_cast<T *>(Object)->~T();
+                }
+            };
+            LastRecord_ = record;
+
+            return *object;
+        }
+    }
+
+private:
+    /*!
+     * @brief Destructor of an object made in the scope. Records are linked
+     * from the newest to the oldest.
+     */
+    class RECORD {
+    public:
+        RECORD *Previous = nullptr;
+        void *Object = nullptr;
+        void (*Destroy)(void *Object) = nullptr;
+    };
+
+    /*!
+     * @brief Cached instance of a type slot, Object is null while its
+     * factory runs.
+     */
+    class INSTANCE {
+    public:
+        std::size_t Slot = 0;
+        void *Object = nullptr;
+        INSTANCE *Next = nullptr;
+    };
+
+    /*!
+     * @brief Header of an arena block outside the scope.
+     */
+    class BLOCK {
+    public:
+        BLOCK *Previous = nullptr;
+
+        /*!
+         * @brief The thread arena chunk of the block, null for blocks from
+         * the global allocator.
+         */
+        Util::ARENA_CHUNK *Chunk = nullptr;
+    };
+
+    void *
+    Allocate(
+        std::size_t Size,
+        std::size_t Alignment
+    )
+    {
+        const auto address = reinterpret_cast<std::uintptr_t>(Cursor_);
+        const auto aligned = (address + Alignment - 1) & ~(std::uintptr_t{Alignment} - 1);
+
+        if (aligned + Size <= reinterpret_cast<std::uintptr_t>(End_)) {
+            Cursor_ = reinterpret_cast<std::byte *>(aligned + Size);
+            return reinterpret_cast<void *>(aligned);
+        }
+
+        return AllocateBlock(Size, Alignment);
+    }
+
+    /*!
+     * @brief Slow path of Allocate: starts a new block large enough for the
+     * allocation and allocates from it.
+     */
+    void *
+    AllocateBlock(
+        std::size_t Size,
+        std::size_t Alignment
+    );
+
+    void
+    Unlist(
+        INSTANCE *Instance
+    );
+
+    const IOC &Ioc_;
+    std::byte *Cursor_;
+    std::byte *End_;
+    BLOCK *LastBlock_ = nullptr;
+    RECORD *LastRecord_ = nullptr;
+    INSTANCE *Instances_ = nullptr;
+    alignas(std::max_align_t) std::byte Inline_[InlineSize];
+};
+
+}
@@ -5,27 +5,192 @@
 
 #include "jobqueue.hpp"
 
+#include <algorithm>
+
 namespace Common::Util {
 
-void
+namespace {
+
+/*!
+ * @brief Heap order of ENTRY: a is run after b.
+ */
+class RUNS_AFTER {
+public:
+    template<class ENTRY>
+    bool
+    operator()(
+        const ENTRY &A,
+        const ENTRY &B
+    ) const
+    {
+        return A.Deadline != B.Deadline ? A.Deadline > B.Deadline : A.Sequence > B.Sequence;
+    }
+};
+
+}
+
+JOB_QUEUE::JOB_QUEUE(
+    WAKEUP Wakeup,
+    std::chrono::steady_clock::duration EscalationWindow
+) : Wakeup_(std::move(Wakeup)),
+    EscalationWindow_(EscalationWindow)
+{
+}
+
+bool
 JOB_QUEUE::PopAndExecute()
 {
     JOB job;
     {
         std::lock_guard lock{Lock_};
-        job = std::move(Jobs_.front());
-        Jobs_.pop_front();
+        if (!TakeNext(job, std::chrono::steady_clock::now())) {
+            WakeupNeeded_ = true;
+            return false;
+        }
     }
     job();
+    return true;
+}
+
+std::size_t
+JOB_QUEUE::Drain(
+    std::chrono::steady_clock::duration Budget
+)
+{
+    const auto deadline = Budget == std::chrono::steady_clock::duration::max()
+        ? std::chrono::steady_clock::time_point::max()
+        : std::chrono::steady_clock::now() + Budget;
+
+    std::size_t executed = 0;
+
+    /* One job per lock, a job enqueued meanwhile may have to run next. */
+    for (;;) {
+        const auto now = std::chrono::steady_clock::now();
+        if (executed && now >= deadline) {
+            Reschedule();
+            return executed;
+        }
+
+        JOB job;
+        {
+            std::lock_guard lock{Lock_};
+            if (!TakeNext(job, now)) {
+                WakeupNeeded_ = true;
+                return executed;
+            }
+        }
+
+        ++executed;
+
+        try {
+            job();
+        } catch (...) {
+            Reschedule();
+            throw;
+        }
+    }
+}
+
+std::size_t
+JOB_QUEUE::DrainAll()
+{
+    return Drain(std::chrono::steady_clock::duration::max());
 }
 
 void
 JOB_QUEUE::EnqueueInternal(
-    JOB Job
+    JOB Job,
+    const JOB_OPTIONS &Options
 )
 {
-    std::lock_guard lock{Lock_};
-    Jobs_.push_back(std::move(Job));
+    {
+        std::lock_guard lock{Lock_};
+
+        auto &jobs = Jobs_[static_cast<std::size_t>(Options.Priority)];
+        jobs.push_back({
+            .Deadline = Options.Deadline,
+            .Sequence = NextSequence_++,
+            .Job = std::move(Job)
+        });
+        std::ranges::push_heap(jobs, RUNS_AFTER{});
+
+        if (!WakeupNeeded_ || !Wakeup_) {
+            return;
+        }
+
+        WakeupNeeded_ = false;
+    }
+
+    try {
+        Wakeup_();
+    } catch (...) {
+        /* Let the next producer retry. */
+        std::lock_guard lock{Lock_};
+        WakeupNeeded_ = true;
+        throw;
+    }
+}
+
+bool
+JOB_QUEUE::TakeNext(
+    JOB &Job,
+    std::chrono::steady_clock::time_point Now
+)
+{
+    std::vector<ENTRY> *next = nullptr;
+    auto nextPriority = Jobs_.size();
+
+    /* The top of a heap has the earliest deadline of its class, so it is also the most escalated job. */
+    for (std::size_t priority = 0; priority < Jobs_.size(); ++priority) {
+        auto &jobs = Jobs_[priority];
+        if (jobs.empty()) {
+            continue;
+        }
+
+        const auto jobDeadline = jobs.front().Deadline;
+        auto effective = priority;
+
+        if (jobDeadline != std::chrono::steady_clock::time_point::max()) {
+            if (Now >= jobDeadline) {
+                effective = 0;
+            } else if (priority && jobDeadline - Now <= EscalationWindow_) {
+                effective = priority - 1;
+            }
+        }
+
+        if (effective < nextPriority ||
+            (effective == nextPriority && jobDeadline < next->front().Deadline)) {
+            next = &jobs;
+            nextPriority = effective;
+        }
+    }
+
+    if (!next) {
+        return false;
+    }
+
+    std::ranges::pop_heap(*next, RUNS_AFTER{});
+    Job = std::move(next->back().Job);
+    next->pop_back();
+    return true;
+}
+
+void
+JOB_QUEUE::Reschedule()
+{
+    {
+        std::lock_guard lock{Lock_};
+        if (std::ranges::all_of(Jobs_, [](const auto &Jobs) {
+            return Jobs.empty();
+        })) {
+            WakeupNeeded_ = true;
+            return;
+        }
+    }
+
+    if (Wakeup_) {
+        Wakeup_();
+    }
 }
 
 }
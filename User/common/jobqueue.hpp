@@ -5,59 +5,256 @@
 
 #pragma once
 
-#include <deque>
+#include <array>
+#include <chrono>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
 #include <functional>
 #include <future>
 #include <mutex>
+#include <stop_token>
+#include <type_traits>
+#include <vector>
 
-#include "log.hpp"
+#include "excption.hpp"
 #include "macros.h"
 
 namespace Common::Util {
 
+/*!
+ * @brief Thrown by the future of a job that was cancelled.
+ */
+class JOB_CANCELLED_EXCEPTION : public BUF_EXCEPTION {
+public:
+    using BUF_EXCEPTION::BUF_EXCEPTION;
+};
+
+/*!
+ * @brief Priority class of a job, Interactive runs first.
+ */
+enum class JOB_PRIORITY {
+    Interactive,
+    Normal,
+    Background
+};
+
+/*!
+ * @brief Scheduling options of an enqueued job.
+ */
+class JOB_OPTIONS {
+public:
+    JOB_PRIORITY Priority = JOB_PRIORITY::Normal;
+
+    /*!
+     * @brief The job moves up one priority class within the escalation window
+     * of the queue before the deadline, and to Interactive once it passed.
+     */
+    std::chrono::steady_clock::time_point Deadline = std::chrono::steady_clock::time_point::max();
+
+    /*!
+     * @brief A job whose stop was requested before it started is skipped.
+     * Functions taking a std::stop_token receive it to stop early.
+     */
+    std::stop_token Cancellation;
+};
+
 /*!
  * @brief A simple job (generic task) queue implementation.
+ * @details Producers wake the consumer through the wakeup function only when
+ * the queue goes from drained to non-empty, so a burst of jobs costs one
+ * wakeup. The consumer runs whole batches per wakeup with Drain. A new queue
+ * assumes its consumer drains it before waiting for the first wakeup.
+ *
+ * Jobs run by priority class, FIFO within a class. Jobs with a deadline run
+ * before the jobs without one in the same class, earliest deadline first.
  */
 class JOB_QUEUE {
 public:
+    using WAKEUP = std::move_only_function<void()>;
+
+    static constexpr std::chrono::milliseconds DefaultEscalationWindow{50};
+
+    JOB_QUEUE() = default;
+
+    /*!
+     * @brief Constructs a queue.
+     * @param Wakeup Called by producers, outside the queue lock, to make the
+     * consumer drain the queue.
+     * @param EscalationWindow How long before its deadline a job moves up a
+     * priority class.
+     */
+    explicit
+    JOB_QUEUE(
+        WAKEUP Wakeup,
+        std::chrono::steady_clock::duration EscalationWindow = DefaultEscalationWindow
+    );
+
     /**
      * @brief Enqueues a function to be executed asynchronously.
-     * @tparam FunctionType Type of the invocable function.
+     * @tparam FunctionType Type of the invocable function, invoked with the
+     * cancellation token if it accepts a std::stop_token.
      * @param Function The function to be enqueued for execution.
-     * @return A future object representing the result of the enqueued function.
+     * @param Options The priority, deadline and cancellation of the job.
+     * @return A future object representing the result of the enqueued
+     * function. It throws JOB_CANCELLED_EXCEPTION if the job was cancelled
+     * before it started, or if the function threw it.
      */
-    template<std::invocable FunctionType>
+    template<class FunctionType>
+        requires std::invocable<FunctionType> || std::invocable<FunctionType, std::stop_token>
     auto
-    Enqueue(FunctionType &&Function)
+    Enqueue(
+        FunctionType &&Function,
+        JOB_OPTIONS Options = {}
+    )
     {
-        using PACKAGED_JOB = std::packaged_task<std::invoke_result_t<FunctionType>()>;
+        using FUNCTION = std::decay_t<FunctionType> &;
+        using RESULT = typename std::conditional_t<std::invocable<FUNCTION, std::stop_token>,
+                                                   std::invoke_result<FUNCTION, std::stop_token>,
+                                                   std::invoke_result<FUNCTION>>::type;
+
+        std::promise<RESULT> promise;
+        auto future = promise.get_future();
 
-        PACKAGED_JOB packagedJob{std::forward<FunctionType>(Function)};
-        auto future = packagedJob.get_future();
+        EnqueueInternal([promise_ = std::move(promise),
+                         function_ = std::forward<FunctionType>(Function),
+                         cancellation_ = Options.Cancellation]() mutable {
+            if (cancellation_.stop_requested()) {
+                promise_.set_exception(std::make_exception_ptr(JOB_CANCELLED_EXCEPTION{"Job cancelled before it started"}));
+                return;
+            }
 
-        EnqueueInternal([packagedJob_ = std::move(packagedJob)]() mutable {
-            packagedJob_();
-        });
+            try {
+                if constexpr (std::is_void_v<RESULT>) {
+                    Invoke(function_, cancellation_);
+                    promise_.set_value();
+                } else {
+                    promise_.set_value(Invoke(function_, cancellation_));
+                }
+            } catch (...) {
+                promise_.set_exception(std::current_exception());
+            }
+        }, Options);
 
         return future;
     }
 
-    /**
-     * @brief Retrieves and executes a job from the queue.
+    /*!
+     * @brief Enqueues a function without a future, for FUTURE continuations.
+     * A job cancelled before it starts is destroyed without running.
+     * @param Function The function to be enqueued for execution.
+     * @param Options The priority, deadline and cancellation of the job.
      */
+    template<std::invocable FunctionType>
     void
+    Post(
+        FunctionType &&Function,
+        JOB_OPTIONS Options = {}
+    )
+    {
+        if (!Options.Cancellation.stop_possible()) {
+            EnqueueInternal(std::forward<FunctionType>(Function), Options);
+            return;
+        }
+
+        EnqueueInternal([function_ = std::forward<FunctionType>(Function),
+                         cancellation_ = Options.Cancellation]() mutable {
+            if (!cancellation_.stop_requested()) {
+                std::invoke(function_);
+            }
+        }, Options);
+    }
+
+    /**
+     * @brief Retrieves and executes the next job from the queue, if there is one.
+     * @return Whether a job was executed.
+     */
+    bool
     PopAndExecute();
 
+    /*!
+     * @brief Executes queued jobs, including the ones enqueued meanwhile,
+     * until the queue is empty or the budget is spent. At least one job is
+     * executed if there is one. When jobs remain the wakeup is called again,
+     * so the consumer can handle other events before it continues.
+     * @param Budget The time after which no further job is started.
+     * @return The number of executed jobs, cancelled ones included.
+     */
+    std::size_t
+    Drain(
+        std::chrono::steady_clock::duration Budget
+    );
+
+    /*!
+     * @brief Executes queued jobs until the queue is empty.
+     * @return The number of executed jobs, cancelled ones included.
+     */
+    std::size_t
+    DrainAll();
+
 private:
     using JOB = std::move_only_function<void()>;
 
+    class ENTRY {
+    public:
+        std::chrono::steady_clock::time_point Deadline;
+        std::uint64_t Sequence = 0;
+        JOB Job;
+    };
+
+    template<class F>
+    static
+    decltype(auto)
+    Invoke(
+        F &Function,
+        const std::stop_token &Cancellation
+    )
+    {
+        if constexpr (std::invocable<F &, std::stop_token>) {
+            return std::invoke(Function, Cancellation);
+        } else {
+            return std::invoke(Function);
+        }
+    }
+
     void
     EnqueueInternal(
-        JOB Job
+        JOB Job,
+        const JOB_OPTIONS &Options
     );
 
+    /*!
+     * @brief Removes the job to run next. Requires the lock.
+     * @return false if the queue is empty.
+     */
+    bool
+    TakeNext(
+        JOB &Job,
+        std::chrono::steady_clock::time_point Now
+    );
+
+    /*!
+     * @brief Wakes the consumer for the remaining jobs when a drain ends
+     * early, or waits for producers if there are none.
+     */
+    void
+    Reschedule();
+
     std::mutex Lock_;
-    std::deque<JOB> Jobs_;
+
+    /*!
+     * @brief A heap per priority class, ordered by deadline and sequence.
+     */
+    std::array<std::vector<ENTRY>, 3> Jobs_;
+    std::uint64_t NextSequence_ = 0;
+    WAKEUP Wakeup_;
+    std::chrono::steady_clock::duration EscalationWindow_ = DefaultEscalationWindow;
+
+    /*!
+     * @brief Whether the consumer drained the queue and waits for a wakeup.
+     */
+    bool WakeupNeeded_ = false;
 };
 
 }
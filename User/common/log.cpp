@@ -6,6 +6,7 @@
 #include "log.hpp"
 
 #include "ioc.hpp"
+#include "lograte.hpp"
 #include "logsessn.hpp"
 #include "win32.h"
 
@@ -13,6 +14,30 @@ using namespace Common::Ioc;
 
 namespace Common::Log {
 
+std::wstring
+LOG_ENTRY::RenderMessage() const
+{
+    if (LogRecord.IsEmpty()) {
+        return std::wstring{LogData.View()};
+    }
+
+    std::wstring message;
+    LogRecord.RenderTo(message);
+    return message;
+}
+
+void
+LOG_ENTRY::RenderMessage(
+    std::wstring &Output
+) const
+{
+    if (LogRecord.IsEmpty()) {
+        Output += LogData.View();
+    } else {
+        LogRecord.RenderTo(Output);
+    }
+}
+
 LOG_CONTROLLER::LOG_CONTROLLER(
     const wchar_t *SourceFile,
     const wchar_t *Function,
@@ -21,57 +46,57 @@ LOG_CONTROLLER::LOG_CONTROLLER(
     .SourceFileName = SourceFile,
     .FunctionName = Function,
     .SourceLine = Line,
-    .LogTimestamp = std::chrono::system_clock::now()
+    .LogTimestamp = LOG_TIMESTAMP::Now()
 }
 {
 }
 
 LOG_CONTROLLER &
 LOG_CONTROLLER::Error(
-    std::wstring Message
+    std::wstring_view Message
 )
 {
-    LogData = std::move(Message);
+    LogData = Message;
     LogLevel = LOG_LEVEL::Error;
     return *this;
 }
 
 LOG_CONTROLLER &
 LOG_CONTROLLER::Warning(
-    std::wstring Message
+    std::wstring_view Message
 )
 {
-    LogData = std::move(Message);
+    LogData = Message;
     LogLevel = LOG_LEVEL::Warning;
     return *this;
 }
 
 LOG_CONTROLLER &
 LOG_CONTROLLER::Info(
-    std::wstring Message
+    std::wstring_view Message
 )
 {
-    LogData = std::move(Message);
+    LogData = Message;
     LogLevel = LOG_LEVEL::Info;
     return *this;
 }
 
 LOG_CONTROLLER &
 LOG_CONTROLLER::Critical(
-    std::wstring Message
+    std::wstring_view Message
 )
 {
-    LogData = std::move(Message);
+    LogData = Message;
     LogLevel = LOG_LEVEL::Critical;
     return *this;
 }
 
 LOG_CONTROLLER &
 LOG_CONTROLLER::Verbose(
-    std::wstring Message
+    std::wstring_view Message
 )
 {
-    LogData = std::move(Message);
+    LogData = Message;
     LogLevel = LOG_LEVEL::Verbose;
     return *this;
 }
@@ -96,10 +121,11 @@ LOG_CONTROLLER::At(
 
 LOG_CONTROLLER &
 LOG_CONTROLLER::WithMessage(
-    std::wstring Message
+    std::wstring_view Message
 )
 {
-    LogData = std::move(Message);
+    LogData = Message;
+    LogRecord.Clear();
     return *this;
 }
 
@@ -110,17 +136,36 @@ LOG_CONTROLLER::Hr()
     return *this;
 }
 
+LOG_CONTROLLER &
+LOG_CONTROLLER::FromSite(
+    LOG_SITE &Site
+)
+{
+    LogSite_ = &Site;
+    return *this;
+}
+
 LOG_CONTROLLER::~LOG_CONTROLLER()
 {
-    if (LogSession_) {
-        LogSession_->Write(*this);
+    if (!LogSession_) {
+        return;
     }
+
+    if (!LogSite_ && (!IsLevelCompiled(LogLevel) || !LogSession_->IsLevelEnabled(LogLevel))) {
+        return;
+    }
+
+    if (!GetLogRateLimiter().Admit(*this, *LogSession_)) {
+        return;
+    }
+
+    LogSession_->Write(*this);
 }
 
 LOG_SESSION_BASE *
 GetDefaultSession()
 {
-    static auto defaultSession = GetIoc().Resolve<LOG_SESSION_BASE>();
+    static auto defaultSession = GetSingletons().Resolve<LOG_SESSION_BASE>();
     return defaultSession.get();
 }
 
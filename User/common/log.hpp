@@ -1,4 +1,4 @@
-/*!
+﻿/*!
  *  @file       log.hpp
  *  @brief      Logging system: Log entry and controller.
  */
@@ -6,60 +6,49 @@
 #pragma once
 
 #include <chrono>
+#include <format>
+#include <optional>
 #include <string>
 
-namespace Common::Log {
-
-class LOG_SESSION_BASE;
+#include "logfield.hpp"
+#include "loglevel.hpp"
+#include "logmsg.hpp"
+#include "logrec.hpp"
+#include "logsessn.hpp"
+#include "logsite.hpp"
+#include "logtime.hpp"
 
-enum class LOG_LEVEL {
-    Critical,
-    Error,
-    Warning,
-    Info,
-    Verbose
-};
-
-/**
- * @brief Converts log level to a string representation.
- * @param LogLevel The log level to convert.
- * @return A string representation of the log level.
- */
-inline
-std::wstring
-LogLevelAsString(
-    const LOG_LEVEL LogLevel
-)
-{
-    switch (LogLevel) {
-
-    case LOG_LEVEL::Critical:
-        return L"Critical";
-    case LOG_LEVEL::Error:
-        return L"Error";
-    case LOG_LEVEL::Warning:
-        return L"Warning";
-    case LOG_LEVEL::Info:
-        return L"Info";
-    case LOG_LEVEL::Verbose:
-        return L"Verbose";
-    }
-
-    return {};
-}
+namespace Common::Log {
 
 /**
  * @brief Represents an individual log entry.
  */
 class LOG_ENTRY {
 public:
-    std::wstring LogData;
+    /**
+     * @brief Returns the message of the entry, formatting a deferred record if present.
+     */
+    std::wstring
+    RenderMessage() const;
+
+    /**
+     * @brief Appends the message of the entry to a string.
+     * @param Output The string to append the message to.
+     */
+    void
+    RenderMessage(
+        std::wstring &Output
+    ) const;
+
+    LOG_MESSAGE LogData;
+    LOG_RECORD LogRecord;
     LOG_LEVEL LogLevel;
     const wchar_t *SourceFileName;
     const wchar_t *FunctionName;
     int SourceLine;
-    std::chrono::system_clock::time_point LogTimestamp;
+    LOG_TIMESTAMP LogTimestamp;
     std::optional<unsigned int> HResult;
+    LOG_FIELDS Fields;
 };
 
 /**
@@ -86,9 +75,26 @@ public:
      */
     LOG_CONTROLLER &
     Error(
-        std::wstring Message
+        std::wstring_view Message
     );
 
+    /**
+     * @brief Records an error-level log message with deferred formatting.
+     * @param Format The format string, which must be a string literal.
+     * @param First, Rest The format arguments.
+     * @return Reference to the current log controller.
+     */
+    template<class FIRST, class... REST>
+    LOG_CONTROLLER &
+    Error(
+        std::wformat_string<FIRST, REST...> Format,
+        FIRST &&First,
+        REST &&...Rest
+    )
+    {
+        return Capture(LOG_LEVEL::Error, Format.get(), First, Rest...);
+    }
+
     /**
      * @brief Records a warning-level log message.
      * @param Message The warning message to be logged.
@@ -96,9 +102,26 @@ public:
      */
     LOG_CONTROLLER &
     Warning(
-        std::wstring Message
+        std::wstring_view Message
     );
 
+    /**
+     * @brief Records a warning-level log message with deferred formatting.
+     * @param Format The format string, which must be a string literal.
+     * @param First, Rest The format arguments.
+     * @return Reference to the current log controller.
+     */
+    template<class FIRST, class... REST>
+    LOG_CONTROLLER &
+    Warning(
+        std::wformat_string<FIRST, REST...> Format,
+        FIRST &&First,
+        REST &&...Rest
+    )
+    {
+        return Capture(LOG_LEVEL::Warning, Format.get(), First, Rest...);
+    }
+
     /**
      * @brief Records an info-level log message.
      * @param Message The info message to be logged.
@@ -106,9 +129,27 @@ public:
      */
     LOG_CONTROLLER &
     Info(
-        std::wstring Message
+        std::wstring_view Message
     );
 
+    /**
+     * @brief Records an info-level log message with deferred formatting.
+     * For example: LOG.Info(L"pid {} opened {}", pid, path);
+     * @param Format The format string, which must be a string literal.
+     * @param First, Rest The format arguments.
+     * @return Reference to the current log controller.
+     */
+    template<class FIRST, class... REST>
+    LOG_CONTROLLER &
+    Info(
+        std::wformat_string<FIRST, REST...> Format,
+        FIRST &&First,
+        REST &&...Rest
+    )
+    {
+        return Capture(LOG_LEVEL::Info, Format.get(), First, Rest...);
+    }
+
     /**
      * @brief Records a critical-level log message.
      * @param Message The critical message to be logged.
@@ -116,9 +157,26 @@ public:
      */
     LOG_CONTROLLER &
     Critical(
-        std::wstring Message
+        std::wstring_view Message
     );
 
+    /**
+     * @brief Records a critical-level log message with deferred formatting.
+     * @param Format The format string, which must be a string literal.
+     * @param First, Rest The format arguments.
+     * @return Reference to the current log controller.
+     */
+    template<class FIRST, class... REST>
+    LOG_CONTROLLER &
+    Critical(
+        std::wformat_string<FIRST, REST...> Format,
+        FIRST &&First,
+        REST &&...Rest
+    )
+    {
+        return Capture(LOG_LEVEL::Critical, Format.get(), First, Rest...);
+    }
+
     /**
      * @brief Records a verbose-level log message.
      * @param Message The verbose message to be logged.
@@ -126,9 +184,26 @@ public:
      */
     LOG_CONTROLLER &
     Verbose(
-        std::wstring Message
+        std::wstring_view Message
     );
 
+    /**
+     * @brief Records a verbose-level log message with deferred formatting.
+     * @param Format The format string, which must be a string literal.
+     * @param First, Rest The format arguments.
+     * @return Reference to the current log controller.
+     */
+    template<class FIRST, class... REST>
+    LOG_CONTROLLER &
+    Verbose(
+        std::wformat_string<FIRST, REST...> Format,
+        FIRST &&First,
+        REST &&...Rest
+    )
+    {
+        return Capture(LOG_LEVEL::Verbose, Format.get(), First, Rest...);
+    }
+
     /**
      * @brief Associates a log session with the controller.
      * @param Session The log session to associate.
@@ -146,25 +221,120 @@ public:
 
     LOG_CONTROLLER &
     WithMessage(
-        std::wstring Message
+        std::wstring_view Message
     );
 
     LOG_CONTROLLER &
     Hr();
 
+    /**
+     * @brief Attaches a typed field to the entry. Fields are stored in
+     * binary form and only converted to text by the formatter.
+     * For example: LOG_INFO(L"Process opened").With("pid", pid).With("handle", handle);
+     * @param Key The field name, a string literal.
+     * @param Value An integer, enumeration, bool, pointer, wide or narrow
+     * string, or std::chrono::duration.
+     * @return Reference to the current log controller.
+     */
+    template<LOG_FIELD_VALUE T>
+    LOG_CONTROLLER &
+    With(
+        LOG_FIELD_KEY Key,
+        const T &Value
+    )
+    {
+        Fields.Add(Key, Value);
+        return *this;
+    }
+
+    /**
+     * @brief Marks the entry as coming from a call site that has already been
+     * filtered, so the session minimum level is not applied again.
+     * @param Site The log call site.
+     * @return Reference to the current log controller.
+     */
+    LOG_CONTROLLER &
+    FromSite(
+        LOG_SITE &Site
+    );
+
     ~LOG_CONTROLLER();
 
 private:
+    /**
+     * @brief Stores the format string and arguments in the log record, or
+     * formats them immediately if they cannot be deferred.
+     */
+    template<class... ARGS>
+    LOG_CONTROLLER &
+    Capture(
+        LOG_LEVEL Level,
+        std::wstring_view Format,
+        const ARGS &...Arguments
+    )
+    {
+        LogLevel = Level;
+        if (!LogRecord.Capture(Format, Arguments...)) {
+            LogData = std::vformat(Format, std::make_wformat_args(Arguments...));
+        }
+        return *this;
+    }
+
     LOG_SESSION_BASE *LogSession_ = nullptr;
+    LOG_SITE *LogSite_ = nullptr;
 };
 
 LOG_SESSION_BASE *
 GetDefaultSession();
 
+/**
+ * @brief Checks whether a LOG_<LEVEL> call site must be logged.
+ * @param Level The log level of the call site.
+ * @param Site The log call site.
+ */
+inline
+bool
+IsLogEnabled(
+    LOG_LEVEL Level,
+    LOG_SITE &Site
+)
+{
+    return Site.IsForced() || GetDefaultSession()->IsLevelEnabled(Level);
+}
+
 /*!
  * @brief Basic macro for chain logging.
  * For example: LOG.Error("My error message");
  */
 #define LOG Common::Log::LOG_CONTROLLER{ __FILEW__, __FUNCTIONW__, __LINE__ }.InSession(Common::Log::GetDefaultSession())
 
+/*!
+ * @brief Level-specific logging macros. The level is checked before any
+ * argument is evaluated, levels below NTECTIVE_LOG_LEVEL_FLOOR are removed at
+ * compile time and each expansion can be switched on at runtime through the
+ * log site registry.
+ * For example: LOG_VERBOSE(L"pid {} opened {}", pid, path).Hr();
+ */
+#define LOG_CRITICAL(...)   Common_Log_LOG_AT_(Critical, __VA_ARGS__)
+#define LOG_ERROR(...)      Common_Log_LOG_AT_(Error, __VA_ARGS__)
+#define LOG_WARNING(...)    Common_Log_LOG_AT_(Warning, __VA_ARGS__)
+#define LOG_INFO(...)       Common_Log_LOG_AT_(Info, __VA_ARGS__)
+#define LOG_VERBOSE(...)    Common_Log_LOG_AT_(Verbose, __VA_ARGS__)
+
+/*
+ * The switch makes the expansion a single statement, so an else after the
+ * macro binds to the caller's if, while the controller expression at the
+ * end stays open for chained calls such as .Hr().
+ */
+#define Common_Log_LOG_AT_(Level, ...)                                                          \
+    switch (0) case 0: default:                                                                 \
+    if constexpr (!Common::Log::IsLevelCompiled(Common::Log::LOG_LEVEL::Level)) {               \
+    } else if (static constinit Common::Log::LOG_SITE logSite_{__FILEW__, __LINE__};            \
+               !Common::Log::IsLogEnabled(Common::Log::LOG_LEVEL::Level, logSite_)) {           \
+    } else                                                                                      \
+        Common::Log::LOG_CONTROLLER{__FILEW__, __FUNCTIONW__, __LINE__}                         \
+            .InSession(Common::Log::GetDefaultSession())                                        \
+            .FromSite(logSite_)                                                                 \
+            .Level(__VA_ARGS__)
+
 };
@@ -0,0 +1,189 @@
+﻿/*!
+ *  @file       logbfmt.hpp
+ *  @brief      Logging system: Binary log file format.
+ *  @details    Shared by BINARY_LOG_PROVIDER_IMPL and the offline tools, so
+ *              this header only depends on the standard library.
+ *
+ *              A binary log file is a sequence of records. Every record
+ *              starts with a LOG_BINARY_RECORD_HEADER, holds the fixed
+ *              layout of its kind and is followed by its payload, padded to
+ *              LogBinaryAlignment bytes. All integers are little-endian and
+ *              all text is UTF-8.
+ *
+ *              Every writer starts with a Begin record. The identifiers of
+ *              strings, sites, zones and HRESULT descriptions are defined
+ *              by records that precede their first use and are valid up to
+ *              the next Begin record, so a file appended to by several runs
+ *              stays readable.
+ *
+ *              Version 2 adds the field block of Entry records, which
+ *              version 1 writers leave empty.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "loglevel.hpp"
+
+namespace Common::Log {
+
+inline constexpr char LogBinaryMagic[4] = {'N', 'T', 'L', 'B'};
+inline constexpr std::uint32_t LogBinaryVersion = 2;
+inline constexpr std::uint32_t LogBinaryAlignment = 8;
+
+/*!
+ * Resolution of record timestamps, which count ticks since the Unix epoch.
+ */
+inline constexpr std::int64_t LogBinaryTicksPerSecond = 10'000'000;
+
+enum class LOG_BINARY_RECORD_KIND : std::uint16_t {
+    Begin = 1,
+    String,
+    Site,
+    Zone,
+    Hresult,
+    Entry
+};
+
+class LOG_BINARY_RECORD_HEADER {
+public:
+    /*!
+     * Size of the record including the header, the payload and the padding.
+     */
+    std::uint32_t Size;
+    LOG_BINARY_RECORD_KIND Kind;
+    std::uint16_t Reserved;
+};
+
+/**
+ * @brief Starts the output of a writer and resets all identifiers.
+ */
+class LOG_BINARY_BEGIN {
+public:
+    static constexpr auto Kind = LOG_BINARY_RECORD_KIND::Begin;
+
+    LOG_BINARY_RECORD_HEADER Header;
+    char Magic[4];
+    std::uint32_t Version;
+    std::int64_t Timestamp;
+};
+
+/**
+ * @brief Defines an interned string. Followed by Length bytes of UTF-8 text.
+ */
+class LOG_BINARY_STRING {
+public:
+    static constexpr auto Kind = LOG_BINARY_RECORD_KIND::String;
+
+    LOG_BINARY_RECORD_HEADER Header;
+    std::uint32_t StringId;
+    std::uint32_t Length;
+};
+
+/**
+ * @brief Defines a source site: a source file, function and line.
+ */
+class LOG_BINARY_SITE {
+public:
+    static constexpr auto Kind = LOG_BINARY_RECORD_KIND::Site;
+
+    LOG_BINARY_RECORD_HEADER Header;
+    std::uint32_t SiteId;
+    std::uint32_t FileStringId;
+    std::uint32_t FunctionStringId;
+    std::int32_t Line;
+};
+
+/**
+ * @brief Defines a time zone state: the UTC offset and abbreviation that
+ * the writer rendered timestamps with.
+ */
+class LOG_BINARY_ZONE {
+public:
+    static constexpr auto Kind = LOG_BINARY_RECORD_KIND::Zone;
+
+    LOG_BINARY_RECORD_HEADER Header;
+    std::uint32_t ZoneId;
+    std::int32_t OffsetSeconds;
+    std::uint32_t AbbreviationStringId;
+    std::uint32_t Reserved;
+};
+
+/**
+ * @brief Defines the system description of an HRESULT.
+ */
+class LOG_BINARY_HRESULT {
+public:
+    static constexpr auto Kind = LOG_BINARY_RECORD_KIND::Hresult;
+
+    LOG_BINARY_RECORD_HEADER Header;
+    std::uint32_t Hresult;
+    std::uint32_t DescriptionStringId;
+};
+
+enum LOG_BINARY_ENTRY_FLAGS : std::uint8_t {
+    LogBinaryEntryHasHresult = 0x01,
+    LogBinaryEntryFieldsTruncated = 0x02 /*!< The entry had more fields than it holds. */
+};
+
+/**
+ * @brief Header of a typed field in the field block of an entry. Type holds
+ * a LOG_FIELD_TYPE value. Followed by Size bytes of value: UTF-8 text for
+ * the string types, a 64-bit integer for the others. Fields are packed
+ * without padding, so readers copy headers and values out of the block.
+ */
+class LOG_BINARY_FIELD {
+public:
+    std::uint32_t KeyStringId;
+    std::uint8_t Type;
+    std::uint8_t Reserved;
+    std::uint16_t Size;
+};
+
+/**
+ * @brief A log entry. Level holds a LOG_LEVEL value. Followed by
+ * MessageLength bytes of UTF-8 text and a field block of FieldsLength
+ * bytes, a sequence of LOG_BINARY_FIELD.
+ */
+class LOG_BINARY_ENTRY {
+public:
+    static constexpr auto Kind = LOG_BINARY_RECORD_KIND::Entry;
+
+    LOG_BINARY_RECORD_HEADER Header;
+    std::int64_t Timestamp;
+    std::uint32_t SiteId;
+    std::uint32_t ZoneId;
+    std::uint32_t Hresult;
+    std::uint8_t Level;
+    std::uint8_t Flags;
+    std::uint8_t Reserved[2];
+    std::uint32_t MessageLength;
+    std::uint32_t FieldsLength;
+};
+
+static_assert(sizeof(LOG_BINARY_RECORD_HEADER) == 8);
+static_assert(sizeof(LOG_BINARY_BEGIN) == 24);
+static_assert(sizeof(LOG_BINARY_STRING) == 16);
+static_assert(sizeof(LOG_BINARY_SITE) == 24);
+static_assert(sizeof(LOG_BINARY_ZONE) == 24);
+static_assert(sizeof(LOG_BINARY_HRESULT) == 16);
+static_assert(sizeof(LOG_BINARY_FIELD) == 8);
+static_assert(sizeof(LOG_BINARY_ENTRY) == 40);
+
+/**
+ * @brief Returns the size of a record with the specified payload, including padding.
+ */
+template<class RECORD>
+constexpr
+std::uint32_t
+LogBinaryRecordSize(
+    std::size_t PayloadSize
+)
+{
+    const auto size = sizeof(RECORD) + PayloadSize;
+    return static_cast<std::uint32_t>((size + LogBinaryAlignment - 1) / LogBinaryAlignment * LogBinaryAlignment);
+}
+
+}
@@ -0,0 +1,303 @@
+﻿/*!
+ *  @file       logbin.cpp
+ *  @brief      Logging system: Binary log provider.
+ */
+
+#include "logbin.hpp"
+
+#include <cstring>
+
+#include "log.hpp"
+#include "strutil.hpp"
+
+namespace Common::Log {
+
+namespace {
+
+using BINARY_TICKS = std::chrono::duration<std::int64_t, std::ratio<1, LogBinaryTicksPerSecond>>;
+
+std::int64_t
+ToBinaryTimestamp(
+    std::chrono::system_clock::time_point Timestamp
+)
+{
+    return std::chrono::duration_cast<BINARY_TICKS>(Timestamp.time_since_epoch()).count();
+}
+
+}
+
+BINARY_LOG_PROVIDER_IMPL::BINARY_LOG_PROVIDER_IMPL(
+    const std::filesystem::path &Path,
+    LOG_LEVEL FlushLevel
+) : FlushLevel_(FlushLevel)
+{
+    create_directories(Path.parent_path());
+
+    std::error_code error;
+    const auto size = file_size(Path, error);
+
+    File_.open(Path, std::ios::binary | std::ios::app);
+
+    /* Realign after a record cut short by a crash, readers resynchronize on the Begin record. */
+    if (!error && size % LogBinaryAlignment != 0) {
+        constexpr char padding[LogBinaryAlignment] = {};
+        File_.write(padding, static_cast<std::streamsize>(LogBinaryAlignment - size % LogBinaryAlignment));
+    }
+
+    LOG_BINARY_BEGIN begin{};
+    std::memcpy(begin.Magic, LogBinaryMagic, sizeof(LogBinaryMagic));
+    begin.Version = LogBinaryVersion;
+    begin.Timestamp = ToBinaryTimestamp(std::chrono::system_clock::now());
+    WriteRecord(begin);
+}
+
+BINARY_LOG_PROVIDER_IMPL::~BINARY_LOG_PROVIDER_IMPL()
+{
+    File_.flush();
+}
+
+void
+BINARY_LOG_PROVIDER_IMPL::Write(
+    const LOG_ENTRY &LogEntry
+)
+{
+    /*
+     * FormatHresult may log a warning itself, so the description of an
+     * HRESULT that is seen for the first time is looked up without the lock.
+     */
+    std::wstring hresultDescription;
+    if (LogEntry.HResult) {
+        bool known;
+        {
+            std::lock_guard lock{Lock_};
+            known = Hresults_.contains(*LogEntry.HResult);
+        }
+        if (!known) {
+            hresultDescription = LOG_FORMATTER::FormatHresult(*LogEntry.HResult);
+        }
+    }
+
+    std::lock_guard lock{Lock_};
+
+    const auto timestamp = LogEntry.LogTimestamp.ToTimePoint();
+
+    LOG_BINARY_ENTRY entry{};
+    entry.Timestamp = ToBinaryTimestamp(timestamp);
+    entry.SiteId = InternSite(LogEntry);
+    entry.ZoneId = InternZone(timestamp);
+    entry.Level = static_cast<std::uint8_t>(LogEntry.LogLevel);
+
+    if (LogEntry.HResult) {
+        if (!Hresults_.contains(*LogEntry.HResult)) {
+            LOG_BINARY_HRESULT hresult{};
+            hresult.Hresult = *LogEntry.HResult;
+            hresult.DescriptionStringId = InternText(hresultDescription);
+            WriteRecord(hresult);
+            Hresults_.emplace(hresult.Hresult, hresult.DescriptionStringId);
+        }
+
+        entry.Hresult = *LogEntry.HResult;
+        entry.Flags |= LogBinaryEntryHasHresult;
+    }
+
+    Message_.clear();
+    LogEntry.RenderMessage(Message_);
+    Utf8_.clear();
+    Util::AppendUtf8(Message_, Utf8_);
+    entry.MessageLength = static_cast<std::uint32_t>(Utf8_.size());
+
+    /* Keys are interned before the entry, their string records must precede it. */
+    AppendFields(LogEntry.Fields);
+    entry.FieldsLength = static_cast<std::uint32_t>(Utf8_.size() - entry.MessageLength);
+    if (LogEntry.Fields.IsTruncated()) {
+        entry.Flags |= LogBinaryEntryFieldsTruncated;
+    }
+
+    WriteRecord(entry, Utf8_);
+
+    if (LogEntry.LogLevel <= FlushLevel_) {
+        File_.flush();
+    }
+}
+
+void
+BINARY_LOG_PROVIDER_IMPL::Flush()
+{
+    std::lock_guard lock{Lock_};
+    File_.flush();
+}
+
+void
+BINARY_LOG_PROVIDER_IMPL::RegisterFormatter(
+    std::shared_ptr<LOG_FORMATTER_BASE>
+)
+{
+}
+
+template<class RECORD>
+void
+BINARY_LOG_PROVIDER_IMPL::WriteRecord(
+    RECORD &Record,
+    std::string_view Payload
+)
+{
+    constexpr char padding[LogBinaryAlignment] = {};
+
+    Record.Header.Size = LogBinaryRecordSize<RECORD>(Payload.size());
+    Record.Header.Kind = RECORD::Kind;
+
+    File_.write(reinterpret_cast<const char *>(&Record), sizeof(RECORD));
+    File_.write(Payload.data(), static_cast<std::streamsize>(Payload.size()));
+    File_.write(padding, static_cast<std::streamsize>(Record.Header.Size - sizeof(RECORD) - Payload.size()));
+}
+
+std::uint32_t
+BINARY_LOG_PROVIDER_IMPL::InternString(
+    const wchar_t *String
+)
+{
+    /* Source file and function names are literals, their address identifies them. */
+    if (const auto iterator = StringsByAddress_.find(String); iterator != StringsByAddress_.end()) {
+        return iterator->second;
+    }
+
+    const auto stringId = InternText(String ? std::wstring_view{String} : std::wstring_view{});
+    StringsByAddress_.emplace(String, stringId);
+    return stringId;
+}
+
+std::uint32_t
+BINARY_LOG_PROVIDER_IMPL::InternText(
+    std::wstring_view Text
+)
+{
+    std::string utf8;
+    Util::AppendUtf8(Text, utf8);
+    return InternUtf8(std::move(utf8));
+}
+
+std::uint32_t
+BINARY_LOG_PROVIDER_IMPL::InternUtf8(
+    std::string Text
+)
+{
+    const auto [iterator, inserted] = Strings_.try_emplace(std::move(Text),
+                                                           static_cast<std::uint32_t>(Strings_.size()));
+
+    if (inserted) {
+        LOG_BINARY_STRING string{};
+        string.StringId = iterator->second;
+        string.Length = static_cast<std::uint32_t>(iterator->first.size());
+        WriteRecord(string, iterator->first);
+    }
+
+    return iterator->second;
+}
+
+std::uint32_t
+BINARY_LOG_PROVIDER_IMPL::InternKey(
+    std::string_view Key
+)
+{
+    /* Keys are literals like source file names, see InternString. */
+    const auto address = std::make_pair(Key.data(), Key.size());
+
+    if (const auto iterator = KeysByAddress_.find(address); iterator != KeysByAddress_.end()) {
+        return iterator->second;
+    }
+
+    const auto stringId = InternUtf8(std::string{Key});
+    KeysByAddress_.emplace(address, stringId);
+    return stringId;
+}
+
+void
+BINARY_LOG_PROVIDER_IMPL::AppendFields(
+    const LOG_FIELDS &Fields
+)
+{
+    Fields.ForEach([this](const LOG_FIELD &Field) {
+        const auto headerOffset = Utf8_.size();
+        Utf8_.resize(headerOffset + sizeof(LOG_BINARY_FIELD));
+
+        switch (Field.Type) {
+        case LOG_FIELD_TYPE::WideString:
+            Util::AppendUtf8(Field.WideString, Utf8_);
+            break;
+        case LOG_FIELD_TYPE::NarrowString:
+            Utf8_ += Field.NarrowString;
+            break;
+        default:
+            Utf8_.append(reinterpret_cast<const char *>(&Field.Integer), sizeof(Field.Integer));
+            break;
+        }
+
+        /* A LOG_FIELDS string holds at most LOG_FIELDS::Capacity UTF-16 units, which always fit. */
+        LOG_BINARY_FIELD field{};
+        field.KeyStringId = InternKey(Field.Key);
+        field.Type = static_cast<std::uint8_t>(Field.Type);
+        field.Size = static_cast<std::uint16_t>(Utf8_.size() - headerOffset - sizeof(LOG_BINARY_FIELD));
+        std::memcpy(Utf8_.data() + headerOffset, &field, sizeof(field));
+    });
+}
+
+std::uint32_t
+BINARY_LOG_PROVIDER_IMPL::InternSite(
+    const LOG_ENTRY &LogEntry
+)
+{
+    const auto key = std::make_tuple(LogEntry.SourceFileName, LogEntry.FunctionName, LogEntry.SourceLine);
+
+    if (const auto iterator = Sites_.find(key); iterator != Sites_.end()) {
+        return iterator->second;
+    }
+
+    LOG_BINARY_SITE site{};
+    site.SiteId = static_cast<std::uint32_t>(Sites_.size());
+    site.FileStringId = InternString(LogEntry.SourceFileName);
+    site.FunctionStringId = InternString(LogEntry.FunctionName);
+    site.Line = LogEntry.SourceLine;
+    WriteRecord(site);
+
+    Sites_.emplace(key, site.SiteId);
+    return site.SiteId;
+}
+
+std::uint32_t
+BINARY_LOG_PROVIDER_IMPL::InternZone(
+    std::chrono::system_clock::time_point Timestamp
+)
+{
+    using namespace std::chrono;
+
+    const auto second = floor<seconds>(Timestamp);
+
+    if (!Zones_.empty()) {
+        const auto &zone = Zones_[CurrentZone_];
+        if (second >= zone.Begin && second < zone.End) {
+            return zone.ZoneId;
+        }
+    }
+
+    for (std::size_t i = 0; i < Zones_.size(); ++i) {
+        if (second >= Zones_[i].Begin && second < Zones_[i].End) {
+            CurrentZone_ = i;
+            return Zones_[i].ZoneId;
+        }
+    }
+
+    const sys_info info = current_zone()->get_info(second);
+
+    LOG_BINARY_ZONE zone{};
+    zone.ZoneId = static_cast<std::uint32_t>(Zones_.size());
+    zone.OffsetSeconds = static_cast<std::int32_t>(info.offset.count());
+
+    zone.AbbreviationStringId = InternText(std::wstring{info.abbrev.begin(), info.abbrev.end()});
+    WriteRecord(zone);
+
+    Zones_.push_back(ZONE{info.begin, info.end, zone.ZoneId});
+    CurrentZone_ = Zones_.size() - 1;
+    return zone.ZoneId;
+}
+
+}
@@ -0,0 +1,144 @@
+﻿/*!
+ *  @file       logbin.hpp
+ *  @brief      Logging system: Binary log provider.
+ */
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <utility>
+#include <unordered_map>
+#include <vector>
+
+#include "logbfmt.hpp"
+#include "logfield.hpp"
+#include "logprov.hpp"
+
+namespace Common::Log {
+
+/**
+ * @brief Log provider that writes log entries in the binary log format.
+ * @details Entries are stored unformatted with fixed-layout headers, source
+ * file and function names and field keys are written once per run to an
+ * interned string table, and typed fields keep their binary values. The format is described in logbfmt.hpp, the logq tool indexes,
+ * queries and renders these files back to the LOG_FORMATTER text layout.
+ */
+class BINARY_LOG_PROVIDER_IMPL : public LOG_PROVIDER_BASE {
+public:
+    /**
+     * @brief Constructs a binary log provider with the specified file path.
+     * @param Path The path to the log file. Entries are appended if the file exists.
+     * @param FlushLevel Entries of this level or more severe are flushed to the file immediately.
+     */
+    BINARY_LOG_PROVIDER_IMPL(
+        const std::filesystem::path &Path,
+        LOG_LEVEL FlushLevel = LOG_LEVEL::Error
+    );
+
+    ~BINARY_LOG_PROVIDER_IMPL() override;
+
+    void
+    Write(
+        const LOG_ENTRY &LogEntry
+    ) override;
+
+    void
+    Flush() override;
+
+    /**
+     * @brief Ignored, entries are stored unformatted.
+     */
+    void
+    RegisterFormatter(
+        std::shared_ptr<LOG_FORMATTER_BASE> LogFormatter
+    ) override;
+
+private:
+    template<class RECORD>
+    void
+    WriteRecord(
+        RECORD &Record,
+        std::string_view Payload = {}
+    );
+
+    /**
+     * @brief Interns a string by address, falling back to its content.
+     */
+    std::uint32_t
+    InternString(
+        const wchar_t *String
+    );
+
+    std::uint32_t
+    InternSite(
+        const LOG_ENTRY &LogEntry
+    );
+
+    std::uint32_t
+    InternZone(
+        std::chrono::system_clock::time_point Timestamp
+    );
+
+    /**
+     * @brief Interns a string by content.
+     */
+    std::uint32_t
+    InternText(
+        std::wstring_view Text
+    );
+
+    /**
+     * @brief Interns UTF-8 text by content.
+     */
+    std::uint32_t
+    InternUtf8(
+        std::string Text
+    );
+
+    /**
+     * @brief Interns a field key by address, falling back to its content.
+     */
+    std::uint32_t
+    InternKey(
+        std::string_view Key
+    );
+
+    /**
+     * @brief Appends the field block of an entry to Utf8_.
+     */
+    void
+    AppendFields(
+        const LOG_FIELDS &Fields
+    );
+
+    class ZONE {
+    public:
+        std::chrono::sys_seconds Begin;
+        std::chrono::sys_seconds End;
+        std::uint32_t ZoneId;
+    };
+
+    std::mutex Lock_;
+    std::ofstream File_;
+    LOG_LEVEL FlushLevel_;
+    std::wstring Message_;
+    std::string Utf8_;
+    std::unordered_map<const wchar_t *, std::uint32_t> StringsByAddress_;
+    std::map<std::pair<const char *, std::size_t>, std::uint32_t> KeysByAddress_;
+    std::unordered_map<std::string, std::uint32_t> Strings_;
+    std::map<std::tuple<const wchar_t *, const wchar_t *, int>, std::uint32_t> Sites_;
+    std::unordered_map<unsigned int, std::uint32_t> Hresults_;
+    std::vector<ZONE> Zones_;
+    std::size_t CurrentZone_ = 0;
+};
+
+}
@@ -0,0 +1,163 @@
+﻿/*!
+ *  @file       logchan.cpp
+ *  @brief      Logging system: Per-provider delivery channel.
+ */
+
+#include "logchan.hpp"
+
+#include <array>
+
+#include "logprov.hpp"
+
+namespace Common::Log {
+
+LOG_DELIVERY_CHANNEL::LOG_DELIVERY_CHANNEL(
+    std::shared_ptr<LOG_PROVIDER_BASE> LogProvider,
+    LOG_DELIVERY_POLICY DeliveryPolicy
+) : LogProvider_(std::move(LogProvider)),
+    OverflowPolicy_(DeliveryPolicy.OverflowPolicy),
+    Concurrent_(DeliveryPolicy.Concurrent)
+{
+    if (DeliveryPolicy.Capacity != 0) {
+        Ring_ = std::make_unique<Util::BOUNDED_RING<LOG_ENTRY>>(DeliveryPolicy.Capacity);
+        WorkerThread_ = std::thread{&LOG_DELIVERY_CHANNEL::WorkerLoop, this};
+    }
+}
+
+LOG_DELIVERY_CHANNEL::~LOG_DELIVERY_CHANNEL()
+{
+    Stopping_.store(true, std::memory_order_release);
+
+    if (WorkerThread_.joinable()) {
+        WakeEpoch_.fetch_add(1, std::memory_order_release);
+        WakeEpoch_.notify_one();
+        WorkerThread_.join();
+    }
+
+    Flush();
+}
+
+void
+LOG_DELIVERY_CHANNEL::Write(
+    LOG_ENTRY &LogEntry
+)
+{
+    if (!Ring_ && Concurrent_) {
+        LogProvider_->Write(LogEntry);
+        return;
+    }
+
+    /*
+     * Entries logged by the provider itself, or after the worker has
+     * stopped, are written synchronously. Queueing them could block the
+     * worker on its own queue.
+     */
+    if (!Ring_ ||
+        std::this_thread::get_id() == WorkerThread_.get_id() ||
+        Stopping_.load(std::memory_order_acquire)) {
+        std::lock_guard lock{DeliveryLock_};
+        LogProvider_->Write(LogEntry);
+        return;
+    }
+
+    switch (OverflowPolicy_) {
+
+    case LOG_OVERFLOW_POLICY::Block:
+        while (!Ring_->TryPush(std::move(LogEntry))) {
+            WakeWorker();
+            std::this_thread::yield();
+        }
+        break;
+
+    case LOG_OVERFLOW_POLICY::DropNewest:
+        if (!Ring_->TryPush(std::move(LogEntry))) {
+            DroppedCount_.fetch_add(1, std::memory_order_relaxed);
+        }
+        break;
+
+    case LOG_OVERFLOW_POLICY::DropOldest:
+        while (!Ring_->TryPush(std::move(LogEntry))) {
+            LOG_ENTRY discarded;
+            if (Ring_->TryPop(discarded)) {
+                DroppedCount_.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+        break;
+    }
+
+    WakeWorker();
+}
+
+void
+LOG_DELIVERY_CHANNEL::Flush()
+{
+    std::lock_guard lock{DeliveryLock_};
+
+    if (Ring_) {
+        while (DrainBatch()) {
+        }
+    }
+
+    LogProvider_->Flush();
+}
+
+void
+LOG_DELIVERY_CHANNEL::WorkerLoop()
+{
+    for (;;) {
+        if (DrainBatch()) {
+            continue;
+        }
+
+        if (Stopping_.load(std::memory_order_acquire)) {
+            break;
+        }
+
+        /*
+         * Announce the idle state before the final emptiness check. Paired
+         * with the fence in WakeWorker, either the producer observes the
+         * idle flag or this thread observes the pushed entry.
+         */
+        const auto epoch = WakeEpoch_.load(std::memory_order_acquire);
+        WorkerIdle_.store(true, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+
+        if (Ring_->IsEmpty() && !Stopping_.load(std::memory_order_acquire)) {
+            WakeEpoch_.wait(epoch, std::memory_order_acquire);
+        }
+
+        WorkerIdle_.store(false, std::memory_order_relaxed);
+    }
+}
+
+std::size_t
+LOG_DELIVERY_CHANNEL::DrainBatch()
+{
+    std::array<LOG_ENTRY, BatchSize> batch;
+    std::size_t count = 0;
+
+    std::lock_guard lock{DeliveryLock_};
+
+    while (count < batch.size() && Ring_->TryPop(batch[count])) {
+        ++count;
+    }
+
+    for (std::size_t i = 0; i < count; ++i) {
+        LogProvider_->Write(batch[i]);
+    }
+
+    return count;
+}
+
+void
+LOG_DELIVERY_CHANNEL::WakeWorker()
+{
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+
+    if (WorkerIdle_.load(std::memory_order_relaxed)) {
+        WakeEpoch_.fetch_add(1, std::memory_order_release);
+        WakeEpoch_.notify_one();
+    }
+}
+
+}
@@ -0,0 +1,120 @@
+﻿/*!
+ *  @file       logchan.hpp
+ *  @brief      Logging system: Per-provider delivery channel.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include "log.hpp"
+#include "logsessn.hpp"
+#include "ring.hpp"
+
+namespace Common::Log {
+
+/**
+ * @brief Delivers log entries to a single provider.
+ * @details A queued channel owns a bounded lock-free ring and a worker
+ * thread that writes the entries to the provider in batches. Producers only
+ * move the entry into the ring and wake the worker if it announced that it
+ * is idle. A channel with a capacity of 0 writes the entries on the logging
+ * thread. The provider is only called
+ * under the delivery lock of the channel, by the worker, by Flush or by a
+ * synchronous write, except for the synchronous writes of a concurrent
+ * channel, which call it directly.
+ */
+class LOG_DELIVERY_CHANNEL {
+public:
+    /**
+     * @brief Constructs a delivery channel and starts its worker.
+     * @param LogProvider The provider the entries are written to.
+     * @param DeliveryPolicy The queue capacity and overflow policy.
+     */
+    LOG_DELIVERY_CHANNEL(
+        std::shared_ptr<LOG_PROVIDER_BASE> LogProvider,
+        LOG_DELIVERY_POLICY DeliveryPolicy
+    );
+
+    LOG_DELIVERY_CHANNEL(const LOG_DELIVERY_CHANNEL &) = delete;
+
+    LOG_DELIVERY_CHANNEL &
+    operator=(const LOG_DELIVERY_CHANNEL &) = delete;
+
+    /**
+     * @brief Stops the worker, delivers the remaining entries and flushes the provider.
+     */
+    ~LOG_DELIVERY_CHANNEL();
+
+    /**
+     * @brief Queues an entry for the provider.
+     * @param LogEntry The entry. It is moved from if it was queued.
+     */
+    void
+    Write(
+        LOG_ENTRY &LogEntry
+    );
+
+    /**
+     * @brief Delivers the queued entries on the calling thread and flushes the provider.
+     */
+    void
+    Flush();
+
+    const std::shared_ptr<LOG_PROVIDER_BASE> &
+    GetProvider() const
+    {
+        return LogProvider_;
+    }
+
+    /**
+     * @brief Checks whether entries are queued, and so moved from by Write.
+     */
+    bool
+    IsQueued() const
+    {
+        return Ring_ != nullptr;
+    }
+
+    /**
+     * @brief Returns the number of entries discarded because the queue was full.
+     */
+    std::uint64_t
+    GetDroppedCount() const
+    {
+        return DroppedCount_.load(std::memory_order_relaxed);
+    }
+
+private:
+    static constexpr std::size_t BatchSize = 32;
+
+    void
+    WorkerLoop();
+
+    /**
+     * @brief Pops up to BatchSize entries and writes them to the provider.
+     * @return The number of delivered entries.
+     */
+    std::size_t
+    DrainBatch();
+
+    void
+    WakeWorker();
+
+    std::shared_ptr<LOG_PROVIDER_BASE> LogProvider_;
+    LOG_OVERFLOW_POLICY OverflowPolicy_;
+    bool Concurrent_;
+    std::unique_ptr<Util::BOUNDED_RING<LOG_ENTRY>> Ring_;
+    std::recursive_mutex DeliveryLock_;
+    std::atomic<std::uint64_t> DroppedCount_ = 0;
+    std::atomic<std::uint32_t> WakeEpoch_ = 0;
+    std::atomic<bool> WorkerIdle_ = false;
+    std::atomic<bool> Stopping_ = false;
+    std::thread WorkerThread_;
+};
+
+}
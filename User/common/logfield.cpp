@@ -0,0 +1,155 @@
+﻿/*!
+ *  @file       logfield.cpp
+ *  @brief      Logging system: Typed key/value fields of a log entry.
+ */
+
+#include "logfield.hpp"
+
+#include <format>
+
+#include "strutil.hpp"
+
+namespace Common::Log {
+
+namespace {
+
+void
+AppendDuration(
+    std::int64_t Nanoseconds,
+    std::wstring &Output
+)
+{
+    const auto magnitude = Nanoseconds < 0 ? -Nanoseconds : Nanoseconds;
+
+    if (magnitude < 1'000) {
+        std::format_to(std::back_inserter(Output), L"{}ns", Nanoseconds);
+    } else if (magnitude < 1'000'000) {
+        std::format_to(std::back_inserter(Output), L"{:.3f}us", Nanoseconds / 1e3);
+    } else if (magnitude < 1'000'000'000) {
+        std::format_to(std::back_inserter(Output), L"{:.3f}ms", Nanoseconds / 1e6);
+    } else {
+        std::format_to(std::back_inserter(Output), L"{:.3f}s", Nanoseconds / 1e9);
+    }
+}
+
+}
+
+void
+LOG_FIELDS::AddInteger(
+    LOG_FIELD_KEY Key,
+    LOG_FIELD_TYPE Type,
+    std::uint64_t Value
+)
+{
+    if (Size_ + AlignedSize(sizeof(Value)) > Capacity) {
+        Truncated_ = true;
+        return;
+    }
+
+    const HEADER header{
+        .Key = Key.View().data(),
+        .KeyLength = static_cast<std::uint16_t>(Key.View().size()),
+        .Type = Type,
+        .Reserved = 0,
+        .Size = sizeof(Value)
+    };
+
+    /* Padding is cleared so that equal fields have equal bytes. */
+    std::memset(Data_ + Size_, 0, AlignedSize(sizeof(Value)));
+    std::memcpy(Data_ + Size_, &header, sizeof(header));
+    std::memcpy(Data_ + Size_ + sizeof(HEADER), &Value, sizeof(Value));
+    Size_ = static_cast<std::uint16_t>(Size_ + AlignedSize(sizeof(Value)));
+}
+
+void
+LOG_FIELDS::AddBytes(
+    LOG_FIELD_KEY Key,
+    LOG_FIELD_TYPE Type,
+    const void *Data,
+    std::size_t Count,
+    std::size_t ElementSize
+)
+{
+    if (Size_ + AlignedSize(0) > Capacity) {
+        Truncated_ = true;
+        return;
+    }
+
+    const auto available = (Capacity - Size_ - sizeof(HEADER)) / ElementSize;
+    if (Count > available) {
+        Count = available;
+        Truncated_ = true;
+    }
+
+    const HEADER header{
+        .Key = Key.View().data(),
+        .KeyLength = static_cast<std::uint16_t>(Key.View().size()),
+        .Type = Type,
+        .Reserved = 0,
+        .Size = static_cast<std::uint32_t>(Count * ElementSize)
+    };
+
+    std::memset(Data_ + Size_, 0, AlignedSize(header.Size));
+    std::memcpy(Data_ + Size_, &header, sizeof(header));
+    std::memcpy(Data_ + Size_ + sizeof(HEADER), Data, header.Size);
+    Size_ = static_cast<std::uint16_t>(Size_ + AlignedSize(header.Size));
+}
+
+void
+LOG_FIELDS::RenderTo(
+    std::wstring &Output
+) const
+{
+    if (IsEmpty()) {
+        return;
+    }
+
+    bool first = true;
+    Output += L" {";
+
+    ForEach([&](const LOG_FIELD &Field) {
+        if (!first) {
+            Output += L", ";
+        }
+        first = false;
+
+        Output.append(Field.Key.begin(), Field.Key.end());
+        Output += L'=';
+
+        switch (Field.Type) {
+        case LOG_FIELD_TYPE::Signed:
+            std::format_to(std::back_inserter(Output), L"{}", static_cast<std::int64_t>(Field.Integer));
+            break;
+        case LOG_FIELD_TYPE::Unsigned:
+            std::format_to(std::back_inserter(Output), L"{}", Field.Integer);
+            break;
+        case LOG_FIELD_TYPE::Bool:
+            Output += Field.Integer ? L"true" : L"false";
+            break;
+        case LOG_FIELD_TYPE::Pointer:
+            std::format_to(std::back_inserter(Output), L"{:#x}", Field.Integer);
+            break;
+        case LOG_FIELD_TYPE::WideString:
+            Output += L'"';
+            Output += Field.WideString;
+            Output += L'"';
+            break;
+        case LOG_FIELD_TYPE::NarrowString:
+            Output += L'"';
+            Util::AppendUtf16(Field.NarrowString, Output);
+            Output += L'"';
+            break;
+        case LOG_FIELD_TYPE::Duration:
+            AppendDuration(static_cast<std::int64_t>(Field.Integer), Output);
+            break;
+        }
+    });
+
+    if (Truncated_) {
+        Output += first ? L"..." : L", ...";
+    }
+
+    Output += L'}';
+}
+
+}
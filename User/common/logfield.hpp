@@ -0,0 +1,260 @@
+﻿/*!
+ *  @file       logfield.hpp
+ *  @brief      Logging system: Typed key/value fields of a log entry.
+ */
+
+#pragma once
+
+#include <chrono>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+namespace Common::Log {
+
+enum class LOG_FIELD_TYPE : std::uint8_t {
+    Signed = 1,
+    Unsigned,
+    Bool,
+    Pointer,
+    WideString,
+    NarrowString,
+    Duration
+};
+
+/**
+ * @brief A field read back from LOG_FIELDS. The views point into the
+ * LOG_FIELDS they were read from.
+ */
+class LOG_FIELD {
+public:
+    std::string_view Key;
+    LOG_FIELD_TYPE Type;
+
+    /*!
+     * Value of the integer types: two's complement for Signed, the address
+     * for Pointer, 0 or 1 for Bool and nanoseconds for Duration.
+     */
+    std::uint64_t Integer;
+
+    std::wstring_view WideString;
+
+    /*!
+     * Expected to hold UTF-8 or plain ASCII text.
+     */
+    std::string_view NarrowString;
+};
+
+/**
+ * @brief Name of a field. Only constructible from a string literal at
+ * compile time, since LOG_FIELDS stores the address of the key rather
+ * than its characters.
+ */
+class LOG_FIELD_KEY {
+public:
+    template<std::size_t N>
+    consteval
+    LOG_FIELD_KEY(
+        const char (&Key)[N]
+    )
+        : Key_(Key)
+    {
+    }
+
+    constexpr
+    std::string_view
+    View() const
+    {
+        return Key_;
+    }
+
+private:
+    std::string_view Key_;
+};
+
+template<class T>
+concept LOG_FIELD_VALUE =
+    std::integral<T> ||
+    std::is_enum_v<T> ||
+    std::is_pointer_v<T> ||
+    std::is_convertible_v<const T &, std::wstring_view> ||
+    std::is_convertible_v<const T &, std::string_view> ||
+    requires(const T &Value) { std::chrono::duration_cast<std::chrono::nanoseconds>(Value); };
+
+/**
+ * @brief Typed key/value fields of a log entry, stored in a fixed inline
+ * buffer so entries stay movable without allocating.
+ * @details Values are stored in their binary form and only converted to
+ * text by the formatter that outputs them. Keys are not copied, like the
+ * format string of LOG_RECORD they are string literals, which
+ * LOG_FIELD_KEY enforces. A string that
+ * does not fit is truncated, a field that does not fit at all is dropped
+ * and the fields are marked truncated.
+ */
+class LOG_FIELDS {
+public:
+    static constexpr std::size_t Capacity = 192;
+
+    /**
+     * @brief Appends a field.
+     * @param Key The field name, a string literal.
+     * @param Value The field value: an integer, enumeration, bool, pointer,
+     * wide or narrow string, or std::chrono::duration.
+     */
+    template<LOG_FIELD_VALUE T>
+    void
+    Add(
+        LOG_FIELD_KEY Key,
+        const T &Value
+    )
+    {
+        if constexpr (std::is_same_v<T, bool>) {
+            AddInteger(Key, LOG_FIELD_TYPE::Bool, Value ? 1 : 0);
+        } else if constexpr (std::is_convertible_v<const T &, std::wstring_view>) {
+            const std::wstring_view text = Value;
+            AddBytes(Key, LOG_FIELD_TYPE::WideString, text.data(), text.size(), sizeof(wchar_t));
+        } else if constexpr (std::is_convertible_v<const T &, std::string_view>) {
+            const std::string_view text = Value;
+            AddBytes(Key, LOG_FIELD_TYPE::NarrowString, text.data(), text.size(), sizeof(char));
+        } else if constexpr (std::is_pointer_v<T>) {
+            AddInteger(Key, LOG_FIELD_TYPE::Pointer, reinterpret_cast<std::uintptr_t>(Value));
+        } else if constexpr (std::is_enum_v<T>) {
+            Add(Key, static_cast<std::underlying_type_t<T>>(Value));
+        } else if constexpr (std::signed_integral<T>) {
+            AddInteger(Key, LOG_FIELD_TYPE::Signed, static_cast<std::uint64_t>(static_cast<std::int64_t>(Value)));
+        } else if constexpr (std::unsigned_integral<T>) {
+            AddInteger(Key, LOG_FIELD_TYPE::Unsigned, static_cast<std::uint64_t>(Value));
+        } else {
+            const auto nanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(Value).count();
+            AddInteger(Key, LOG_FIELD_TYPE::Duration, static_cast<std::uint64_t>(nanoseconds));
+        }
+    }
+
+    /**
+     * @brief Calls Visitor with a LOG_FIELD for every field, in insertion order.
+     */
+    template<class F>
+    void
+    ForEach(
+        F &&Visitor
+    ) const
+    {
+        for (std::size_t offset = 0; offset < Size_;) {
+            HEADER header;
+            std::memcpy(&header, Data_ + offset, sizeof(header));
+
+            const std::byte *value = Data_ + offset + sizeof(HEADER);
+
+            LOG_FIELD field{
+                .Key = {header.Key, header.KeyLength},
+                .Type = header.Type,
+                .Integer = 0
+            };
+
+            switch (header.Type) {
+            case LOG_FIELD_TYPE::WideString:
+                field.WideString = {reinterpret_cast<const wchar_t *>(value), header.Size / sizeof(wchar_t)};
+                break;
+            case LOG_FIELD_TYPE::NarrowString:
+                field.NarrowString = {reinterpret_cast<const char *>(value), header.Size};
+                break;
+            default:
+                std::memcpy(&field.Integer, value, sizeof(field.Integer));
+                break;
+            }
+
+            Visitor(static_cast<const LOG_FIELD &>(field));
+            offset += AlignedSize(header.Size);
+        }
+    }
+
+    bool
+    IsEmpty() const
+    {
+        return Size_ == 0 && !Truncated_;
+    }
+
+    /**
+     * @brief Checks whether a field was dropped or a string shortened.
+     */
+    bool
+    IsTruncated() const
+    {
+        return Truncated_;
+    }
+
+    /**
+     * @brief Returns the encoded fields, which identify their keys and values.
+     */
+    std::span<const std::byte>
+    GetData() const
+    {
+        return {Data_, Size_};
+    }
+
+    void
+    Clear()
+    {
+        Size_ = 0;
+        Truncated_ = false;
+    }
+
+    /**
+     * @brief Appends the fields as " {key=value, ...}" for human readers.
+     */
+    void
+    RenderTo(
+        std::wstring &Output
+    ) const;
+
+private:
+    class HEADER {
+    public:
+        const char *Key;
+        std::uint16_t KeyLength;
+        LOG_FIELD_TYPE Type;
+        std::uint8_t Reserved;
+        std::uint32_t Size;
+    };
+
+    static constexpr std::size_t Alignment = alignof(std::uint64_t);
+
+    static constexpr std::size_t
+    AlignedSize(
+        std::size_t ValueSize
+    )
+    {
+        return (sizeof(HEADER) + ValueSize + Alignment - 1) & ~(Alignment - 1);
+    }
+
+    void
+    AddInteger(
+        LOG_FIELD_KEY Key,
+        LOG_FIELD_TYPE Type,
+        std::uint64_t Value
+    );
+
+    /**
+     * @brief Appends a field with Count elements of ElementSize bytes,
+     * keeping as many elements as fit.
+     */
+    void
+    AddBytes(
+        LOG_FIELD_KEY Key,
+        LOG_FIELD_TYPE Type,
+        const void *Data,
+        std::size_t Count,
+        std::size_t ElementSize
+    );
+
+    std::uint16_t Size_ = 0;
+    bool Truncated_ = false;
+    alignas(Alignment) std::byte Data_[Capacity];
+};
+
+}
@@ -0,0 +1,288 @@
+﻿/*!
+ *  @file       logfile.cpp
+ *  @brief      Logging system: Buffered UTF-8 file log provider.
+ */
+
+#include "logfile.hpp"
+
+#include "log.hpp"
+#include "strutil.hpp"
+#include "win32.h"
+
+namespace Common::Log {
+
+BUFFERED_FILE_LOG_PROVIDER_IMPL::BUFFERED_FILE_LOG_PROVIDER_IMPL(
+    const std::filesystem::path &Path,
+    std::shared_ptr<LOG_FORMATTER_BASE> LogFormatter,
+    LOG_FILE_COMMIT_POLICY CommitPolicy,
+    LOG_FILE_ROTATION_POLICY RotationPolicy
+) : Path_(Path),
+    CommitPolicy_(CommitPolicy),
+    RotationPolicy_(RotationPolicy),
+    LogFormatter_(std::move(LogFormatter)),
+    Archiver_(Path, RotationPolicy.MaxSegments, RotationPolicy.IndexBlockBytes)
+{
+    create_directories(Path_.parent_path());
+
+    OpenSegment();
+
+    Buffer_.reserve(CommitPolicy_.CommitBytes * 2);
+    WriteBuffer_.reserve(CommitPolicy_.CommitBytes * 2);
+
+    WriterThread_ = std::thread{&BUFFERED_FILE_LOG_PROVIDER_IMPL::WriterLoop, this};
+}
+
+BUFFERED_FILE_LOG_PROVIDER_IMPL::~BUFFERED_FILE_LOG_PROVIDER_IMPL()
+{
+    {
+        std::lock_guard lock{Lock_};
+        Stopping_ = true;
+    }
+    CommitRequested_.notify_one();
+    WriterThread_.join();
+
+    WriteSegment(Buffer_, Checkpoints_);
+
+    if (File_ != INVALID_HANDLE_VALUE) {
+        CloseHandle(File_);
+    }
+}
+
+void
+BUFFERED_FILE_LOG_PROVIDER_IMPL::Write(
+    const LOG_ENTRY &LogEntry
+)
+{
+    LOG_SCRATCH_BUFFER<std::string> scratch;
+    auto &encoded = scratch.Get();
+
+    if (LogFormatter_) {
+        LogFormatter_->FormatLogEntryUtf8(LogEntry, encoded);
+    } else {
+        LOG_SCRATCH_BUFFER<std::wstring> formatted;
+        LogEntry.RenderMessage(formatted.Get());
+        Util::AppendUtf8(formatted.Get(), encoded);
+    }
+
+    std::unique_lock lock{Lock_};
+
+    if (Buffer_.size() >= CommitPolicy_.MaxBufferedBytes) {
+        CommitRequested_.notify_one();
+        CommitCompleted_.wait(lock, [this] {
+            return Buffer_.size() < CommitPolicy_.MaxBufferedBytes || Stopping_;
+        });
+    }
+
+    /* Checkpoints are kept at least IndexBlockBytes apart, the writer thread thins them out further. */
+    if (Checkpoints_.empty() || Buffer_.size() - Checkpoints_.back().Offset >= RotationPolicy_.IndexBlockBytes) {
+        Checkpoints_.push_back(LOG_SEGMENT_CHECKPOINT{LogEntry.LogTimestamp.ToTimePoint(), Buffer_.size()});
+    }
+
+    Buffer_ += encoded;
+
+    if (LogEntry.LogLevel <= CommitPolicy_.CommitLevel) {
+        CommitAndWait(lock);
+    } else if (Buffer_.size() >= CommitPolicy_.CommitBytes) {
+        CommitRequested_.notify_one();
+    }
+}
+
+void
+BUFFERED_FILE_LOG_PROVIDER_IMPL::Flush()
+{
+    std::unique_lock lock{Lock_};
+    CommitAndWait(lock);
+}
+
+void
+BUFFERED_FILE_LOG_PROVIDER_IMPL::RegisterFormatter(
+    std::shared_ptr<LOG_FORMATTER_BASE> LogFormatter
+)
+{
+    LogFormatter_ = std::move(LogFormatter);
+}
+
+void
+BUFFERED_FILE_LOG_PROVIDER_IMPL::WriterLoop()
+{
+    std::unique_lock lock{Lock_};
+
+    for (;;) {
+        CommitRequested_.wait_for(lock, CommitPolicy_.CommitInterval, [this] {
+            return Stopping_ ||
+                   RequestedCommit_ != CompletedCommit_ ||
+                   Buffer_.size() >= CommitPolicy_.CommitBytes;
+        });
+
+        if (Stopping_) {
+            break;
+        }
+
+        if (Buffer_.empty() && RequestedCommit_ == CompletedCommit_) {
+            continue;
+        }
+
+        const auto commit = RequestedCommit_;
+        Buffer_.swap(WriteBuffer_);
+        Checkpoints_.swap(WriteCheckpoints_);
+        CommitCompleted_.notify_all();
+
+        lock.unlock();
+        WriteSegment(WriteBuffer_, WriteCheckpoints_);
+        WriteBuffer_.clear();
+        WriteCheckpoints_.clear();
+        lock.lock();
+
+        CompletedCommit_ = commit;
+        CommitCompleted_.notify_all();
+    }
+
+    /* Release writers still waiting for a commit, the destructor writes the rest. */
+    CompletedCommit_ = RequestedCommit_;
+    CommitCompleted_.notify_all();
+}
+
+void
+BUFFERED_FILE_LOG_PROVIDER_IMPL::CommitAndWait(
+    std::unique_lock<std::mutex> &Lock
+)
+{
+    if (Stopping_) {
+        return;
+    }
+
+    const auto commit = ++RequestedCommit_;
+    CommitRequested_.notify_one();
+    CommitCompleted_.wait(Lock, [this, commit] {
+        return CompletedCommit_ >= commit;
+    });
+}
+
+void
+BUFFERED_FILE_LOG_PROVIDER_IMPL::WriteSegment(
+    const std::string &Data,
+    const std::vector<LOG_SEGMENT_CHECKPOINT> &Checkpoints
+)
+{
+    if (Data.empty()) {
+        return;
+    }
+
+    if (IsRotationDue(Data.size())) {
+        Rotate();
+    }
+
+    for (const auto &checkpoint : Checkpoints) {
+        const auto offset = SegmentBytes_ + checkpoint.Offset;
+        if (SegmentIndex_.empty() || offset - SegmentIndex_.back().Offset >= RotationPolicy_.IndexBlockBytes) {
+            SegmentIndex_.push_back(LOG_SEGMENT_CHECKPOINT{checkpoint.Timestamp, offset});
+        }
+    }
+
+    WriteToFile(Data);
+    SegmentBytes_ += Data.size();
+}
+
+bool
+BUFFERED_FILE_LOG_PROVIDER_IMPL::IsRotationDue(
+    std::size_t Size
+) const
+{
+    if (SegmentBytes_ == 0) {
+        return false;
+    }
+
+    if (RotationPolicy_.MaxSegmentBytes != 0 && SegmentBytes_ + Size > RotationPolicy_.MaxSegmentBytes) {
+        return true;
+    }
+
+    return RotationPolicy_.Interval.count() != 0 && std::chrono::system_clock::now() >= SegmentDeadline_;
+}
+
+void
+BUFFERED_FILE_LOG_PROVIDER_IMPL::Rotate()
+{
+    if (File_ != INVALID_HANDLE_VALUE) {
+        CloseHandle(File_);
+    }
+
+    const auto segmentPath = Archiver_.MakeSegmentPath(SegmentOpened_);
+
+    std::error_code error;
+    rename(Path_, segmentPath, error);
+
+    if (error) {
+        /*
+         * Keep appending to the same segment, its start time and deadline
+         * stay as they are, so rotation is retried with the next write.
+         */
+        OutputDebugStringW(L"BUFFERED_FILE_LOG_PROVIDER_IMPL: Failed to rotate the log file\n");
+        OpenFile();
+        return;
+    }
+
+    Archiver_.Archive(segmentPath, std::move(SegmentIndex_));
+    SegmentIndex_.clear();
+
+    OpenSegment();
+}
+
+void
+BUFFERED_FILE_LOG_PROVIDER_IMPL::OpenSegment()
+{
+    OpenFile();
+
+    LARGE_INTEGER size{};
+    if (File_ == INVALID_HANDLE_VALUE || !GetFileSizeEx(File_, &size)) {
+        size.QuadPart = 0;
+    }
+
+    /* Text appended by an earlier run has no known timestamps. */
+    SegmentBytes_ = static_cast<std::uint64_t>(size.QuadPart);
+    if (SegmentBytes_ != 0 && SegmentIndex_.empty()) {
+        SegmentIndex_.push_back(LOG_SEGMENT_CHECKPOINT{});
+    }
+
+    SegmentOpened_ = std::chrono::system_clock::now();
+    if (RotationPolicy_.Interval.count() != 0) {
+        SegmentDeadline_ = SegmentOpened_ - SegmentOpened_.time_since_epoch() % RotationPolicy_.Interval +
+                           RotationPolicy_.Interval;
+    }
+}
+
+void
+BUFFERED_FILE_LOG_PROVIDER_IMPL::OpenFile()
+{
+    File_ = CreateFileW(Path_.c_str(),
+                        FILE_APPEND_DATA,
+                        FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                        nullptr,
+                        OPEN_ALWAYS,
+                        FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN,
+                        nullptr);
+}
+
+void
+BUFFERED_FILE_LOG_PROVIDER_IMPL::WriteToFile(
+    const std::string &Data
+)
+{
+    if (File_ == INVALID_HANDLE_VALUE || Data.empty()) {
+        return;
+    }
+
+    DWORD written = 0;
+    if (!WriteFile(File_,
+                   Data.data(),
+                   static_cast<DWORD>(Data.size()),
+                   &written,
+                   nullptr)) {
+        /*
+         * Logging the failure would re-enter this provider through the
+         * session, report it to the debugger only.
+         */
+        OutputDebugStringW(L"BUFFERED_FILE_LOG_PROVIDER_IMPL: WriteFile failed\n");
+    }
+}
+
+}
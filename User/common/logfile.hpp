@@ -0,0 +1,196 @@
+﻿/*!
+ *  @file       logfile.hpp
+ *  @brief      Logging system: Buffered UTF-8 file log provider.
+ */
+
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "loglevel.hpp"
+#include "logprov.hpp"
+#include "logsegm.hpp"
+
+namespace Common::Log {
+
+/**
+ * @brief Group-commit policy of the buffered file log provider. Buffered
+ * entries are written to the file as soon as any of the conditions is met.
+ */
+class LOG_FILE_COMMIT_POLICY {
+public:
+    /*!
+     * Number of buffered bytes that triggers a write.
+     */
+    std::size_t CommitBytes = 256 * 1024;
+
+    /*!
+     * Maximum time an entry stays in the buffer.
+     */
+    std::chrono::milliseconds CommitInterval{500};
+
+    /*!
+     * Entries of this level or more severe are written before Write returns.
+     */
+    LOG_LEVEL CommitLevel = LOG_LEVEL::Error;
+
+    /*!
+     * Number of buffered bytes at which writers wait for the file to catch up.
+     */
+    std::size_t MaxBufferedBytes = 4 * 1024 * 1024;
+};
+
+/**
+ * @brief Rotation policy of the buffered file log provider. The log file is
+ * rotated before a write as soon as any of the limits is reached, a limit of
+ * zero disables it.
+ */
+class LOG_FILE_ROTATION_POLICY {
+public:
+    /*!
+     * Maximum size of a segment. A single write larger than that still goes
+     * into one segment.
+     */
+    std::uint64_t MaxSegmentBytes = 64 * 1024 * 1024;
+
+    /*!
+     * Wall-clock rotation interval. Segments end on multiples of the interval
+     * since the Unix epoch, so a day-long interval rotates at midnight UTC.
+     */
+    std::chrono::seconds Interval = std::chrono::hours{24};
+
+    /*!
+     * Number of rotated segments to keep.
+     */
+    std::size_t MaxSegments = 16;
+
+    /*!
+     * Uncompressed distance between seek index checkpoints.
+     */
+    std::size_t IndexBlockBytes = 1024 * 1024;
+};
+
+/**
+ * @brief Log provider that writes UTF-8 log entries to a file.
+ * @details Entries are converted to UTF-8 and appended to a memory buffer.
+ * A writer thread swaps the buffer out and writes it with a single large
+ * write whenever the commit policy asks for it, so disk latency is not paid
+ * by the threads that log. When the rotation policy asks for it, the writer
+ * thread renames the file and hands it to a LOG_SEGMENT_ARCHIVER, which
+ * compresses it with a seek index in the background.
+ */
+class BUFFERED_FILE_LOG_PROVIDER_IMPL : public FILE_LOG_PROVIDER_BASE {
+public:
+    /**
+     * @brief Constructs a buffered file log provider with the specified file path.
+     * @param Path The path to the log file. Entries are appended if the file exists.
+     * @param LogFormatter The log entry formatter.
+     * @param CommitPolicy The group-commit policy.
+     * @param RotationPolicy The rotation policy.
+     */
+    BUFFERED_FILE_LOG_PROVIDER_IMPL(
+        const std::filesystem::path &Path,
+        std::shared_ptr<LOG_FORMATTER_BASE> LogFormatter = {},
+        LOG_FILE_COMMIT_POLICY CommitPolicy = {},
+        LOG_FILE_ROTATION_POLICY RotationPolicy = {}
+    );
+
+    ~BUFFERED_FILE_LOG_PROVIDER_IMPL() override;
+
+    void
+    Write(
+        const LOG_ENTRY &LogEntry
+    ) override;
+
+    void
+    Flush() override;
+
+    void
+    RegisterFormatter(
+        std::shared_ptr<LOG_FORMATTER_BASE> LogFormatter
+    ) override;
+
+private:
+    void
+    WriterLoop();
+
+    /**
+     * @brief Requests a commit and waits until everything buffered so far is written.
+     * @param Lock Lock on Lock_, held on entry and on return.
+     */
+    void
+    CommitAndWait(
+        std::unique_lock<std::mutex> &Lock
+    );
+
+    /**
+     * @brief Writes a batch to the current segment, rotating it first if due.
+     * @param Data The batch.
+     * @param Checkpoints The checkpoints of the batch, offsets are relative to Data.
+     */
+    void
+    WriteSegment(
+        const std::string &Data,
+        const std::vector<LOG_SEGMENT_CHECKPOINT> &Checkpoints
+    );
+
+    bool
+    IsRotationDue(
+        std::size_t Size
+    ) const;
+
+    void
+    Rotate();
+
+    /**
+     * @brief Opens the file and starts a new segment with its current size.
+     */
+    void
+    OpenSegment();
+
+    /**
+     * @brief Opens the file without starting a new segment.
+     */
+    void
+    OpenFile();
+
+    void
+    WriteToFile(
+        const std::string &Data
+    );
+
+    std::filesystem::path Path_;
+    void *File_ = nullptr;
+    LOG_FILE_COMMIT_POLICY CommitPolicy_;
+    LOG_FILE_ROTATION_POLICY RotationPolicy_;
+    std::shared_ptr<LOG_FORMATTER_BASE> LogFormatter_;
+    std::mutex Lock_;
+    std::condition_variable CommitRequested_;
+    std::condition_variable CommitCompleted_;
+    std::string Buffer_;
+    std::string WriteBuffer_;
+    std::vector<LOG_SEGMENT_CHECKPOINT> Checkpoints_;
+    std::vector<LOG_SEGMENT_CHECKPOINT> WriteCheckpoints_;
+    std::uint64_t RequestedCommit_ = 0;
+    std::uint64_t CompletedCommit_ = 0;
+    bool Stopping_ = false;
+
+    /* Owned by the writer thread. */
+    std::uint64_t SegmentBytes_ = 0;
+    std::chrono::system_clock::time_point SegmentOpened_;
+    std::chrono::system_clock::time_point SegmentDeadline_;
+    std::vector<LOG_SEGMENT_CHECKPOINT> SegmentIndex_;
+
+    LOG_SEGMENT_ARCHIVER Archiver_;
+    std::thread WriterThread_;
+};
+
+}
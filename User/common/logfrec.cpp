@@ -0,0 +1,283 @@
+﻿/*!
+ *  @file       logfrec.cpp
+ *  @brief      Logging system: Memory-mapped flight recorder log provider.
+ */
+
+#include "logfrec.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <format>
+
+#include "log.hpp"
+#include "win32.h"
+
+namespace Common::Log {
+
+namespace {
+
+constexpr std::size_t TextCapacity = sizeof(LOG_FLIGHT_RECORD::Text) / sizeof(wchar_t);
+
+std::int64_t
+ToNanoseconds(
+    std::chrono::system_clock::time_point Timestamp
+)
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(Timestamp.time_since_epoch()).count();
+}
+
+std::chrono::system_clock::time_point
+FromNanoseconds(
+    std::int64_t Nanoseconds
+)
+{
+    return std::chrono::system_clock::time_point{
+        std::chrono::duration_cast<std::chrono::system_clock::duration>(std::chrono::nanoseconds{Nanoseconds})
+    };
+}
+
+}
+
+FLIGHT_RECORDER_LOG_PROVIDER_IMPL::FLIGHT_RECORDER_LOG_PROVIDER_IMPL(
+    const std::filesystem::path &Path,
+    std::uint32_t RecordCount,
+    std::size_t MaxRecoveredEntries
+) : RecordCount_(std::max<std::uint32_t>(RecordCount, 1)),
+    MaxRecoveredEntries_(MaxRecoveredEntries)
+{
+    create_directories(Path.parent_path());
+
+    File_ = CreateFileW(Path.c_str(),
+                        GENERIC_READ | GENERIC_WRITE,
+                        FILE_SHARE_READ,
+                        nullptr,
+                        OPEN_ALWAYS,
+                        FILE_ATTRIBUTE_NORMAL,
+                        nullptr);
+
+    if (File_ == INVALID_HANDLE_VALUE) {
+        OutputDebugStringW(L"FLIGHT_RECORDER_LOG_PROVIDER_IMPL: Failed to open the flight recorder file\n");
+        return;
+    }
+
+    const auto size = sizeof(LOG_FLIGHT_HEADER) + std::uint64_t{RecordCount_} * sizeof(LOG_FLIGHT_RECORD);
+
+    LARGE_INTEGER existingSize{};
+    if (!GetFileSizeEx(File_, &existingSize)) {
+        existingSize.QuadPart = 0;
+    }
+
+    /* Grows the file to the mapped size if needed. */
+    Mapping_ = CreateFileMappingW(File_,
+                                  nullptr,
+                                  PAGE_READWRITE,
+                                  static_cast<DWORD>(size >> 32),
+                                  static_cast<DWORD>(size),
+                                  nullptr);
+
+    const auto view = Mapping_ ? MapViewOfFile(Mapping_, FILE_MAP_ALL_ACCESS, 0, 0, size) : nullptr;
+    if (!view) {
+        OutputDebugStringW(L"FLIGHT_RECORDER_LOG_PROVIDER_IMPL: Failed to map the flight recorder file\n");
+        Close();
+        return;
+    }
+
+    Header_ = static_cast<LOG_FLIGHT_HEADER *>(view);
+    Records_ = reinterpret_cast<LOG_FLIGHT_RECORD *>(Header_ + 1);
+
+    if (static_cast<std::uint64_t>(existingSize.QuadPart) >= size &&
+        std::memcmp(Header_->Magic, LogFlightMagic, sizeof(LogFlightMagic)) == 0 &&
+        Header_->Version == LogFlightVersion &&
+        Header_->RecordSize == sizeof(LOG_FLIGHT_RECORD) &&
+        Header_->RecordCount == RecordCount_ &&
+        Header_->State == LOG_FLIGHT_STATE::Running) {
+        Recover();
+    }
+
+    std::memset(view, 0, size);
+    std::memcpy(Header_->Magic, LogFlightMagic, sizeof(LogFlightMagic));
+    Header_->Version = LogFlightVersion;
+    Header_->RecordSize = sizeof(LOG_FLIGHT_RECORD);
+    Header_->RecordCount = RecordCount_;
+    Header_->State = LOG_FLIGHT_STATE::Running;
+}
+
+FLIGHT_RECORDER_LOG_PROVIDER_IMPL::~FLIGHT_RECORDER_LOG_PROVIDER_IMPL()
+{
+    if (Header_) {
+        FlushViewOfFile(Header_, 0);
+        Header_->State = LOG_FLIGHT_STATE::Closed;
+        FlushViewOfFile(Header_, sizeof(LOG_FLIGHT_HEADER));
+    }
+
+    Close();
+}
+
+void
+FLIGHT_RECORDER_LOG_PROVIDER_IMPL::Write(
+    const LOG_ENTRY &LogEntry
+)
+{
+    if (!Records_) {
+        return;
+    }
+
+    /* Inline and eagerly formatted text is copied as is, only deferred records are rendered. */
+    LOG_SCRATCH_BUFFER<std::wstring> scratch;
+    std::wstring_view message;
+    if (LogEntry.LogRecord.IsEmpty()) {
+        message = LogEntry.LogData.View();
+    } else {
+        auto &rendered = scratch.Get();
+        LogEntry.RenderMessage(rendered);
+        message = rendered;
+    }
+
+    std::wstring_view file = LogEntry.SourceFileName ? LogEntry.SourceFileName : L"";
+    std::wstring_view function = LogEntry.FunctionName ? LogEntry.FunctionName : L"";
+
+    /* The end of a source path is the part that identifies it. */
+    if (file.size() > LOG_FLIGHT_RECORD::MaxFileLength) {
+        file.remove_prefix(file.size() - LOG_FLIGHT_RECORD::MaxFileLength);
+    }
+    function = function.substr(0, LOG_FLIGHT_RECORD::MaxFunctionLength);
+    message = message.substr(0, TextCapacity - file.size() - function.size());
+
+    const auto sequence = std::atomic_ref{Header_->NextSequence}.fetch_add(1, std::memory_order_relaxed);
+    auto &record = Records_[sequence % RecordCount_];
+    std::atomic_ref recordSequence{record.Sequence};
+
+    /* Invalidate the record before overwriting it, a crash in between leaves it empty. */
+    recordSequence.store(0, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    record.Timestamp = ToNanoseconds(LogEntry.LogTimestamp.ToTimePoint());
+    record.Hresult = LogEntry.HResult.value_or(0);
+    record.SourceLine = LogEntry.SourceLine;
+    record.Level = static_cast<std::uint8_t>(LogEntry.LogLevel);
+    record.HasHresult = LogEntry.HResult.has_value();
+    record.FileLength = static_cast<std::uint16_t>(file.size());
+    record.FunctionLength = static_cast<std::uint16_t>(function.size());
+    record.MessageLength = static_cast<std::uint16_t>(message.size());
+
+    auto *text = record.Text;
+    text = std::copy(file.begin(), file.end(), text);
+    text = std::copy(function.begin(), function.end(), text);
+    std::copy(message.begin(), message.end(), text);
+
+    recordSequence.store(sequence + 1, std::memory_order_release);
+}
+
+void
+FLIGHT_RECORDER_LOG_PROVIDER_IMPL::Flush()
+{
+    if (Header_) {
+        FlushViewOfFile(Header_, 0);
+    }
+}
+
+void
+FLIGHT_RECORDER_LOG_PROVIDER_IMPL::RegisterFormatter(
+    std::shared_ptr<LOG_FORMATTER_BASE>
+)
+{
+}
+
+std::size_t
+FLIGHT_RECORDER_LOG_PROVIDER_IMPL::WriteRecoveredEntries(
+    LOG_PROVIDER_BASE &LogProvider
+)
+{
+    if (Recovered_.empty()) {
+        return 0;
+    }
+
+    LOG_ENTRY notice{
+        .LogLevel = LOG_LEVEL::Warning,
+        .SourceFileName = __FILEW__,
+        .FunctionName = __FUNCTIONW__,
+        .SourceLine = __LINE__,
+        .LogTimestamp = std::chrono::system_clock::now()
+    };
+    notice.LogData = std::format(L"The previous run did not shut down cleanly, its last {} entries follow",
+                                 Recovered_.size());
+    LogProvider.Write(notice);
+
+    for (const auto &recovered : Recovered_) {
+        LOG_ENTRY entry{
+            .LogLevel = recovered.Level,
+            .SourceFileName = recovered.SourceFileName.c_str(),
+            .FunctionName = recovered.FunctionName.c_str(),
+            .SourceLine = recovered.SourceLine,
+            .LogTimestamp = recovered.Timestamp,
+            .HResult = recovered.HResult
+        };
+        entry.LogData = recovered.Message;
+        LogProvider.Write(entry);
+    }
+
+    LogProvider.Flush();
+
+    const auto count = Recovered_.size();
+    Recovered_.clear();
+    Recovered_.shrink_to_fit();
+    return count;
+}
+
+void
+FLIGHT_RECORDER_LOG_PROVIDER_IMPL::Recover()
+{
+    std::vector<const LOG_FLIGHT_RECORD *> committed;
+
+    for (std::uint32_t i = 0; i < RecordCount_; ++i) {
+        const auto &record = Records_[i];
+        if (record.Sequence == 0 ||
+            record.Level > static_cast<std::uint8_t>(LOG_LEVEL::Verbose) ||
+            std::size_t{record.FileLength} + record.FunctionLength + record.MessageLength > TextCapacity) {
+            continue;
+        }
+        committed.push_back(&record);
+    }
+
+    std::ranges::sort(committed, {}, &LOG_FLIGHT_RECORD::Sequence);
+    if (committed.size() > MaxRecoveredEntries_) {
+        committed.erase(committed.begin(), committed.end() - static_cast<std::ptrdiff_t>(MaxRecoveredEntries_));
+    }
+
+    Recovered_.reserve(committed.size());
+    for (const auto *record : committed) {
+        const std::wstring_view text{record->Text, TextCapacity};
+
+        Recovered_.push_back(RECOVERED_ENTRY{
+            .Timestamp = FromNanoseconds(record->Timestamp),
+            .Level = static_cast<LOG_LEVEL>(record->Level),
+            .SourceFileName = std::wstring{text.substr(0, record->FileLength)},
+            .FunctionName = std::wstring{text.substr(record->FileLength, record->FunctionLength)},
+            .SourceLine = record->SourceLine,
+            .Message = std::wstring{text.substr(record->FileLength + record->FunctionLength,
+                                                record->MessageLength)},
+            .HResult = record->HasHresult ? std::optional<unsigned int>{record->Hresult} : std::nullopt
+        });
+    }
+}
+
+void
+FLIGHT_RECORDER_LOG_PROVIDER_IMPL::Close()
+{
+    if (Header_) {
+        UnmapViewOfFile(Header_);
+        Header_ = nullptr;
+        Records_ = nullptr;
+    }
+    if (Mapping_) {
+        CloseHandle(Mapping_);
+        Mapping_ = nullptr;
+    }
+    if (File_ && File_ != INVALID_HANDLE_VALUE) {
+        CloseHandle(File_);
+    }
+    File_ = nullptr;
+}
+
+}
@@ -0,0 +1,192 @@
+﻿/*!
+ *  @file       logfrec.hpp
+ *  @brief      Logging system: Memory-mapped flight recorder log provider.
+ */
+
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "loglevel.hpp"
+#include "logprov.hpp"
+#include "ring.hpp"
+
+namespace Common::Log {
+
+inline constexpr char LogFlightMagic[4] = {'N', 'T', 'F', 'R'};
+inline constexpr std::uint32_t LogFlightVersion = 1;
+inline constexpr std::size_t LogFlightRecordSize = 512;
+
+enum class LOG_FLIGHT_STATE : std::uint32_t {
+    Running = 1,
+    Closed
+};
+
+/**
+ * @brief Header of a flight recorder file, followed by RecordCount records.
+ */
+class LOG_FLIGHT_HEADER {
+public:
+    char Magic[4];
+    std::uint32_t Version;
+    std::uint32_t RecordSize;
+    std::uint32_t RecordCount;
+
+    /*!
+     * Closed only after the provider was destroyed, a file found Running was
+     * left by a process that did not shut down cleanly.
+     */
+    LOG_FLIGHT_STATE State;
+    std::uint32_t Reserved;
+
+    /*!
+     * Sequence number of the next record, the record is stored at
+     * NextSequence % RecordCount.
+     */
+    alignas(Util::CACHE_LINE_SIZE) std::uint64_t NextSequence;
+};
+
+/**
+ * @brief Fixed-size record of a flight recorder file. Text holds the source
+ * file name, the function name and the message, in this order, truncated to
+ * fit the record.
+ */
+class LOG_FLIGHT_RECORD {
+public:
+    static constexpr std::size_t MaxFileLength = 64;
+    static constexpr std::size_t MaxFunctionLength = 48;
+
+    /*!
+     * Sequence number of the record plus one, stored last. 0 while the
+     * record is empty or being written.
+     */
+    std::uint64_t Sequence;
+    std::int64_t Timestamp;
+    std::uint32_t Hresult;
+    std::int32_t SourceLine;
+    std::uint8_t Level;
+    std::uint8_t HasHresult;
+    std::uint16_t FileLength;
+    std::uint16_t FunctionLength;
+    std::uint16_t MessageLength;
+    wchar_t Text[(LogFlightRecordSize - 32) / sizeof(wchar_t)];
+};
+
+static_assert(sizeof(LOG_FLIGHT_RECORD) == LogFlightRecordSize);
+
+/**
+ * @brief Log provider that keeps the most recent log entries in a
+ * memory-mapped circular file.
+ */
+class FLIGHT_RECORDER_LOG_PROVIDER_BASE : public LOG_PROVIDER_BASE {
+public:
+    /**
+     * @brief Writes the entries recovered from a run that did not shut down
+     * cleanly to another provider, once.
+     * @param LogProvider The provider to write the recovered entries to.
+     * @return The number of recovered entries.
+     */
+    virtual
+    std::size_t
+    WriteRecoveredEntries(
+        LOG_PROVIDER_BASE &LogProvider
+    ) = 0;
+};
+
+/**
+ * @brief Log provider that keeps the most recent log entries in a
+ * memory-mapped circular file.
+ * @details Entries are copied into fixed-size records of a shared file
+ * mapping. The pages belong to the system file cache, so the records
+ * survive the process when it crashes or is terminated; writing an entry
+ * is a few stores and a copy of its text, cheap enough to record every
+ * level in production.
+ *
+ * Writers reserve a record with an atomic increment and publish it by
+ * storing its sequence number last, so a record torn by a crash is
+ * recognized and skipped. Write takes no lock and may be called from
+ * several threads at once, so the provider is meant for a concurrent
+ * synchronous channel: every entry is in the mapped file before the LOG
+ * call returns. On construction, a file that was not closed
+ * cleanly is read back: the most recent entries are kept until
+ * WriteRecoveredEntries hands them to the regular log.
+ */
+class FLIGHT_RECORDER_LOG_PROVIDER_IMPL : public FLIGHT_RECORDER_LOG_PROVIDER_BASE {
+public:
+    /**
+     * @brief Constructs a flight recorder log provider.
+     * @param Path The path to the flight recorder file.
+     * @param RecordCount The number of entries the file holds.
+     * @param MaxRecoveredEntries The number of entries recovered after an unclean shutdown.
+     */
+    FLIGHT_RECORDER_LOG_PROVIDER_IMPL(
+        const std::filesystem::path &Path,
+        std::uint32_t RecordCount = 4096,
+        std::size_t MaxRecoveredEntries = 1024
+    );
+
+    ~FLIGHT_RECORDER_LOG_PROVIDER_IMPL() override;
+
+    void
+    Write(
+        const LOG_ENTRY &LogEntry
+    ) override;
+
+    /**
+     * @brief Writes the mapped records to the disk, which is only needed to
+     * survive a system crash.
+     */
+    void
+    Flush() override;
+
+    /**
+     * @brief Ignored, entries are stored unformatted.
+     */
+    void
+    RegisterFormatter(
+        std::shared_ptr<LOG_FORMATTER_BASE> LogFormatter
+    ) override;
+
+    std::size_t
+    WriteRecoveredEntries(
+        LOG_PROVIDER_BASE &LogProvider
+    ) override;
+
+private:
+    class RECOVERED_ENTRY {
+    public:
+        std::chrono::system_clock::time_point Timestamp;
+        LOG_LEVEL Level;
+        std::wstring SourceFileName;
+        std::wstring FunctionName;
+        int SourceLine;
+        std::wstring Message;
+        std::optional<unsigned int> HResult;
+    };
+
+    /**
+     * @brief Collects the committed records of a mapped file, oldest first.
+     */
+    void
+    Recover();
+
+    void
+    Close();
+
+    void *File_ = nullptr;
+    void *Mapping_ = nullptr;
+    LOG_FLIGHT_HEADER *Header_ = nullptr;
+    LOG_FLIGHT_RECORD *Records_ = nullptr;
+    std::uint32_t RecordCount_;
+    std::size_t MaxRecoveredEntries_;
+    std::vector<RECOVERED_ENTRY> Recovered_;
+};
+
+}
@@ -0,0 +1,91 @@
+﻿/*!
+ *  @file       loglevel.hpp
+ *  @brief      Logging system: Log levels.
+ */
+
+#pragma once
+
+#include <string>
+#include <string_view>
+
+namespace Common::Log {
+
+enum class LOG_LEVEL {
+    Critical,
+    Error,
+    Warning,
+    Info,
+    Verbose
+};
+
+/**
+ * @brief Returns the name of a log level.
+ * @param LogLevel The log level to convert.
+ * @return A view of a static string holding the name of the log level.
+ */
+constexpr
+std::wstring_view
+LogLevelName(
+    const LOG_LEVEL LogLevel
+)
+{
+    switch (LogLevel) {
+
+    case LOG_LEVEL::Critical:
+        return L"Critical";
+    case LOG_LEVEL::Error:
+        return L"Error";
+    case LOG_LEVEL::Warning:
+        return L"Warning";
+    case LOG_LEVEL::Info:
+        return L"Info";
+    case LOG_LEVEL::Verbose:
+        return L"Verbose";
+    }
+
+    return {};
+}
+
+/**
+ * @brief Converts log level to a string representation.
+ * @param LogLevel The log level to convert.
+ * @return A string representation of the log level.
+ */
+inline
+std::wstring
+LogLevelAsString(
+    const LOG_LEVEL LogLevel
+)
+{
+    return std::wstring{LogLevelName(LogLevel)};
+}
+
+}
+
+/*!
+ * Least severe level that is compiled into the program. Levels below the
+ * floor are removed from the LOG_<LEVEL> macros at compile time.
+ */
+#ifndef NTECTIVE_LOG_LEVEL_FLOOR
+    #ifdef NDEBUG
+        #define NTECTIVE_LOG_LEVEL_FLOOR Info
+    #else
+        #define NTECTIVE_LOG_LEVEL_FLOOR Verbose
+    #endif
+#endif
+
+namespace Common::Log {
+
+/**
+ * @brief Checks whether a log level is at or above the compile-time floor.
+ */
+constexpr
+bool
+IsLevelCompiled(
+    const LOG_LEVEL LogLevel
+)
+{
+    return LogLevel <= LOG_LEVEL::NTECTIVE_LOG_LEVEL_FLOOR;
+}
+
+}
@@ -0,0 +1,151 @@
+﻿/*!
+ *  @file       logmsg.cpp
+ *  @brief      Logging system: Log message storage.
+ */
+
+#include "logmsg.hpp"
+
+#include <cwchar>
+
+#include "arena.hpp"
+
+using namespace Common::Util;
+
+namespace Common::Log {
+
+LOG_MESSAGE::LOG_MESSAGE(
+    std::wstring_view Message
+)
+{
+    Assign(Message);
+}
+
+LOG_MESSAGE::LOG_MESSAGE(
+    const LOG_MESSAGE &Other
+)
+{
+    Assign(Other.View());
+}
+
+LOG_MESSAGE::LOG_MESSAGE(
+    LOG_MESSAGE &&Other
+) noexcept
+{
+    MoveFrom(Other);
+}
+
+LOG_MESSAGE::~LOG_MESSAGE()
+{
+    Release();
+}
+
+LOG_MESSAGE &
+LOG_MESSAGE::operator=(
+    const LOG_MESSAGE &Other
+)
+{
+    if (this != &Other) {
+        Assign(Other.View());
+    }
+    return *this;
+}
+
+LOG_MESSAGE &
+LOG_MESSAGE::operator=(
+    LOG_MESSAGE &&Other
+) noexcept
+{
+    if (this != &Other) {
+        Release();
+        MoveFrom(Other);
+    }
+    return *this;
+}
+
+LOG_MESSAGE &
+LOG_MESSAGE::operator=(
+    std::wstring_view Message
+)
+{
+    Assign(Message);
+    return *this;
+}
+
+void
+LOG_MESSAGE::Clear()
+{
+    Release();
+}
+
+void
+LOG_MESSAGE::Assign(
+    std::wstring_view Message
+)
+{
+    const auto size = Message.size();
+    wchar_t *external = nullptr;
+    ARENA_CHUNK *chunk = nullptr;
+    auto storage = STORAGE::Inline;
+
+    if (size > InlineCapacity) {
+        const auto allocation = THREAD_ARENA::Allocate(size * sizeof(wchar_t));
+        if (allocation.Data) {
+            external = static_cast<wchar_t *>(allocation.Data);
+            chunk = allocation.Chunk;
+            storage = STORAGE::Arena;
+        } else {
+            external = new wchar_t[size];
+            storage = STORAGE::Heap;
+        }
+        std::wmemcpy(external, Message.data(), size);
+    } else if (size) {
+        /* The message may alias the inline buffer of this object. */
+        std::wmemmove(Inline_, Message.data(), size);
+    }
+
+    /* Released only now, the message may alias the previous external buffer. */
+    Release();
+
+    External_ = external;
+    Chunk_ = chunk;
+    Storage_ = storage;
+    Size_ = static_cast<std::uint32_t>(size);
+}
+
+void
+LOG_MESSAGE::MoveFrom(
+    LOG_MESSAGE &Other
+)
+{
+    Storage_ = Other.Storage_;
+    Size_ = Other.Size_;
+
+    if (Storage_ == STORAGE::Inline) {
+        std::wmemcpy(Inline_, Other.Inline_, Size_);
+    } else {
+        External_ = Other.External_;
+        Chunk_ = Other.Chunk_;
+    }
+
+    Other.External_ = nullptr;
+    Other.Chunk_ = nullptr;
+    Other.Storage_ = STORAGE::Inline;
+    Other.Size_ = 0;
+}
+
+void
+LOG_MESSAGE::Release()
+{
+    if (Storage_ == STORAGE::Arena) {
+        THREAD_ARENA::Release(Chunk_);
+    } else if (Storage_ == STORAGE::Heap) {
+        delete[] External_;
+    }
+
+    External_ = nullptr;
+    Chunk_ = nullptr;
+    Storage_ = STORAGE::Inline;
+    Size_ = 0;
+}
+
+}
@@ -0,0 +1,108 @@
+﻿/*!
+ *  @file       logmsg.hpp
+ *  @brief      Logging system: Log message storage.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace Common::Util {
+
+class ARENA_CHUNK;
+
+}
+
+namespace Common::Log {
+
+/**
+ * @brief Message text of a log entry.
+ * @details Short messages are stored inline. Longer messages spill into the
+ * arena of the logging thread and the arena memory is recycled when the entry
+ * is destroyed by whichever thread consumed it. Only messages larger than
+ * Util::THREAD_ARENA::MaxAllocationSize fall back to the heap.
+ */
+class LOG_MESSAGE {
+public:
+    /**
+     * @brief Number of characters stored without any allocation.
+     */
+    static constexpr std::size_t InlineCapacity = 64;
+
+    LOG_MESSAGE() = default;
+
+    LOG_MESSAGE(
+        std::wstring_view Message
+    );
+
+    LOG_MESSAGE(
+        const LOG_MESSAGE &Other
+    );
+
+    LOG_MESSAGE(
+        LOG_MESSAGE &&Other
+    ) noexcept;
+
+    ~LOG_MESSAGE();
+
+    LOG_MESSAGE &
+    operator=(
+        const LOG_MESSAGE &Other
+    );
+
+    LOG_MESSAGE &
+    operator=(
+        LOG_MESSAGE &&Other
+    ) noexcept;
+
+    LOG_MESSAGE &
+    operator=(
+        std::wstring_view Message
+    );
+
+    std::wstring_view
+    View() const
+    {
+        return {Storage_ == STORAGE::Inline ? Inline_ : External_, Size_};
+    }
+
+    bool
+    IsEmpty() const
+    {
+        return Size_ == 0;
+    }
+
+    void
+    Clear();
+
+private:
+    enum class STORAGE : std::uint8_t {
+        Inline,
+        Arena,
+        Heap
+    };
+
+    void
+    Assign(
+        std::wstring_view Message
+    );
+
+    void
+    MoveFrom(
+        LOG_MESSAGE &Other
+    );
+
+    void
+    Release();
+
+    wchar_t *External_ = nullptr;
+    Util::ARENA_CHUNK *Chunk_ = nullptr;
+    std::uint32_t Size_ = 0;
+    STORAGE Storage_ = STORAGE::Inline;
+    wchar_t Inline_[InlineCapacity];
+};
+
+}
@@ -5,22 +5,72 @@
 
 #include "logprov.hpp"
 #include "log.hpp"
+#include "strutil.hpp"
 #include "win32.h"
 
 namespace Common::Log {
 
+namespace {
+
+/*!
+ * @brief Per-thread state of the fast formatting mode.
+ */
+class TIMESTAMP_CACHE {
+public:
+    std::chrono::sys_seconds ZoneBegin = std::chrono::sys_seconds::max();
+    std::chrono::sys_seconds ZoneEnd = std::chrono::sys_seconds::min();
+    std::chrono::seconds ZoneOffset{};
+    std::wstring ZoneAbbreviation;
+    std::chrono::sys_seconds Second = std::chrono::sys_seconds::min();
+    std::wstring SecondText;
+};
+
+thread_local TIMESTAMP_CACHE TimestampCache;
+
+}
+
+void
+LOG_FORMATTER_BASE::FormatLogEntryUtf8(
+    const LOG_ENTRY &LogEntry,
+    std::string &Output
+)
+{
+    LOG_SCRATCH_BUFFER<std::wstring> formatted;
+
+    FormatLogEntryTo(LogEntry, formatted.Get());
+    Util::AppendUtf8(formatted.Get(), Output);
+}
+
+LOG_FORMATTER::LOG_FORMATTER(
+    LOG_FORMATTER_MODE Mode
+) : Mode_(Mode)
+{
+}
+
 std::wstring
 LOG_FORMATTER::FormatLogEntry(
     const LOG_ENTRY &LogEntry
 )
 {
+    if (Mode_ == LOG_FORMATTER_MODE::Fast) {
+        std::wstring output;
+        FormatLogEntryTo(LogEntry, output);
+        return output;
+    }
+
     std::wostringstream stream;
     std::wstring logLevelName = LogLevelAsString(LogEntry.LogLevel);
 
     stream << std::format(L"[{}] [{}] {}",
                           logLevelName,
-                          std::chrono::zoned_time{std::chrono::current_zone(), LogEntry.LogTimestamp},
-                          LogEntry.LogData);
+                          std::chrono::zoned_time{std::chrono::current_zone(), LogEntry.LogTimestamp.ToTimePoint()},
+                          LogEntry.RenderMessage());
+
+    if (!LogEntry.Fields.IsEmpty()) {
+        std::wstring fields;
+        LogEntry.Fields.RenderTo(fields);
+        stream << fields;
+    }
 
     if (LogEntry.HResult) {
         stream << std::format(L"\n  !HRESULT [{:#010x}]: {}",
@@ -36,6 +86,86 @@ LOG_FORMATTER::FormatLogEntry(
     return stream.str();
 }
 
+void
+LOG_FORMATTER::FormatLogEntryTo(
+    const LOG_ENTRY &LogEntry,
+    std::wstring &Output
+)
+{
+    if (Mode_ == LOG_FORMATTER_MODE::Standard) {
+        Output += FormatLogEntry(LogEntry);
+        return;
+    }
+
+    Output += L'[';
+    Output += LogLevelName(LogEntry.LogLevel);
+    Output += L"] [";
+    FormatTimestampTo(LogEntry.LogTimestamp.ToTimePoint(), Output);
+    Output += L"] ";
+    LogEntry.RenderMessage(Output);
+    LogEntry.Fields.RenderTo(Output);
+
+    if (LogEntry.HResult) {
+        std::format_to(std::back_inserter(Output),
+                       L"\n  !HRESULT [{:#010x}]: {}",
+                       *LogEntry.HResult,
+                       FormatHresult(*LogEntry.HResult));
+    }
+
+    std::format_to(std::back_inserter(Output),
+                   L"\n  >> at {} [{} @ {}]\n\n",
+                   LogEntry.FunctionName,
+                   LogEntry.SourceFileName,
+                   LogEntry.SourceLine);
+}
+
+void
+LOG_FORMATTER::FormatTimestampTo(
+    std::chrono::system_clock::time_point Timestamp,
+    std::wstring &Output
+)
+{
+    using namespace std::chrono;
+
+    auto &cache = TimestampCache;
+    const auto second = floor<seconds>(Timestamp);
+
+    /* The zone offset only changes at the boundaries reported by the tz database. */
+    if (second < cache.ZoneBegin || second >= cache.ZoneEnd) {
+        const sys_info info = current_zone()->get_info(second);
+        cache.ZoneBegin = info.begin;
+        cache.ZoneEnd = info.end;
+        cache.ZoneOffset = info.offset;
+        cache.ZoneAbbreviation.assign(info.abbrev.begin(), info.abbrev.end());
+        cache.Second = sys_seconds::min();
+    }
+
+    if (second != cache.Second) {
+        cache.Second = second;
+        cache.SecondText.clear();
+        std::format_to(std::back_inserter(cache.SecondText),
+                       L"{:%F %T}",
+                       sys_seconds{second + cache.ZoneOffset});
+    }
+
+    Output += cache.SecondText;
+
+    constexpr auto fractionalWidth = hh_mm_ss<system_clock::duration>::fractional_width;
+    if constexpr (fractionalWidth > 0) {
+        wchar_t digits[fractionalWidth];
+        auto fraction = (Timestamp - second).count();
+        for (auto i = fractionalWidth; i > 0; --i) {
+            digits[i - 1] = static_cast<wchar_t>(L'0' + fraction % 10);
+            fraction /= 10;
+        }
+        Output += L'.';
+        Output.append(digits, fractionalWidth);
+    }
+
+    Output += L' ';
+    Output += cache.ZoneAbbreviation;
+}
+
 std::wstring
 LOG_FORMATTER::FormatHresult(unsigned Hresult)
 {
@@ -51,12 +181,13 @@ LOG_FORMATTER::FormatHresult(unsigned Hresult)
         nullptr
     );
 
+    /* Called while an entry is formatted, so failures are not logged themselves. */
     if (!status) {
-        LOG.Warning(L"Failed formatting windows error");
+        OutputDebugStringW(L"Failed formatting windows error\n");
     } else {
         hresultDescription = descriptionWinalloc;
         if (LocalFree(descriptionWinalloc)) {
-            LOG.Warning(L"Failed freeing memory for windows error formatting");
+            OutputDebugStringW(L"Failed freeing memory for windows error formatting\n");
         }
         if (hresultDescription.ends_with(L"\r\n")) {
             hresultDescription.resize(hresultDescription.size() - 2);
@@ -77,11 +208,16 @@ DEBUGGER_LOG_PROVIDER_IMPL::Write(
     const LOG_ENTRY &LogEntry
 )
 {
+    LOG_SCRATCH_BUFFER<std::wstring> scratch;
+    auto &buffer = scratch.Get();
+
     if (LogFormatter_) {
-        OutputDebugStringW(LogFormatter_->FormatLogEntry(LogEntry).c_str());
+        LogFormatter_->FormatLogEntryTo(LogEntry, buffer);
     } else {
-        OutputDebugStringW(LogEntry.LogData.c_str());
+        LogEntry.RenderMessage(buffer);
     }
+
+    OutputDebugStringW(buffer.c_str());
 }
 
 void
@@ -111,11 +247,16 @@ FILE_LOG_PROVIDER_IMPL::Write(
     const LOG_ENTRY &LogEntry
 )
 {
+    LOG_SCRATCH_BUFFER<std::wstring> scratch;
+    auto &buffer = scratch.Get();
+
     if (LogFormatter_) {
-        File_ << LogFormatter_->FormatLogEntry(LogEntry).c_str();
+        LogFormatter_->FormatLogEntryTo(LogEntry, buffer);
     } else {
-        File_ << LogEntry.LogData.c_str();
+        LogEntry.RenderMessage(buffer);
     }
+
+    File_ << buffer;
 }
 
 void
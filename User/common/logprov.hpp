@@ -5,6 +5,7 @@
 
 #pragma once
 
+#include <chrono>
 #include <filesystem>
 #include <fstream>
 #include <memory>
@@ -14,6 +15,54 @@ namespace Common::Log {
 
 class LOG_ENTRY;
 
+/**
+ * @brief Scratch string of the calling thread, reused across the entries it
+ * formats so formatting does not allocate once the string has grown.
+ * @details Formatting an entry may log, for example through a deferred
+ * argument, and the nested entry may be written to the same provider on the
+ * same thread. A nested buffer gets a string of its own, so it cannot
+ * clear the text of the entry still being formatted.
+ */
+template<class STRING>
+class LOG_SCRATCH_BUFFER {
+public:
+    LOG_SCRATCH_BUFFER() : Owner_(!Busy_)
+    {
+        if (Owner_) {
+            Busy_ = true;
+            Shared_.clear();
+        }
+    }
+
+    LOG_SCRATCH_BUFFER(const LOG_SCRATCH_BUFFER &) = delete;
+
+    LOG_SCRATCH_BUFFER &
+    operator=(const LOG_SCRATCH_BUFFER &) = delete;
+
+    ~LOG_SCRATCH_BUFFER()
+    {
+        if (Owner_) {
+            Busy_ = false;
+        }
+    }
+
+    /**
+     * @brief Returns the string, empty when the buffer was constructed.
+     */
+    STRING &
+    Get()
+    {
+        return Owner_ ? Shared_ : Local_;
+    }
+
+private:
+    static inline thread_local STRING Shared_;
+    static inline thread_local bool Busy_ = false;
+
+    const bool Owner_;
+    STRING Local_;
+};
+
 class LOG_FORMATTER_BASE {
 public:
     virtual
@@ -24,20 +73,91 @@ public:
     FormatLogEntry(
         const LOG_ENTRY &LogEntry
     ) = 0;
+
+    /**
+     * @brief Formats a log entry and appends it to a string. Providers call this
+     * with a reused buffer, so formatters that override it avoid allocating
+     * a new string per entry.
+     * @param LogEntry The log entry to format.
+     * @param Output The string to append the formatted entry to.
+     */
+    virtual
+    void
+    FormatLogEntryTo(
+        const LOG_ENTRY &LogEntry,
+        std::wstring &Output
+    )
+    {
+        Output += FormatLogEntry(LogEntry);
+    }
+
+    /**
+     * @brief Formats a log entry and appends its UTF-8 encoding to a byte
+     * string. Byte-oriented providers call this, formatters that produce
+     * UTF-8 or binary output natively override it.
+     * @param LogEntry The log entry to format.
+     * @param Output The string to append the encoded entry to.
+     */
+    virtual
+    void
+    FormatLogEntryUtf8(
+        const LOG_ENTRY &LogEntry,
+        std::string &Output
+    );
+};
+
+/**
+ * @brief Formatting strategy of LOG_FORMATTER.
+ */
+enum class LOG_FORMATTER_MODE {
+    /*!
+     * Looks up the time zone and formats every part of the entry with
+     * separate std::format calls.
+     */
+    Standard,
+    /*!
+     * Produces the same text as Standard. The zone offset is cached until
+     * the timestamp leaves the validity range of the cached offset, the
+     * timestamp is rendered once per second and only the sub-second digits
+     * are patched in, and output goes straight into the caller's buffer.
+     */
+    Fast
 };
 
 class LOG_FORMATTER : public LOG_FORMATTER_BASE {
 public:
+    LOG_FORMATTER(
+        LOG_FORMATTER_MODE Mode = LOG_FORMATTER_MODE::Standard
+    );
+
     std::wstring
     FormatLogEntry(
         const LOG_ENTRY &LogEntry
     ) override;
 
-private:
+    void
+    FormatLogEntryTo(
+        const LOG_ENTRY &LogEntry,
+        std::wstring &Output
+    ) override;
+
+    /**
+     * @brief Returns the system description of an HRESULT.
+     */
+    static
     std::wstring
     FormatHresult(
         unsigned int Hresult
     );
+
+private:
+    void
+    FormatTimestampTo(
+        std::chrono::system_clock::time_point Timestamp,
+        std::wstring &Output
+    );
+
+    LOG_FORMATTER_MODE Mode_;
 };
 
 /**
@@ -0,0 +1,367 @@
+﻿/*!
+ *  @file       lograte.cpp
+ *  @brief      Logging system: Per-site rate limiting and repeat collapsing.
+ */
+
+#include "lograte.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <format>
+
+#include "log.hpp"
+#include "logsessn.hpp"
+#include "tscclock.hpp"
+
+namespace Common::Log {
+
+namespace {
+
+constexpr std::uint64_t EmptyKey = 0;
+constexpr std::uint64_t BusyKey = 1;
+constexpr std::size_t MaxProbes = 32;
+constexpr std::size_t LevelCount = static_cast<std::size_t>(LOG_LEVEL::Verbose) + 1;
+
+/*!
+ * @brief Period of the sweep while repeat collapsing is disabled.
+ */
+constexpr std::chrono::seconds DefaultSweepPeriod{1};
+
+/*!
+ * @brief Returns the time of an entry in raw FAST_CLOCK ticks, which need
+ * no conversion at all.
+ */
+Util::FAST_CLOCK::TICKS
+ToTicks(
+    const LOG_TIMESTAMP &Timestamp
+)
+{
+    return Timestamp.IsTicks() ? Timestamp.GetTicks() : Util::FAST_CLOCK::Now();
+}
+
+std::uint64_t
+HashBytes(
+    const void *Data,
+    std::size_t Size,
+    std::uint64_t Hash = 14695981039346656037ull
+)
+{
+    /* FNV-1a */
+    const auto *bytes = static_cast<const unsigned char *>(Data);
+    for (std::size_t i = 0; i < Size; ++i) {
+        Hash = (Hash ^ bytes[i]) * 1099511628211ull;
+    }
+    return Hash;
+}
+
+/*!
+ * @brief Hashes the message and the fields of an entry. A deferred record is
+ * hashed by the address of its format string literal and its encoded
+ * arguments, so the message is never formatted.
+ */
+std::uint64_t
+HashMessage(
+    const LOG_ENTRY &LogEntry
+)
+{
+    std::uint64_t hash;
+
+    if (LogEntry.LogRecord.IsEmpty()) {
+        const auto message = LogEntry.LogData.View();
+        hash = HashBytes(message.data(), message.size() * sizeof(wchar_t));
+    } else {
+        const auto *format = LogEntry.LogRecord.GetFormat().data();
+        const auto arguments = LogEntry.LogRecord.GetArguments();
+        hash = HashBytes(&format, sizeof(format));
+        hash = HashBytes(arguments.data(), arguments.size(), hash);
+    }
+
+    const auto fields = LogEntry.Fields.GetData();
+    hash = HashBytes(fields.data(), fields.size(), hash);
+
+    /* 0 means that the site has no previous message. */
+    return hash | 1;
+}
+
+std::uint64_t
+SiteKey(
+    const wchar_t *SourceFileName,
+    int SourceLine
+)
+{
+    const auto key = reinterpret_cast<std::uintptr_t>(SourceFileName) * 0x9E3779B97F4A7C15ull ^
+                     static_cast<std::uint32_t>(SourceLine) * 0xC2B2AE3D27D4EB4Full;
+    return key > BusyKey ? key : key + 2;
+}
+
+std::uint64_t
+WaitForKey(
+    std::atomic<std::uint64_t> &Key,
+    std::uint64_t Current
+)
+{
+    /* A claiming thread only stores three fields before publishing the key. */
+    while (Current == BusyKey) {
+        Current = Key.load(std::memory_order_acquire);
+    }
+    return Current;
+}
+
+/*!
+ * @brief Lowers the level stored in a summary level to Level if Level is
+ * more severe.
+ */
+void
+RecordSummaryLevel(
+    std::atomic<std::uint32_t> &SummaryLevel,
+    LOG_LEVEL Level
+)
+{
+    const auto level = static_cast<std::uint32_t>(Level);
+    auto current = SummaryLevel.load(std::memory_order_relaxed);
+    while (level < current &&
+           !SummaryLevel.compare_exchange_weak(current, level, std::memory_order_relaxed)) {
+    }
+}
+
+/*!
+ * @brief Takes the level of a summary, the most severe level of the entries
+ * it counts.
+ */
+LOG_LEVEL
+TakeSummaryLevel(
+    std::atomic<std::uint32_t> &SummaryLevel
+)
+{
+    const auto level = SummaryLevel.exchange(LevelCount, std::memory_order_relaxed);
+    return level < LevelCount ? static_cast<LOG_LEVEL>(level) : LOG_LEVEL::Verbose;
+}
+
+}
+
+LOG_RATE_LIMITER::LOG_RATE_LIMITER()
+    : Slots_(std::make_unique<SLOT[]>(SlotCount))
+{
+    for (std::size_t level = 0; level < LevelCount; ++level) {
+        SetLimit(static_cast<LOG_LEVEL>(level), {});
+    }
+    SetRepeatWindow(std::chrono::milliseconds{0});
+}
+
+void
+LOG_RATE_LIMITER::SetLimit(
+    LOG_LEVEL Level,
+    LOG_RATE_LIMIT Limit
+)
+{
+    const auto index = static_cast<std::size_t>(Level);
+    const auto interval = Limit.EntriesPerSecond > 0
+                              ? std::max<std::int64_t>(Util::FAST_CLOCK::ToTicks(std::chrono::nanoseconds{
+                                                           std::llround(1e9 / Limit.EntriesPerSecond)}),
+                                                       1)
+                              : 0;
+
+    EmissionInterval_[index].store(interval, std::memory_order_relaxed);
+    Burst_[index].store(std::max<std::uint32_t>(Limit.Burst, 1), std::memory_order_relaxed);
+}
+
+void
+LOG_RATE_LIMITER::SetRepeatWindow(
+    std::chrono::milliseconds Window
+)
+{
+    const auto window = Window.count() > 0 ? std::max<std::int64_t>(Util::FAST_CLOCK::ToTicks(Window), 1) : 0;
+
+    RepeatWindow_.store(window, std::memory_order_relaxed);
+    SweepPeriod_.store(window != 0 ? window : Util::FAST_CLOCK::ToTicks(DefaultSweepPeriod),
+                       std::memory_order_relaxed);
+}
+
+bool
+LOG_RATE_LIMITER::Admit(
+    const LOG_ENTRY &LogEntry,
+    LOG_SESSION_BASE &Session
+)
+{
+    const auto window = RepeatWindow_.load(std::memory_order_relaxed);
+    const auto level = std::min(static_cast<std::size_t>(LogEntry.LogLevel), LevelCount - 1);
+    const auto interval = EmissionInterval_[level].load(std::memory_order_relaxed);
+
+    const auto now = ToTicks(LogEntry.LogTimestamp);
+    const auto sweepPeriod = SweepPeriod_.load(std::memory_order_relaxed);
+
+    /* The first thread past the deadline sweeps, the others go on. */
+    if (auto next = NextSweep_.load(std::memory_order_relaxed);
+        now >= next && NextSweep_.compare_exchange_strong(next, now + sweepPeriod, std::memory_order_relaxed)) {
+        SweepSlots(Session, now, sweepPeriod);
+    }
+
+    /* Neither collapsed nor limited, the site needs no slot. */
+    if (window == 0 && interval == 0) {
+        return true;
+    }
+
+    auto *slot = FindSlot(LogEntry);
+    if (!slot) {
+        /* The table is full, the site is not limited. */
+        return true;
+    }
+
+    slot->LastSeen.store(now, std::memory_order_relaxed);
+
+    if (window != 0) {
+        const auto message = HashMessage(LogEntry);
+        if (slot->LastMessage.exchange(message, std::memory_order_relaxed) == message) {
+            RecordSummaryLevel(slot->RepeatLevel, LogEntry.LogLevel);
+            slot->Repeats.fetch_add(1, std::memory_order_relaxed);
+
+            /* A run that outlasts the window is summarized without waiting for it to end. */
+            if (auto since = slot->RepeatSince.load(std::memory_order_relaxed);
+                now - since >= window &&
+                slot->RepeatSince.compare_exchange_strong(since, now, std::memory_order_relaxed)) {
+                WriteRepeatSummary(*slot, Session);
+            }
+            return false;
+        }
+
+        slot->RepeatSince.store(now, std::memory_order_relaxed);
+    }
+
+    /* A run that ended, or that was pending when collapsing was disabled. */
+    WriteRepeatSummary(*slot, Session);
+
+    if (interval == 0) {
+        return true;
+    }
+
+    /* Generic cell rate algorithm: admitted while the theoretical arrival time stays within the burst. */
+    const auto tolerance = interval * Burst_[level].load(std::memory_order_relaxed);
+    auto arrival = slot->TheoreticalArrival.load(std::memory_order_relaxed);
+    for (;;) {
+        const auto next = std::max(arrival, now) + interval;
+        if (next - now > tolerance) {
+            RecordSummaryLevel(slot->SuppressedLevel, LogEntry.LogLevel);
+            slot->Suppressed.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        if (slot->TheoreticalArrival.compare_exchange_weak(arrival, next, std::memory_order_relaxed)) {
+            break;
+        }
+    }
+
+    WriteSuppressedSummary(*slot, Session);
+    return true;
+}
+
+void
+LOG_RATE_LIMITER::Sweep(
+    LOG_SESSION_BASE &Session
+)
+{
+    SweepSlots(Session, Util::FAST_CLOCK::Now(), 0);
+}
+
+LOG_RATE_LIMITER::SLOT *
+LOG_RATE_LIMITER::FindSlot(
+    const LOG_ENTRY &LogEntry
+)
+{
+    const auto key = SiteKey(LogEntry.SourceFileName, LogEntry.SourceLine);
+    const auto start = static_cast<std::size_t>(key >> (64 - std::countr_zero(SlotCount)));
+
+    for (std::size_t probe = 0; probe < MaxProbes; ++probe) {
+        auto &slot = Slots_[(start + probe) % SlotCount];
+        auto current = WaitForKey(slot.Key, slot.Key.load(std::memory_order_acquire));
+
+        if (current == EmptyKey) {
+            if (slot.Key.compare_exchange_strong(current, BusyKey, std::memory_order_acquire)) {
+                slot.SourceFileName = LogEntry.SourceFileName;
+                slot.FunctionName = LogEntry.FunctionName;
+                slot.SourceLine = LogEntry.SourceLine;
+                slot.Key.store(key, std::memory_order_release);
+                return &slot;
+            }
+            current = WaitForKey(slot.Key, current);
+        }
+
+        if (current == key) {
+            return &slot;
+        }
+    }
+
+    return nullptr;
+}
+
+void
+LOG_RATE_LIMITER::WriteRepeatSummary(
+    SLOT &Slot,
+    LOG_SESSION_BASE &Session
+)
+{
+    const auto repeats = Slot.Repeats.exchange(0, std::memory_order_relaxed);
+    if (repeats == 0) {
+        return;
+    }
+
+    LOG_ENTRY summary{
+        .LogLevel = TakeSummaryLevel(Slot.RepeatLevel),
+        .SourceFileName = Slot.SourceFileName,
+        .FunctionName = Slot.FunctionName,
+        .SourceLine = Slot.SourceLine,
+        .LogTimestamp = LOG_TIMESTAMP::Now()
+    };
+    summary.LogData = std::format(L"Previous message repeated {} times", repeats);
+    Session.Write(summary);
+}
+
+void
+LOG_RATE_LIMITER::WriteSuppressedSummary(
+    SLOT &Slot,
+    LOG_SESSION_BASE &Session
+)
+{
+    const auto suppressed = Slot.Suppressed.exchange(0, std::memory_order_relaxed);
+    if (suppressed == 0) {
+        return;
+    }
+
+    LOG_ENTRY summary{
+        .LogLevel = TakeSummaryLevel(Slot.SuppressedLevel),
+        .SourceFileName = Slot.SourceFileName,
+        .FunctionName = Slot.FunctionName,
+        .SourceLine = Slot.SourceLine,
+        .LogTimestamp = LOG_TIMESTAMP::Now()
+    };
+    summary.LogData = std::format(L"{} entries suppressed by the rate limit", suppressed);
+    Session.Write(summary);
+}
+
+void
+LOG_RATE_LIMITER::SweepSlots(
+    LOG_SESSION_BASE &Session,
+    std::int64_t Now,
+    std::int64_t QuietFor
+)
+{
+    for (std::size_t i = 0; i < SlotCount; ++i) {
+        auto &slot = Slots_[i];
+        if (slot.Key.load(std::memory_order_acquire) <= BusyKey) {
+            continue;
+        }
+        if (Now - slot.LastSeen.load(std::memory_order_relaxed) < QuietFor) {
+            continue;
+        }
+        WriteRepeatSummary(slot, Session);
+        WriteSuppressedSummary(slot, Session);
+    }
+}
+
+LOG_RATE_LIMITER &
+GetLogRateLimiter()
+{
+    static LOG_RATE_LIMITER logRateLimiter;
+    return logRateLimiter;
+}
+
+}
@@ -0,0 +1,194 @@
+﻿/*!
+ *  @file       lograte.hpp
+ *  @brief      Logging system: Per-site rate limiting and repeat collapsing.
+ */
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+
+#include "loglevel.hpp"
+#include "ring.hpp"
+
+namespace Common::Log {
+
+class LOG_ENTRY;
+class LOG_SESSION_BASE;
+
+/**
+ * @brief Token bucket parameters of a log level.
+ */
+class LOG_RATE_LIMIT {
+public:
+    /*!
+     * Sustained number of entries per second a call site may write,
+     * 0 disables the limit.
+     */
+    double EntriesPerSecond = 0;
+
+    /*!
+     * Number of entries a call site may write in a burst.
+     */
+    std::uint32_t Burst = 1;
+};
+
+/**
+ * @brief Limits how often a single call site can write to the log.
+ * @details Call sites are identified by the source file pointer and line
+ * captured by LOG_CONTROLLER and tracked in a fixed-size open-addressing
+ * table whose slots are claimed with a compare-and-swap, so no lock is
+ * taken on the logging path.
+ *
+ * An entry whose message equals the previous message of its call site is
+ * collapsed: it is counted and dropped, and a single "repeated N times"
+ * entry is written when the site logs a different message or when the
+ * repeat window elapses. Entries that remain are admitted by a per-site
+ * token bucket, implemented as a generic cell rate algorithm on a single
+ * atomic, with the limit of the entry level. Suppressed entries are
+ * reported by a summary entry once the site is admitted again. Summaries
+ * have the most severe level of the entries they count.
+ *
+ * Both are disabled by default: every level is unlimited and the repeat
+ * window is 0. Entries of sites that are neither collapsed nor limited
+ * skip the table.
+ *
+ * Summaries of sites that went quiet are written by a sweep that the
+ * first logging thread after each repeat window runs, and by Sweep.
+ * Times are kept in raw Util::FAST_CLOCK ticks, the limits and the window
+ * are converted to ticks when they are set.
+ * Under contention from several threads at one site the counts are
+ * approximate, but entries are never lost without being counted.
+ */
+class LOG_RATE_LIMITER {
+public:
+    static constexpr std::size_t SlotCount = 1024;
+
+
+    /**
+     * @brief Constructs a limiter that neither limits nor collapses entries
+     * until SetLimit or SetRepeatWindow enables it.
+     */
+    LOG_RATE_LIMITER();
+
+    /**
+     * @brief Sets the token bucket parameters of a log level.
+     */
+    void
+    SetLimit(
+        LOG_LEVEL Level,
+        LOG_RATE_LIMIT Limit
+    );
+
+    /**
+     * @brief Sets the longest time a run of repeated messages is collapsed
+     * before its summary is written. 0 disables collapsing.
+     */
+    void
+    SetRepeatWindow(
+        std::chrono::milliseconds Window
+    );
+
+    /**
+     * @brief Decides whether an entry is written, writing pending summaries
+     * of its call site to the session first.
+     * @param LogEntry The entry.
+     * @param Session The session the entry and the summaries are written to.
+     * @return true if the entry must be written.
+     */
+    bool
+    Admit(
+        const LOG_ENTRY &LogEntry,
+        LOG_SESSION_BASE &Session
+    );
+
+    /**
+     * @brief Writes the pending summaries of all call sites.
+     */
+    void
+    Sweep(
+        LOG_SESSION_BASE &Session
+    );
+
+private:
+    class alignas(Util::CACHE_LINE_SIZE) SLOT {
+    public:
+        std::atomic<std::uint64_t> Key = 0;
+        std::atomic<std::int64_t> TheoreticalArrival = 0;
+        std::atomic<std::uint64_t> Suppressed = 0;
+        std::atomic<std::uint64_t> LastMessage = 0;
+        std::atomic<std::uint64_t> Repeats = 0;
+        std::atomic<std::int64_t> RepeatSince = 0;
+        std::atomic<std::int64_t> LastSeen = 0;
+
+        /*!
+         * Most severe level of the collapsed and of the suppressed entries,
+         * the levels of their summaries. One past Verbose while there are
+         * none.
+         */
+        std::atomic<std::uint32_t> RepeatLevel = static_cast<std::uint32_t>(LOG_LEVEL::Verbose) + 1;
+        std::atomic<std::uint32_t> SuppressedLevel = static_cast<std::uint32_t>(LOG_LEVEL::Verbose) + 1;
+
+        const wchar_t *SourceFileName = nullptr;
+        const wchar_t *FunctionName = nullptr;
+        int SourceLine = 0;
+    };
+
+    SLOT *
+    FindSlot(
+        const LOG_ENTRY &LogEntry
+    );
+
+    /**
+     * @brief Writes the "repeated N times" summary of a slot, if any.
+     * @param Slot The slot.
+     * @param Session The session to write the summary to.
+     */
+    static
+    void
+    WriteRepeatSummary(
+        SLOT &Slot,
+        LOG_SESSION_BASE &Session
+    );
+
+    /**
+     * @brief Writes the "N entries suppressed" summary of a slot, if any.
+     */
+    static
+    void
+    WriteSuppressedSummary(
+        SLOT &Slot,
+        LOG_SESSION_BASE &Session
+    );
+
+    /**
+     * @brief Writes the pending summaries of the sites quiet for at least QuietFor.
+     * @param Now The current time in Util::FAST_CLOCK ticks.
+     * @param QuietFor Ticks since the last entry of a site.
+     */
+    void
+    SweepSlots(
+        LOG_SESSION_BASE &Session,
+        std::int64_t Now,
+        std::int64_t QuietFor
+    );
+
+    std::array<std::atomic<std::int64_t>, 5> EmissionInterval_;
+    std::array<std::atomic<std::uint32_t>, 5> Burst_;
+    std::atomic<std::int64_t> RepeatWindow_;
+    std::atomic<std::int64_t> SweepPeriod_;
+    std::atomic<std::int64_t> NextSweep_ = 0;
+    std::unique_ptr<SLOT[]> Slots_;
+};
+
+/*!
+ * @brief Log rate limiter accessor.
+ * @return The process-wide log rate limiter.
+ */
+LOG_RATE_LIMITER &
+GetLogRateLimiter();
+
+}
@@ -0,0 +1,348 @@
+﻿/*!
+ *  @file       logrec.hpp
+ *  @brief      Logging system: Deferred-formatting log records.
+ *  @details    A log record captures a pointer to a static format string and
+ *              a compact binary encoding of the format arguments. The text is
+ *              only produced when a provider renders the entry, so the cost of
+ *              std::format is paid by the consumer of the entry, not by the
+ *              thread that logged it.
+ *
+ *              Each argument is encoded as a two byte header, a LOG_ARGUMENT_TYPE
+ *              tag and a zero byte, followed by its payload, so the record can
+ *              also be decoded offline from the format string and the raw
+ *              argument bytes:
+ *
+ *                  Bool        2 bytes (0 or 1)
+ *                  Char        4 bytes, code unit
+ *                  Int64       8 bytes
+ *                  UInt64      8 bytes
+ *                  Float       4 bytes, IEEE 754
+ *                  Double      8 bytes, IEEE 754
+ *                  Pointer     8 bytes, address
+ *                  WideString  4 bytes length in code units + UTF-16 code units
+ *
+ *              All values are stored in native (little-endian) byte order. Every
+ *              encoded size is even, which keeps string payloads aligned.
+ */
+
+#pragma once
+
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <format>
+#include <iterator>
+#include <span>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+
+namespace Common::Log {
+
+/**
+ * @brief Type tag of an encoded log record argument.
+ */
+enum class LOG_ARGUMENT_TYPE : std::uint8_t {
+    Bool,
+    Char,
+    Int64,
+    UInt64,
+    Float,
+    Double,
+    Pointer,
+    WideString
+};
+
+/**
+ * @brief Concept to identify arguments that can be captured without formatting.
+ */
+template<class T>
+concept DEFERRABLE_ARGUMENT = std::is_arithmetic_v<T> ||
+                              (std::is_pointer_v<T> && std::is_void_v<std::remove_pointer_t<T>>) ||
+                              std::is_null_pointer_v<T> ||
+                              std::convertible_to<const T &, std::wstring_view>;
+
+/**
+ * @brief Encoding of a single deferrable argument.
+ */
+template<DEFERRABLE_ARGUMENT T>
+class LOG_ARGUMENT {
+public:
+    static constexpr bool IsString = std::convertible_to<const T &, std::wstring_view>;
+
+    /**
+     * @brief Type the argument is decoded into when the record is rendered.
+     */
+    using DECODED = std::conditional_t<IsString,
+                                       std::wstring_view,
+                                       std::conditional_t<std::is_null_pointer_v<T>, const void *, T>>;
+
+    static
+    constexpr
+    LOG_ARGUMENT_TYPE
+    GetType()
+    {
+        if constexpr (IsString) {
+            return LOG_ARGUMENT_TYPE::WideString;
+        } else if constexpr (std::is_same_v<T, bool>) {
+            return LOG_ARGUMENT_TYPE::Bool;
+        } else if constexpr (std::is_same_v<T, char> || std::is_same_v<T, wchar_t>) {
+            return LOG_ARGUMENT_TYPE::Char;
+        } else if constexpr (std::is_same_v<T, float>) {
+            return LOG_ARGUMENT_TYPE::Float;
+        } else if constexpr (std::is_floating_point_v<T>) {
+            return LOG_ARGUMENT_TYPE::Double;
+        } else if constexpr (std::is_signed_v<T>) {
+            return LOG_ARGUMENT_TYPE::Int64;
+        } else if constexpr (std::is_unsigned_v<T>) {
+            return LOG_ARGUMENT_TYPE::UInt64;
+        } else {
+            return LOG_ARGUMENT_TYPE::Pointer;
+        }
+    }
+
+    static
+    std::size_t
+    GetSize(
+        const T &Value
+    )
+    {
+        if constexpr (IsString) {
+            return HeaderSize + sizeof(std::uint32_t) + std::wstring_view{Value}.size() * sizeof(wchar_t);
+        } else {
+            return HeaderSize + GetPayloadSize();
+        }
+    }
+
+    static
+    std::byte *
+    Encode(
+        std::byte *Output,
+        const T &Value
+    )
+    {
+        *Output++ = static_cast<std::byte>(GetType());
+        *Output++ = std::byte{0};
+
+        if constexpr (IsString) {
+            const std::wstring_view string{Value};
+            const auto length = static_cast<std::uint32_t>(string.size());
+            Output = Put(Output, length);
+            std::memcpy(Output, string.data(), length * sizeof(wchar_t));
+            return Output + length * sizeof(wchar_t);
+        } else {
+            return Put(Output, ToPayload(Value));
+        }
+    }
+
+    static
+    DECODED
+    Decode(
+        const std::byte *&Input
+    )
+    {
+        Input += HeaderSize;
+
+        if constexpr (IsString) {
+            const auto length = Get<std::uint32_t>(Input);
+            const auto data = reinterpret_cast<const wchar_t *>(Input);
+            Input += length * sizeof(wchar_t);
+            return {data, length};
+        } else {
+            using PAYLOAD = decltype(ToPayload(std::declval<T>()));
+            const auto payload = Get<PAYLOAD>(Input);
+
+            if constexpr (std::is_null_pointer_v<T>) {
+                return nullptr;
+            } else if constexpr (std::is_pointer_v<T>) {
+                return reinterpret_cast<T>(static_cast<std::uintptr_t>(payload));
+            } else {
+                return static_cast<T>(payload);
+            }
+        }
+    }
+
+private:
+    static constexpr std::size_t HeaderSize = 2;
+
+    static
+    auto
+    ToPayload(
+        const T &Value
+    )
+    {
+        if constexpr (std::is_same_v<T, bool>) {
+            return static_cast<std::uint16_t>(Value);
+        } else if constexpr (std::is_same_v<T, char> || std::is_same_v<T, wchar_t>) {
+            return static_cast<std::uint32_t>(Value);
+        } else if constexpr (std::is_same_v<T, float>) {
+            return Value;
+        } else if constexpr (std::is_floating_point_v<T>) {
+            return static_cast<double>(Value);
+        } else if constexpr (std::is_null_pointer_v<T>) {
+            return std::uint64_t{0};
+        } else if constexpr (std::is_pointer_v<T>) {
+            return static_cast<std::uint64_t>(reinterpret_cast<std::uintptr_t>(Value));
+        } else if constexpr (std::is_signed_v<T>) {
+            return static_cast<std::int64_t>(Value);
+        } else {
+            return static_cast<std::uint64_t>(Value);
+        }
+    }
+
+    static
+    constexpr
+    std::size_t
+    GetPayloadSize()
+    {
+        return sizeof(decltype(ToPayload(std::declval<T>())));
+    }
+
+    template<class V>
+    static
+    std::byte *
+    Put(
+        std::byte *Output,
+        const V &Value
+    )
+    {
+        std::memcpy(Output, &Value, sizeof(V));
+        return Output + sizeof(V);
+    }
+
+    template<class V>
+    static
+    V
+    Get(
+        const std::byte *&Input
+    )
+    {
+        V value;
+        std::memcpy(&value, Input, sizeof(V));
+        Input += sizeof(V);
+        return value;
+    }
+};
+
+/**
+ * @brief Static format string and binary encoded arguments of a log message.
+ */
+class LOG_RECORD {
+public:
+    /**
+     * @brief Maximum size of the encoded arguments. Records that do not fit
+     * are formatted eagerly by the caller instead.
+     */
+    static constexpr std::size_t Capacity = 192;
+
+    /**
+     * @brief Captures a format string and its arguments.
+     * @param Format The format string. It must outlive the record, which in
+     * practice means a string literal.
+     * @param Arguments The format arguments.
+     * @return true if the arguments were captured, false if any argument
+     * cannot be deferred or the encoded arguments exceed Capacity.
+     */
+    template<class... ARGS>
+    bool
+    Capture(
+        std::wstring_view Format,
+        const ARGS &...Arguments
+    )
+    {
+        if constexpr (!(DEFERRABLE_ARGUMENT<std::decay_t<const ARGS &>> && ...)) {
+            return false;
+        } else {
+            const std::size_t size = (LOG_ARGUMENT<std::decay_t<const ARGS &>>::GetSize(Arguments) + ... + 0);
+            if (size > Capacity) {
+                return false;
+            }
+
+            std::byte *cursor = Data_;
+            ((cursor = LOG_ARGUMENT<std::decay_t<const ARGS &>>::Encode(cursor, Arguments)), ...);
+
+            Format_ = Format;
+            Size_ = static_cast<std::uint16_t>(size);
+            Decoder_ = &DecodeArguments<std::decay_t<const ARGS &>...>;
+            return true;
+        }
+    }
+
+    /**
+     * @brief Checks whether the record holds a captured message.
+     */
+    bool
+    IsEmpty() const
+    {
+        return Decoder_ == nullptr;
+    }
+
+    /**
+     * @brief Formats the captured message and appends it to a string.
+     * @param Output The string to append the formatted message to.
+     */
+    void
+    RenderTo(
+        std::wstring &Output
+    ) const
+    {
+        if (Decoder_) {
+            Decoder_(Output, Format_, Data_);
+        }
+    }
+
+    /**
+     * @brief Returns the captured format string.
+     */
+    std::wstring_view
+    GetFormat() const
+    {
+        return Format_;
+    }
+
+    /**
+     * @brief Returns the encoded arguments.
+     */
+    std::span<const std::byte>
+    GetArguments() const
+    {
+        return {Data_, Size_};
+    }
+
+    void
+    Clear()
+    {
+        Format_ = {};
+        Size_ = 0;
+        Decoder_ = nullptr;
+    }
+
+private:
+    using DECODER = void (*)(std::wstring &Output, std::wstring_view Format, const std::byte *Data);
+
+    template<class... ARGS>
+    static
+    void
+    DecodeArguments(
+        std::wstring &Output,
+        std::wstring_view Format,
+        const std::byte *Data
+    )
+    {
+        /* Braced initialization guarantees left-to-right decoding. */
+        std::tuple<typename LOG_ARGUMENT<ARGS>::DECODED...> values{LOG_ARGUMENT<ARGS>::Decode(Data)...};
+
+        std::apply([&](auto &...Values) {
+            std::vformat_to(std::back_inserter(Output), Format, std::make_wformat_args(Values...));
+        }, values);
+    }
+
+    std::wstring_view Format_;
+    DECODER Decoder_ = nullptr;
+    std::uint16_t Size_ = 0;
+    alignas(8) std::byte Data_[Capacity];
+};
+
+}
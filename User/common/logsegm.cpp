@@ -0,0 +1,472 @@
+﻿/*!
+ *  @file       logsegm.cpp
+ *  @brief      Logging system: Compressed log segments.
+ */
+
+#include "logsegm.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <format>
+
+#include "win32.h"
+
+#include <compressapi.h>
+
+#pragma comment(lib, "Cabinet.lib")
+
+namespace Common::Log {
+
+namespace {
+
+constexpr char SegmentMagic[4] = {'N', 'T', 'L', 'S'};
+constexpr std::uint32_t SegmentVersion = 1;
+constexpr wchar_t SegmentExtension[] = L".lgz";
+constexpr wchar_t TemporaryExtension[] = L".lgz.tmp";
+
+class SEGMENT_HEADER {
+public:
+    char Magic[4];
+    std::uint32_t Version;
+    std::uint32_t BlockCount;
+    std::uint32_t Reserved;
+    std::uint64_t IndexOffset;
+    std::uint64_t UncompressedSize;
+};
+
+class SEGMENT_INDEX_ENTRY {
+public:
+    std::int64_t Timestamp;
+    std::uint64_t Offset;
+    std::uint64_t CompressedOffset;
+    std::uint32_t Size;
+    std::uint32_t CompressedSize;
+};
+
+static_assert(sizeof(SEGMENT_HEADER) == 32);
+static_assert(sizeof(SEGMENT_INDEX_ENTRY) == 32);
+
+std::int64_t
+ToUnixMicroseconds(
+    std::chrono::system_clock::time_point Timestamp
+)
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(Timestamp.time_since_epoch()).count();
+}
+
+std::chrono::system_clock::time_point
+FromUnixMicroseconds(
+    std::int64_t Microseconds
+)
+{
+    return std::chrono::system_clock::time_point{
+        std::chrono::duration_cast<std::chrono::system_clock::duration>(std::chrono::microseconds{Microseconds})
+    };
+}
+
+}
+
+LOG_SEGMENT_ARCHIVER::LOG_SEGMENT_ARCHIVER(
+    const std::filesystem::path &ActivePath,
+    std::size_t MaxSegments,
+    std::size_t BlockBytes
+) : ActivePath_(ActivePath),
+    MaxSegments_(MaxSegments),
+    BlockBytes_(BlockBytes)
+{
+    /* Scanned before anything is rotated, so only files of earlier runs are found. */
+    RecoverSegments();
+
+    ArchiverThread_ = std::thread{&LOG_SEGMENT_ARCHIVER::ArchiverLoop, this};
+}
+
+LOG_SEGMENT_ARCHIVER::~LOG_SEGMENT_ARCHIVER()
+{
+    {
+        std::lock_guard lock{Lock_};
+        Stopping_ = true;
+    }
+    JobQueued_.notify_one();
+    ArchiverThread_.join();
+}
+
+std::filesystem::path
+LOG_SEGMENT_ARCHIVER::MakeSegmentPath(
+    std::chrono::system_clock::time_point Opened
+) const
+{
+    auto opened = std::chrono::floor<std::chrono::milliseconds>(Opened);
+
+    for (;;) {
+        const auto seconds = std::chrono::floor<std::chrono::seconds>(opened);
+        const auto name = std::format(L"{}.{:%Y%m%d-%H%M%S}-{:03}{}",
+                                      ActivePath_.stem().wstring(),
+                                      seconds,
+                                      (opened - seconds).count(),
+                                      ActivePath_.extension().wstring());
+
+        auto path = ActivePath_;
+        path.replace_filename(name);
+
+        std::error_code error;
+        if (!exists(path, error) && !exists(std::filesystem::path{path}.replace_extension(SegmentExtension), error)) {
+            return path;
+        }
+
+        /* Names sort by time, so a later time resolves the collision without breaking the order. */
+        opened += std::chrono::milliseconds{1};
+    }
+}
+
+void
+LOG_SEGMENT_ARCHIVER::Archive(
+    std::filesystem::path SegmentPath,
+    std::vector<LOG_SEGMENT_CHECKPOINT> Checkpoints
+)
+{
+    {
+        std::lock_guard lock{Lock_};
+        Jobs_.push_back(JOB{std::move(SegmentPath), std::move(Checkpoints)});
+    }
+    JobQueued_.notify_one();
+}
+
+void
+LOG_SEGMENT_ARCHIVER::ArchiverLoop()
+{
+    EnforceRetention();
+
+    std::unique_lock lock{Lock_};
+
+    for (;;) {
+        JobQueued_.wait(lock, [this] {
+            return Stopping_ || !Jobs_.empty();
+        });
+
+        if (Jobs_.empty()) {
+            break;
+        }
+
+        const auto job = std::move(Jobs_.front());
+        Jobs_.pop_front();
+
+        lock.unlock();
+        Compress(job);
+        EnforceRetention();
+        lock.lock();
+    }
+}
+
+void
+LOG_SEGMENT_ARCHIVER::Compress(
+    const JOB &Job
+)
+{
+    std::error_code error;
+
+    std::ifstream input{Job.SegmentPath, std::ios::binary};
+    const auto size = file_size(Job.SegmentPath, error);
+    if (!input || error) {
+        /* Removed by the retention policy while it was queued. */
+        return;
+    }
+
+    auto temporaryPath = Job.SegmentPath;
+    temporaryPath.replace_extension(TemporaryExtension);
+    auto targetPath = Job.SegmentPath;
+    targetPath.replace_extension(SegmentExtension);
+
+    std::ofstream output{temporaryPath, std::ios::binary | std::ios::trunc};
+
+    SEGMENT_HEADER header{};
+    std::memcpy(header.Magic, SegmentMagic, sizeof(SegmentMagic));
+    header.Version = SegmentVersion;
+    header.UncompressedSize = size;
+    output.write(reinterpret_cast<const char *>(&header), sizeof(header));
+
+    auto checkpoints = Job.Checkpoints;
+    if (checkpoints.empty() || checkpoints.front().Offset != 0) {
+        checkpoints.insert(checkpoints.begin(), LOG_SEGMENT_CHECKPOINT{});
+    }
+
+    COMPRESSOR_HANDLE compressor = nullptr;
+    if (!CreateCompressor(COMPRESS_ALGORITHM_XPRESS_HUFF, nullptr, &compressor)) {
+        compressor = nullptr;
+    }
+
+    std::vector<SEGMENT_INDEX_ENTRY> index;
+    std::string block;
+    std::string compressed;
+    std::uint64_t compressedOffset = sizeof(header);
+
+    for (std::size_t i = 0; i < checkpoints.size(); ++i) {
+        const auto end = i + 1 < checkpoints.size()
+                             ? std::min<std::uint64_t>(checkpoints[i + 1].Offset, size)
+                             : size;
+        auto position = checkpoints[i].Offset;
+
+        while (position < end) {
+            /* Long stretches without a checkpoint are split at line ends and share its timestamp. */
+            auto length = static_cast<std::size_t>(std::min<std::uint64_t>(end - position, BlockBytes_ * 2));
+
+            block.resize(length);
+            input.seekg(static_cast<std::streamoff>(position));
+            input.read(block.data(), static_cast<std::streamsize>(length));
+
+            if (position + length < end) {
+                if (const auto newline = block.rfind('\n'); newline != std::string::npos) {
+                    length = newline + 1;
+                    block.resize(length);
+                }
+            }
+
+            /* A block that does not shrink is stored as is, marked by equal sizes. */
+            compressed.resize(length);
+            SIZE_T compressedSize = 0;
+            const char *data = block.data();
+            if (compressor &&
+                ::Compress(compressor, block.data(), length, compressed.data(), length, &compressedSize) &&
+                compressedSize < length) {
+                data = compressed.data();
+            } else {
+                compressedSize = length;
+            }
+
+            output.write(data, static_cast<std::streamsize>(compressedSize));
+
+            index.push_back(SEGMENT_INDEX_ENTRY{
+                ToUnixMicroseconds(checkpoints[i].Timestamp),
+                position,
+                compressedOffset,
+                static_cast<std::uint32_t>(length),
+                static_cast<std::uint32_t>(compressedSize)
+            });
+
+            compressedOffset += compressedSize;
+            position += length;
+        }
+    }
+
+    if (compressor) {
+        CloseCompressor(compressor);
+    }
+
+    output.write(reinterpret_cast<const char *>(index.data()),
+                 static_cast<std::streamsize>(index.size() * sizeof(SEGMENT_INDEX_ENTRY)));
+
+    header.BlockCount = static_cast<std::uint32_t>(index.size());
+    header.IndexOffset = compressedOffset;
+    output.seekp(0);
+    output.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    output.close();
+
+    const bool failed = !input || !output;
+    input.close();
+
+    if (failed) {
+        remove(temporaryPath, error);
+        OutputDebugStringW(std::format(L"LOG_SEGMENT_ARCHIVER: Failed to compress {}\n",
+                                       Job.SegmentPath.wstring()).c_str());
+        return;
+    }
+
+    rename(temporaryPath, targetPath, error);
+    if (!error) {
+        remove(Job.SegmentPath, error);
+    }
+}
+
+void
+LOG_SEGMENT_ARCHIVER::RecoverSegments()
+{
+    std::error_code error;
+    for (const auto &path : ListSegments(TemporaryExtension)) {
+        remove(path, error);
+    }
+
+    for (auto &path : ListSegments(ActivePath_.extension())) {
+        Jobs_.push_back(JOB{std::move(path), {}});
+    }
+}
+
+void
+LOG_SEGMENT_ARCHIVER::EnforceRetention()
+{
+    if (MaxSegments_ == 0) {
+        return;
+    }
+
+    auto segments = ListSegments(SegmentExtension);
+    auto pending = ListSegments(ActivePath_.extension());
+    segments.insert(segments.end(), pending.begin(), pending.end());
+
+    if (segments.size() <= MaxSegments_) {
+        return;
+    }
+
+    std::ranges::sort(segments, {}, &std::filesystem::path::filename);
+
+    std::error_code error;
+    for (std::size_t i = 0; i < segments.size() - MaxSegments_; ++i) {
+        remove(segments[i], error);
+    }
+}
+
+std::vector<std::filesystem::path>
+LOG_SEGMENT_ARCHIVER::ListSegments(
+    const std::filesystem::path &Extension
+) const
+{
+    std::vector<std::filesystem::path> segments;
+
+    auto directory = ActivePath_.parent_path();
+    if (directory.empty()) {
+        directory = L".";
+    }
+
+    const auto prefix = ActivePath_.stem().wstring() + L".";
+    const auto suffix = Extension.wstring();
+
+    std::error_code error;
+    for (const auto &entry : std::filesystem::directory_iterator{directory, error}) {
+        const auto name = entry.path().filename().wstring();
+        if (entry.is_regular_file(error) &&
+            name != ActivePath_.filename().wstring() &&
+            name.size() > prefix.size() + suffix.size() &&
+            name.starts_with(prefix) &&
+            name.ends_with(suffix)) {
+            segments.push_back(entry.path());
+        }
+    }
+
+    std::ranges::sort(segments, {}, &std::filesystem::path::filename);
+    return segments;
+}
+
+LOG_SEGMENT_READER::LOG_SEGMENT_READER(
+    const std::filesystem::path &Path
+) : File_(Path, std::ios::binary)
+{
+    SEGMENT_HEADER header{};
+    File_.read(reinterpret_cast<char *>(&header), sizeof(header));
+
+    if (!File_ ||
+        std::memcmp(header.Magic, SegmentMagic, sizeof(SegmentMagic)) != 0 ||
+        header.Version != SegmentVersion) {
+        throw LOG_SEGMENT_EXCEPTION{L"Not a log segment: " + Path.wstring()};
+    }
+
+    std::vector<SEGMENT_INDEX_ENTRY> index(header.BlockCount);
+    File_.seekg(static_cast<std::streamoff>(header.IndexOffset));
+    File_.read(reinterpret_cast<char *>(index.data()),
+               static_cast<std::streamsize>(index.size() * sizeof(SEGMENT_INDEX_ENTRY)));
+
+    if (!File_) {
+        throw LOG_SEGMENT_EXCEPTION{L"Truncated log segment index: " + Path.wstring()};
+    }
+
+    Blocks_.reserve(index.size());
+    for (const auto &entry : index) {
+        Blocks_.push_back(LOG_SEGMENT_BLOCK{
+            FromUnixMicroseconds(entry.Timestamp),
+            entry.Offset,
+            entry.CompressedOffset,
+            entry.Size,
+            entry.CompressedSize
+        });
+    }
+
+    DECOMPRESSOR_HANDLE decompressor = nullptr;
+    if (!CreateDecompressor(COMPRESS_ALGORITHM_XPRESS_HUFF, nullptr, &decompressor)) {
+        throw LOG_SEGMENT_EXCEPTION{"Failed to create the log segment decompressor"};
+    }
+    Decompressor_ = decompressor;
+}
+
+LOG_SEGMENT_READER::~LOG_SEGMENT_READER()
+{
+    if (Decompressor_) {
+        CloseDecompressor(static_cast<DECOMPRESSOR_HANDLE>(Decompressor_));
+    }
+}
+
+std::span<const LOG_SEGMENT_BLOCK>
+LOG_SEGMENT_READER::GetBlocks() const
+{
+    return Blocks_;
+}
+
+std::size_t
+LOG_SEGMENT_READER::FindBlock(
+    std::chrono::system_clock::time_point Timestamp
+) const
+{
+    auto iterator = std::ranges::upper_bound(Blocks_, Timestamp, {}, &LOG_SEGMENT_BLOCK::Timestamp);
+    if (iterator == Blocks_.begin()) {
+        return 0;
+    }
+    --iterator;
+
+    /* Blocks split from one checkpoint share its timestamp, the range starts at the first of them. */
+    while (iterator != Blocks_.begin() && std::prev(iterator)->Timestamp == iterator->Timestamp) {
+        --iterator;
+    }
+
+    return static_cast<std::size_t>(iterator - Blocks_.begin());
+}
+
+std::string
+LOG_SEGMENT_READER::ReadBlock(
+    std::size_t Index
+)
+{
+    if (Index >= Blocks_.size()) {
+        throw LOG_SEGMENT_EXCEPTION{"Log segment block index is out of range"};
+    }
+
+    const auto &block = Blocks_[Index];
+
+    std::string compressed(block.CompressedSize, '\0');
+    File_.clear();
+    File_.seekg(static_cast<std::streamoff>(block.CompressedOffset));
+    File_.read(compressed.data(), static_cast<std::streamsize>(compressed.size()));
+
+    if (!File_) {
+        throw LOG_SEGMENT_EXCEPTION{"Failed to read a log segment block"};
+    }
+
+    if (block.CompressedSize == block.Size) {
+        return compressed;
+    }
+
+    std::string text(block.Size, '\0');
+    SIZE_T size = 0;
+    if (!Decompress(static_cast<DECOMPRESSOR_HANDLE>(Decompressor_),
+                    compressed.data(),
+                    compressed.size(),
+                    text.data(),
+                    text.size(),
+                    &size) ||
+        size != block.Size) {
+        throw LOG_SEGMENT_EXCEPTION{"Failed to decompress a log segment block"};
+    }
+
+    return text;
+}
+
+std::string
+LOG_SEGMENT_READER::ReadRange(
+    std::chrono::system_clock::time_point From,
+    std::chrono::system_clock::time_point To
+)
+{
+    std::string text;
+
+    for (auto i = FindBlock(From); i < Blocks_.size() && Blocks_[i].Timestamp <= To; ++i) {
+        text += ReadBlock(i);
+    }
+
+    return text;
+}
+
+}
@@ -0,0 +1,225 @@
+﻿/*!
+ *  @file       logsegm.hpp
+ *  @brief      Logging system: Compressed log segments.
+ *  @details    A rotated log file is stored as a segment: a sequence of
+ *              independently compressed blocks followed by a seek index that
+ *              maps the first timestamp of every block to its offsets. A
+ *              viewer decompresses only the blocks of the time range it shows.
+ *
+ *              Segment layout, all integers little-endian:
+ *              - header: magic "NTLS", version, block count, index offset and
+ *                uncompressed size;
+ *              - blocks: XPRESS Huffman compressed UTF-8 text, a block whose
+ *                compressed size equals its size is stored as is;
+ *              - index: one entry per block with the timestamp in
+ *                microseconds since the Unix epoch, the uncompressed offset,
+ *                the compressed offset and both sizes.
+ */
+
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <span>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "excption.hpp"
+
+namespace Common::Log {
+
+class LOG_SEGMENT_EXCEPTION : public Util::BUF_EXCEPTION {
+public:
+    using BUF_EXCEPTION::BUF_EXCEPTION;
+};
+
+/**
+ * @brief Seek index checkpoint recorded while a segment is written.
+ */
+class LOG_SEGMENT_CHECKPOINT {
+public:
+    /*!
+     * Timestamp of the first entry at Offset. The default value means that
+     * the time of the entries is unknown, such as for text written by an
+     * earlier run of the application.
+     */
+    std::chrono::system_clock::time_point Timestamp;
+
+    /*!
+     * Offset of the entry in the uncompressed segment.
+     */
+    std::uint64_t Offset = 0;
+};
+
+/**
+ * @brief Seek index entry of a compressed segment.
+ */
+class LOG_SEGMENT_BLOCK {
+public:
+    std::chrono::system_clock::time_point Timestamp;
+    std::uint64_t Offset = 0;
+    std::uint64_t CompressedOffset = 0;
+    std::uint32_t Size = 0;
+    std::uint32_t CompressedSize = 0;
+};
+
+/**
+ * @brief Background compressor of rotated log files.
+ * @details Rotated files are named after the active log file with the UTC
+ * time the segment was opened inserted before the extension, for example
+ * log.20240131-235959-250.txt. The archiver compresses them one at a time
+ * into segments with the .lgz extension on its own thread, deletes the text
+ * file and then removes the oldest segments beyond the retention count.
+ * Rotated files left behind by an earlier run are compressed on startup.
+ */
+class LOG_SEGMENT_ARCHIVER {
+public:
+    /**
+     * @brief Constructs an archiver for the segments of a log file.
+     * @param ActivePath The path of the log file that is being written.
+     * @param MaxSegments The number of segments to keep, 0 keeps all of them.
+     * @param BlockBytes The preferred uncompressed size of a block.
+     */
+    LOG_SEGMENT_ARCHIVER(
+        const std::filesystem::path &ActivePath,
+        std::size_t MaxSegments,
+        std::size_t BlockBytes
+    );
+
+    /**
+     * @brief Compresses the files queued so far and stops the archiver thread.
+     */
+    ~LOG_SEGMENT_ARCHIVER();
+
+    LOG_SEGMENT_ARCHIVER(const LOG_SEGMENT_ARCHIVER &) = delete;
+    LOG_SEGMENT_ARCHIVER &operator=(const LOG_SEGMENT_ARCHIVER &) = delete;
+
+    /**
+     * @brief Returns the path to rename the active log file to on rotation.
+     * @param Opened The time the segment was opened.
+     */
+    std::filesystem::path
+    MakeSegmentPath(
+        std::chrono::system_clock::time_point Opened
+    ) const;
+
+    /**
+     * @brief Queues a rotated log file for compression.
+     * @param SegmentPath The path of the rotated file.
+     * @param Checkpoints The checkpoints recorded while the file was written,
+     * ordered by offset.
+     */
+    void
+    Archive(
+        std::filesystem::path SegmentPath,
+        std::vector<LOG_SEGMENT_CHECKPOINT> Checkpoints
+    );
+
+private:
+    class JOB {
+    public:
+        std::filesystem::path SegmentPath;
+        std::vector<LOG_SEGMENT_CHECKPOINT> Checkpoints;
+    };
+
+    void
+    ArchiverLoop();
+
+    void
+    Compress(
+        const JOB &Job
+    );
+
+    /**
+     * @brief Queues the rotated text files of an earlier run.
+     */
+    void
+    RecoverSegments();
+
+    void
+    EnforceRetention();
+
+    /**
+     * @brief Returns the rotated files with the specified extension, oldest first.
+     */
+    std::vector<std::filesystem::path>
+    ListSegments(
+        const std::filesystem::path &Extension
+    ) const;
+
+    std::filesystem::path ActivePath_;
+    std::size_t MaxSegments_;
+    std::size_t BlockBytes_;
+    std::mutex Lock_;
+    std::condition_variable JobQueued_;
+    std::deque<JOB> Jobs_;
+    bool Stopping_ = false;
+    std::thread ArchiverThread_;
+};
+
+/**
+ * @brief Reader of compressed log segments.
+ */
+class LOG_SEGMENT_READER {
+public:
+    /**
+     * @brief Opens a segment and loads its seek index.
+     * @param Path The path of the segment.
+     * @throws LOG_SEGMENT_EXCEPTION if the file is not a valid segment.
+     */
+    explicit
+    LOG_SEGMENT_READER(
+        const std::filesystem::path &Path
+    );
+
+    ~LOG_SEGMENT_READER();
+
+    LOG_SEGMENT_READER(const LOG_SEGMENT_READER &) = delete;
+    LOG_SEGMENT_READER &operator=(const LOG_SEGMENT_READER &) = delete;
+
+    std::span<const LOG_SEGMENT_BLOCK>
+    GetBlocks() const;
+
+    /**
+     * @brief Returns the index of the first block that may contain entries
+     * logged at or after the specified time.
+     */
+    std::size_t
+    FindBlock(
+        std::chrono::system_clock::time_point Timestamp
+    ) const;
+
+    /**
+     * @brief Decompresses a block.
+     * @return The UTF-8 text of the block.
+     */
+    std::string
+    ReadBlock(
+        std::size_t Index
+    );
+
+    /**
+     * @brief Decompresses the blocks that may contain entries of a time range.
+     * @details The result consists of whole blocks, so it starts and ends
+     * with entries outside of the range that the caller filters out.
+     * @return The UTF-8 text of the blocks.
+     */
+    std::string
+    ReadRange(
+        std::chrono::system_clock::time_point From,
+        std::chrono::system_clock::time_point To
+    );
+
+private:
+    std::ifstream File_;
+    std::vector<LOG_SEGMENT_BLOCK> Blocks_;
+    void *Decompressor_ = nullptr;
+};
+
+}
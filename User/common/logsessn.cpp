@@ -4,14 +4,21 @@
  */
 
 #include "logsessn.hpp"
+
+#include <algorithm>
+
+#include "logchan.hpp"
 #include "logprov.hpp"
 
 namespace Common::Log {
 
 LOG_SESSION_IMPL::LOG_SESSION_IMPL(
     std::vector<std::shared_ptr<LOG_PROVIDER_BASE>> LogProviders
-) : LogProviders_(std::move(LogProviders))
+)
 {
+    for (auto &provider : LogProviders) {
+        RegisterProvider(std::move(provider));
+    }
 }
 
 LOG_SESSION_IMPL::~LOG_SESSION_IMPL() = default;
@@ -21,16 +28,43 @@ LOG_SESSION_IMPL::Write(
     LOG_ENTRY &LogEntry
 )
 {
-    for (const auto &provider : LogProviders_) {
-        provider->Write(LogEntry);
+    const auto channels = Channels_.Read();
+
+    /*
+     * Synchronous channels only read the entry. Every queued channel but the
+     * last queues a copy, the last one takes the entry once the others are done.
+     */
+    LOG_DELIVERY_CHANNEL *last = nullptr;
+    for (const auto &channel : *channels) {
+        if (channel->IsQueued()) {
+            last = channel.get();
+        }
+    }
+
+    for (const auto &channel : *channels) {
+        if (channel.get() == last) {
+            continue;
+        }
+        if (channel->IsQueued()) {
+            LOG_ENTRY copy{LogEntry};
+            channel->Write(copy);
+        } else {
+            channel->Write(LogEntry);
+        }
+    }
+
+    if (last) {
+        last->Write(LogEntry);
     }
 }
 
 void
 LOG_SESSION_IMPL::Flush()
 {
-    for (const auto &provider : LogProviders_) {
-        provider->Flush();
+    const auto channels = Channels_.Read();
+
+    for (const auto &channel : *channels) {
+        channel->Flush();
     }
 }
 
@@ -39,7 +73,53 @@ LOG_SESSION_IMPL::RegisterProvider(
     std::shared_ptr<LOG_PROVIDER_BASE> LogProvider
 )
 {
-    LogProviders_.push_back(std::move(LogProvider));
+    RegisterProvider(std::move(LogProvider), LOG_DELIVERY_POLICY{});
+}
+
+void
+LOG_SESSION_IMPL::RegisterProvider(
+    std::shared_ptr<LOG_PROVIDER_BASE> LogProvider,
+    LOG_DELIVERY_POLICY DeliveryPolicy
+)
+{
+    auto channel = std::make_shared<LOG_DELIVERY_CHANNEL>(std::move(LogProvider), DeliveryPolicy);
+
+    Channels_.Update([&](CHANNEL_LIST &Channels) {
+        Channels.push_back(std::move(channel));
+    });
+}
+
+void
+LOG_SESSION_IMPL::UnregisterProvider(
+    const std::shared_ptr<LOG_PROVIDER_BASE> &LogProvider
+)
+{
+    std::shared_ptr<LOG_DELIVERY_CHANNEL> removed;
+
+    Channels_.Update([&](CHANNEL_LIST &Channels) {
+        const auto iterator = std::ranges::find(Channels, LogProvider, &LOG_DELIVERY_CHANNEL::GetProvider);
+        if (iterator != Channels.end()) {
+            removed = std::move(*iterator);
+            Channels.erase(iterator);
+        }
+    });
+
+    /*
+     * The grace period has ended, no writer can reach the channel anymore.
+     * Its destructor delivers the queued entries and flushes the provider.
+     */
+    removed.reset();
+}
+
+std::uint64_t
+LOG_SESSION_IMPL::GetDroppedCount(
+    const std::shared_ptr<LOG_PROVIDER_BASE> &LogProvider
+) const
+{
+    const auto channels = Channels_.Read();
+
+    const auto iterator = std::ranges::find(*channels, LogProvider, &LOG_DELIVERY_CHANNEL::GetProvider);
+    return iterator != channels->end() ? (*iterator)->GetDroppedCount() : 0;
 }
 
 }
@@ -1,17 +1,54 @@
-/*!
+﻿/*!
  *  @file       logsessn.hpp
  *  @brief      Logging system: Log session.
  */
 
 #pragma once
 
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
 #include <memory>
 #include <vector>
 
+#include "loglevel.hpp"
+#include "rcu.hpp"
+
 namespace Common::Log {
 
 class LOG_ENTRY;
 class LOG_PROVIDER_BASE;
+class LOG_DELIVERY_CHANNEL;
+
+/**
+ * @brief Behavior of a producer when the log queue is full.
+ */
+enum class LOG_OVERFLOW_POLICY {
+    Block,      /*!< Wait until the consumer makes room. No entry is lost. */
+    DropNewest, /*!< Discard the entry being written. */
+    DropOldest  /*!< Discard the oldest queued entry to make room. */
+};
+
+/**
+ * @brief Delivery parameters of a log provider in LOG_SESSION_IMPL.
+ */
+class LOG_DELIVERY_POLICY {
+public:
+    LOG_OVERFLOW_POLICY OverflowPolicy = LOG_OVERFLOW_POLICY::Block;
+
+    /*!
+     * Minimum number of entries queued for the provider. 0 writes the
+     * entries to the provider on the logging thread instead.
+     */
+    std::size_t Capacity = 4096;
+
+    /*!
+     * With a Capacity of 0, the provider synchronizes itself: entries are
+     * written without the delivery lock, concurrently from every logging
+     * thread.
+     */
+    bool Concurrent = false;
+};
 
 /**
  * @brief Base class for log sessions.
@@ -46,22 +83,66 @@ public:
     RegisterProvider(
         std::shared_ptr<LOG_PROVIDER_BASE> LogProvider
     ) = 0;
+
+    /**
+     * @brief Sets the least severe level that the session accepts.
+     * @param Level The minimum log level.
+     */
+    void
+    SetMinimumLevel(
+        LOG_LEVEL Level
+    )
+    {
+        MinimumLevel_.store(Level, std::memory_order_relaxed);
+    }
+
+    LOG_LEVEL
+    GetMinimumLevel() const
+    {
+        return MinimumLevel_.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief Checks whether entries of the given level are accepted by the session.
+     * @param Level The log level to check.
+     */
+    bool
+    IsLevelEnabled(
+        LOG_LEVEL Level
+    ) const
+    {
+        return Level <= MinimumLevel_.load(std::memory_order_relaxed);
+    }
+
+private:
+    std::atomic<LOG_LEVEL> MinimumLevel_ = LOG_LEVEL::Verbose;
 };
 
 /**
  * @brief Log session implementation.
+ * @details Every provider is fed by its own LOG_DELIVERY_CHANNEL, with a
+ * queue, a worker thread and an overflow policy of its own, so a slow
+ * provider only holds back itself. The channel list is published through
+ * an RCU cell: Write reads it without a lock, while registering or
+ * unregistering a provider copies the list and the channel of a removed
+ * provider is drained and destroyed after a grace period.
+ *
+ * Flush delivers every entry written before the call to every provider
+ * registered at the time, except entries dropped by an overflow policy,
+ * and then flushes the providers.
  */
 class LOG_SESSION_IMPL : public LOG_SESSION_BASE {
 public:
     /**
      * @brief Constructs a log session with the specified log providers.
-     * @param LogProviders Vector of log providers to initialize the session with.
+     * @param LogProviders Vector of log providers to initialize the session with,
+     * delivered with the default LOG_DELIVERY_POLICY.
      */
     LOG_SESSION_IMPL(
         std::vector<std::shared_ptr<LOG_PROVIDER_BASE>> LogProviders = {}
     );
 
-    ~LOG_SESSION_IMPL();
+    ~LOG_SESSION_IMPL() override;
 
     void
     Write(
@@ -73,11 +154,42 @@ public:
 
     void
     RegisterProvider(
-        std::shared_ptr<LOG_PROVIDER_BASE>
+        std::shared_ptr<LOG_PROVIDER_BASE> LogProvider
     ) override;
 
+    /**
+     * @brief Registers a log provider with its own delivery policy.
+     * @param LogProvider The log provider to register.
+     * @param DeliveryPolicy The queue capacity and overflow policy of the provider.
+     */
+    void
+    RegisterProvider(
+        std::shared_ptr<LOG_PROVIDER_BASE> LogProvider,
+        LOG_DELIVERY_POLICY DeliveryPolicy
+    );
+
+    /**
+     * @brief Removes a log provider. Entries queued for it are delivered and
+     * the provider is flushed before the call returns.
+     * @param LogProvider The log provider to remove.
+     */
+    void
+    UnregisterProvider(
+        const std::shared_ptr<LOG_PROVIDER_BASE> &LogProvider
+    );
+
+    /**
+     * @brief Returns the number of entries discarded for a provider because its queue was full.
+     */
+    std::uint64_t
+    GetDroppedCount(
+        const std::shared_ptr<LOG_PROVIDER_BASE> &LogProvider
+    ) const;
+
 private:
-    std::vector<std::shared_ptr<LOG_PROVIDER_BASE>> LogProviders_;
+    using CHANNEL_LIST = std::vector<std::shared_ptr<LOG_DELIVERY_CHANNEL>>;
+
+    Util::RCU_CELL<CHANNEL_LIST> Channels_;
 };
 
 }
@@ -0,0 +1,137 @@
+﻿/*!
+ *  @file       logsite.cpp
+ *  @brief      Logging system: Log call sites.
+ */
+
+#include "logsite.hpp"
+
+#include <algorithm>
+#include <cwctype>
+
+namespace Common::Log {
+
+namespace {
+
+bool
+MatchesSourceFile(
+    std::wstring_view SourceFileName,
+    std::wstring_view Pattern
+)
+{
+    if (Pattern.empty() || Pattern.size() > SourceFileName.size()) {
+        return false;
+    }
+
+    const auto tail = SourceFileName.substr(SourceFileName.size() - Pattern.size());
+    const bool matches = std::equal(tail.begin(), tail.end(), Pattern.begin(), [](wchar_t Left, wchar_t Right) {
+        return std::towlower(Left) == std::towlower(Right);
+    });
+
+    if (!matches) {
+        return false;
+    }
+
+    if (tail.size() == SourceFileName.size()) {
+        return true;
+    }
+
+    const wchar_t separator = SourceFileName[SourceFileName.size() - Pattern.size() - 1];
+    return separator == L'\\' || separator == L'/';
+}
+
+}
+
+LOG_SITE::STATE
+LOG_SITE::Register()
+{
+    return GetLogSiteRegistry().Register(*this);
+}
+
+void
+LOG_SITE_REGISTRY::Enable(
+    std::wstring_view SourceFileName,
+    int SourceLine
+)
+{
+    AddRule({std::wstring{SourceFileName}, SourceLine, true});
+}
+
+void
+LOG_SITE_REGISTRY::Disable(
+    std::wstring_view SourceFileName,
+    int SourceLine
+)
+{
+    AddRule({std::wstring{SourceFileName}, SourceLine, false});
+}
+
+void
+LOG_SITE_REGISTRY::Reset()
+{
+    std::lock_guard lock{Lock_};
+
+    Rules_.clear();
+    for (auto site = Sites_; site; site = site->Next_) {
+        site->State_.store(LOG_SITE::STATE::Default, std::memory_order_relaxed);
+    }
+}
+
+void
+LOG_SITE_REGISTRY::AddRule(
+    RULE Rule
+)
+{
+    std::lock_guard lock{Lock_};
+
+    Rules_.push_back(std::move(Rule));
+    for (auto site = Sites_; site; site = site->Next_) {
+        site->State_.store(Evaluate(*site), std::memory_order_relaxed);
+    }
+}
+
+LOG_SITE::STATE
+LOG_SITE_REGISTRY::Register(
+    LOG_SITE &Site
+)
+{
+    std::lock_guard lock{Lock_};
+
+    /* Another thread may have registered the site while this one waited. */
+    auto state = Site.State_.load(std::memory_order_relaxed);
+    if (state != LOG_SITE::STATE::Unresolved) {
+        return state;
+    }
+
+    Site.Next_ = Sites_;
+    Sites_ = &Site;
+
+    state = Evaluate(Site);
+    Site.State_.store(state, std::memory_order_relaxed);
+    return state;
+}
+
+LOG_SITE::STATE
+LOG_SITE_REGISTRY::Evaluate(
+    const LOG_SITE &Site
+) const
+{
+    for (auto rule = Rules_.rbegin(); rule != Rules_.rend(); ++rule) {
+        if ((rule->SourceLine == 0 || rule->SourceLine == Site.SourceLine_) &&
+            MatchesSourceFile(Site.SourceFileName_, rule->SourceFileName)) {
+            return rule->Enabled
+                       ? LOG_SITE::STATE::Forced
+                       : LOG_SITE::STATE::Default;
+        }
+    }
+
+    return LOG_SITE::STATE::Default;
+}
+
+LOG_SITE_REGISTRY &
+GetLogSiteRegistry()
+{
+    static LOG_SITE_REGISTRY logSiteRegistry;
+    return logSiteRegistry;
+}
+
+}
@@ -0,0 +1,161 @@
+﻿/*!
+ *  @file       logsite.hpp
+ *  @brief      Logging system: Log call sites.
+ *  @details    Every LOG_<LEVEL> macro expansion owns a statically initialized
+ *              LOG_SITE. A site registers itself on first use and from then on
+ *              answers whether it has been switched on at runtime with a single
+ *              relaxed atomic load. Sites that are switched on are logged
+ *              regardless of the minimum level of the session.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace Common::Log {
+
+class LOG_SITE_REGISTRY;
+
+/**
+ * @brief A single log call site, identified by its source file and line.
+ */
+class LOG_SITE {
+public:
+    constexpr
+    LOG_SITE(
+        const wchar_t *SourceFileName,
+        int SourceLine
+    ) : SourceFileName_(SourceFileName),
+        SourceLine_(SourceLine)
+    {
+    }
+
+    LOG_SITE(const LOG_SITE &) = delete;
+
+    LOG_SITE &
+    operator=(const LOG_SITE &) = delete;
+
+    /**
+     * @brief Checks whether the site has been switched on at runtime.
+     * @return true if the site must be logged regardless of the session minimum level.
+     */
+    bool
+    IsForced()
+    {
+        auto state = State_.load(std::memory_order_relaxed);
+        if (state == STATE::Unresolved) [[unlikely]] {
+            state = Register();
+        }
+        return state == STATE::Forced;
+    }
+
+    const wchar_t *
+    GetSourceFileName() const
+    {
+        return SourceFileName_;
+    }
+
+    int
+    GetSourceLine() const
+    {
+        return SourceLine_;
+    }
+
+private:
+    friend LOG_SITE_REGISTRY;
+
+    enum class STATE : std::uint8_t {
+        Unresolved,
+        Default,
+        Forced
+    };
+
+    STATE
+    Register();
+
+    const wchar_t *SourceFileName_;
+    int SourceLine_;
+    std::atomic<STATE> State_ = STATE::Unresolved;
+    LOG_SITE *Next_ = nullptr;
+};
+
+/**
+ * @brief Registry of all log call sites that have been reached.
+ * @details Rules are matched against the end of the source file path, at a
+ * path separator boundary and case-insensitively, so "logprov.cpp" and
+ * "common\logprov.cpp" both select User\common\logprov.cpp. A rule with a
+ * source line of 0 selects every site in the file. The last matching rule wins.
+ */
+class LOG_SITE_REGISTRY {
+public:
+    /**
+     * @brief Switches on the matching log sites.
+     * @param SourceFileName Trailing part of the source file path.
+     * @param SourceLine The source line, or 0 for every site in the file.
+     */
+    void
+    Enable(
+        std::wstring_view SourceFileName,
+        int SourceLine = 0
+    );
+
+    /**
+     * @brief Switches off the matching log sites.
+     * @param SourceFileName Trailing part of the source file path.
+     * @param SourceLine The source line, or 0 for every site in the file.
+     */
+    void
+    Disable(
+        std::wstring_view SourceFileName,
+        int SourceLine = 0
+    );
+
+    /**
+     * @brief Removes all rules and switches off every site.
+     */
+    void
+    Reset();
+
+private:
+    friend LOG_SITE;
+
+    class RULE {
+    public:
+        std::wstring SourceFileName;
+        int SourceLine;
+        bool Enabled;
+    };
+
+    void
+    AddRule(
+        RULE Rule
+    );
+
+    LOG_SITE::STATE
+    Register(
+        LOG_SITE &Site
+    );
+
+    LOG_SITE::STATE
+    Evaluate(
+        const LOG_SITE &Site
+    ) const;
+
+    std::mutex Lock_;
+    LOG_SITE *Sites_ = nullptr;
+    std::vector<RULE> Rules_;
+};
+
+/*!
+ * @brief Log site registry accessor.
+ * @return The process-wide log site registry.
+ */
+LOG_SITE_REGISTRY &
+GetLogSiteRegistry();
+
+}
@@ -0,0 +1,369 @@
+﻿/*!
+ *  @file       logstruc.cpp
+ *  @brief      Logging system: Structured log formatter.
+ */
+
+#include "logstruc.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <format>
+#include <type_traits>
+
+#include "log.hpp"
+#include "strutil.hpp"
+
+namespace Common::Log {
+
+namespace {
+
+void
+AppendAscii(
+    std::wstring_view Text,
+    std::string &Output
+)
+{
+    for (const auto character : Text) {
+        Output += static_cast<char>(character);
+    }
+}
+
+/*!
+ * @brief Appends a JSON string literal, escaping the characters JSON
+ * requires and encoding the runs in between straight to UTF-8.
+ */
+template<class CHAR>
+void
+AppendJsonString(
+    std::basic_string_view<CHAR> Text,
+    std::string &Output
+)
+{
+    Output += '"';
+
+    std::size_t runBegin = 0;
+    const auto flushRun = [&](std::size_t RunEnd) {
+        const auto run = Text.substr(runBegin, RunEnd - runBegin);
+        if constexpr (std::is_same_v<CHAR, wchar_t>) {
+            Util::AppendUtf8(run, Output);
+        } else {
+            Output += run;
+        }
+    };
+
+    for (std::size_t i = 0; i < Text.size(); ++i) {
+        const auto character = static_cast<std::uint32_t>(static_cast<std::make_unsigned_t<CHAR>>(Text[i]));
+        if (character != '"' && character != '\\' && character >= 0x20) {
+            continue;
+        }
+
+        flushRun(i);
+        runBegin = i + 1;
+
+        switch (character) {
+        case '"':
+            Output += "\\\"";
+            break;
+        case '\\':
+            Output += "\\\\";
+            break;
+        case '\n':
+            Output += "\\n";
+            break;
+        case '\r':
+            Output += "\\r";
+            break;
+        case '\t':
+            Output += "\\t";
+            break;
+        default:
+            std::format_to(std::back_inserter(Output), "\\u{:04x}", character);
+            break;
+        }
+    }
+
+    flushRun(Text.size());
+    Output += '"';
+}
+
+/*!
+ * @brief Appends the timestamp in ISO 8601 UTC. The text up to the seconds
+ * is rendered once per second and thread.
+ */
+void
+AppendJsonTimestamp(
+    std::chrono::system_clock::time_point Timestamp,
+    std::string &Output
+)
+{
+    using namespace std::chrono;
+
+    thread_local sys_seconds cachedSecond = sys_seconds::min();
+    thread_local std::string cachedText;
+
+    const auto second = floor<seconds>(Timestamp);
+    if (second != cachedSecond) {
+        cachedSecond = second;
+        cachedText.clear();
+        std::format_to(std::back_inserter(cachedText), "{:%FT%T}", second);
+    }
+
+    Output += '"';
+    Output += cachedText;
+
+    constexpr auto fractionalWidth = hh_mm_ss<system_clock::duration>::fractional_width;
+    if constexpr (fractionalWidth > 0) {
+        char digits[fractionalWidth];
+        auto fraction = (Timestamp - second).count();
+        for (auto i = fractionalWidth; i > 0; --i) {
+            digits[i - 1] = static_cast<char>('0' + fraction % 10);
+            fraction /= 10;
+        }
+        Output += '.';
+        Output.append(digits, fractionalWidth);
+    }
+
+    Output += "Z\"";
+}
+
+void
+AppendJsonField(
+    const LOG_FIELD &Field,
+    std::string &Output
+)
+{
+    AppendJsonString(Field.Key, Output);
+    Output += ':';
+
+    switch (Field.Type) {
+    case LOG_FIELD_TYPE::Signed:
+    case LOG_FIELD_TYPE::Duration:
+        std::format_to(std::back_inserter(Output), "{}", static_cast<std::int64_t>(Field.Integer));
+        break;
+    case LOG_FIELD_TYPE::Unsigned:
+        std::format_to(std::back_inserter(Output), "{}", Field.Integer);
+        break;
+    case LOG_FIELD_TYPE::Bool:
+        Output += Field.Integer ? "true" : "false";
+        break;
+    case LOG_FIELD_TYPE::Pointer:
+        std::format_to(std::back_inserter(Output), "\"{:#x}\"", Field.Integer);
+        break;
+    case LOG_FIELD_TYPE::WideString:
+        AppendJsonString(Field.WideString, Output);
+        break;
+    case LOG_FIELD_TYPE::NarrowString:
+        AppendJsonString(Field.NarrowString, Output);
+        break;
+    }
+}
+
+/*!
+ * @brief Starts a TLV element whose length is patched by EndTlv.
+ * @return The offset of the length.
+ */
+std::size_t
+BeginTlv(
+    LOG_TLV_TAG Tag,
+    std::string &Output
+)
+{
+    Output += static_cast<char>(Tag);
+    const auto lengthOffset = Output.size();
+    Output.append(sizeof(std::uint32_t), '\0');
+    return lengthOffset;
+}
+
+void
+EndTlv(
+    std::size_t LengthOffset,
+    std::string &Output
+)
+{
+    const auto length = static_cast<std::uint32_t>(Output.size() - LengthOffset - sizeof(std::uint32_t));
+    std::memcpy(Output.data() + LengthOffset, &length, sizeof(length));
+}
+
+template<class T>
+void
+AppendTlvInteger(
+    LOG_TLV_TAG Tag,
+    T Value,
+    std::string &Output
+)
+{
+    const auto lengthOffset = BeginTlv(Tag, Output);
+    Output.append(reinterpret_cast<const char *>(&Value), sizeof(Value));
+    EndTlv(lengthOffset, Output);
+}
+
+void
+AppendTlvText(
+    LOG_TLV_TAG Tag,
+    std::wstring_view Text,
+    std::string &Output
+)
+{
+    const auto lengthOffset = BeginTlv(Tag, Output);
+    Util::AppendUtf8(Text, Output);
+    EndTlv(lengthOffset, Output);
+}
+
+/*!
+ * @brief Returns the message of an entry without copying a plain message.
+ */
+std::wstring_view
+ViewMessage(
+    const LOG_ENTRY &LogEntry
+)
+{
+    thread_local std::wstring rendered;
+
+    if (LogEntry.LogRecord.IsEmpty()) {
+        return LogEntry.LogData.View();
+    }
+
+    rendered.clear();
+    LogEntry.LogRecord.RenderTo(rendered);
+    return rendered;
+}
+
+}
+
+LOG_STRUCTURED_FORMATTER::LOG_STRUCTURED_FORMATTER(
+    LOG_STRUCTURED_ENCODING Encoding
+) : Encoding_(Encoding)
+{
+}
+
+std::wstring
+LOG_STRUCTURED_FORMATTER::FormatLogEntry(
+    const LOG_ENTRY &LogEntry
+)
+{
+    std::wstring output;
+    FormatLogEntryTo(LogEntry, output);
+    return output;
+}
+
+void
+LOG_STRUCTURED_FORMATTER::FormatLogEntryTo(
+    const LOG_ENTRY &LogEntry,
+    std::wstring &Output
+)
+{
+    thread_local std::string encoded;
+
+    encoded.clear();
+    FormatJson(LogEntry, encoded);
+    Util::AppendUtf16(encoded, Output);
+}
+
+void
+LOG_STRUCTURED_FORMATTER::FormatLogEntryUtf8(
+    const LOG_ENTRY &LogEntry,
+    std::string &Output
+)
+{
+    if (Encoding_ == LOG_STRUCTURED_ENCODING::Tlv) {
+        FormatTlv(LogEntry, Output);
+    } else {
+        FormatJson(LogEntry, Output);
+    }
+}
+
+void
+LOG_STRUCTURED_FORMATTER::FormatJson(
+    const LOG_ENTRY &LogEntry,
+    std::string &Output
+)
+{
+    Output += "{\"ts\":";
+    AppendJsonTimestamp(LogEntry.LogTimestamp.ToTimePoint(), Output);
+    Output += ",\"level\":\"";
+    AppendAscii(LogLevelName(LogEntry.LogLevel), Output);
+    Output += "\",\"msg\":";
+    AppendJsonString(ViewMessage(LogEntry), Output);
+    Output += ",\"file\":";
+    AppendJsonString(std::wstring_view{LogEntry.SourceFileName ? LogEntry.SourceFileName : L""}, Output);
+    Output += ",\"func\":";
+    AppendJsonString(std::wstring_view{LogEntry.FunctionName ? LogEntry.FunctionName : L""}, Output);
+    std::format_to(std::back_inserter(Output), ",\"line\":{}", LogEntry.SourceLine);
+
+    if (LogEntry.HResult) {
+        std::format_to(std::back_inserter(Output), ",\"hresult\":\"{:#010x}\"", *LogEntry.HResult);
+    }
+
+    if (!LogEntry.Fields.IsEmpty()) {
+        bool first = true;
+        Output += ",\"fields\":{";
+        LogEntry.Fields.ForEach([&](const LOG_FIELD &Field) {
+            if (!first) {
+                Output += ',';
+            }
+            first = false;
+            AppendJsonField(Field, Output);
+        });
+        Output += '}';
+
+        if (LogEntry.Fields.IsTruncated()) {
+            Output += ",\"fields_truncated\":true";
+        }
+    }
+
+    Output += "}\n";
+}
+
+void
+LOG_STRUCTURED_FORMATTER::FormatTlv(
+    const LOG_ENTRY &LogEntry,
+    std::string &Output
+)
+{
+    const auto entryOffset = BeginTlv(LOG_TLV_TAG::Entry, Output);
+
+    const auto timestamp = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        LogEntry.LogTimestamp.ToTimePoint().time_since_epoch()).count();
+    AppendTlvInteger(LOG_TLV_TAG::Timestamp, static_cast<std::int64_t>(timestamp), Output);
+    AppendTlvInteger(LOG_TLV_TAG::Level, static_cast<std::uint8_t>(LogEntry.LogLevel), Output);
+    AppendTlvText(LOG_TLV_TAG::Message, ViewMessage(LogEntry), Output);
+    AppendTlvText(LOG_TLV_TAG::SourceFile, LogEntry.SourceFileName ? LogEntry.SourceFileName : L"", Output);
+    AppendTlvText(LOG_TLV_TAG::Function, LogEntry.FunctionName ? LogEntry.FunctionName : L"", Output);
+    AppendTlvInteger(LOG_TLV_TAG::SourceLine, static_cast<std::int32_t>(LogEntry.SourceLine), Output);
+
+    if (LogEntry.HResult) {
+        AppendTlvInteger(LOG_TLV_TAG::Hresult, static_cast<std::uint32_t>(*LogEntry.HResult), Output);
+    }
+
+    LogEntry.Fields.ForEach([&](const LOG_FIELD &Field) {
+        const auto fieldOffset = BeginTlv(LOG_TLV_TAG::Field, Output);
+
+        const auto keyLength = std::min<std::size_t>(Field.Key.size(), 0xFF);
+        Output += static_cast<char>(keyLength);
+        Output.append(Field.Key.data(), keyLength);
+        Output += static_cast<char>(Field.Type);
+
+        switch (Field.Type) {
+        case LOG_FIELD_TYPE::WideString:
+            Util::AppendUtf8(Field.WideString, Output);
+            break;
+        case LOG_FIELD_TYPE::NarrowString:
+            Output += Field.NarrowString;
+            break;
+        default:
+            Output.append(reinterpret_cast<const char *>(&Field.Integer), sizeof(Field.Integer));
+            break;
+        }
+
+        EndTlv(fieldOffset, Output);
+    });
+
+    if (LogEntry.Fields.IsTruncated()) {
+        EndTlv(BeginTlv(LOG_TLV_TAG::FieldsTruncated, Output), Output);
+    }
+
+    EndTlv(entryOffset, Output);
+}
+
+}
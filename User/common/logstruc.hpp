@@ -0,0 +1,102 @@
+﻿/*!
+ *  @file       logstruc.hpp
+ *  @brief      Logging system: Structured log formatter.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include "logprov.hpp"
+
+namespace Common::Log {
+
+/**
+ * @brief Output encoding of LOG_STRUCTURED_FORMATTER.
+ */
+enum class LOG_STRUCTURED_ENCODING {
+    /*!
+     * One JSON object per line:
+     * {"ts":"2024-01-31T12:00:00.1234567Z","level":"Info","msg":"...",
+     *  "file":"...","func":"...","line":42,"hresult":"0x80070005",
+     *  "fields":{"pid":1234,"handle":"0x1a4","elapsed":1500000}}
+     * Pointers are hexadecimal strings, durations are nanoseconds, and
+     * "fields_truncated":true marks fields dropped at the call site.
+     */
+    JsonLines,
+
+    /*!
+     * Type-length-value records. Every element is a LOG_TLV_TAG byte, a
+     * 32-bit length and the value; integers are little-endian and text is
+     * UTF-8. An entry is an Entry element whose value is a sequence of
+     * elements. A Field value is the key length byte, the key, the
+     * LOG_FIELD_TYPE byte and either a 64-bit integer or the text.
+     */
+    Tlv
+};
+
+enum class LOG_TLV_TAG : std::uint8_t {
+    Entry = 0x01,
+    Timestamp = 0x10,   /*!< int64, nanoseconds since the Unix epoch. */
+    Level = 0x11,       /*!< uint8 LOG_LEVEL. */
+    Message = 0x12,
+    SourceFile = 0x13,
+    Function = 0x14,
+    SourceLine = 0x15,  /*!< int32. */
+    Hresult = 0x16,     /*!< uint32. */
+    Field = 0x20,
+    FieldsTruncated = 0x21
+};
+
+/**
+ * @brief Formatter that outputs log entries and their typed fields for
+ * machines.
+ * @details Entries are encoded straight into the byte buffer of the
+ * provider: fields are written from their binary form, wide strings are
+ * converted to UTF-8 in place and only a deferred message is rendered to
+ * an intermediate string. Through the wide-string interface, used by the
+ * debugger provider, entries are rendered as JSON Lines in both encodings.
+ */
+class LOG_STRUCTURED_FORMATTER : public LOG_FORMATTER_BASE {
+public:
+    LOG_STRUCTURED_FORMATTER(
+        LOG_STRUCTURED_ENCODING Encoding = LOG_STRUCTURED_ENCODING::JsonLines
+    );
+
+    std::wstring
+    FormatLogEntry(
+        const LOG_ENTRY &LogEntry
+    ) override;
+
+    void
+    FormatLogEntryTo(
+        const LOG_ENTRY &LogEntry,
+        std::wstring &Output
+    ) override;
+
+    void
+    FormatLogEntryUtf8(
+        const LOG_ENTRY &LogEntry,
+        std::string &Output
+    ) override;
+
+private:
+    static
+    void
+    FormatJson(
+        const LOG_ENTRY &LogEntry,
+        std::string &Output
+    );
+
+    static
+    void
+    FormatTlv(
+        const LOG_ENTRY &LogEntry,
+        std::string &Output
+    );
+
+    LOG_STRUCTURED_ENCODING Encoding_;
+};
+
+}
@@ -0,0 +1,81 @@
+﻿/*!
+ *  @file       logtime.hpp
+ *  @brief      Logging system: Log entry timestamp.
+ */
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+
+#include "tscclock.hpp"
+
+namespace Common::Log {
+
+/**
+ * @brief Time of a log entry.
+ * @details Entries created by LOG_CONTROLLER store the raw ticks of
+ * Util::FAST_CLOCK, which are captured in a few cycles and only converted
+ * to wall-clock time when the entry is formatted. Entries whose time is
+ * already known, such as recovered entries, store the time point itself.
+ */
+class LOG_TIMESTAMP {
+public:
+    LOG_TIMESTAMP() = default;
+
+    LOG_TIMESTAMP(
+        std::chrono::system_clock::time_point TimePoint
+    ) : Value_(TimePoint.time_since_epoch().count()),
+        IsTicks_(false)
+    {
+    }
+
+    /**
+     * @brief Captures the current time as raw ticks.
+     */
+    static
+    LOG_TIMESTAMP
+    Now()
+    {
+        LOG_TIMESTAMP timestamp;
+        timestamp.Value_ = Util::FAST_CLOCK::Now();
+        timestamp.IsTicks_ = true;
+        return timestamp;
+    }
+
+    /**
+     * @brief Checks whether the timestamp holds FAST_CLOCK ticks.
+     */
+    bool
+    IsTicks() const
+    {
+        return IsTicks_;
+    }
+
+    /**
+     * @brief Returns the FAST_CLOCK ticks of a timestamp that holds them.
+     */
+    Util::FAST_CLOCK::TICKS
+    GetTicks() const
+    {
+        return Value_;
+    }
+
+    /**
+     * @brief Returns the wall-clock time of the timestamp.
+     */
+    std::chrono::system_clock::time_point
+    ToTimePoint() const
+    {
+        if (IsTicks_) {
+            return Util::FAST_CLOCK::ToSystemTime(Value_);
+        }
+        return std::chrono::system_clock::time_point{std::chrono::system_clock::duration{Value_}};
+    }
+
+private:
+    std::int64_t Value_ = 0;
+    bool IsTicks_ = false;
+};
+
+}
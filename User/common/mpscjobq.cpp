@@ -0,0 +1,218 @@
+﻿/*!
+ *  @file       mpscjobq.cpp
+ *  @brief      Lock-free multi-producer single-consumer job queue.
+ */
+
+#include "mpscjobq.hpp"
+
+#include <bit>
+#include <thread>
+
+namespace Common::Util {
+
+MPSC_JOB_QUEUE::MPSC_JOB_QUEUE(
+    std::size_t Capacity,
+    WAKEUP Wakeup
+) : NodeCount_(std::bit_ceil(Capacity < 2 ? std::size_t{2} : Capacity)),
+    Nodes_(std::make_unique<NODE[]>(NodeCount_)),
+    FreeNodes_(NodeCount_),
+    Wakeup_(std::move(Wakeup)),
+    Head_(&Stub_),
+    Tail_(&Stub_)
+{
+    for (std::size_t i = 0; i < NodeCount_; ++i) {
+        FreeNodes_.TryPush(&Nodes_[i]);
+    }
+}
+
+MPSC_JOB_QUEUE::~MPSC_JOB_QUEUE()
+{
+    while (const auto node = Pop()) {
+        node->Complete(node->Storage, false);
+        ReleaseNode(node);
+    }
+}
+
+bool
+MPSC_JOB_QUEUE::PopAndExecute()
+{
+    for (;;) {
+        const auto node = Pop();
+        if (node) {
+            Execute(node);
+            return true;
+        }
+
+        if (Park()) {
+            return false;
+        }
+
+        /* A producer is between its exchange and its link, its job comes next. */
+        std::this_thread::yield();
+    }
+}
+
+std::size_t
+MPSC_JOB_QUEUE::Drain(
+    std::chrono::steady_clock::duration Budget
+)
+{
+    const auto deadline = Budget == std::chrono::steady_clock::duration::max()
+        ? std::chrono::steady_clock::time_point::max()
+        : std::chrono::steady_clock::now() + Budget;
+
+    std::size_t executed = 0;
+
+    try {
+        for (;;) {
+            if (executed && std::chrono::steady_clock::now() >= deadline) {
+                Reschedule();
+                return executed;
+            }
+
+            const auto node = Pop();
+            if (!node) {
+                if (Park()) {
+                    return executed;
+                }
+
+                /* A producer is between its exchange and its link. */
+                std::this_thread::yield();
+                continue;
+            }
+
+            ++executed;
+            Execute(node);
+        }
+    } catch (...) {
+        Reschedule();
+        throw;
+    }
+}
+
+std::size_t
+MPSC_JOB_QUEUE::DrainAll()
+{
+    return Drain(std::chrono::steady_clock::duration::max());
+}
+
+MPSC_JOB_QUEUE::NODE *
+MPSC_JOB_QUEUE::AcquireNode()
+{
+    NODE *node = nullptr;
+    if (!FreeNodes_.TryPop(node)) {
+        node = new NODE;
+    }
+
+    return node;
+}
+
+void
+MPSC_JOB_QUEUE::ReleaseNode(
+    NODE *Node
+)
+{
+    if (Node < Nodes_.get() || Node >= Nodes_.get() + NodeCount_) {
+        delete Node;
+        return;
+    }
+
+    /* Never full, the ring holds every pooled node. */
+    FreeNodes_.TryPush(Node);
+}
+
+void
+MPSC_JOB_QUEUE::Push(
+    NODE *Node
+)
+{
+    Node->Next.store(nullptr, std::memory_order_relaxed);
+    const auto previous = Head_.exchange(Node);
+    previous->Next.store(Node, std::memory_order_release);
+}
+
+MPSC_JOB_QUEUE::NODE *
+MPSC_JOB_QUEUE::Pop()
+{
+    auto tail = Tail_;
+    auto next = tail->Next.load(std::memory_order_acquire);
+
+    if (tail == &Stub_) {
+        if (!next) {
+            return nullptr;
+        }
+
+        Tail_ = next;
+        tail = next;
+        next = next->Next.load(std::memory_order_acquire);
+    }
+
+    if (next) {
+        Tail_ = next;
+        return tail;
+    }
+
+    if (tail != Head_.load(std::memory_order_acquire)) {
+        return nullptr;
+    }
+
+    /* The tail is the last node, queue the stub behind it so it can be unlinked. */
+    Push(&Stub_);
+
+    next = tail->Next.load(std::memory_order_acquire);
+    if (next) {
+        Tail_ = next;
+        return tail;
+    }
+
+    return nullptr;
+}
+
+void
+MPSC_JOB_QUEUE::Execute(
+    NODE *Node
+)
+{
+    class RELEASE {
+    public:
+        ~RELEASE()
+        {
+            Queue.ReleaseNode(Node);
+        }
+
+        MPSC_JOB_QUEUE &Queue;
+        NODE *Node;
+    };
+
+    RELEASE release{*this, Node};
+    Node->Complete(Node->Storage, true);
+}
+
+bool
+MPSC_JOB_QUEUE::HasPending() const
+{
+    return Head_.load() != Tail_ || Tail_ != &Stub_;
+}
+
+bool
+MPSC_JOB_QUEUE::Park()
+{
+    /* Pairs with the exchange of Head_ and the load of the flag in Post. */
+    WakeupNeeded_.store(true);
+    if (!HasPending()) {
+        return true;
+    }
+
+    /* If a producer took the flag, its wakeup is on the way. */
+    return !WakeupNeeded_.exchange(false);
+}
+
+void
+MPSC_JOB_QUEUE::Reschedule()
+{
+    if (!Park() && Wakeup_) {
+        Wakeup_();
+    }
+}
+
+}
@@ -0,0 +1,277 @@
+﻿/*!
+ *  @file       mpscjobq.hpp
+ *  @brief      Lock-free multi-producer single-consumer job queue.
+ *  @details    Jobs are constructed in place in fixed-size nodes of two cache
+ *              lines and linked into D. Vyukov's intrusive MPSC queue: a push
+ *              is one atomic exchange and one store, a pop takes a bounded
+ *              number of steps. Nodes come from a pool preallocated at
+ *              construction and handed back to producers through a
+ *              BOUNDED_RING, so enqueuing and executing jobs that fit a node
+ *              does not reach the global allocator. Larger jobs are boxed on
+ *              the heap and nodes are allocated on the heap while the pool is
+ *              exhausted.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <functional>
+#include <future>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+#include "ring.hpp"
+
+namespace Common::Util {
+
+/*!
+ * @brief Job queue with any number of producers and a single consumer. Has
+ * the interface of JOB_QUEUE, including the coalesced wakeup: a new queue
+ * assumes its consumer drains it before waiting for the first wakeup.
+ */
+class MPSC_JOB_QUEUE {
+public:
+    using WAKEUP = std::move_only_function<void()>;
+
+    /*!
+     * @brief Size of the job storage of a node. Jobs that are larger or
+     * over-aligned are boxed on the heap.
+     */
+    static constexpr std::size_t InlineSize = 2 * CACHE_LINE_SIZE - 2 * sizeof(void *);
+
+    /*!
+     * @brief Constructs a queue.
+     * @param Capacity The number of pooled nodes, rounded up to the next power
+     * of two. More jobs in flight are stored in heap-allocated nodes.
+     * @param Wakeup Called by producers, outside of any lock, to make the
+     * consumer drain the queue.
+     */
+    explicit
+    MPSC_JOB_QUEUE(
+        std::size_t Capacity = 1024,
+        WAKEUP Wakeup = {}
+    );
+
+    MPSC_JOB_QUEUE(const MPSC_JOB_QUEUE &) = delete;
+
+    MPSC_JOB_QUEUE &
+    operator=(const MPSC_JOB_QUEUE &) = delete;
+
+    /*!
+     * @brief Destroys the jobs that were not executed.
+     */
+    ~MPSC_JOB_QUEUE();
+
+    /**
+     * @brief Enqueues a function to be executed asynchronously.
+     * @tparam FunctionType Type of the invocable function.
+     * @param Function The function to be enqueued for execution.
+     * @return A future object representing the result of the enqueued function.
+     */
+    template<std::invocable FunctionType>
+    auto
+    Enqueue(FunctionType &&Function)
+    {
+        using PACKAGED_JOB = std::packaged_task<std::invoke_result_t<FunctionType>()>;
+
+        PACKAGED_JOB packagedJob{std::forward<FunctionType>(Function)};
+        auto future = packagedJob.get_future();
+
+        Post([packagedJob_ = std::move(packagedJob)]() mutable {
+            packagedJob_();
+        });
+
+        return future;
+    }
+
+    /*!
+     * @brief Enqueues a function without a future. The function is stored in
+     * the node, so this does not allocate if it fits InlineSize and a pooled
+     * node is free.
+     * @param Function The function to be enqueued for execution. Exceptions
+     * it throws propagate out of the Drain or PopAndExecute running it.
+     */
+    template<std::invocable FunctionType>
+    void
+    Post(FunctionType &&Function)
+    {
+        using JOB = std::decay_t<FunctionType>;
+
+        const auto node = AcquireNode();
+
+        try {
+            if constexpr (sizeof(JOB) <= InlineSize && alignof(JOB) <= alignof(std::max_align_t)) {
+                new (node->Storage) JOB(std::forward<FunctionType>(Function));
+                node->Complete = &Complete<JOB>;
+            } else {
+                new (node->Storage) BOXED_JOB<JOB>{std::make_unique<JOB>(std::forward<FunctionType>(Function))};
+                node->Complete = &Complete<BOXED_JOB<JOB>>;
+            }
+        } catch (...) {
+            ReleaseNode(node);
+            throw;
+        }
+
+        Push(node);
+
+        /* The load keeps producers off the cache line of the flag while the consumer runs. */
+        if (WakeupNeeded_.load() && WakeupNeeded_.exchange(false) && Wakeup_) {
+            Wakeup_();
+        }
+    }
+
+    /**
+     * @brief Retrieves and executes a job from the queue, if there is one.
+     * Waits out a producer that is still linking its node, so false always
+     * leaves the wakeup armed for the next push.
+     * @return Whether a job was executed.
+     */
+    bool
+    PopAndExecute();
+
+    /*!
+     * @brief Executes queued jobs, including the ones enqueued meanwhile,
+     * until the queue is empty or the budget is spent. At least one job is
+     * executed if there is one. When jobs remain the wakeup is called again.
+     * @param Budget The time after which no further job is started.
+     * @return The number of executed jobs.
+     */
+    std::size_t
+    Drain(
+        std::chrono::steady_clock::duration Budget
+    );
+
+    /*!
+     * @brief Executes queued jobs until the queue is empty.
+     * @return The number of executed jobs.
+     */
+    std::size_t
+    DrainAll();
+
+private:
+    /*!
+     * @brief A queued job. Two cache lines, so producers filling adjacent
+     * nodes do not share a line.
+     */
+    class alignas(CACHE_LINE_SIZE) NODE {
+    public:
+        std::atomic<NODE *> Next = nullptr;
+
+        /*!
+         * @brief Executes the job in Storage if Execute is true and destroys it.
+         */
+        void (*Complete)(void *Storage, bool Execute) = nullptr;
+
+        alignas(std::max_align_t) std::byte Storage[InlineSize];
+    };
+
+    static_assert(sizeof(NODE) == 2 * CACHE_LINE_SIZE);
+
+    template<class JOB>
+    class BOXED_JOB {
+    public:
+        void
+        operator()()
+        {
+            (*Job)();
+        }
+
+        std::unique_ptr<JOB> Job;
+    };
+
+    template<class JOB>
+    static
+    void
+    Complete(
+        void *Storage,
+        bool Execute
+    )
+    {
+        class DESTROY {
+        public:
+            ~DESTROY()
+            {
+                Job.~JOB();
+            }
+
+            JOB &Job;
+        };
+
+        DESTROY destroy{*std::launder(static_cast<JOB *>(Storage))};
+        if (Execute) {
+            std::invoke(destroy.Job);
+        }
+    }
+
+    NODE *
+    AcquireNode();
+
+    void
+    ReleaseNode(
+        NODE *Node
+    );
+
+    void
+    Push(
+        NODE *Node
+    );
+
+    /*!
+     * @brief Unlinks the oldest node. Consumer only. Returns null if the
+     * queue is empty or the oldest producer has not linked its node yet.
+     */
+    NODE *
+    Pop();
+
+    void
+    Execute(
+        NODE *Node
+    );
+
+    /*!
+     * @brief Whether nodes are queued or being pushed. Consumer only.
+     */
+    bool
+    HasPending() const;
+
+    /*!
+     * @brief Arms the wakeup after Pop found nothing.
+     * @return true if the consumer may stop and wait for the wakeup, false
+     * if it disarmed the wakeup again because a push is pending.
+     */
+    bool
+    Park();
+
+    /*!
+     * @brief Arms or calls the wakeup when a drain ends early.
+     */
+    void
+    Reschedule();
+
+    const std::size_t NodeCount_;
+    const std::unique_ptr<NODE[]> Nodes_;
+    BOUNDED_RING<NODE *> FreeNodes_;
+    WAKEUP Wakeup_;
+
+    /*!
+     * @brief Whether the consumer found the queue empty and waits for a wakeup.
+     */
+    alignas(CACHE_LINE_SIZE) std::atomic<bool> WakeupNeeded_ = false;
+
+    /*!
+     * @brief The most recently pushed node, producers exchange it.
+     */
+    alignas(CACHE_LINE_SIZE) std::atomic<NODE *> Head_;
+
+    /*!
+     * @brief The oldest node, consumer only.
+     */
+    alignas(CACHE_LINE_SIZE) NODE *Tail_;
+    NODE Stub_;
+};
+
+}
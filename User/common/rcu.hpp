@@ -0,0 +1,156 @@
+﻿/*!
+ *  @file       rcu.hpp
+ *  @brief      Read-copy-update cell.
+ *  @details    Readers pin the current value with two atomic increments and
+ *              never wait. Writers copy the value, modify the copy, publish
+ *              it with a pointer exchange and reclaim the old value once
+ *              every reader that could still see it has left (a grace
+ *              period). Readers are counted in one of two counters selected
+ *              by an epoch; a grace period flips the epoch twice and waits
+ *              for each counter to drain, so a steady stream of new readers
+ *              cannot starve the writer.
+ */
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include "ring.hpp"
+
+namespace Common::Util {
+
+/*!
+ * @brief Value that is read without locks and updated by copy.
+ * @tparam T Type of the value, must be copy constructible.
+ */
+template<class T>
+class RCU_CELL {
+public:
+    /*!
+     * @brief Read-side critical section. The value it points to stays valid
+     * until the guard is destroyed.
+     */
+    class READ_GUARD {
+    public:
+        READ_GUARD(const READ_GUARD &) = delete;
+
+        READ_GUARD &
+        operator=(const READ_GUARD &) = delete;
+
+        ~READ_GUARD()
+        {
+            Cell_.Readers_[Counter_].Count.fetch_sub(1, std::memory_order_release);
+        }
+
+        const T &
+        operator*() const
+        {
+            return *Value_;
+        }
+
+        const T *
+        operator->() const
+        {
+            return Value_;
+        }
+
+    private:
+        friend class RCU_CELL;
+
+        explicit
+        READ_GUARD(
+            const RCU_CELL &Cell
+        ) : Cell_(Cell),
+            Counter_(Cell.Epoch_.load(std::memory_order_relaxed) & 1)
+        {
+            /* The value is loaded after the reader is counted, paired with Synchronize. */
+            Cell_.Readers_[Counter_].Count.fetch_add(1, std::memory_order_seq_cst);
+            Value_ = Cell_.Value_.load(std::memory_order_seq_cst);
+        }
+
+        const RCU_CELL &Cell_;
+        std::uint32_t Counter_;
+        const T *Value_;
+    };
+
+    explicit
+    RCU_CELL(
+        T Value = {}
+    ) : Value_(new T(std::move(Value)))
+    {
+    }
+
+    RCU_CELL(const RCU_CELL &) = delete;
+
+    RCU_CELL &
+    operator=(const RCU_CELL &) = delete;
+
+    /*!
+     * @brief Destroys the value. No reader may be active.
+     */
+    ~RCU_CELL()
+    {
+        delete Value_.load(std::memory_order_relaxed);
+    }
+
+    /*!
+     * @brief Enters a read-side critical section.
+     */
+    READ_GUARD
+    Read() const
+    {
+        return READ_GUARD{*this};
+    }
+
+    /*!
+     * @brief Replaces the value with a modified copy and destroys the old
+     * value after a grace period. Updates are serialized. Must not be called
+     * from a read-side critical section, the grace period would never end.
+     * @param Updater Callable that modifies the copy, invoked with T&.
+     */
+    template<class F>
+    void
+    Update(
+        F &&Updater
+    )
+    {
+        std::lock_guard lock{WriterLock_};
+
+        auto next = std::make_unique<T>(*Value_.load(std::memory_order_relaxed));
+        std::forward<F>(Updater)(*next);
+
+        std::unique_ptr<T> previous{Value_.exchange(next.release(), std::memory_order_seq_cst)};
+        Synchronize();
+    }
+
+private:
+    struct alignas(CACHE_LINE_SIZE) READER_COUNTER {
+        std::atomic<std::uint64_t> Count = 0;
+    };
+
+    /*!
+     * @brief Waits until every reader that entered before the call has left.
+     */
+    void
+    Synchronize()
+    {
+        for (int flip = 0; flip < 2; ++flip) {
+            const auto counter = Epoch_.fetch_add(1, std::memory_order_seq_cst) & 1;
+            while (Readers_[counter].Count.load(std::memory_order_seq_cst) != 0) {
+                std::this_thread::yield();
+            }
+        }
+    }
+
+    std::atomic<T *> Value_;
+    std::atomic<std::uint32_t> Epoch_ = 0;
+    mutable std::array<READER_COUNTER, 2> Readers_;
+    std::mutex WriterLock_;
+};
+
+}
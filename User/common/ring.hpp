@@ -0,0 +1,149 @@
+﻿/*!
+ *  @file       ring.hpp
+ *  @brief      Bounded lock-free ring buffer.
+ *  @details    Array-based bounded queue with a per-slot sequence number
+ *              (D. Vyukov's bounded MPMC queue). Producers and consumers
+ *              only contend on their own position counter, a push or pop
+ *              is a single CAS in the uncontended case and no operation
+ *              allocates after construction.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <memory>
+
+namespace Common::Util {
+
+/*!
+ * @brief Size used to keep independently written data on separate cache lines.
+ */
+inline constexpr std::size_t CACHE_LINE_SIZE = 64;
+
+/*!
+ * @brief Bounded multi-producer multi-consumer lock-free ring buffer.
+ * @tparam T Type of the stored values, must be default constructible and movable.
+ */
+template<class T>
+class BOUNDED_RING {
+public:
+    /*!
+     * @brief Constructs a ring buffer.
+     * @param Capacity The minimum number of values the ring can hold,
+     * rounded up to the next power of two.
+     */
+    explicit
+    BOUNDED_RING(
+        std::size_t Capacity
+    ) : Mask_(std::bit_ceil(Capacity < 2 ? std::size_t{2} : Capacity) - 1),
+        Slots_(std::make_unique<SLOT[]>(Mask_ + 1))
+    {
+        for (std::size_t i = 0; i <= Mask_; ++i) {
+            Slots_[i].Sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    BOUNDED_RING(const BOUNDED_RING &) = delete;
+
+    BOUNDED_RING &
+    operator=(const BOUNDED_RING &) = delete;
+
+    /*!
+     * @brief Tries to push a value into the ring.
+     * @param Value The value to push. It is only moved from if the push succeeds.
+     * @return true if the value was pushed, false if the ring is full.
+     */
+    template<class U>
+    bool
+    TryPush(
+        U &&Value
+    )
+    {
+        std::size_t position = EnqueuePosition_.load(std::memory_order_relaxed);
+
+        for (;;) {
+            SLOT &slot = Slots_[position & Mask_];
+            const std::size_t sequence = slot.Sequence.load(std::memory_order_acquire);
+            const auto difference = static_cast<std::ptrdiff_t>(sequence) - static_cast<std::ptrdiff_t>(position);
+
+            if (difference == 0) {
+                if (EnqueuePosition_.compare_exchange_weak(position,
+                                                           position + 1,
+                                                           std::memory_order_relaxed)) {
+                    slot.Value = std::forward<U>(Value);
+                    slot.Sequence.store(position + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (difference < 0) {
+                return false;
+            } else {
+                position = EnqueuePosition_.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    /*!
+     * @brief Tries to pop the oldest value from the ring.
+     * @param Value Receives the popped value.
+     * @return true if a value was popped, false if the ring is empty.
+     */
+    bool
+    TryPop(
+        T &Value
+    )
+    {
+        std::size_t position = DequeuePosition_.load(std::memory_order_relaxed);
+
+        for (;;) {
+            SLOT &slot = Slots_[position & Mask_];
+            const std::size_t sequence = slot.Sequence.load(std::memory_order_acquire);
+            const auto difference = static_cast<std::ptrdiff_t>(sequence) - static_cast<std::ptrdiff_t>(position + 1);
+
+            if (difference == 0) {
+                if (DequeuePosition_.compare_exchange_weak(position,
+                                                           position + 1,
+                                                           std::memory_order_relaxed)) {
+                    Value = std::move(slot.Value);
+                    slot.Sequence.store(position + Mask_ + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (difference < 0) {
+                return false;
+            } else {
+                position = DequeuePosition_.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    /*!
+     * @brief Checks whether the ring is empty. The result is a snapshot and
+     * may be stale as soon as it is returned.
+     */
+    bool
+    IsEmpty() const
+    {
+        return DequeuePosition_.load(std::memory_order_relaxed) ==
+               EnqueuePosition_.load(std::memory_order_relaxed);
+    }
+
+    std::size_t
+    GetCapacity() const
+    {
+        return Mask_ + 1;
+    }
+
+private:
+    struct alignas(CACHE_LINE_SIZE) SLOT {
+        std::atomic<std::size_t> Sequence;
+        T Value;
+    };
+
+    const std::size_t Mask_;
+    std::unique_ptr<SLOT[]> Slots_;
+    alignas(CACHE_LINE_SIZE) std::atomic<std::size_t> EnqueuePosition_ = 0;
+    alignas(CACHE_LINE_SIZE) std::atomic<std::size_t> DequeuePosition_ = 0;
+};
+
+}
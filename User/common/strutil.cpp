@@ -5,11 +5,15 @@
 
 #include "strutil.hpp"
 
-#include "log.hpp"
 #include "win32.h"
 
 namespace Common::Util {
 
+/*
+ * The logging system converts text with these functions while it formats
+ * entries, so failures are reported to the debugger instead of the log.
+ */
+
 std::wstring
 StringToWstring(
     const std::string &String
@@ -26,7 +30,7 @@ StringToWstring(
                                            nullptr,
                                            0);
     if (length == 0) {
-        LOG.Warning(L"MultiByteToWideChar failed");
+        OutputDebugStringW(L"MultiByteToWideChar failed\n");
         return {};
     }
 
@@ -39,7 +43,7 @@ StringToWstring(
                             static_cast<int>(String.size()),
                             wstring.data(),
                             static_cast<int>(wstring.size())) == 0) {
-        LOG.Warning(L"MultiByteToWideChar failed");
+        OutputDebugStringW(L"MultiByteToWideChar failed\n");
         return {};
     }
 
@@ -70,9 +74,59 @@ WstringToString(
         return string;
 
     } else {
-        LOG.Warning(L"wcstombs_s failed");
+        OutputDebugStringW(L"wcstombs_s failed\n");
         return {};
     }
 }
 
+void
+AppendUtf8(
+    std::wstring_view Wstring,
+    std::string &Output
+)
+{
+    if (Wstring.empty()) {
+        return;
+    }
+
+    /* A UTF-16 code unit never needs more than three UTF-8 bytes. */
+    const auto offset = Output.size();
+    Output.resize(offset + Wstring.size() * 3);
+
+    const int length = WideCharToMultiByte(CP_UTF8,
+                                           0,
+                                           Wstring.data(),
+                                           static_cast<int>(Wstring.size()),
+                                           Output.data() + offset,
+                                           static_cast<int>(Wstring.size() * 3),
+                                           nullptr,
+                                           nullptr);
+
+    Output.resize(offset + length);
+}
+
+void
+AppendUtf16(
+    std::string_view String,
+    std::wstring &Output
+)
+{
+    if (String.empty()) {
+        return;
+    }
+
+    /* A UTF-8 sequence never decodes to more UTF-16 code units than it has bytes. */
+    const auto offset = Output.size();
+    Output.resize(offset + String.size());
+
+    const int length = MultiByteToWideChar(CP_UTF8,
+                                           0,
+                                           String.data(),
+                                           static_cast<int>(String.size()),
+                                           Output.data() + offset,
+                                           static_cast<int>(String.size()));
+
+    Output.resize(offset + length);
+}
+
 }
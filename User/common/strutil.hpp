@@ -6,6 +6,7 @@
 #pragma once
 
 #include <string>
+#include <string_view>
 
 namespace Common::Util {
 
@@ -19,4 +20,22 @@ WstringToString(
     const std::wstring &Wstring
 );
 
+/*!
+ * @brief Appends the UTF-8 encoding of a wide string to a byte string.
+ */
+void
+AppendUtf8(
+    std::wstring_view Wstring,
+    std::string &Output
+);
+
+/*!
+ * @brief Appends the UTF-16 decoding of a UTF-8 string to a wide string.
+ */
+void
+AppendUtf16(
+    std::string_view String,
+    std::wstring &Output
+);
+
 }
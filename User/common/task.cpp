@@ -0,0 +1,238 @@
+﻿/*!
+ *  @file       task.cpp
+ *  @brief      Coroutine tasks.
+ */
+
+#include "task.hpp"
+
+#include <array>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <new>
+#include <queue>
+#include <thread>
+#include <vector>
+
+namespace Common::Util {
+
+namespace {
+
+constexpr std::size_t SizeClassCount = COROUTINE_FRAME_POOL::MaxPooledSize / COROUTINE_FRAME_POOL::SizeClass;
+
+/*!
+ * @brief A released frame, linked into the free list of its size class.
+ */
+class FREE_FRAME {
+public:
+    FREE_FRAME *Next;
+};
+
+/*!
+ * @brief Free frames of a thread. Frees them on thread exit.
+ */
+class FRAME_CACHE {
+public:
+    ~FRAME_CACHE();
+
+    std::array<FREE_FRAME *, SizeClassCount> Free = {};
+    std::array<std::size_t, SizeClassCount> Count = {};
+};
+
+thread_local FRAME_CACHE FrameCache;
+
+/*!
+ * @brief Set once the cache of the thread is destroyed. Trivially
+ * destructible, so frames released later in thread exit can still check it.
+ */
+thread_local bool FrameCacheDestroyed = false;
+
+FRAME_CACHE::~FRAME_CACHE()
+{
+    FrameCacheDestroyed = true;
+
+    for (auto frame : Free) {
+        while (frame) {
+            const auto next = frame->Next;
+            ::operator delete(frame);
+            frame = next;
+        }
+    }
+}
+
+/*!
+ * @brief Index of the size class of a pooled frame.
+ */
+std::size_t
+GetSizeClass(
+    std::size_t Size
+)
+{
+    return (Size - 1) / COROUTINE_FRAME_POOL::SizeClass;
+}
+
+/*!
+ * @brief A callback of the timer, ordered by due time and then by scheduling order.
+ */
+class TIMER_ENTRY {
+public:
+    std::chrono::steady_clock::time_point Due;
+    std::uint64_t Sequence;
+    mutable std::move_only_function<void()> Callback;
+};
+
+class RUNS_LATER {
+public:
+    bool
+    operator()(
+        const TIMER_ENTRY &Left,
+        const TIMER_ENTRY &Right
+    ) const
+    {
+        return Left.Due != Right.Due ? Left.Due > Right.Due : Left.Sequence > Right.Sequence;
+    }
+};
+
+/*!
+ * @brief Thread that calls timer callbacks once they are due. Callbacks that
+ * are pending when the process exits are destroyed without being called.
+ */
+class TIMER_THREAD {
+public:
+    TIMER_THREAD() : Thread_([this](std::stop_token Stop) {
+        Run(Stop);
+    })
+    {
+    }
+
+    ~TIMER_THREAD()
+    {
+        {
+            std::lock_guard lock{Lock_};
+            Thread_.request_stop();
+        }
+
+        Changed_.notify_one();
+    }
+
+    void
+    Schedule(
+        std::chrono::steady_clock::time_point Due,
+        std::move_only_function<void()> Callback
+    )
+    {
+        bool earliest = false;
+        {
+            std::lock_guard lock{Lock_};
+            Entries_.push({Due, NextSequence_++, std::move(Callback)});
+            earliest = Entries_.top().Sequence == NextSequence_ - 1;
+        }
+
+        /* Only a new earliest entry shortens the wait of the thread. */
+        if (earliest) {
+            Changed_.notify_one();
+        }
+    }
+
+private:
+    void
+    Run(
+        std::stop_token Stop
+    )
+    {
+        std::unique_lock lock{Lock_};
+
+        while (!Stop.stop_requested()) {
+            if (Entries_.empty()) {
+                Changed_.wait(lock);
+                continue;
+            }
+
+            const auto due = Entries_.top().Due;
+            if (std::chrono::steady_clock::now() < due) {
+                Changed_.wait_until(lock, due);
+                continue;
+            }
+
+            auto callback = std::move(Entries_.top().Callback);
+            Entries_.pop();
+
+            lock.unlock();
+            callback();
+            lock.lock();
+        }
+    }
+
+    std::mutex Lock_;
+    std::condition_variable Changed_;
+    std::priority_queue<TIMER_ENTRY, std::vector<TIMER_ENTRY>, RUNS_LATER> Entries_;
+    std::uint64_t NextSequence_ = 0;
+
+    /* Last member, the thread must not start before the others are constructed. */
+    std::jthread Thread_;
+};
+
+TIMER_THREAD &
+GetTimerThread()
+{
+    static TIMER_THREAD timerThread;
+    return timerThread;
+}
+
+}
+
+void *
+COROUTINE_FRAME_POOL::Allocate(
+    std::size_t Size
+)
+{
+    if (Size == 0 || Size > MaxPooledSize || FrameCacheDestroyed) {
+        return ::operator new(Size);
+    }
+
+    const auto sizeClass = GetSizeClass(Size);
+    auto &cache = FrameCache;
+
+    if (const auto frame = cache.Free[sizeClass]) {
+        cache.Free[sizeClass] = frame->Next;
+        --cache.Count[sizeClass];
+        return frame;
+    }
+
+    /* Frames of a class share one size, so any thread can reuse them. */
+    return ::operator new((sizeClass + 1) * SizeClass);
+}
+
+void
+COROUTINE_FRAME_POOL::Release(
+    void *Frame,
+    std::size_t Size
+)
+{
+    if (Size == 0 || Size > MaxPooledSize || FrameCacheDestroyed) {
+        ::operator delete(Frame);
+        return;
+    }
+
+    const auto sizeClass = GetSizeClass(Size);
+    auto &cache = FrameCache;
+
+    if (cache.Count[sizeClass] >= MaxCachedFrames) {
+        ::operator delete(Frame);
+        return;
+    }
+
+    cache.Free[sizeClass] = new (Frame) FREE_FRAME{cache.Free[sizeClass]};
+    ++cache.Count[sizeClass];
+}
+
+void
+TASK_TIMER::Schedule(
+    std::chrono::steady_clock::time_point Due,
+    std::move_only_function<void()> Callback
+)
+{
+    GetTimerThread().Schedule(Due, std::move(Callback));
+}
+
+}
@@ -0,0 +1,627 @@
+﻿/*!
+ *  @file       task.hpp
+ *  @brief      Coroutine tasks.
+ *  @details    TASK<T> is a lazily started coroutine returning T. Awaiting a
+ *              task starts it and resumes the awaiting coroutine when it
+ *              returns, through symmetric transfer, so in optimized builds
+ *              chains of tasks do not grow the stack. A coroutine moves
+ *              between threads by awaiting SwitchTo with any JOB_EXECUTOR,
+ *              such as the UI job queue or a THREAD_POOL, sleeps without
+ *              holding a thread with Delay and waits for a FUTURE without
+ *              blocking. Frames are taken from per-thread free lists of
+ *              64-byte size classes and go back to the free list of the
+ *              thread that destroys them, so in steady state creating a task
+ *              does not reach the global allocator. Start runs a task to
+ *              completion in the background and hands its result to a FUTURE.
+ */
+
+#pragma once
+
+#include <chrono>
+#include <coroutine>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <optional>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+#include "future.hpp"
+
+namespace Common::Util {
+
+/*!
+ * @brief Recycling allocator of coroutine frames.
+ */
+class COROUTINE_FRAME_POOL {
+public:
+    /*!
+     * @brief Granularity of the size classes.
+     */
+    static constexpr std::size_t SizeClass = 64;
+
+    /*!
+     * @brief Largest pooled frame, larger frames use the global allocator.
+     */
+    static constexpr std::size_t MaxPooledSize = 32 * SizeClass;
+
+    /*!
+     * @brief Frames of one size class a thread keeps, more are freed.
+     */
+    static constexpr std::size_t MaxCachedFrames = 256;
+
+    static
+    void *
+    Allocate(
+        std::size_t Size
+    );
+
+    /*!
+     * @brief Returns a frame to the free list of the calling thread.
+     * @param Size The size passed to Allocate.
+     */
+    static
+    void
+    Release(
+        void *Frame,
+        std::size_t Size
+    );
+};
+
+/*!
+ * @brief Thread that resumes Delay awaiters once they are due.
+ */
+class TASK_TIMER {
+public:
+    /*!
+     * @brief Calls Callback on the timer thread at or after Due. Callbacks
+     * should return quickly, they delay the callbacks due after them.
+     */
+    static
+    void
+    Schedule(
+        std::chrono::steady_clock::time_point Due,
+        std::move_only_function<void()> Callback
+    );
+};
+
+template<class T = void>
+class TASK;
+
+/*!
+ * @brief Promise members shared by all result types.
+ */
+class TASK_PROMISE_BASE {
+public:
+    static
+    void *
+    operator new(
+        std::size_t Size
+    )
+    {
+        return COROUTINE_FRAME_POOL::Allocate(Size);
+    }
+
+    static
+    void
+    operator delete(
+        void *Frame,
+        std::size_t Size
+    )
+    {
+        COROUTINE_FRAME_POOL::Release(Frame, Size);
+    }
+
+    std::suspend_always
+    initial_suspend() noexcept
+    {
+        return {};
+    }
+
+    void
+    unhandled_exception() noexcept
+    {
+        Exception = std::current_exception();
+    }
+
+    /*!
+     * @brief The coroutine awaiting the task, null for a started task.
+     */
+    std::coroutine_handle<> Continuation;
+    std::exception_ptr Exception;
+};
+
+/*!
+ * @brief Promise type of TASK<T>.
+ */
+template<class T>
+class TASK_PROMISE : public TASK_PROMISE_BASE {
+public:
+    using VALUE = typename FUTURE_STATE<T>::VALUE;
+
+    /*!
+     * @brief Transfers to the awaiting coroutine, or completes and destroys a
+     * started task.
+     */
+    class FINAL_AWAITER {
+    public:
+        bool
+        await_ready() noexcept
+        {
+            return false;
+        }
+
+        std::coroutine_handle<>
+        await_suspend(
+            std::coroutine_handle<TASK_PROMISE> Handle
+        ) noexcept
+        {
+            auto &promise = Handle.promise();
+            if (promise.Continuation) {
+                return promise.Continuation;
+            }
+
+            auto completion = std::move(*promise.Completion);
+            completion.SetResultOf([&promise]() -> T {
+                return promise.TakeResult();
+            });
+
+            Handle.destroy();
+            return std::noop_coroutine();
+        }
+
+        void
+        await_resume() noexcept
+        {
+        }
+    };
+
+    TASK<T>
+    get_return_object() noexcept;
+
+    FINAL_AWAITER
+    final_suspend() noexcept
+    {
+        return {};
+    }
+
+    template<class U>
+    void
+    return_value(
+        U &&Value
+    )
+    {
+        Value_.emplace(std::forward<U>(Value));
+    }
+
+    /*!
+     * @brief Moves the result out or rethrows the exception of the task.
+     */
+    T
+    TakeResult()
+    {
+        if (Exception) {
+            std::rethrow_exception(Exception);
+        }
+
+        return std::move(*Value_);
+    }
+
+    /*!
+     * @brief Receives the result of a started task.
+     */
+    std::optional<PROMISE<T>> Completion;
+
+private:
+    std::optional<VALUE> Value_;
+};
+
+template<>
+class TASK_PROMISE<void> : public TASK_PROMISE_BASE {
+public:
+    class FINAL_AWAITER {
+    public:
+        bool
+        await_ready() noexcept
+        {
+            return false;
+        }
+
+        std::coroutine_handle<>
+        await_suspend(
+            std::coroutine_handle<TASK_PROMISE> Handle
+        ) noexcept
+        {
+            auto &promise = Handle.promise();
+            if (promise.Continuation) {
+                return promise.Continuation;
+            }
+
+            auto completion = std::move(*promise.Completion);
+            completion.SetResultOf([&promise] {
+                promise.TakeResult();
+            });
+
+            Handle.destroy();
+            return std::noop_coroutine();
+        }
+
+        void
+        await_resume() noexcept
+        {
+        }
+    };
+
+    TASK<void>
+    get_return_object() noexcept;
+
+    FINAL_AWAITER
+    final_suspend() noexcept
+    {
+        return {};
+    }
+
+    void
+    return_void()
+    {
+    }
+
+    void
+    TakeResult()
+    {
+        if (Exception) {
+            std::rethrow_exception(Exception);
+        }
+    }
+
+    std::optional<PROMISE<void>> Completion;
+};
+
+/*!
+ * @brief Lazily started coroutine with a result of type T.
+ * @details The body runs when the task is awaited or started. Exceptions
+ * leaving the body are rethrown by the await or by the future of Start.
+ */
+template<class T>
+class [[nodiscard]] TASK {
+public:
+    using promise_type = TASK_PROMISE<T>;
+    using HANDLE = std::coroutine_handle<promise_type>;
+
+    class AWAITER {
+    public:
+        bool
+        await_ready() noexcept
+        {
+            return false;
+        }
+
+        /*!
+         * @brief Starts the task, the awaiting coroutine continues when it ends.
+         */
+        std::coroutine_handle<>
+        await_suspend(
+            std::coroutine_handle<> Awaiting
+        ) noexcept
+        {
+            Handle.promise().Continuation = Awaiting;
+            return Handle;
+        }
+
+        T
+        await_resume()
+        {
+            return Handle.promise().TakeResult();
+        }
+
+        HANDLE Handle;
+    };
+
+    explicit
+    TASK(
+        HANDLE Handle
+    ) : Handle_(Handle)
+    {
+    }
+
+    TASK(
+        TASK &&Other
+    ) noexcept : Handle_(std::exchange(Other.Handle_, nullptr))
+    {
+    }
+
+    TASK &
+    operator=(
+        TASK &&Other
+    ) noexcept
+    {
+        if (this != &Other) {
+            if (Handle_) {
+                Handle_.destroy();
+            }
+
+            Handle_ = std::exchange(Other.Handle_, nullptr);
+        }
+
+        return *this;
+    }
+
+    /*!
+     * @brief Destroys the coroutine, which must not be running.
+     */
+    ~TASK()
+    {
+        if (Handle_) {
+            Handle_.destroy();
+        }
+    }
+
+    AWAITER
+    operator co_await() noexcept
+    {
+        return {Handle_};
+    }
+
+    /*!
+     * @brief Runs the task on the calling thread until it first suspends,
+     * it then continues wherever its awaits resume it. The frame is
+     * destroyed when the body ends.
+     * @return The future of the result of the task.
+     */
+    FUTURE<T>
+    Start() &&
+    {
+        auto &promise = Handle_.promise();
+        promise.Completion.emplace();
+        auto future = promise.Completion->GetFuture();
+
+        std::exchange(Handle_, nullptr).resume();
+        return future;
+    }
+
+private:
+    HANDLE Handle_;
+};
+
+template<class T>
+TASK<T>
+TASK_PROMISE<T>::get_return_object() noexcept
+{
+    return TASK<T>{std::coroutine_handle<TASK_PROMISE>::from_promise(*this)};
+}
+
+inline
+TASK<void>
+TASK_PROMISE<void>::get_return_object() noexcept
+{
+    return TASK<void>{std::coroutine_handle<TASK_PROMISE>::from_promise(*this)};
+}
+
+/*!
+ * @brief Job that continues a suspended coroutine. An executor that
+ * destroys the job without running it, such as JOB_QUEUE for a cancelled
+ * job, resumes the coroutine with Cancelled set instead of leaking its frame.
+ */
+class RESUME_JOB {
+public:
+    RESUME_JOB(
+        std::coroutine_handle<> Handle,
+        bool &Cancelled
+    ) : Handle_(Handle),
+        Cancelled_(&Cancelled)
+    {
+    }
+
+    RESUME_JOB(
+        RESUME_JOB &&Other
+    ) noexcept : Handle_(std::exchange(Other.Handle_, nullptr)),
+                 Cancelled_(Other.Cancelled_)
+    {
+    }
+
+    ~RESUME_JOB()
+    {
+        if (Handle_) {
+            *Cancelled_ = true;
+            Handle_.resume();
+        }
+    }
+
+    void
+    operator()()
+    {
+        std::exchange(Handle_, nullptr).resume();
+    }
+
+private:
+    std::coroutine_handle<> Handle_;
+    bool *Cancelled_;
+};
+
+/*!
+ * @brief Awaiter of SwitchTo.
+ */
+template<JOB_EXECUTOR E, class... A>
+class SWITCH_AWAITER {
+public:
+    bool
+    await_ready() noexcept
+    {
+        return false;
+    }
+
+    void
+    await_suspend(
+        std::coroutine_handle<> Handle
+    )
+    {
+        std::apply([&](auto &...PostArguments) {
+            Executor.Post(RESUME_JOB{Handle, Cancelled}, std::move(PostArguments)...);
+        }, PostArguments);
+    }
+
+    void
+    await_resume()
+    {
+        if (Cancelled) {
+            throw JOB_CANCELLED_EXCEPTION{"Job cancelled before it started"};
+        }
+    }
+
+    E &Executor;
+    std::tuple<A...> PostArguments;
+    bool Cancelled = false;
+};
+
+/*!
+ * @brief Continues the awaiting coroutine as a job of Executor. If the
+ * executor drops the job, such as a cancelled one, the coroutine continues
+ * where the job is destroyed and the await throws JOB_CANCELLED_EXCEPTION.
+ * @param PostArguments Passed to Post after the job, such as JOB_OPTIONS.
+ */
+template<JOB_EXECUTOR E, class... A>
+SWITCH_AWAITER<E, std::decay_t<A>...>
+SwitchTo(
+    E &Executor,
+    A &&...PostArguments
+)
+{
+    return {Executor, {std::forward<A>(PostArguments)...}};
+}
+
+/*!
+ * @brief Awaiter of Delay, resumes on the timer thread.
+ */
+class DELAY_AWAITER {
+public:
+    bool
+    await_ready() noexcept
+    {
+        return Due <= std::chrono::steady_clock::now();
+    }
+
+    void
+    await_suspend(
+        std::coroutine_handle<> Handle
+    )
+    {
+        TASK_TIMER::Schedule(Due, [Handle] {
+            Handle.resume();
+        });
+    }
+
+    void
+    await_resume() noexcept
+    {
+    }
+
+    std::chrono::steady_clock::time_point Due;
+};
+
+/*!
+ * @brief Awaiter of Delay with an executor.
+ */
+template<JOB_EXECUTOR E>
+class DELAY_ON_AWAITER {
+public:
+    bool
+    await_ready() noexcept
+    {
+        return false;
+    }
+
+    void
+    await_suspend(
+        std::coroutine_handle<> Handle
+    )
+    {
+        TASK_TIMER::Schedule(Due, [&Executor = Executor, Handle] {
+            Executor.Post([Handle] {
+                Handle.resume();
+            });
+        });
+    }
+
+    void
+    await_resume() noexcept
+    {
+    }
+
+    std::chrono::steady_clock::time_point Due;
+    E &Executor;
+};
+
+/*!
+ * @brief Suspends the awaiting coroutine for Duration without holding a
+ * thread. It continues on the timer thread, which it should leave with
+ * SwitchTo for longer work.
+ */
+inline
+DELAY_AWAITER
+Delay(
+    std::chrono::steady_clock::duration Duration
+)
+{
+    return {std::chrono::steady_clock::now() + Duration};
+}
+
+/*!
+ * @brief Suspends the awaiting coroutine for Duration and continues it as a
+ * job of Executor.
+ */
+template<JOB_EXECUTOR E>
+DELAY_ON_AWAITER<E>
+Delay(
+    std::chrono::steady_clock::duration Duration,
+    E &Executor
+)
+{
+    return {std::chrono::steady_clock::now() + Duration, Executor};
+}
+
+/*!
+ * @brief Awaiter of a FUTURE, resumes on the thread that completes it.
+ */
+template<class T>
+class FUTURE_AWAITER {
+public:
+    bool
+    await_ready() noexcept
+    {
+        return Future.IsReady();
+    }
+
+    void
+    await_suspend(
+        std::coroutine_handle<> Handle
+    )
+    {
+        Future.Subscribe([this, Handle](FUTURE<T> Ready) {
+            Future = std::move(Ready);
+            Handle.resume();
+        });
+    }
+
+    T
+    await_resume()
+    {
+        return Future.Get();
+    }
+
+    FUTURE<T> Future;
+};
+
+/*!
+ * @brief Waits for a FUTURE without blocking the thread.
+ */
+template<class T>
+FUTURE_AWAITER<T>
+operator co_await(
+    FUTURE<T> &&Future
+)
+{
+    return {std::move(Future)};
+}
+
+}
@@ -0,0 +1,158 @@
+﻿/*!
+ *  @file       thrdpool.cpp
+ *  @brief      Work-stealing thread pool.
+ */
+
+#include "thrdpool.hpp"
+
+#include <algorithm>
+
+#include "wsdeque.hpp"
+
+namespace Common::Util {
+
+class THREAD_POOL::WORKER {
+public:
+    WORKER(
+        THREAD_POOL &Pool,
+        std::size_t Index
+    ) : Pool(Pool),
+        Index(Index)
+    {
+    }
+
+    THREAD_POOL &Pool;
+    const std::size_t Index;
+    WORK_STEALING_DEQUE<JOB> Jobs;
+    std::thread Thread;
+};
+
+namespace {
+
+/*!
+ * @brief The worker running on the calling thread, null on other threads.
+ */
+thread_local void *CurrentWorker = nullptr;
+
+}
+
+THREAD_POOL::THREAD_POOL(
+    std::size_t WorkerCount
+)
+{
+    WorkerCount = std::max<std::size_t>(WorkerCount, 1);
+
+    Workers_.reserve(WorkerCount);
+    for (std::size_t i = 0; i < WorkerCount; ++i) {
+        Workers_.push_back(std::make_unique<WORKER>(*this, i));
+    }
+
+    /* Started only once every deque exists, workers steal from each other. */
+    for (auto &worker : Workers_) {
+        worker->Thread = std::thread{&THREAD_POOL::WorkerLoop, this, std::ref(*worker)};
+    }
+}
+
+THREAD_POOL::~THREAD_POOL()
+{
+    Stopping_.store(true, std::memory_order_release);
+    Epoch_.fetch_add(1, std::memory_order_seq_cst);
+    Epoch_.notify_all();
+
+    for (auto &worker : Workers_) {
+        worker->Thread.join();
+    }
+}
+
+std::size_t
+THREAD_POOL::GetWorkerCount() const
+{
+    return Workers_.size();
+}
+
+void
+THREAD_POOL::EnqueueInternal(
+    JOB Job
+)
+{
+    auto job = std::make_unique<JOB>(std::move(Job));
+
+    if (const auto worker = static_cast<WORKER *>(CurrentWorker); worker && &worker->Pool == this) {
+        worker->Jobs.Push(job.release());
+    } else {
+        std::lock_guard lock{InjectionLock_};
+        Injected_.push_back(std::move(job));
+        InjectedCount_.store(Injected_.size(), std::memory_order_relaxed);
+    }
+
+    Notify();
+}
+
+void
+THREAD_POOL::Notify()
+{
+    /* Pairs with the sleeper registering before it waits on the epoch. */
+    Epoch_.fetch_add(1, std::memory_order_seq_cst);
+    if (Sleepers_.load(std::memory_order_seq_cst)) {
+        Epoch_.notify_one();
+    }
+}
+
+std::unique_ptr<THREAD_POOL::JOB>
+THREAD_POOL::FindJob(
+    WORKER &Worker
+)
+{
+    if (const auto job = Worker.Jobs.Pop()) {
+        return std::unique_ptr<JOB>{job};
+    }
+
+    if (InjectedCount_.load(std::memory_order_relaxed)) {
+        std::lock_guard lock{InjectionLock_};
+        if (!Injected_.empty()) {
+            auto job = std::move(Injected_.front());
+            Injected_.pop_front();
+            InjectedCount_.store(Injected_.size(), std::memory_order_relaxed);
+            return job;
+        }
+    }
+
+    const auto workerCount = Workers_.size();
+    for (std::size_t i = 1; i < workerCount; ++i) {
+        if (const auto job = Workers_[(Worker.Index + i) % workerCount]->Jobs.Steal()) {
+            return std::unique_ptr<JOB>{job};
+        }
+    }
+
+    return nullptr;
+}
+
+void
+THREAD_POOL::WorkerLoop(
+    WORKER &Worker
+)
+{
+    CurrentWorker = &Worker;
+
+    for (;;) {
+        /* Read before looking for jobs, an enqueue after the search changes it. */
+        const auto epoch = Epoch_.load(std::memory_order_seq_cst);
+
+        if (const auto job = FindJob(Worker)) {
+            (*job)();
+            continue;
+        }
+
+        if (Stopping_.load(std::memory_order_acquire)) {
+            break;
+        }
+
+        Sleepers_.fetch_add(1, std::memory_order_seq_cst);
+        Epoch_.wait(epoch, std::memory_order_seq_cst);
+        Sleepers_.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    CurrentWorker = nullptr;
+}
+
+}
@@ -0,0 +1,142 @@
+﻿/*!
+ *  @file       thrdpool.hpp
+ *  @brief      Work-stealing thread pool.
+ *  @details    Every worker owns a work-stealing deque. Jobs enqueued by a
+ *              worker go to its own deque and are popped in LIFO order,
+ *              jobs enqueued by other threads go to a shared injection
+ *              queue. A worker without jobs takes from the injection queue,
+ *              then steals from the other workers, and finally sleeps on an
+ *              epoch counter that every enqueue advances, so idle workers
+ *              neither spin nor miss a wakeup.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include "ring.hpp"
+
+namespace Common::Util {
+
+/*!
+ * @brief Work-stealing pool of worker threads.
+ */
+class THREAD_POOL {
+public:
+    /*!
+     * @brief Starts the workers.
+     * @param WorkerCount The number of worker threads, at least one.
+     */
+    explicit
+    THREAD_POOL(
+        std::size_t WorkerCount = std::thread::hardware_concurrency()
+    );
+
+    THREAD_POOL(const THREAD_POOL &) = delete;
+
+    THREAD_POOL &
+    operator=(const THREAD_POOL &) = delete;
+
+    /*!
+     * @brief Runs the jobs still queued, including the jobs they enqueue,
+     * and joins the workers. Only workers may enqueue from then on.
+     */
+    ~THREAD_POOL();
+
+    /**
+     * @brief Enqueues a function to be executed on a worker.
+     * @tparam FunctionType Type of the invocable function.
+     * @param Function The function to be enqueued for execution.
+     * @return A future object representing the result of the enqueued function.
+     */
+    template<std::invocable FunctionType>
+    auto
+    Enqueue(FunctionType &&Function)
+    {
+        using PACKAGED_JOB = std::packaged_task<std::invoke_result_t<FunctionType>()>;
+
+        PACKAGED_JOB packagedJob{std::forward<FunctionType>(Function)};
+        auto future = packagedJob.get_future();
+
+        EnqueueInternal([packagedJob_ = std::move(packagedJob)]() mutable {
+            packagedJob_();
+        });
+
+        return future;
+    }
+
+    /*!
+     * @brief Enqueues a function without a future, for FUTURE continuations.
+     * @param Function The function to be enqueued for execution.
+     */
+    template<std::invocable FunctionType>
+    void
+    Post(FunctionType &&Function)
+    {
+        EnqueueInternal(std::forward<FunctionType>(Function));
+    }
+
+    std::size_t
+    GetWorkerCount() const;
+
+private:
+    using JOB = std::move_only_function<void()>;
+
+    class WORKER;
+
+    void
+    EnqueueInternal(
+        JOB Job
+    );
+
+    void
+    WorkerLoop(
+        WORKER &Worker
+    );
+
+    /*!
+     * @brief Takes a job from the own deque, the injection queue or another
+     * worker, in that order.
+     * @return The job, null if none was found.
+     */
+    std::unique_ptr<JOB>
+    FindJob(
+        WORKER &Worker
+    );
+
+    /*!
+     * @brief Wakes a sleeping worker, if there is one.
+     */
+    void
+    Notify();
+
+    std::vector<std::unique_ptr<WORKER>> Workers_;
+
+    std::mutex InjectionLock_;
+    std::deque<std::unique_ptr<JOB>> Injected_;
+
+    /*!
+     * @brief Size of Injected_, read without the lock.
+     */
+    std::atomic<std::size_t> InjectedCount_ = 0;
+
+    /*!
+     * @brief Advanced by every enqueue, sleeping workers wait for it to change.
+     */
+    alignas(CACHE_LINE_SIZE) std::atomic<std::uint32_t> Epoch_ = 0;
+    alignas(CACHE_LINE_SIZE) std::atomic<std::uint32_t> Sleepers_ = 0;
+    std::atomic<bool> Stopping_ = false;
+};
+
+}
@@ -0,0 +1,320 @@
+﻿/*!
+ *  @file       tscclock.cpp
+ *  @brief      Fast timestamp source.
+ */
+
+#include "tscclock.hpp"
+
+#include <cmath>
+#include <limits>
+#include <mutex>
+#include <ratio>
+
+#if NTECTIVE_FAST_CLOCK_TSC && !defined(_MSC_VER)
+    #include <cpuid.h>
+#endif
+
+namespace Common::Util {
+
+namespace {
+
+constexpr auto CalibrationInterval = std::chrono::seconds{1};
+
+/*!
+ * Steady time the first tick rate is measured over.
+ */
+constexpr auto InitialBaseline = std::chrono::milliseconds{2};
+
+std::int64_t
+SinceEpoch(
+    auto TimePoint
+)
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(TimePoint.time_since_epoch()).count();
+}
+
+/**
+ * @brief Readings of the ticks and of the standard clocks taken together.
+ */
+class CLOCK_SAMPLE {
+public:
+    FAST_CLOCK::TICKS Ticks = 0;
+    std::int64_t Steady = 0;    /*!< Nanoseconds of steady_clock. */
+    std::int64_t System = 0;    /*!< Nanoseconds since the Unix epoch. */
+};
+
+/*!
+ * @brief Reads the standard clocks between two tick readings and keeps the
+ * attempt with the narrowest bracket, which is the least disturbed by
+ * preemption.
+ */
+CLOCK_SAMPLE
+TakeSample()
+{
+    CLOCK_SAMPLE best;
+    auto bestWidth = std::numeric_limits<FAST_CLOCK::TICKS>::max();
+
+    for (int attempt = 0; attempt < 5; ++attempt) {
+        const auto before = FAST_CLOCK::Now();
+        const auto steady = std::chrono::steady_clock::now();
+        const auto system = std::chrono::system_clock::now();
+        const auto after = FAST_CLOCK::Now();
+
+        if (after - before < bestWidth) {
+            bestWidth = after - before;
+            best = {
+                .Ticks = before + (after - before) / 2,
+                .Steady = SinceEpoch(steady),
+                .System = SinceEpoch(system)
+            };
+        }
+    }
+
+    return best;
+}
+
+/**
+ * @brief The current linear mapping of ticks to both standard clocks.
+ */
+class CALIBRATION_STATE {
+public:
+    CLOCK_SAMPLE Anchor;
+    double NanosecondsPerTick = 1;
+    FAST_CLOCK::TICKS NextCalibration = 0;
+};
+
+/**
+ * @brief Calibration published with a sequence lock, so that converting
+ * threads only read shared memory.
+ */
+class CALIBRATION {
+public:
+    CALIBRATION()
+    {
+        auto anchor = TakeSample();
+        double nanosecondsPerTick;
+
+        if (FAST_CLOCK::IsTscUsed()) {
+            /* The first conversion pays for a short measurement, later ones refine it. */
+            const auto origin = anchor;
+            const auto baseline = std::chrono::nanoseconds{InitialBaseline}.count();
+            while (SinceEpoch(std::chrono::steady_clock::now()) - origin.Steady < baseline) {
+            }
+
+            anchor = TakeSample();
+            nanosecondsPerTick = static_cast<double>(anchor.Steady - origin.Steady) /
+                                 static_cast<double>(anchor.Ticks - origin.Ticks);
+        } else {
+            using TICK_PERIOD = std::ratio_divide<std::chrono::steady_clock::period, std::nano>;
+            nanosecondsPerTick = static_cast<double>(TICK_PERIOD::num) / static_cast<double>(TICK_PERIOD::den);
+        }
+
+        Publish(anchor, nanosecondsPerTick);
+    }
+
+    CALIBRATION_STATE
+    Read() const
+    {
+        for (;;) {
+            const auto sequence = Sequence_.load(std::memory_order_acquire);
+            if (sequence & 1) {
+                continue;
+            }
+
+            CALIBRATION_STATE state{
+                .Anchor = {
+                    .Ticks = AnchorTicks_.load(std::memory_order_relaxed),
+                    .Steady = AnchorSteady_.load(std::memory_order_relaxed),
+                    .System = AnchorSystem_.load(std::memory_order_relaxed)
+                },
+                .NanosecondsPerTick = NanosecondsPerTick_.load(std::memory_order_relaxed),
+                .NextCalibration = NextCalibration_.load(std::memory_order_relaxed)
+            };
+
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (Sequence_.load(std::memory_order_relaxed) == sequence) {
+                return state;
+            }
+        }
+    }
+
+    /*!
+     * @brief Moves the anchor to a new sample and measures the tick rate
+     * since the previous anchor, which follows drift of the counter.
+     * @param Force Recalibrate even if the current calibration is not due.
+     */
+    void
+    Recalibrate(
+        bool Force
+    )
+    {
+        std::unique_lock lock{Lock_, std::try_to_lock};
+        if (!lock) {
+            if (!Force) {
+                return;
+            }
+            lock.lock();
+        }
+
+        const auto state = Read();
+        const auto anchor = TakeSample();
+        if (!Force && anchor.Ticks < state.NextCalibration) {
+            return;
+        }
+
+        auto nanosecondsPerTick = state.NanosecondsPerTick;
+        if (FAST_CLOCK::IsTscUsed() && anchor.Ticks > state.Anchor.Ticks) {
+            const auto measured = static_cast<double>(anchor.Steady - state.Anchor.Steady) /
+                                  static_cast<double>(anchor.Ticks - state.Anchor.Ticks);
+            if (std::isfinite(measured) && measured > 0) {
+                nanosecondsPerTick = measured;
+            }
+        }
+
+        Publish(anchor, nanosecondsPerTick);
+    }
+
+private:
+    /*!
+     * @brief Publishes a calibration. Called from the constructor or with Lock_ held.
+     */
+    void
+    Publish(
+        const CLOCK_SAMPLE &Anchor,
+        double NanosecondsPerTick
+    )
+    {
+        const auto interval = std::chrono::nanoseconds{CalibrationInterval}.count();
+        const auto sequence = Sequence_.load(std::memory_order_relaxed);
+
+        Sequence_.store(sequence + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+
+        AnchorTicks_.store(Anchor.Ticks, std::memory_order_relaxed);
+        AnchorSteady_.store(Anchor.Steady, std::memory_order_relaxed);
+        AnchorSystem_.store(Anchor.System, std::memory_order_relaxed);
+        NanosecondsPerTick_.store(NanosecondsPerTick, std::memory_order_relaxed);
+        NextCalibration_.store(Anchor.Ticks + static_cast<FAST_CLOCK::TICKS>(interval / NanosecondsPerTick),
+                               std::memory_order_relaxed);
+
+        Sequence_.store(sequence + 2, std::memory_order_release);
+    }
+
+    std::atomic<std::uint32_t> Sequence_ = 0;
+    std::atomic<FAST_CLOCK::TICKS> AnchorTicks_ = 0;
+    std::atomic<std::int64_t> AnchorSteady_ = 0;
+    std::atomic<std::int64_t> AnchorSystem_ = 0;
+    std::atomic<double> NanosecondsPerTick_ = 1;
+    std::atomic<FAST_CLOCK::TICKS> NextCalibration_ = 0;
+    std::mutex Lock_;
+};
+
+CALIBRATION &
+GetCalibration()
+{
+    static CALIBRATION calibration;
+    return calibration;
+}
+
+/*!
+ * @brief Returns the current calibration, recalibrating first if Ticks is
+ * past the next calibration time.
+ */
+CALIBRATION_STATE
+ReadCalibration(
+    FAST_CLOCK::TICKS Ticks
+)
+{
+    auto &calibration = GetCalibration();
+    auto state = calibration.Read();
+
+    if (Ticks >= state.NextCalibration) {
+        calibration.Recalibrate(false);
+        state = calibration.Read();
+    }
+
+    return state;
+}
+
+}
+
+bool
+FAST_CLOCK::IsTscUsed()
+{
+    if (Source_.load(std::memory_order_relaxed) == SOURCE::Unknown) {
+        SelectSource();
+    }
+    return Source_.load(std::memory_order_relaxed) == SOURCE::Tsc;
+}
+
+std::int64_t
+FAST_CLOCK::ToNanoseconds(
+    TICKS Ticks
+)
+{
+    const auto state = ReadCalibration(Ticks);
+    return state.Anchor.Steady +
+           std::llround(static_cast<double>(Ticks - state.Anchor.Ticks) * state.NanosecondsPerTick);
+}
+
+FAST_CLOCK::TICKS
+FAST_CLOCK::ToTicks(
+    std::chrono::nanoseconds Duration
+)
+{
+    const auto state = GetCalibration().Read();
+    return std::llround(static_cast<double>(Duration.count()) / state.NanosecondsPerTick);
+}
+
+std::chrono::system_clock::time_point
+FAST_CLOCK::ToSystemTime(
+    TICKS Ticks
+)
+{
+    const auto state = ReadCalibration(Ticks);
+    const std::chrono::nanoseconds sinceEpoch{
+        state.Anchor.System +
+        std::llround(static_cast<double>(Ticks - state.Anchor.Ticks) * state.NanosecondsPerTick)
+    };
+    return std::chrono::system_clock::time_point{
+        std::chrono::round<std::chrono::system_clock::duration>(sinceEpoch)
+    };
+}
+
+void
+FAST_CLOCK::Recalibrate()
+{
+    GetCalibration().Recalibrate(true);
+}
+
+void
+FAST_CLOCK::SelectSource()
+{
+    auto source = SOURCE::Steady;
+
+#if NTECTIVE_FAST_CLOCK_TSC
+    /* CPUID 80000007h EDX bit 8: the TSC runs at a constant rate in every P-, C- and T-state. */
+    constexpr unsigned invariantTscBit = 1u << 8;
+
+    #ifdef _MSC_VER
+        int info[4];
+        __cpuid(info, 0x80000000);
+        if (static_cast<unsigned>(info[0]) >= 0x80000007) {
+            __cpuid(info, 0x80000007);
+            if (static_cast<unsigned>(info[3]) & invariantTscBit) {
+                source = SOURCE::Tsc;
+            }
+        }
+    #else
+        unsigned eax, ebx, ecx, edx;
+        if (__get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx) && (edx & invariantTscBit)) {
+            source = SOURCE::Tsc;
+        }
+    #endif
+#endif
+
+    auto expected = SOURCE::Unknown;
+    Source_.compare_exchange_strong(expected, source, std::memory_order_relaxed);
+}
+
+}
@@ -0,0 +1,124 @@
+﻿/*!
+ *  @file       tscclock.hpp
+ *  @brief      Fast timestamp source.
+ *  @details    FAST_CLOCK captures raw ticks of the invariant time stamp
+ *              counter, a single instruction, and converts them to
+ *              nanoseconds or system_clock time points only when asked.
+ *              The tick rate is measured against steady_clock and the
+ *              ticks are anchored to system_clock. Both are refreshed
+ *              once per second by the thread converting timestamps, so
+ *              the frequency estimate improves over time and steps of the
+ *              system clock are picked up. On processors without an
+ *              invariant TSC, and on other architectures, the ticks are
+ *              those of steady_clock.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+    #define NTECTIVE_FAST_CLOCK_TSC true
+    #ifdef _MSC_VER
+        #include <intrin.h>
+    #else
+        #include <x86intrin.h>
+    #endif
+#else
+    #define NTECTIVE_FAST_CLOCK_TSC false
+#endif
+
+namespace Common::Util {
+
+/*!
+ * @brief Monotonic clock with cheap capture and deferred conversion.
+ */
+class FAST_CLOCK {
+public:
+    using TICKS = std::int64_t;
+
+    /*!
+     * @brief Returns the current raw tick count. Ticks are only comparable
+     * within the process.
+     */
+    static
+    TICKS
+    Now()
+    {
+#if NTECTIVE_FAST_CLOCK_TSC
+        const auto source = Source_.load(std::memory_order_relaxed);
+        if (source == SOURCE::Tsc) [[likely]] {
+            return static_cast<TICKS>(__rdtsc());
+        }
+        if (source == SOURCE::Unknown) [[unlikely]] {
+            SelectSource();
+            return Now();
+        }
+#endif
+        return std::chrono::steady_clock::now().time_since_epoch().count();
+    }
+
+    /*!
+     * @brief Checks whether ticks come from the time stamp counter rather
+     * than steady_clock.
+     */
+    static
+    bool
+    IsTscUsed();
+
+    /*!
+     * @brief Converts ticks to nanoseconds since the first use of the
+     * clock. Cheaper than ToSystemTime and monotonic between two
+     * calibrations.
+     */
+    static
+    std::int64_t
+    ToNanoseconds(
+        TICKS Ticks
+    );
+
+    /*!
+     * @brief Converts a duration to ticks at the current tick rate, so that
+     * it can be compared with differences of raw ticks.
+     */
+    static
+    TICKS
+    ToTicks(
+        std::chrono::nanoseconds Duration
+    );
+
+    /*!
+     * @brief Converts ticks to wall-clock time, calibrating the clock first
+     * if the last calibration is more than a second older than Ticks.
+     */
+    static
+    std::chrono::system_clock::time_point
+    ToSystemTime(
+        TICKS Ticks
+    );
+
+    /*!
+     * @brief Measures the tick rate again and re-anchors the ticks to the
+     * system clock.
+     */
+    static
+    void
+    Recalibrate();
+
+private:
+    enum class SOURCE : std::uint8_t {
+        Unknown,
+        Tsc,
+        Steady
+    };
+
+    static
+    void
+    SelectSource();
+
+    static inline std::atomic<SOURCE> Source_ = SOURCE::Unknown;
+};
+
+}
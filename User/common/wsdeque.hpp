@@ -0,0 +1,199 @@
+﻿/*!
+ *  @file       wsdeque.hpp
+ *  @brief      Work-stealing deque.
+ *  @details    Chase-Lev deque with the memory orderings of Le, Pop, Cohen
+ *              and Zappa Nardelli, "Correct and Efficient Work-Stealing for
+ *              Weak Memory Models". The owning thread pushes and pops at the
+ *              bottom without atomic read-modify-write operations except
+ *              when taking the last element; other threads steal from the
+ *              top with a CAS. The circular array grows by doubling, arrays
+ *              it outgrew are kept until the deque is destroyed because a
+ *              thief may still be reading them.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "ring.hpp"
+
+namespace Common::Util {
+
+/*!
+ * @brief Single-owner, multi-thief deque of pointers.
+ * @tparam T Type of the pointed-to elements. The deque does not own them.
+ */
+template<class T>
+class WORK_STEALING_DEQUE {
+public:
+    /*!
+     * @brief Constructs a deque.
+     * @param Capacity The initial capacity, rounded up to the next power of two.
+     */
+    explicit
+    WORK_STEALING_DEQUE(
+        std::size_t Capacity = 256
+    )
+    {
+        auto array = std::make_unique<ARRAY>(std::bit_ceil(Capacity < 2 ? std::size_t{2} : Capacity));
+        Array_.store(array.get(), std::memory_order_relaxed);
+        Arrays_.push_back(std::move(array));
+    }
+
+    WORK_STEALING_DEQUE(const WORK_STEALING_DEQUE &) = delete;
+
+    WORK_STEALING_DEQUE &
+    operator=(const WORK_STEALING_DEQUE &) = delete;
+
+    /*!
+     * @brief Pushes an element at the bottom. Owner only.
+     */
+    void
+    Push(
+        T *Element
+    )
+    {
+        const auto bottom = Bottom_.load(std::memory_order_relaxed);
+        const auto top = Top_.load(std::memory_order_acquire);
+        auto array = Array_.load(std::memory_order_relaxed);
+
+        if (bottom - top > static_cast<std::int64_t>(array->Mask)) {
+            array = Grow(array, top, bottom);
+        }
+
+        array->Put(bottom, Element);
+        std::atomic_thread_fence(std::memory_order_release);
+        Bottom_.store(bottom + 1, std::memory_order_relaxed);
+    }
+
+    /*!
+     * @brief Pops the most recently pushed element. Owner only.
+     * @return The element, null if the deque is empty.
+     */
+    T *
+    Pop()
+    {
+        const auto bottom = Bottom_.load(std::memory_order_relaxed) - 1;
+        const auto array = Array_.load(std::memory_order_relaxed);
+        Bottom_.store(bottom, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        auto top = Top_.load(std::memory_order_relaxed);
+
+        if (top > bottom) {
+            Bottom_.store(bottom + 1, std::memory_order_relaxed);
+            return nullptr;
+        }
+
+        auto element = array->Get(bottom);
+        if (top == bottom) {
+            /* The last element, race the thieves for it. */
+            if (!Top_.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+                element = nullptr;
+            }
+
+            Bottom_.store(bottom + 1, std::memory_order_relaxed);
+        }
+
+        return element;
+    }
+
+    /*!
+     * @brief Steals the least recently pushed element. Any thread. Retries
+     * while it loses races against other thieves or the owner and elements
+     * remain.
+     * @return The element, null if the deque is empty.
+     */
+    T *
+    Steal()
+    {
+        for (;;) {
+            auto top = Top_.load(std::memory_order_acquire);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            const auto bottom = Bottom_.load(std::memory_order_acquire);
+
+            if (top >= bottom) {
+                return nullptr;
+            }
+
+            const auto element = Array_.load(std::memory_order_acquire)->Get(top);
+            if (Top_.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+                return element;
+            }
+        }
+    }
+
+    /*!
+     * @brief Whether the deque looked empty. Any thread, a hint only.
+     */
+    bool
+    IsEmpty() const
+    {
+        return Top_.load(std::memory_order_relaxed) >= Bottom_.load(std::memory_order_relaxed);
+    }
+
+private:
+    class ARRAY {
+    public:
+        explicit
+        ARRAY(
+            std::size_t Capacity
+        ) : Mask(Capacity - 1),
+            Elements(std::make_unique<std::atomic<T *>[]>(Capacity))
+        {
+        }
+
+        T *
+        Get(
+            std::int64_t Index
+        ) const
+        {
+            return Elements[static_cast<std::size_t>(Index) & Mask].load(std::memory_order_relaxed);
+        }
+
+        void
+        Put(
+            std::int64_t Index,
+            T *Element
+        )
+        {
+            Elements[static_cast<std::size_t>(Index) & Mask].store(Element, std::memory_order_relaxed);
+        }
+
+        const std::size_t Mask;
+        const std::unique_ptr<std::atomic<T *>[]> Elements;
+    };
+
+    ARRAY *
+    Grow(
+        ARRAY *Array,
+        std::int64_t Top,
+        std::int64_t Bottom
+    )
+    {
+        auto grown = std::make_unique<ARRAY>((Array->Mask + 1) * 2);
+        for (auto i = Top; i < Bottom; ++i) {
+            grown->Put(i, Array->Get(i));
+        }
+
+        const auto result = grown.get();
+        Array_.store(result, std::memory_order_release);
+        Arrays_.push_back(std::move(grown));
+        return result;
+    }
+
+    alignas(CACHE_LINE_SIZE) std::atomic<std::int64_t> Top_ = 0;
+    alignas(CACHE_LINE_SIZE) std::atomic<std::int64_t> Bottom_ = 0;
+    alignas(CACHE_LINE_SIZE) std::atomic<ARRAY *> Array_;
+
+    /*!
+     * @brief Every array the deque used, owner only.
+     */
+    std::vector<std::unique_ptr<ARRAY>> Arrays_;
+};
+
+}
@@ -3,6 +3,7 @@
  *  @brief      Entry point of the NTective program.
  */
 
+#include <chrono>
 #include <exception>
 
 #include "init.hpp"
@@ -32,6 +33,17 @@ wWinMain(
         InitializeLoggingSystem();
         InitializeUiSystem();
 
+        /* Validate the registrations and make them read-only */
+        Common::Ioc::GetIoc().Freeze();
+        Common::Ioc::GetSingletons().Freeze();
+
+        /* Construct the independent singletons concurrently */
+        for (const auto &timing : Common::Ioc::GetSingletons().StartEager()) {
+            LOG_INFO(L"Singleton \"{}\" constructed in {:.3f} ms",
+                     Common::Util::StringToWstring(timing.TypeName),
+                     std::chrono::duration<double, std::milli>(timing.Duration).count());
+        }
+
         std::shared_ptr<Ui::WINDOW_BASE> mainWindow = Common::Ioc::GetIoc().Resolve<Ui::WINDOW_BASE>();
 
         /* Core loop */
@@ -5,7 +5,10 @@
 
 #include "init.hpp"
 #include "../common/ioc.hpp"
+#include "../common/logfile.hpp"
+#include "../common/logfrec.hpp"
 #include "../common/logprov.hpp"
+#include "../common/lograte.hpp"
 #include "../common/logsessn.hpp"
 #include "../ui/winbase.hpp"
 #include "../ui/winimpl.hpp"
@@ -16,33 +19,61 @@ using namespace Common::Log;
 void
 InitializeLoggingSystem()
 {
+    /*
+     * Chatty call sites are limited and repeats collapsed. Errors are never
+     * limited, distinct failures may share a call site such as ASSERTION.
+     */
+    auto &rateLimiter = GetLogRateLimiter();
+    rateLimiter.SetLimit(LOG_LEVEL::Warning, {.EntriesPerSecond = 10, .Burst = 20});
+    rateLimiter.SetLimit(LOG_LEVEL::Info, {.EntriesPerSecond = 10, .Burst = 20});
+    rateLimiter.SetLimit(LOG_LEVEL::Verbose, {.EntriesPerSecond = 10, .Burst = 20});
+    rateLimiter.SetRepeatWindow(std::chrono::seconds{1});
+
     /* Log session factory */
     Ioc::GetIoc().RegisterFactory<LOG_SESSION_BASE>([] {
 
-        std::vector<std::shared_ptr<LOG_PROVIDER_BASE>> providers{
-            Ioc::GetIoc().Resolve<DEBUGGER_LOG_PROVIDER_BASE>(),
-            Ioc::GetIoc().Resolve<FILE_LOG_PROVIDER_BASE>()
-        };
+        auto fileProvider = Ioc::GetIoc().Resolve<FILE_LOG_PROVIDER_BASE>();
+        auto flightRecorder = Ioc::GetIoc().Resolve<FLIGHT_RECORDER_LOG_PROVIDER_BASE>();
 
-        return std::make_shared<LOG_SESSION_IMPL>(std::move(providers));
-    });
+        /* Entries of a run that crashed go to the log file before any entry of this run. */
+        flightRecorder->WriteRecoveredEntries(*fileProvider);
+
+        /*
+         * The debugger and the log file have their own queues: the debugger
+         * drops the oldest entries rather than stall callers and the log
+         * file loses nothing. The flight recorder is written on the logging
+         * thread without a lock, so no entry is still queued when the
+         * process dies.
+         */
+        auto session = std::make_shared<LOG_SESSION_IMPL>();
+        session->RegisterProvider(Ioc::GetIoc().Resolve<DEBUGGER_LOG_PROVIDER_BASE>(),
+                                  {.OverflowPolicy = LOG_OVERFLOW_POLICY::DropOldest, .Capacity = 1024});
+        session->RegisterProvider(std::move(fileProvider),
+                                  {.OverflowPolicy = LOG_OVERFLOW_POLICY::Block, .Capacity = 4096});
+        session->RegisterProvider(std::move(flightRecorder),
+                                  {.Capacity = 0, .Concurrent = true});
+        return session;
+    }, Ioc::DEPENDENCIES<FILE_LOG_PROVIDER_BASE, FLIGHT_RECORDER_LOG_PROVIDER_BASE, DEBUGGER_LOG_PROVIDER_BASE>{});
 
     /* Log providers */
     Ioc::GetIoc().RegisterFactory<DEBUGGER_LOG_PROVIDER_BASE>([] {
         return std::make_shared<DEBUGGER_LOG_PROVIDER_IMPL>(Ioc::GetIoc().Resolve<LOG_FORMATTER_BASE>());
-    });
+    }, Ioc::DEPENDENCIES<LOG_FORMATTER_BASE>{});
     Ioc::GetIoc().RegisterFactory<FILE_LOG_PROVIDER_BASE>([] {
-        return std::make_shared<FILE_LOG_PROVIDER_IMPL>("logs\\log.txt",
-                                                        Ioc::GetIoc().Resolve<LOG_FORMATTER_BASE>());
+        return std::make_shared<BUFFERED_FILE_LOG_PROVIDER_IMPL>("logs\\log.txt",
+                                                                 Ioc::GetIoc().Resolve<LOG_FORMATTER_BASE>());
+    }, Ioc::DEPENDENCIES<LOG_FORMATTER_BASE>{});
+    Ioc::GetIoc().RegisterFactory<FLIGHT_RECORDER_LOG_PROVIDER_BASE>([] {
+        return std::make_shared<FLIGHT_RECORDER_LOG_PROVIDER_IMPL>("logs\\flightrec.bin");
     });
 
     /* Log formatter */
     Ioc::GetIoc().RegisterFactory<LOG_FORMATTER_BASE>([] {
-        return std::make_shared<LOG_FORMATTER>();
+        return std::make_shared<LOG_FORMATTER>(LOG_FORMATTER_MODE::Fast);
     });
 
     /* Log session singleton */
-    Ioc::GetSingletons().RegisterDelegateFactory<LOG_SESSION_BASE>();
+    Ioc::GetSingletons().RegisterDelegateFactory<LOG_SESSION_BASE>(Ioc::SINGLETON_START::Eager);
 }
 
 void
@@ -54,7 +85,7 @@ InitializeUiSystem()
                                                      ? IocParams.WindowClass
                                                      : Ioc::GetSingletons().Resolve<Ui::WINDOW_CLASS_BASE>(),
                                                  IocParams.Title.value_or(L"NTective — NT Detective"));
-    });
+    }, Ioc::DEPENDENCIES<Ioc::SINGLETON_OF<Ui::WINDOW_CLASS_BASE>>{}, Ioc::PAYLOAD_DEFAULT::Supported);
 
     /* Window class factory */
     Ioc::GetIoc().RegisterFactory<Ui::WINDOW_CLASS_BASE>([] {
@@ -62,5 +93,5 @@ InitializeUiSystem()
     });
 
     /* Window class singleton */
-    Ioc::GetSingletons().RegisterDelegateFactory<Ui::WINDOW_CLASS_BASE>();
+    Ioc::GetSingletons().RegisterDelegateFactory<Ui::WINDOW_CLASS_BASE>(Ioc::SINGLETON_START::Eager);
 }
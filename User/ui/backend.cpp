@@ -76,7 +76,7 @@ void
 GFX_BACKEND::EndFrame()
 {
     if (!SwapChain_) {
-        LOG.Warning(L"SwapChain_ is null");
+        LOG_WARNING(L"SwapChain_ is null");
         return;
     }
 
@@ -92,7 +92,7 @@ GFX_BACKEND::ClearBuffer(
 )
 {
     if (!RenderTargetView_) {
-        LOG.Warning(L"RenderTargetView_ is null");
+        LOG_WARNING(L"RenderTargetView_ is null");
         return;
     }
 
@@ -124,7 +124,7 @@ MAIN_WINDOW::HandleMessage(
             return 0;
         }
         case WM_JOB: {
-            JobQueue_.PopAndExecute();
+            JobQueue_.Drain(JobBudget);
             return 0;
         }
         case WM_SIZE: {
@@ -157,7 +157,7 @@ void
 MAIN_WINDOW::MessageLoop()
 {
     StartSignal_.acquire();
-    JobQueue_.PopAndExecute();
+    JobQueue_.DrainAll();
 
     MSG message{};
     while (GetMessageW(&message, Handle_, 0, 0)) {
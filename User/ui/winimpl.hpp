@@ -5,6 +5,7 @@
 
 #pragma once
 
+#include <chrono>
 #include <thread>
 #include <semaphore>
 
@@ -47,6 +48,12 @@ public:
 protected:
     static constexpr UINT WM_JOB = WM_USER + 0;
 
+    /*!
+     * @brief Time spent executing jobs per WM_JOB message before the message
+     * loop handles other messages.
+     */
+    static constexpr std::chrono::milliseconds JobBudget{4};
+
     LRESULT
     HandleMessage(
         HWND Handle,
@@ -59,13 +66,15 @@ protected:
     void
     MessageLoop();
 
-    template<std::invocable F>
+    template<class F>
+        requires std::invocable<F> || std::invocable<F, std::stop_token>
     auto
-    Dispatch(F &&Function)
+    Dispatch(
+        F &&Function,
+        Common::Util::JOB_OPTIONS Options = {}
+    )
     {
-        auto future = JobQueue_.Enqueue(std::forward<F>(Function));
-        JobDispatch();
-        return future;
+        return JobQueue_.Enqueue(std::forward<F>(Function), std::move(Options));
     }
 
     void
@@ -77,7 +86,9 @@ protected:
     std::unique_ptr<IMGUI_MGR> ImguiMgr_;
     std::thread MessageLoopThread_;
     std::binary_semaphore StartSignal_{ 0 };
-    mutable Common::Util::JOB_QUEUE JobQueue_;
+    mutable Common::Util::JOB_QUEUE JobQueue_{[this] {
+        JobDispatch();
+    }};
     std::atomic<bool> IsClosing_ = false;
     std::atomic<unsigned int> ResizeWidth_ = 0;
     std::atomic<unsigned int> ResizeHeight_ = 0;